@@ -31,6 +31,7 @@ win32 {
   OPENSSL=C:\\OpenSSL-Win32
   GIT_BIN='C:\\Git\\bin\\git'
   MARBLE_BASE="c:\\Projekte\\marble-$${CONF_TYPE}"
+  SQLITE_BASE="C:\\Projekte\\sqlite"
 }
 
 # Linux ==================
@@ -82,7 +83,7 @@ INCLUDEPATH += $$PWD/../atools/src $$PWD/src
 win32 {
 DEFINES += _USE_MATH_DEFINES
   LIBS += -L $$PWD/../build-atools-$${CONF_TYPE}/$${CONF_TYPE} -l atools
-  LIBS += -lz
+  LIBS += -lz -lpsapi
   PRE_TARGETDEPS += $$PWD/../build-atools-$${CONF_TYPE}/$${CONF_TYPE}/libatools.a
   WINDEPLOY_FLAGS = --compiler-runtime
 }
@@ -105,6 +106,16 @@ macx {
 
 CONFIG += c++14
 
+# SQLite is linked directly to interrupt outdated background searches in the search tabs.
+# Interrupting is disabled at runtime if the version differs from the one used by the Qt SQL driver.
+win32 {
+  INCLUDEPATH += $$SQLITE_BASE
+  LIBS += -L$$SQLITE_BASE -lsqlite3
+}
+unix {
+  LIBS += -lsqlite3
+}
+
 # Get the current GIT revision to include it into the code
 win32:DEFINES += GIT_REVISION='\\"$$system($${GIT_BIN} rev-parse --short HEAD)\\"'
 unix:DEFINES += GIT_REVISION='\\"$$system(git rev-parse --short HEAD)\\"'
@@ -123,6 +134,7 @@ SOURCES += src/main.cpp\
     src/search/airportsearch.cpp \
     src/search/navsearch.cpp \
     src/mapgui/mappaintlayer.cpp \
+    src/mapgui/mappaintprofiler.cpp \
     src/mapgui/maplayer.cpp \
     src/mapgui/maplayersettings.cpp \
     src/mapgui/mappainter.cpp \
@@ -144,12 +156,18 @@ SOURCES += src/main.cpp\
     src/common/maptypesfactory.cpp \
     src/db/databasedialog.cpp \
     src/route/parkingdialog.cpp \
+    src/route/routebatch.cpp \
     src/route/routecommand.cpp \
     src/route/routefinder.cpp \
+    src/route/indexedheap.cpp \
+    src/route/routelandmarks.cpp \
+    src/route/routenetworkshortcuts.cpp \
     src/mapgui/mapwidget.cpp \
     src/route/routenetworkradio.cpp \
     src/route/routenetworkairway.cpp \
     src/route/routenetwork.cpp \
+    src/route/routenetworkgraph.cpp \
+    src/route/routenetworkgrid.cpp \
     src/common/weatherreporter.cpp \
     src/connect/connectdialog.cpp \
     src/connect/connectclient.cpp \
@@ -160,12 +178,15 @@ SOURCES += src/main.cpp\
     src/common/symbolpainter.cpp \
     src/db/databasemanager.cpp \
     src/db/dbtypes.cpp \
+    src/db/spatialindex.cpp \
+    src/db/textindex.cpp \
     src/common/constants.cpp \
     src/export/csvexporter.cpp \
     src/export/exporter.cpp \
     src/export/htmlexporter.cpp \
     src/common/htmlinfobuilder.cpp \
     src/mapgui/mapscreenindex.cpp \
+    src/mapgui/mapscreengrid.cpp \
     src/options/optionsdialog.cpp \
     src/options/optiondata.cpp \
     src/common/settingsmigrate.cpp \
@@ -208,6 +229,7 @@ HEADERS  += src/gui/mainwindow.h \
     src/search/airportsearch.h \
     src/search/navsearch.h \
     src/mapgui/mappaintlayer.h \
+    src/mapgui/mappaintprofiler.h \
     src/mapgui/maplayer.h \
     src/mapgui/maplayersettings.h \
     src/mapgui/mappainter.h \
@@ -229,15 +251,22 @@ HEADERS  += src/gui/mainwindow.h \
     src/common/maptypesfactory.h \
     src/db/databasedialog.h \
     src/route/parkingdialog.h \
+    src/route/routebatch.h \
     src/route/routecommand.h \
     src/route/routefinder.h \
+    src/route/indexedheap.h \
+    src/route/routelandmarks.h \
+    src/route/routenetworkshortcuts.h \
     src/mapgui/mapwidget.h \
     src/route/routenetworkradio.h \
     src/route/routenetworkairway.h \
     src/route/routenetwork.h \
+    src/route/routenetworkgraph.h \
+    src/route/routenetworkgrid.h \
     src/common/weatherreporter.h \
     src/connect/connectdialog.h \
     src/connect/connectclient.h \
+    src/connect/simconnectdataptr.h \
     src/mapgui/mappainteraircraft.h \
     src/profile/profilewidget.h \
     src/common/aircrafttrack.h \
@@ -245,12 +274,15 @@ HEADERS  += src/gui/mainwindow.h \
     src/common/symbolpainter.h \
     src/db/databasemanager.h \
     src/db/dbtypes.h \
+    src/db/spatialindex.h \
+    src/db/textindex.h \
     src/common/constants.h \
     src/export/csvexporter.h \
     src/export/exporter.h \
     src/export/htmlexporter.h \
     src/common/htmlinfobuilder.h \
     src/mapgui/mapscreenindex.h \
+    src/mapgui/mapscreengrid.h \
     src/options/optionsdialog.h \
     src/options/optiondata.h \
     src/common/settingsmigrate.h \
@@ -25,14 +25,27 @@
 #include <QDateTime>
 #include <QFile>
 
-AircraftTrack::AircraftTrack()
+#include <limits>
+
+/* Use a coarser level if the points of a level are closer than this on average */
+static const float TRACK_MIN_PIXEL_DISTANCE = 2.f;
+
+/* Flush history file after this number of positions */
+static const int HISTORY_FLUSH_INTERVAL = 60;
+
+static QString historyFilename()
 {
+  return atools::settings::Settings::getConfigFilename(".trackhistory");
+}
 
+AircraftTrack::AircraftTrack()
+{
+  levels.resize(NUM_TRACK_LEVELS);
 }
 
 AircraftTrack::~AircraftTrack()
 {
-
+  closeHistory();
 }
 
 namespace at {
@@ -51,66 +64,226 @@ QDataStream& operator<<(QDataStream& dataStream, const at::AircraftTrackPos& tra
 
 }
 
+/* History records are written field by field to get a fixed record size */
+static void writeHistoryPos(QDataStream& dataStream, const at::AircraftTrackPos& trackPos)
+{
+  dataStream << trackPos.pos.getLonX() << trackPos.pos.getLatY() << trackPos.pos.getAltitude()
+             << trackPos.timestamp << static_cast<quint8>(trackPos.onGround);
+}
+
+static void readHistoryPos(QDataStream& dataStream, at::AircraftTrackPos& trackPos)
+{
+  float lonX, latY, altitude;
+  quint8 onGround;
+  dataStream >> lonX >> latY >> altitude >> trackPos.timestamp >> onGround;
+  trackPos.pos = atools::geo::Pos(lonX, latY, altitude);
+  trackPos.onGround = onGround > 0;
+}
+
 void AircraftTrack::saveState()
 {
+  // All positions are already in the history file
+  if(!historyFile.isNull())
+    historyFile->flush();
+}
+
+void AircraftTrack::restoreState()
+{
+  closeHistory();
+  clear();
+  clearLevels();
+
+  if(restoreHistory())
+    // Continue writing to the existing history
+    openHistory(false);
+  else
+    migrateTrackFile();
+}
+
+void AircraftTrack::migrateTrackFile()
+{
+  QList<at::AircraftTrackPos> positions;
   QFile trackFile(atools::settings::Settings::getConfigFilename(".track"));
+  if(!trackFile.exists())
+    return;
 
-  if(trackFile.open(QIODevice::WriteOnly))
+  if(trackFile.open(QIODevice::ReadOnly))
   {
-    QDataStream out(&trackFile);
-    out.setVersion(QDataStream::Qt_5_5);
-    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    quint32 magic;
+    quint16 version;
+    QDataStream in(&trackFile);
+    in.setVersion(QDataStream::Qt_5_5);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    in >> magic;
+
+    if(magic == FILE_MAGIC_NUMBER)
+    {
+      in >> version;
+      if(version == FILE_VERSION)
+        in >> positions;
+      else
+        qWarning() << "Cannot read track" << trackFile.fileName() << ". Invalid version number:" << version;
+    }
+    else
+      qWarning() << "Cannot read track" << trackFile.fileName() << ". Invalid magic number:" << magic;
 
-    out << FILE_MAGIC_NUMBER << FILE_VERSION << *this;
     trackFile.close();
   }
   else
-    qWarning() << "Cannot write track" << trackFile.fileName() << ":" << trackFile.errorString();
+  {
+    qWarning() << "Cannot read track" << trackFile.fileName() << ":" << trackFile.errorString();
+    return;
+  }
+
+  // Build levels and start a new history
+  openHistory(true);
+  for(const at::AircraftTrackPos& trackPos : positions)
+    addTrackPos(trackPos, true);
+
+  if(!historyStream.isNull())
+  {
+    // Positions are in the history now - old file is not written anymore
+    historyFile->flush();
+    trackFile.remove();
+  }
 }
 
-void AircraftTrack::restoreState()
+bool AircraftTrack::restoreHistory()
 {
-  clear();
+  QString filename = historyFilename();
+  QFile file(filename);
+  if(!file.exists())
+    return false;
 
-  QFile trackFile(atools::settings::Settings::getConfigFilename(".track"));
-  if(trackFile.exists())
+  if(!file.open(QIODevice::ReadOnly))
   {
-    if(trackFile.open(QIODevice::ReadOnly))
+    qWarning() << "Cannot read track history" << filename << ":" << file.errorString();
+    return false;
+  }
+
+  quint32 magic;
+  quint16 version;
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_5_5);
+  in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+  in >> magic >> version;
+
+  if(magic != HISTORY_FILE_MAGIC_NUMBER || version != HISTORY_FILE_VERSION)
+  {
+    qWarning() << "Cannot read track history" << filename << ". Invalid magic or version number:"
+               << magic << version;
+    return false;
+  }
+
+  // Incomplete last record if program was not shut down properly
+  qint64 headerSize = file.pos();
+  qint64 numRecords = (file.size() - headerSize) / HISTORY_RECORD_SIZE;
+  qint64 validSize = headerSize + numRecords * HISTORY_RECORD_SIZE;
+  qint64 fileSize = file.size();
+
+  // Level n keeps every TRACK_LEVEL_FACTOR^n-th record - read only the last maxTrackEntries of each
+  // level instead of replaying the whole history
+  qint64 step = 1;
+  for(int levelIndex = 0; levelIndex <= NUM_TRACK_LEVELS && numRecords > 0; levelIndex++)
+  {
+    QList<at::AircraftTrackPos>& level = levelIndex == 0 ? *this : levels[levelIndex - 1];
+    qint64 count = (numRecords - 1) / step + 1;
+    qint64 first = std::max<qint64>(count - maxTrackEntries, 0);
+
+    at::AircraftTrackPos trackPos;
+    for(qint64 i = first; i < count; i++)
     {
-      quint32 magic;
-      quint16 version;
-      QDataStream in(&trackFile);
-      in.setVersion(QDataStream::Qt_5_5);
-      in.setFloatingPointPrecision(QDataStream::SinglePrecision);
-      in >> magic;
-
-      if(magic == FILE_MAGIC_NUMBER)
-      {
-        in >> version;
-        if(version == FILE_VERSION)
-          in >> *this;
-        else
-          qWarning() << "Cannot read track" << trackFile.fileName() << ". Invalid version number:" << version;
-      }
-      else
-        qWarning() << "Cannot read track" << trackFile.fileName() << ". Invalid magic number:" << magic;
+      // Records are consecutive on level 0
+      if((step > 1 || i == first) && !file.seek(headerSize + i * step * HISTORY_RECORD_SIZE))
+        break;
 
-      trackFile.close();
+      readHistoryPos(in, trackPos);
+      if(in.status() != QDataStream::Ok)
+        break;
+      level.append(trackPos);
     }
-    else
-      qWarning() << "Cannot read track" << trackFile.fileName() << ":" << trackFile.errorString();
+
+    // Estimate the track length from the finest level covering the whole history or the coarsest one
+    if((first == 0 || levelIndex == NUM_TRACK_LEVELS) && trackLengthMeter == 0.)
+    {
+      for(int i = 1; i < level.size(); i++)
+        trackLengthMeter += level.at(i - 1).pos.distanceMeterTo(level.at(i).pos);
+    }
+    step *= TRACK_LEVEL_FACTOR;
+  }
+  numPositions = static_cast<quint64>(numRecords);
+  file.close();
+
+  if(validSize < fileSize)
+  {
+    qWarning() << "Truncating track history" << filename << "to" << validSize;
+    QFile::resize(filename, validSize);
+  }
+
+  return true;
+}
+
+void AircraftTrack::openHistory(bool truncate)
+{
+  closeHistory();
+
+  historyFile.reset(new QFile(historyFilename()));
+  if(historyFile->open(truncate ? QIODevice::WriteOnly : QIODevice::WriteOnly | QIODevice::Append))
+  {
+    historyStream.reset(new QDataStream(historyFile.data()));
+    historyStream->setVersion(QDataStream::Qt_5_5);
+    historyStream->setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    if(truncate)
+      *historyStream << HISTORY_FILE_MAGIC_NUMBER << HISTORY_FILE_VERSION;
+    historyError = false;
   }
+  else
+  {
+    qWarning() << "Cannot write track history" << historyFile->fileName() << ":" << historyFile->errorString();
+    historyFile.reset();
+
+    // Do not try again for each position
+    historyError = true;
+  }
+}
+
+void AircraftTrack::closeHistory()
+{
+  historyStream.reset();
+
+  if(!historyFile.isNull())
+    historyFile->close();
+  historyFile.reset();
+}
+
+void AircraftTrack::clearTrack()
+{
+  clear();
+  clearLevels();
+  closeHistory();
+  historyError = false;
+  QFile::remove(historyFilename());
+  // Avoid conversion of an outdated track on next start
+  QFile::remove(atools::settings::Settings::getConfigFilename(".track"));
+}
+
+void AircraftTrack::clearLevels()
+{
+  for(QList<at::AircraftTrackPos>& level : levels)
+    level.clear();
+  numPositions = 0;
+  trackLengthMeter = 0.;
 }
 
 bool AircraftTrack::appendTrackPos(const atools::geo::Pos& pos, const QDateTime& timestamp, bool onGround)
 {
-  bool pruned = false;
   // Use a larger distance on ground before storing position
   float epsilon = onGround ? atools::geo::Pos::POS_EPSILON_5M : atools::geo::Pos::POS_EPSILON_100M;
   long timeDiff = onGround ? MIN_POSITION_TIME_DIFF_GROUND_MS : MIN_POSITION_TIME_DIFF_MS;
 
   if(isEmpty())
-    append({pos, timestamp.toTime_t(), onGround});
+    return addTrackPos({pos, timestamp.toTime_t(), onGround}, true);
   else
   {
     long time = timestamp.toMSecsSinceEpoch();
@@ -120,22 +293,107 @@ bool AircraftTrack::appendTrackPos(const atools::geo::Pos& pos, const QDateTime&
     {
       if(pos.distanceMeterTo(last().pos) > atools::geo::nmToMeter(MAX_POINT_DISTANCE_NM))
       {
-        clear();
-        pruned = true;
+        // Aircraft jumped - start a new track and history
+        clearTrack();
+        addTrackPos({pos, timestamp.toTime_t(), onGround}, true);
+        return true;
       }
       else
+        return addTrackPos({pos, timestamp.toTime_t(), onGround}, true);
+    }
+  }
+  return false;
+}
+
+bool AircraftTrack::addTrackPos(const at::AircraftTrackPos& trackPos, bool writeHistory)
+{
+  bool pruned = false;
+  if(size() > maxTrackEntries)
+  {
+    // Older positions are still available in the coarser levels and the history file
+    erase(begin(), begin() + PRUNE_TRACK_ENTRIES);
+    pruned = true;
+  }
+
+  if(!isEmpty())
+    trackLengthMeter += last().pos.distanceMeterTo(trackPos.pos);
+  append(trackPos);
+
+  // Add every TRACK_LEVEL_FACTOR^n-th position to level n
+  quint64 step = TRACK_LEVEL_FACTOR;
+  for(QList<at::AircraftTrackPos>& level : levels)
+  {
+    if(numPositions % step != 0)
+      break;
+
+    if(level.size() > maxTrackEntries)
+      level.erase(level.begin(), level.begin() + PRUNE_TRACK_ENTRIES);
+    level.append(trackPos);
+    step *= TRACK_LEVEL_FACTOR;
+  }
+  numPositions++;
+
+  if(writeHistory)
+  {
+    if(historyStream.isNull() && !historyError)
+      openHistory(true);
+
+    if(!historyStream.isNull())
+    {
+      writeHistoryPos(*historyStream, trackPos);
+      if(numPositions % HISTORY_FLUSH_INTERVAL == 0)
+        historyFile->flush();
+    }
+  }
+  return pruned;
+}
+
+void AircraftTrack::getTrackPositions(float metersPerPixel, QVector<atools::geo::Pos>& positions) const
+{
+  positions.clear();
+  if(isEmpty())
+    return;
+
+  // Find the finest level where positions are not closer than a few pixels on average
+  double distance = numPositions > 1 ? trackLengthMeter / (numPositions - 1) : 0.;
+  int levelIndex = 0;
+  while(levelIndex < NUM_TRACK_LEVELS && distance < TRACK_MIN_PIXEL_DISTANCE * metersPerPixel)
+  {
+    distance *= TRACK_LEVEL_FACTOR;
+    levelIndex++;
+  }
+
+  const QList<at::AircraftTrackPos>& selected = levelIndex == 0 ? *this : levels.at(levelIndex - 1);
+
+  // Fill the time before the first position of the selected level from coarser levels
+  QVector<QVector<atools::geo::Pos> > olderParts;
+  quint32 earliest = selected.isEmpty() ? std::numeric_limits<quint32>::max() : selected.first().timestamp;
+  for(int i = levelIndex; i < NUM_TRACK_LEVELS; i++)
+  {
+    const QList<at::AircraftTrackPos>& level = levels.at(i);
+    if(!level.isEmpty() && level.first().timestamp < earliest)
+    {
+      QVector<atools::geo::Pos> part;
+      for(const at::AircraftTrackPos& trackPos : level)
       {
-        if(size() > maxTrackEntries)
-        {
-          for(int i = 0; i < PRUNE_TRACK_ENTRIES; i++)
-            removeFirst();
-          pruned = true;
-        }
+        if(trackPos.timestamp >= earliest)
+          break;
+        part.append(trackPos.pos);
       }
-      append({pos, timestamp.toTime_t(), onGround});
+      olderParts.prepend(part);
+      earliest = level.first().timestamp;
     }
   }
-  return pruned;
+
+  for(const QVector<atools::geo::Pos>& part : olderParts)
+    positions += part;
+
+  for(const at::AircraftTrackPos& trackPos : selected)
+    positions.append(trackPos.pos);
+
+  // Always end at the current position
+  if(levelIndex > 0 && (selected.isEmpty() || selected.last().timestamp != last().timestamp))
+    positions.append(last().pos);
 }
 
 float AircraftTrack::getMaxAltitude() const
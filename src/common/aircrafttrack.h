@@ -20,6 +20,12 @@
 
 #include "geo/pos.h"
 
+#include <QVector>
+#include <QScopedPointer>
+
+class QFile;
+class QDataStream;
+
 namespace at {
 /* Track position. Can be converted to QVariant and thus be saved to settings */
 struct AircraftTrackPos
@@ -38,7 +44,12 @@ Q_DECLARE_TYPEINFO(at::AircraftTrackPos, Q_PRIMITIVE_TYPE);
 Q_DECLARE_METATYPE(at::AircraftTrackPos);
 
 /*
- * Stores the track of the flight simulator aircraft
+ * Stores the track of the flight simulator aircraft.
+ *
+ * The list contains the most recent positions in full resolution. All positions are also appended to a
+ * history file so nothing is lost if the list is pruned. Additional levels keep every
+ * TRACK_LEVEL_FACTOR^level-th position and reach further back in time. These are used to paint long tracks
+ * with a resolution matching the zoom distance.
  */
 class AircraftTrack :
   private QList<at::AircraftTrackPos>
@@ -47,14 +58,14 @@ public:
   AircraftTrack();
   ~AircraftTrack();
 
-  /* Saves and restores track into a separate file (little_navmap.track) */
+  /* Positions are written continuously to the history file (little_navmap.trackhistory).
+   * saveState only flushes it. restoreState reads the history or converts the track file
+   * (little_navmap.track) of older versions. */
   void saveState();
   void restoreState();
 
-  void clearTrack()
-  {
-    clear();
-  }
+  /* Remove all positions and the history file */
+  void clearTrack();
 
   /*
    * Add a track position. Accurracy depends on the ground flag which will cause more
@@ -65,6 +76,14 @@ public:
 
   float getMaxAltitude() const;
 
+  /*
+   * Get positions for painting with point distance matching the map scale.
+   * Older parts which were pruned from finer levels are taken from coarser ones.
+   * @param metersPerPixel current map scale
+   * @param positions receives positions from oldest to newest
+   */
+  void getTrackPositions(float metersPerPixel, QVector<atools::geo::Pos>& positions) const;
+
   /* Pull only needed methods into public space */
   using QList::isEmpty;
   using QList::first;
@@ -80,7 +99,23 @@ public:
   }
 
 private:
-  /* Maximum number of track points. If exceeded entries will be removed from beginning of the list */
+  /* Add position to list and levels and write it to the history file if writeHistory is true */
+  bool addTrackPos(const at::AircraftTrackPos& trackPos, bool writeHistory);
+
+  /* Rebuild list and levels from the history file. Reads only the positions kept in memory for each level.
+   * Returns false if not found or invalid. */
+  bool restoreHistory();
+
+  /* Read old track file and start a new history from it. Old file is deleted afterwards. */
+  void migrateTrackFile();
+
+  /* Open history file for appending. File is recreated if truncate is true. */
+  void openHistory(bool truncate);
+  void closeHistory();
+  void clearLevels();
+
+  /* Maximum number of track points. If exceeded entries will be removed from beginning of the list.
+   * Also used as the limit for each level. */
   int maxTrackEntries = 20000;
   /* Number of entries to remove at once */
   static Q_DECL_CONSTEXPR int PRUNE_TRACK_ENTRIES = 200;
@@ -96,6 +131,32 @@ private:
 
   /* Version 2 to adds timstamp and single floating point precision */
   static Q_DECL_CONSTEXPR quint16 FILE_VERSION = 2;
+
+  static Q_DECL_CONSTEXPR quint32 HISTORY_FILE_MAGIC_NUMBER = 0x5B6C1A2C;
+
+  /* Version 2 uses fixed size records to allow seeking */
+  static Q_DECL_CONSTEXPR quint16 HISTORY_FILE_VERSION = 2;
+
+  /* Size of a history record: lonX, latY, altitude, timestamp and on ground flag */
+  static Q_DECL_CONSTEXPR qint64 HISTORY_RECORD_SIZE = 3 * sizeof(float) + sizeof(quint32) + sizeof(quint8);
+
+  /* Number of decimated levels and factor between two levels */
+  static Q_DECL_CONSTEXPR int NUM_TRACK_LEVELS = 6;
+  static Q_DECL_CONSTEXPR int TRACK_LEVEL_FACTOR = 4;
+
+  /* Decimated levels 1 to NUM_TRACK_LEVELS. Level 0 is the list itself. */
+  QVector<QList<at::AircraftTrackPos> > levels;
+
+  /* Number of positions and track length since last clear. Used to select the level. */
+  quint64 numPositions = 0;
+  double trackLengthMeter = 0.;
+
+  /* Append only file containing all positions since last clear */
+  QScopedPointer<QFile> historyFile;
+  QScopedPointer<QDataStream> historyStream;
+  bool historyError = false;
+
+  Q_DISABLE_COPY(AircraftTrack)
 };
 
 #endif // LITTLENAVMAP_AIRCRAFTTRACK_H
@@ -142,7 +142,9 @@ const QLatin1Literal SEARCHTAB_NAV_VIEW_DIST_WIDGET("SearchPaneNav/WidgetDistVie
 /* General settings in the configuration file not covered by any GUI elements */
 const QLatin1Literal SETTINGS_INFOQUERY("Settings/InfoQuery");
 const QLatin1Literal SETTINGS_MAPQUERY("Settings/MapQuery");
+const QLatin1Literal SETTINGS_MAPPAINT("Settings/MapPaint");
 const QLatin1Literal SETTINGS_DATABASE("Settings/Database");
+const QLatin1Literal SETTINGS_ROUTENETWORK("Settings/RouteNetwork");
 
 const QLatin1Literal APPROACHTREE_WIDGET("ApproachTree/Widget");
 const QLatin1Literal APPROACHTREE_SELECTED_WIDGET("ApproachTree/WidgetSelected");
@@ -25,11 +25,18 @@
 
 #include <QLineF>
 
+#include <cmath>
+
 using namespace Marble;
 using namespace atools::geo;
 
 const QSize CoordinateConverter::DEFAULT_WTOS_SIZE(100, 100);
 
+/* Positions above or below are not shown in the Mercator projection. Same as Marble. */
+static const double MAX_MERCATOR_LAT_DEG = 85.05113;
+
+static const double DEG_TO_RAD = M_PI / 180.;
+
 CoordinateConverter::CoordinateConverter(const ViewportParams *viewportParams)
   : viewport(viewportParams)
 {
@@ -201,6 +208,121 @@ QPoint CoordinateConverter::wToS(const Marble::GeoDataCoordinates& coords, const
   }
 }
 
+void CoordinateConverter::wToSBatch(const QVector<double>& lonX, const QVector<double>& latY,
+                                    QVector<double>& x, QVector<double>& y, QVector<bool>& visible,
+                                    const QSize& size, const QVector<QSize> *sizes,
+                                    QVector<bool> *hidden) const
+{
+  int num = lonX.size();
+  x.resize(num);
+  y.resize(num);
+  visible.resize(num);
+  if(hidden != nullptr)
+    hidden->resize(num);
+
+  Marble::Projection projection = viewport->projection();
+  if(projection != Marble::Spherical && projection != Marble::Mercator)
+  {
+    // Let Marble do the work
+    for(int i = 0; i < num; i++)
+    {
+      bool hid;
+      const QSize& sz = sizes != nullptr ? sizes->at(i) : size;
+      visible[i] = wToS(Pos(lonX.at(i), latY.at(i)), x[i], y[i], sz, &hid);
+      if(hidden != nullptr)
+        (*hidden)[i] = hid;
+    }
+    return;
+  }
+
+  // Positions behind globe for the spherical and positions out of range for the Mercator projection
+  QVector<bool> notShown(num, false);
+  if(projection == Marble::Spherical)
+    wToSBatchSpherical(lonX, latY, x, y, notShown);
+  else
+    wToSBatchMercator(lonX, latY, x, y);
+
+  // Check visibility for all points - allow symbols partially outside of the screen
+  const double width = viewport->width(), height = viewport->height();
+  const double worldWidth = 4. * viewport->radius();
+  for(int i = 0; i < num; i++)
+  {
+    const QSize& sz = sizes != nullptr ? sizes->at(i) : size;
+    double w2 = sz.width() / 2., h2 = sz.height() / 2.;
+
+    bool valid = std::abs(latY.at(i)) <= 90. && std::abs(lonX.at(i)) <= 360.;
+    if(projection == Marble::Mercator && valid)
+    {
+      valid = std::abs(latY.at(i)) <= MAX_MERCATOR_LAT_DEG;
+
+      // Use the leftmost of the repeated points which touches the screen like wToS does
+      double xr = x.at(i) - std::floor((x.at(i) + w2) / worldWidth) * worldWidth;
+      if(xr - w2 <= width)
+        x[i] = xr;
+    }
+
+    if(!valid)
+      x[i] = y[i] = 0.;
+
+    bool hid = valid && notShown.at(i);
+    if(hidden != nullptr)
+      (*hidden)[i] = hid;
+
+    visible[i] = valid && !hid &&
+                 x.at(i) + w2 >= 0. && x.at(i) - w2 <= width && y.at(i) + h2 >= 0. && y.at(i) - h2 <= height;
+  }
+}
+
+/* Orthographic projection. */
+void CoordinateConverter::wToSBatchSpherical(const QVector<double>& lonX, const QVector<double>& latY,
+                                             QVector<double>& x, QVector<double>& y,
+                                             QVector<bool>& hidden) const
+{
+  const double radius = viewport->radius();
+  const double centerX = viewport->width() / 2., centerY = viewport->height() / 2.;
+  const double centerLon = viewport->centerLongitude();
+  const double sinCenterLat = std::sin(viewport->centerLatitude());
+  const double cosCenterLat = std::cos(viewport->centerLatitude());
+
+  const double *lonXPtr = lonX.constData(), *latYPtr = latY.constData();
+  double *xPtr = x.data(), *yPtr = y.data();
+  bool *hiddenPtr = hidden.data();
+
+  for(int i = 0; i < lonX.size(); i++)
+  {
+    double lat = latYPtr[i] * DEG_TO_RAD;
+    double deltaLon = lonXPtr[i] * DEG_TO_RAD - centerLon;
+    double sinLat = std::sin(lat), cosLat = std::cos(lat), cosDeltaLon = std::cos(deltaLon);
+
+    xPtr[i] = centerX + radius * cosLat * std::sin(deltaLon);
+    yPtr[i] = centerY - radius * (cosCenterLat * sinLat - sinCenterLat * cosLat * cosDeltaLon);
+    hiddenPtr[i] = sinCenterLat * sinLat + cosCenterLat * cosLat * cosDeltaLon < 0.;
+  }
+}
+
+/* Mercator projection without repetition. */
+void CoordinateConverter::wToSBatchMercator(const QVector<double>& lonX, const QVector<double>& latY,
+                                            QVector<double>& x, QVector<double>& y) const
+{
+  const double rad2Pixel = 2. * viewport->radius() / M_PI;
+  const double centerX = viewport->width() / 2., centerY = viewport->height() / 2.;
+  const double centerLon = viewport->centerLongitude();
+  const double centerLatMercator = std::atanh(std::sin(viewport->centerLatitude()));
+
+  const double maxLat = MAX_MERCATOR_LAT_DEG * DEG_TO_RAD;
+  const double *lonXPtr = lonX.constData(), *latYPtr = latY.constData();
+  double *xPtr = x.data(), *yPtr = y.data();
+
+  for(int i = 0; i < lonX.size(); i++)
+  {
+    // Clamp to avoid infinite values at the poles - positions outside are marked invisible by the caller
+    double lat = std::min(std::max(latYPtr[i] * DEG_TO_RAD, -maxLat), maxLat);
+
+    xPtr[i] = centerX + rad2Pixel * (lonXPtr[i] * DEG_TO_RAD - centerLon);
+    yPtr[i] = centerY - rad2Pixel * (std::atanh(std::sin(lat)) - centerLatMercator);
+  }
+}
+
 bool CoordinateConverter::sToW(int x, int y, Marble::GeoDataCoordinates& coords) const
 {
   qreal lon, lat;
@@ -22,6 +22,8 @@
 
 #include <QPoint>
 #include <QSize>
+#include <QList>
+#include <QVector>
 
 namespace Marble {
 class ViewportParams;
@@ -103,6 +105,28 @@ public:
   bool wToS(const atools::geo::Line& coords, QLineF& line, const QSize& size = DEFAULT_WTOS_SIZE,
             bool *isHidden = nullptr) const;
 
+  /*
+   * Convert arrays of world coordinates at once. Calculates the spherical and Mercator projections directly
+   * without Marble objects. Other projections fall back to single conversion.
+   * Results can differ up to one pixel from wToS since Marble uses integer math for the screen center.
+   *
+   * @param lonX, latY coordinates in degree. Invalid coordinates are not visible.
+   * @param x, y receive screen coordinates not rounded
+   * @param visible receives true if the position is visible on screen and not hidden
+   * @param size used to check visibility. See wToS.
+   * @param sizes optional size for each position which replaces size
+   * @param hidden optional. Receives true if the position is hidden behind the globe
+   */
+  void wToSBatch(const QVector<double>& lonX, const QVector<double>& latY,
+                 QVector<double>& x, QVector<double>& y, QVector<bool>& visible,
+                 const QSize& size = DEFAULT_WTOS_SIZE, const QVector<QSize> *sizes = nullptr,
+                 QVector<bool> *hidden = nullptr) const;
+
+  /* Convert the position member of all objects at once. See above. */
+  template<typename TYPE>
+  void wToSBatch(const QList<TYPE>& objects, QVector<double>& x, QVector<double>& y, QVector<bool>& visible,
+                 const QSize& size = DEFAULT_WTOS_SIZE) const;
+
   bool sToW(int x, int y, Marble::GeoDataCoordinates& coords) const;
 
   /* Converte screen to world coordinates */
@@ -118,7 +142,17 @@ public:
   static Q_DECL_CONSTEXPR Marble::GeoDataCoordinates::BearingType FINALBRG =
     Marble::GeoDataCoordinates::FinalBearing;
 
+  const Marble::ViewportParams *getViewport() const
+  {
+    return viewport;
+  }
+
 private:
+  void wToSBatchSpherical(const QVector<double>& lonX, const QVector<double>& latY,
+                          QVector<double>& x, QVector<double>& y, QVector<bool>& hidden) const;
+  void wToSBatchMercator(const QVector<double>& lonX, const QVector<double>& latY,
+                         QVector<double>& x, QVector<double>& y) const;
+
   bool wToSInternal(const Marble::GeoDataCoordinates& coords, double& x, double& y, const QSize& size,
                     bool *isHidden) const;
 
@@ -126,4 +160,19 @@ private:
 
 };
 
+template<typename TYPE>
+void CoordinateConverter::wToSBatch(const QList<TYPE>& objects, QVector<double>& x, QVector<double>& y,
+                                    QVector<bool>& visible, const QSize& size) const
+{
+  QVector<double> lonX, latY;
+  lonX.reserve(objects.size());
+  latY.reserve(objects.size());
+  for(const TYPE& obj : objects)
+  {
+    lonX.append(obj.position.getLonX());
+    latY.append(obj.position.getLatY());
+  }
+  wToSBatch(lonX, latY, x, y, visible, size);
+}
+
 #endif // LITTLENAVMAP_COORDINATECONVERTER_H
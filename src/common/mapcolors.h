@@ -148,6 +148,9 @@ const QColor routeProcedurePreviewOutlineColor = QColor(Qt::black);
 const QColor routeProcedurePreviewColor = QColor(0, 180, 255);
 const QColor routeProcedurePreviewMissedColor = QColor(0, 180, 255);
 
+const QColor routeAlternativeColor = QColor(120, 120, 120);
+const QColor routeAlternativeSelectedColor = QColor(0, 180, 255);
+
 const QColor routeProcedureOutlineColor = QColor(Qt::black);
 
 const QColor routeHighlightBackColor = QColor(Qt::black);
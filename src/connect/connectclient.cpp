@@ -210,7 +210,8 @@ void ConnectClient::disconnectedFromSimulatorDirect()
 /* Posts data received directly from simconnect or the socket and caches any metar reports */
 void ConnectClient::postSimConnectData(atools::fs::sc::SimConnectData dataPacket)
 {
-  emit dataPacketReceived(dataPacket);
+  // Copy once into a shared snapshot which is passed to all receivers
+  emit dataPacketReceived(simdata::makeSimConnectDataPtr(dataPacket));
 
   if(!dataPacket.getMetars().isEmpty())
   {
@@ -18,7 +18,7 @@
 #ifndef LITTLENAVMAP_CONNECTCLIENT_H
 #define LITTLENAVMAP_CONNECTCLIENT_H
 
-#include "fs/sc/simconnectdata.h"
+#include "connect/simconnectdataptr.h"
 #include "util/timedcache.h"
 #include "connectdialog.h"
 
@@ -75,8 +75,8 @@ public:
 
 signals:
   /* Emitted when new data was received from the server (Little Navconnect).
-   * can be aircraft position or weather update */
-  void dataPacketReceived(atools::fs::sc::SimConnectData simConnectData);
+   * can be aircraft position or weather update. The snapshot is shared by all receivers and must not be modified. */
+  void dataPacketReceived(const SimConnectDataPtr& simConnectData);
 
   /* Emitted when a new SimConnect data was received that contains weather data */
   void weatherUpdated();
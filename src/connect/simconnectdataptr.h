@@ -0,0 +1,48 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_SIMCONNECTDATAPTR_H
+#define LITTLENAVMAP_SIMCONNECTDATAPTR_H
+
+#include "fs/sc/simconnectdata.h"
+
+#include <QSharedPointer>
+
+/*
+ * Immutable snapshot of one simulator data packet. Created once by the ConnectClient for each
+ * received packet and shared by all receivers. Receivers keep the pointer instead of a copy.
+ */
+typedef QSharedPointer<const atools::fs::sc::SimConnectData> SimConnectDataPtr;
+
+namespace simdata {
+
+/* Wraps a received packet into a shared snapshot */
+inline SimConnectDataPtr makeSimConnectDataPtr(const atools::fs::sc::SimConnectData& data)
+{
+  return SimConnectDataPtr(new atools::fs::sc::SimConnectData(data));
+}
+
+/* Shared empty snapshot used for initialization and after disconnect. Never null. */
+inline const SimConnectDataPtr& emptySimConnectData()
+{
+  static const SimConnectDataPtr EMPTY(new atools::fs::sc::SimConnectData);
+  return EMPTY;
+}
+
+} // namespace simdata
+
+#endif // LITTLENAVMAP_SIMCONNECTDATAPTR_H
@@ -23,6 +23,8 @@
 #include "common/constants.h"
 #include "fs/db/databasemeta.h"
 #include "db/databasedialog.h"
+#include "db/spatialindex.h"
+#include "db/textindex.h"
 #include "settings/settings.h"
 #include "fs/navdatabaseoptions.h"
 #include "fs/navdatabaseprogress.h"
@@ -49,6 +51,7 @@
 #include <QAbstractButton>
 #include <QSettings>
 #include <QSplashScreen>
+#include <QtConcurrent/QtConcurrentRun>
 
 using atools::gui::ErrorHandler;
 using atools::sql::SqlUtil;
@@ -174,6 +177,9 @@ DatabaseManager::DatabaseManager(MainWindow *parent)
   SqlDatabase::addDatabase(DATABASE_TYPE, DATABASE_NAME_DLG_INFO_TEMP);
   SqlDatabase::addDatabase(DATABASE_TYPE, DATABASE_NAME_TEMP);
 
+  connect(&indexWatcher, &QFutureWatcher<IndexBuildResult>::finished, this, &DatabaseManager::indexBuildThreadFinished);
+  connect(this, &DatabaseManager::indexProgress, this, &DatabaseManager::showIndexProgress);
+
   databaseSim = new SqlDatabase(DATABASE_NAME);
   databaseNav = new SqlDatabase(DATABASE_NAME_NAV);
 }
@@ -442,6 +448,11 @@ void DatabaseManager::checkCopyAndPrepareDatabases()
           atools::gui::Application::processEventsExtended();
           NavDatabase::runPreparationScript(tempDb);
 
+          dialog->setText(tr("Preparing %1 Database: Creating search indexes ...").
+                          arg(FsPaths::typeToName(FsPaths::NAVIGRAPH)));
+          atools::gui::Application::processEventsExtended();
+          createOptionalIndexes(&tempDb, settingsDb);
+
           dialog->setText(tr("Preparing %1 Database: Analyzing ...").arg(FsPaths::typeToName(FsPaths::NAVIGRAPH)));
           atools::gui::Application::processEventsExtended();
           tempDb.analyze();
@@ -471,6 +482,7 @@ void DatabaseManager::checkCopyAndPrepareDatabases()
     SqlDatabase tempDb(DATABASE_NAME_TEMP);
     openDatabaseFile(&tempDb, settingsDb, false /* readonly */);
     NavDatabase::runPreparationScript(tempDb);
+    createOptionalIndexes(&tempDb, settingsDb);
     tempDb.analyze();
     closeDatabaseFile(&tempDb);
 
@@ -694,16 +706,25 @@ void DatabaseManager::switchSimFromMainMenu()
 void DatabaseManager::openAllDatabases()
 {
   QString simDbFile = buildDatabaseFileName(currentFsType);
-  QString navDbFile = buildDatabaseFileNameAppDirOrSettings(FsPaths::NAVIGRAPH);
+  QString navDbFile = getDatabaseFileNav();
 
   if(navDatabaseStatus == dm::NAVDATABASE_ALL)
     simDbFile = navDbFile;
-  else if(navDatabaseStatus == dm::NAVDATABASE_OFF)
-    navDbFile = simDbFile;
   // else if(usingNavDatabase == MIXED)
 
   openDatabaseFile(databaseSim, simDbFile, true /* readonly */);
   openDatabaseFile(databaseNav, navDbFile, true /* readonly */);
+
+  if(indexBuildEnabled)
+    startIndexBuild();
+}
+
+QString DatabaseManager::getDatabaseFileNav() const
+{
+  if(navDatabaseStatus == dm::NAVDATABASE_OFF)
+    return buildDatabaseFileName(currentFsType);
+  else
+    return buildDatabaseFileNameAppDirOrSettings(FsPaths::NAVIGRAPH);
 }
 
 void DatabaseManager::openDatabaseFile(atools::sql::SqlDatabase *db, const QString& file, bool readonly)
@@ -711,6 +732,8 @@ void DatabaseManager::openDatabaseFile(atools::sql::SqlDatabase *db, const QStri
   atools::settings::Settings& settings = atools::settings::Settings::instance();
   int databaseCacheKb = settings.getAndStoreValue(lnm::SETTINGS_DATABASE + "CacheKb", 50000).toInt();
   bool foreignKeys = settings.getAndStoreValue(lnm::SETTINGS_DATABASE + "ForeignKeys", false).toBool();
+  bool spatialIndex = settings.getAndStoreValue(lnm::SETTINGS_DATABASE + "SpatialIndex", true).toBool();
+  bool textIndex = settings.getAndStoreValue(lnm::SETTINGS_DATABASE + "TextIndex", true).toBool();
 
   // cache_size * 1024 bytes if value is negative
   QStringList DATABASE_PRAGMAS({QString("PRAGMA cache_size=-%1").arg(databaseCacheKb),
@@ -758,6 +781,33 @@ void DatabaseManager::openDatabaseFile(atools::sql::SqlDatabase *db, const QStri
       db->open(DATABASE_PRAGMAS);
     }
 
+    bool spatialMissing = spatialIndex && !spatialFailedFiles.contains(file) && spatialindex::isIndexMissing(db);
+    bool textMissing = textIndex && !textFailedFiles.contains(file) && textindex::isIndexMissing(db);
+    if(readonly && (spatialMissing || textMissing))
+    {
+      // Database was not indexed when compiled - use index tables from a separate file in the settings directory
+      // Reopen in autocommit mode since attaching is not possible within a transaction
+      db->close();
+      db->setAutocommit(true);
+      db->open(DATABASE_PRAGMAS);
+
+      try
+      {
+        // Missing or outdated - build in background and reopen when done
+        // A valid file without one of the index types is kept since creating this type failed before
+        if(!spatialindex::attachSidecar(db, file) && !indexPendingFiles.contains(file))
+          indexPendingFiles.append(file);
+      }
+      catch(atools::Exception& e)
+      {
+        // Not fatal - queries fall back to the column indexes
+        qWarning() << Q_FUNC_INFO << "Cannot attach index database for" << file << e.what();
+        spatialFailedFiles.insert(file);
+        textFailedFiles.insert(file);
+      }
+      db->setAutocommit(autocommit);
+    }
+
     DatabaseMeta dbmeta(db);
     qInfo().nospace() << "Database version "
                       << dbmeta.getMajorVersion() << "." << dbmeta.getMinorVersion();
@@ -775,8 +825,202 @@ void DatabaseManager::openDatabaseFile(atools::sql::SqlDatabase *db, const QStri
   }
 }
 
+/* Create optional index tables in a newly compiled or prepared database which is open read/write */
+void DatabaseManager::createOptionalIndexes(atools::sql::SqlDatabase *db, const QString& file)
+{
+  Settings& settings = Settings::instance();
+  if(settings.getAndStoreValue(lnm::SETTINGS_DATABASE + "SpatialIndex", true).toBool())
+    createIndex(db, file, &spatialindex::createIndexes);
+  if(settings.getAndStoreValue(lnm::SETTINGS_DATABASE + "TextIndex", true).toBool())
+    createIndex(db, file, &textindex::createIndexes);
+}
+
+void DatabaseManager::startIndexBuild()
+{
+  indexBuildEnabled = true;
+  if(indexFuture.isRunning() || indexPendingFiles.isEmpty())
+    return;
+
+  Settings& settings = Settings::instance();
+  bool spatialIndex = settings.getAndStoreValue(lnm::SETTINGS_DATABASE + "SpatialIndex", true).toBool();
+  bool textIndex = settings.getAndStoreValue(lnm::SETTINGS_DATABASE + "TextIndex", true).toBool();
+
+  // Leave out index types which failed before for a file
+  QVector<IndexBuildJob> jobs;
+  for(const QString& file : indexPendingFiles)
+    jobs.append({file, spatialIndex && !spatialFailedFiles.contains(file), textIndex && !textFailedFiles.contains(file)});
+
+  indexBuildFiles = indexPendingFiles;
+  indexPendingFiles.clear();
+  indexCancel = false;
+
+  indexFuture = QtConcurrent::run(this, &DatabaseManager::indexBuildThread, jobs);
+
+  // Watcher will call indexBuildThreadFinished when finished
+  indexWatcher.setFuture(indexFuture);
+}
+
+QStringList DatabaseManager::stopIndexBuild()
+{
+  QStringList files;
+  if(indexFuture.isRunning())
+  {
+    indexCancel = true;
+    indexFuture.waitForFinished();
+    files = indexBuildFiles;
+  }
+
+  // Result is dropped
+  indexFuture = QFuture<IndexBuildResult>();
+  indexBuildFiles.clear();
+  return files;
+}
+
+/* Runs in a separate thread and writes the R*Tree and FTS tables of each file into its sidecar database */
+DatabaseManager::IndexBuildResult DatabaseManager::indexBuildThread(QVector<IndexBuildJob> jobs)
+{
+  IndexBuildResult result;
+
+  // Database connections cannot be shared between threads
+  SqlDatabase::addDatabase(DATABASE_TYPE, DATABASE_NAME_INDEX_TEMP);
+  {
+    SqlDatabase tempDb(DATABASE_NAME_INDEX_TEMP);
+    for(const IndexBuildJob& job : jobs)
+    {
+      if(indexCancel)
+        break;
+
+      QString filename = QFileInfo(job.file).fileName();
+      std::function<bool(const QString& table)> progress = [this, &filename](const QString& table) -> bool
+      {
+        emit indexProgress(tr("Creating search index for %1: %2 ...").arg(filename).arg(table));
+        return !indexCancel;
+      };
+
+      try
+      {
+        spatialindex::beginSidecar(&tempDb, job.file);
+
+        // Each index type can fail on its own, e.g. if SQLite was built without the FTS5 module
+        bool done = true;
+        if(job.spatial)
+          done = createSidecarIndex(&tempDb, job.file, "spatial", &spatialindex::createIndexesFrom, progress,
+                                    result.spatialFailed);
+        if(job.text && done)
+          done = createSidecarIndex(&tempDb, job.file, "text", &textindex::createIndexesFrom, progress,
+                                    result.textFailed);
+
+        spatialindex::endSidecar(&tempDb, job.file, done);
+        if(done)
+          result.built.append(job.file);
+      }
+      catch(atools::Exception& e)
+      {
+        // Not fatal - queries fall back to the column indexes
+        qWarning() << Q_FUNC_INFO << "Cannot create index database for" << job.file << e.what();
+        result.spatialFailed.append(job.file);
+        result.textFailed.append(job.file);
+      }
+      catch(...)
+      {
+        qWarning() << Q_FUNC_INFO << "Unknown exception creating index database for" << job.file;
+        result.spatialFailed.append(job.file);
+        result.textFailed.append(job.file);
+      }
+    }
+  }
+  SqlDatabase::removeDatabase(DATABASE_NAME_INDEX_TEMP);
+
+  return result;
+}
+
+/* Create one index type in the sidecar within a savepoint. A failure removes only the tables of this type and
+ * adds the file to failed. Returns false if cancelled. */
+bool DatabaseManager::createSidecarIndex(atools::sql::SqlDatabase *tempDb, const QString& file,
+                                         const QString& savepoint, IndexCreateFuncType createFunc,
+                                         const std::function<bool(const QString&)>& progress, QStringList& failed)
+{
+  tempDb->exec("savepoint " + savepoint);
+  try
+  {
+    bool done = createFunc(tempDb, "src", progress);
+    tempDb->exec("release " + savepoint);
+    return done;
+  }
+  catch(atools::Exception& e)
+  {
+    qWarning() << Q_FUNC_INFO << "Cannot create" << savepoint << "index for" << file << e.what();
+    tempDb->exec("rollback to " + savepoint);
+    tempDb->exec("release " + savepoint);
+    failed.append(file);
+    return true;
+  }
+}
+
+/* Called by watcher when the thread is finished */
+void DatabaseManager::indexBuildThreadFinished()
+{
+  if(indexFuture.isFinished() && indexFuture.resultCount() > 0)
+  {
+    IndexBuildResult result = indexFuture.result();
+    indexFuture = QFuture<IndexBuildResult>();
+    indexBuildFiles.clear();
+
+    // Do not try again until restart
+    for(const QString& file : result.spatialFailed)
+      spatialFailedFiles.insert(file);
+    for(const QString& file : result.textFailed)
+      textFailedFiles.insert(file);
+
+    if(result.built.contains(databaseSim->databaseName()) || result.built.contains(databaseNav->databaseName()))
+    {
+      // Reopen databases to attach the new index files - recipients reload their queries
+      emit preDatabaseLoad();
+      closeDatabases();
+      openAllDatabases();
+      emit postDatabaseLoad(currentFsType);
+    }
+
+    if(mainWindow != nullptr)
+      mainWindow->setStatusMessage(result.spatialFailed.isEmpty() && result.textFailed.isEmpty() ?
+                                   tr("Search indexes created.") : tr("Creating search indexes failed."));
+  }
+
+  // Start files queued in the meantime
+  startIndexBuild();
+}
+
+void DatabaseManager::showIndexProgress(const QString& message)
+{
+  if(mainWindow != nullptr)
+    mainWindow->setStatusMessage(message);
+}
+
+/* Create and commit optional index tables. Errors are not fatal since queries fall back to the column indexes.
+ * Returns false on error. */
+bool DatabaseManager::createIndex(atools::sql::SqlDatabase *db, const QString& file,
+                                  void (*createFunc)(atools::sql::SqlDatabase *))
+{
+  try
+  {
+    createFunc(db);
+    db->commit();
+    return true;
+  }
+  catch(atools::Exception& e)
+  {
+    qWarning() << Q_FUNC_INFO << "Cannot create index for" << file << e.what();
+    db->rollback();
+    return false;
+  }
+}
+
 void DatabaseManager::closeDatabases()
 {
+  // Files are detected again when opening
+  stopIndexBuild();
+  indexPendingFiles.clear();
+
   closeDatabaseFile(databaseSim);
   closeDatabaseFile(databaseNav);
 }
@@ -825,10 +1069,20 @@ void DatabaseManager::run()
 
   updateDialogInfo(selectedFsType);
 
+  // Databases might be replaced and reopened while the dialog is shown - build indexes again afterwards
+  for(const QString& file : stopIndexBuild())
+  {
+    if(!indexPendingFiles.contains(file))
+      indexPendingFiles.append(file);
+  }
+
   // try until user hits cancel or the database was loaded successfully
   while(runInternal())
     ;
 
+  if(indexBuildEnabled)
+    startIndexBuild();
+
   updateSimulatorFlags();
   insertSimSwitchActions();
 
@@ -862,8 +1116,10 @@ void DatabaseManager::copyAirspaces()
           // X-Plane database file has a boundary table
           QGuiApplication::setOverrideCursor(Qt::WaitCursor);
 
-          // Delete
+          // Delete - spatial index is rebuilt below if the file has one
+          bool spatial = spatialindex::hasIndex(&xpDb, "boundary");
           xpDb.exec("delete from boundary");
+          spatialindex::dropIndex(&xpDb, "boundary");
           xpDb.commit();
 
           // Build statements
@@ -886,6 +1142,12 @@ void DatabaseManager::copyAirspaces()
           int copied = SqlUtil::copyResultValues(fromQuery, xpQuery, func);
           xpDb.commit();
 
+          if(spatial)
+          {
+            spatialindex::createIndexes(&xpDb);
+            xpDb.commit();
+          }
+
           QGuiApplication::restoreOverrideCursor();
           QMessageBox::information(mainWindow, QApplication::applicationName(),
                                    tr("Copied %1 airspaces to the X-Plane scenery database.").
@@ -963,6 +1225,10 @@ bool DatabaseManager::runInternal()
             // Successfully loaded
             reopenDialog = false;
 
+            QMessageBox *dialog = showSimpleProgressDialog(tr("Creating search indexes ..."));
+            createOptionalIndexes(&tempDb, tempFilename);
+            deleteSimpleProgressDialog(dialog);
+
             closeDatabaseFile(&tempDb);
 
             emit preDatabaseLoad();
@@ -1437,7 +1703,7 @@ void DatabaseManager::updateDialogInfo(atools::fs::FsPaths::SimulatorType value)
 }
 
 /* Create database name including simulator short name */
-QString DatabaseManager::buildDatabaseFileName(atools::fs::FsPaths::SimulatorType type)
+QString DatabaseManager::buildDatabaseFileName(atools::fs::FsPaths::SimulatorType type) const
 {
   return databaseDirectory +
          QDir::separator() + lnm::DATABASE_PREFIX +
@@ -1445,7 +1711,7 @@ QString DatabaseManager::buildDatabaseFileName(atools::fs::FsPaths::SimulatorTyp
 }
 
 /* Create database name including simulator short name in application directory */
-QString DatabaseManager::buildDatabaseFileNameAppDir(atools::fs::FsPaths::SimulatorType type)
+QString DatabaseManager::buildDatabaseFileNameAppDir(atools::fs::FsPaths::SimulatorType type) const
 {
   return QCoreApplication::applicationDirPath() +
          QDir::separator() + lnm::DATABASE_DIR +
@@ -1454,7 +1720,7 @@ QString DatabaseManager::buildDatabaseFileNameAppDir(atools::fs::FsPaths::Simula
 }
 
 /* Create database name including simulator short name */
-QString DatabaseManager::buildDatabaseFileNameAppDirOrSettings(atools::fs::FsPaths::SimulatorType type)
+QString DatabaseManager::buildDatabaseFileNameAppDirOrSettings(atools::fs::FsPaths::SimulatorType type) const
 {
   QString ngDbFile = buildDatabaseFileName(type);
   QString ngDbFileApp = buildDatabaseFileNameAppDir(type);
@@ -23,7 +23,12 @@
 #include "db/dbtypes.h"
 
 #include <QAction>
+#include <QSet>
 #include <QObject>
+#include <QFutureWatcher>
+
+#include <atomic>
+#include <functional>
 
 namespace atools {
 namespace fs {
@@ -85,6 +90,9 @@ public:
    * Will not return if an exception is caught during opening. */
   void openAllDatabases();
 
+  /* Navaid database file as used by openAllDatabases() without opening it */
+  QString getDatabaseFileNav() const;
+
   /* Close database.
    * Will not return if an exception is caught during opening. */
   void closeDatabases();
@@ -109,6 +117,11 @@ public:
   /* Copy from app dir to settings directory if newer and create indexes if missing */
   void checkCopyAndPrepareDatabases();
 
+  /* Build missing spatial and text indexes of the open databases in a background thread. Databases are reopened
+   * and preDatabaseLoad and postDatabaseLoad are emitted when done. Therefore not done before this is called once
+   * the main window is shown. */
+  void startIndexBuild();
+
   /* Get the settings directory where the database is stored */
   const QString& getDatabaseDirectory() const
   {
@@ -140,9 +153,41 @@ signals:
    */
   void postDatabaseLoad(atools::fs::FsPaths::SimulatorType type);
 
+  /* Emitted by the index thread to show progress in the status bar */
+  void indexProgress(const QString& message);
+
 private:
+  /* File and index types to build into its sidecar database */
+  struct IndexBuildJob
+  {
+    QString file;
+    bool spatial, text;
+  };
+
+  /* Files which got a new sidecar database and files where creation of an index type failed */
+  struct IndexBuildResult
+  {
+    QStringList built, spatialFailed, textFailed;
+  };
+
+  /* spatialindex::createIndexesFrom or textindex::createIndexesFrom */
+  typedef bool (*IndexCreateFuncType)(atools::sql::SqlDatabase *db, const QString& sourceSchema,
+                                      const std::function<bool(const QString& table)>& progress);
+
   void openDatabaseFile(atools::sql::SqlDatabase *db, const QString& file, bool readonly);
   void closeDatabaseFile(atools::sql::SqlDatabase *db);
+  bool createIndex(atools::sql::SqlDatabase *db, const QString& file,
+                   void (*createFunc)(atools::sql::SqlDatabase *));
+  void createOptionalIndexes(atools::sql::SqlDatabase *db, const QString& file);
+
+  /* Cancel and wait for the index thread. Returns the files of the stopped build. Result is dropped. */
+  QStringList stopIndexBuild();
+  IndexBuildResult indexBuildThread(QVector<IndexBuildJob> jobs);
+  bool createSidecarIndex(atools::sql::SqlDatabase *tempDb, const QString& file, const QString& savepoint,
+                          IndexCreateFuncType createFunc, const std::function<bool(const QString&)>& progress,
+                          QStringList& failed);
+  void indexBuildThreadFinished();
+  void showIndexProgress(const QString& message);
 
   void restoreState();
 
@@ -158,13 +203,13 @@ private:
   void updateDialogInfo(atools::fs::FsPaths::SimulatorType value);
 
   /* Database stored in settings directory */
-  QString buildDatabaseFileName(atools::fs::FsPaths::SimulatorType currentFsType);
+  QString buildDatabaseFileName(atools::fs::FsPaths::SimulatorType currentFsType) const;
 
   /* Database stored in application directory or settings directory */
-  QString buildDatabaseFileNameAppDirOrSettings(atools::fs::FsPaths::SimulatorType type);
+  QString buildDatabaseFileNameAppDirOrSettings(atools::fs::FsPaths::SimulatorType type) const;
 
   /* Database stored in application directory */
-  QString buildDatabaseFileNameAppDir(atools::fs::FsPaths::SimulatorType type);
+  QString buildDatabaseFileNameAppDir(atools::fs::FsPaths::SimulatorType type) const;
 
   /* Temporary name stored in settings directory */
   QString buildCompilingDatabaseFileName();
@@ -192,10 +237,24 @@ private:
 
   const QString DATABASE_NAME_TEMP = "LNMTEMPDB";
   const QString DATABASE_NAME_DLG_INFO_TEMP = "LNMTEMPDB2";
+
+  /* Used in the index thread to write R*Tree and FTS tables for read only databases into a separate file */
+  const QString DATABASE_NAME_INDEX_TEMP = "LNMTEMPDBINDEX";
   const QString DATABASE_TYPE = "QSQLITE";
 
   DatabaseDialog *databaseDialog = nullptr;
   QString databaseDirectory;
+
+  /* Database files where creation of R*Tree or FTS tables in the separate index file failed.
+   * Not tried again until restart. */
+  QSet<QString> spatialFailedFiles, textFailedFiles;
+
+  /* Files waiting for the index thread and files currently processed by the thread */
+  QStringList indexPendingFiles, indexBuildFiles;
+  bool indexBuildEnabled = false;
+  std::atomic_bool indexCancel {false};
+  QFuture<IndexBuildResult> indexFuture;
+  QFutureWatcher<IndexBuildResult> indexWatcher;
   qint64 progressTimerElapsed = 0L;
 
   // Need a pointer since it has to be deleted before the destructor is left
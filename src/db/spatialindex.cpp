@@ -0,0 +1,272 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "db/spatialindex.h"
+
+#include "common/constants.h"
+#include "exception.h"
+#include "settings/settings.h"
+#include "sql/sqldatabase.h"
+#include "sql/sqlquery.h"
+#include "sql/sqlutil.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QVector>
+
+using atools::sql::SqlDatabase;
+using atools::sql::SqlQuery;
+using atools::sql::SqlUtil;
+
+namespace spatialindex {
+
+/* Table with bounding rectangle columns. Points use the same column for minimum and maximum. */
+struct IndexTable
+{
+  QString table, idColumn, minLonx, maxLonx, minLaty, maxLaty;
+};
+
+static const QVector<IndexTable> INDEX_TABLES(
+{
+  {"airport", "airport_id", "lonx", "lonx", "laty", "laty"},
+  {"vor", "vor_id", "lonx", "lonx", "laty", "laty"},
+  {"ndb", "ndb_id", "lonx", "lonx", "laty", "laty"},
+  {"waypoint", "waypoint_id", "lonx", "lonx", "laty", "laty"},
+  {"ils", "ils_id", "lonx", "lonx", "laty", "laty"},
+  {"airway", "airway_id", "left_lonx", "right_lonx", "bottom_laty", "top_laty"},
+  {"boundary", "boundary_id", "min_lonx", "max_lonx", "min_laty", "max_laty"},
+  {"nav_search", "nav_search_id", "lonx", "lonx", "laty", "laty"}
+});
+
+/* Schema name of the attached sidecar database */
+static const QString SIDECAR_SCHEMA("indexsidecar");
+
+/* Table in the sidecar database containing path, size and modification time of the indexed file */
+static const QString SIDECAR_SOURCE_TABLE("index_source");
+
+static QString indexName(const QString& table)
+{
+  return table + "_rtree";
+}
+
+/* Files with the same name in different directories get different sidecars */
+static QString sidecarFilename(const QString& databaseFile)
+{
+  QString path = QFileInfo(databaseFile).absoluteFilePath();
+  QString hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+
+  return atools::settings::Settings::getPath() + QDir::separator() + lnm::DATABASE_DIR + QDir::separator() +
+         QFileInfo(databaseFile).completeBaseName() + "_" + hash + "_index.sqlite";
+}
+
+static QString quoted(const QString& filename)
+{
+  return "'" + QString(filename).replace("'", "''") + "'";
+}
+
+bool hasSchemaTable(SqlDatabase *db, const QString& schema, const QString& table)
+{
+  SqlQuery query(db);
+  query.prepare("select count(1) from " + schema + ".sqlite_master where type = 'table' and name = :name");
+  query.bindValue(":name", table);
+  query.exec();
+  return query.next() && query.value(0).toInt() > 0;
+}
+
+static bool isSidecarAttached(SqlDatabase *db)
+{
+  SqlQuery query(db);
+  query.exec("pragma database_list");
+  while(query.next())
+  {
+    if(query.value("name").toString() == SIDECAR_SCHEMA)
+      return true;
+  }
+  return false;
+}
+
+bool hasIndexTable(SqlDatabase *db, const QString& indexTable)
+{
+  if(SqlUtil(db).hasTable(indexTable))
+    return true;
+
+  return isSidecarAttached(db) && hasSchemaTable(db, SIDECAR_SCHEMA, indexTable);
+}
+
+bool hasIndex(SqlDatabase *db, const QString& table)
+{
+  return hasIndexTable(db, indexName(table));
+}
+
+bool isIndexMissing(SqlDatabase *db)
+{
+  SqlUtil util(db);
+  for(const IndexTable& idx : INDEX_TABLES)
+  {
+    if(util.hasTable(idx.table) && !hasIndex(db, idx.table))
+      return true;
+  }
+  return false;
+}
+
+bool createIndexesFrom(SqlDatabase *db, const QString& sourceSchema,
+                       const std::function<bool(const QString& table)>& progress)
+{
+  for(const IndexTable& idx : INDEX_TABLES)
+  {
+    if(!hasSchemaTable(db, sourceSchema, idx.table) || hasSchemaTable(db, "main", indexName(idx.table)))
+      continue;
+
+    if(progress && !progress(idx.table))
+      return false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QString name = indexName(idx.table);
+    db->exec("create virtual table " + name + " using rtree(id, min_lonx, max_lonx, min_laty, max_laty)");
+
+    // Objects crossing the anti-meridian have a left coordinate larger than the right one - let them cover all
+    db->exec(QString("insert into %1 (id, min_lonx, max_lonx, min_laty, max_laty) "
+                     "select %2, "
+                     "case when %4 < %3 then -180. else %3 end, "
+                     "case when %4 < %3 then 180. else %4 end, "
+                     "%5, %6 from %7 "
+                     "where %3 is not null and %4 is not null and %5 is not null and %6 is not null").
+             arg(name).arg(idx.idColumn).arg(idx.minLonx).arg(idx.maxLonx).arg(idx.minLaty).arg(idx.maxLaty).
+             arg(sourceSchema + "." + idx.table));
+
+    qDebug() << Q_FUNC_INFO << "Created" << name << "in" << timer.elapsed() << "ms";
+  }
+  return true;
+}
+
+void createIndexes(SqlDatabase *db)
+{
+  createIndexesFrom(db, "main", nullptr);
+}
+
+void beginSidecar(SqlDatabase *tempDb, const QString& databaseFile)
+{
+  QString filename = sidecarFilename(databaseFile);
+  qDebug() << Q_FUNC_INFO << "Creating" << filename << "for" << databaseFile;
+
+  QFile::remove(filename);
+  tempDb->setDatabaseName(filename);
+  tempDb->setReadonly(false);
+
+  // Attach is not possible within a transaction
+  tempDb->setAutocommit(true);
+  tempDb->open({"PRAGMA synchronous=OFF", "PRAGMA journal_mode=OFF"});
+
+  try
+  {
+    // SQLite falls back to read only access if the file is write protected
+    tempDb->exec("attach database " + quoted(databaseFile) + " as src");
+  }
+  catch(atools::Exception&)
+  {
+    // Do not leave an incomplete file behind
+    tempDb->close();
+    QFile::remove(filename);
+    throw;
+  }
+}
+
+void endSidecar(SqlDatabase *tempDb, const QString& databaseFile, bool keep)
+{
+  QString filename = sidecarFilename(databaseFile);
+  QFileInfo fileinfo(databaseFile);
+
+  try
+  {
+    tempDb->exec("detach database src");
+
+    if(keep)
+    {
+      // Remember the indexed file to detect changes
+      tempDb->exec("create table " + SIDECAR_SOURCE_TABLE +
+                   " (file_path varchar(1024), file_size integer, last_modified integer)");
+      SqlQuery insert(tempDb);
+      insert.prepare("insert into " + SIDECAR_SOURCE_TABLE + " (file_path, file_size, last_modified) "
+                     "values(:path, :size, :modified)");
+      insert.bindValue(":path", fileinfo.absoluteFilePath());
+      insert.bindValue(":size", fileinfo.size());
+      insert.bindValue(":modified", fileinfo.lastModified().toMSecsSinceEpoch());
+      insert.exec();
+    }
+  }
+  catch(atools::Exception&)
+  {
+    // Do not leave an incomplete file behind
+    tempDb->close();
+    QFile::remove(filename);
+    throw;
+  }
+
+  tempDb->close();
+  if(!keep)
+    QFile::remove(filename);
+}
+
+bool attachSidecar(SqlDatabase *db, const QString& databaseFile)
+{
+  QString filename = sidecarFilename(databaseFile);
+  if(!QFile::exists(filename))
+    return false;
+
+  db->exec("attach database " + quoted(filename) + " as " + SIDECAR_SCHEMA);
+
+  bool valid = false;
+  if(hasSchemaTable(db, SIDECAR_SCHEMA, SIDECAR_SOURCE_TABLE))
+  {
+    QFileInfo fileinfo(databaseFile);
+    SqlQuery query(db);
+    query.exec("select file_path, file_size, last_modified from " + SIDECAR_SCHEMA + "." + SIDECAR_SOURCE_TABLE);
+    valid = query.next() && query.value("file_path").toString() == fileinfo.absoluteFilePath() &&
+            query.value("file_size").toLongLong() == fileinfo.size() &&
+            query.value("last_modified").toLongLong() == fileinfo.lastModified().toMSecsSinceEpoch();
+  }
+
+  if(!valid)
+  {
+    // Database file was replaced or changed - sidecar has to be created again
+    qInfo() << Q_FUNC_INFO << "Outdated" << filename << "for" << databaseFile;
+    db->exec("detach database " + SIDECAR_SCHEMA);
+  }
+  return valid;
+}
+
+void dropIndex(SqlDatabase *db, const QString& table)
+{
+  db->exec("drop table if exists " + indexName(table));
+}
+
+QString rectCondition(const QString& table, const QString& idColumn, const QString& leftx, const QString& rightx,
+                      const QString& bottomy, const QString& topy)
+{
+  return QString("%1 in (select id from %2 where max_lonx >= %3 and min_lonx <= %4 and "
+                 "max_laty >= %5 and min_laty <= %6)").
+         arg(idColumn).arg(indexName(table)).arg(leftx).arg(rightx).arg(bottomy).arg(topy);
+}
+
+} // namespace spatialindex
@@ -0,0 +1,89 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_SPATIALINDEX_H
+#define LITTLENAVMAP_SPATIALINDEX_H
+
+#include <QString>
+
+#include <functional>
+
+namespace atools {
+namespace sql {
+class SqlDatabase;
+}
+}
+
+/*
+ * Optional SQLite R*Tree tables for rectangle lookups on airport, vor, ndb, waypoint, ils, airway, boundary
+ * and nav_search.
+ * Each index table is named like the indexed table with a suffix "_rtree" and has the columns
+ * "id, min_lonx, max_lonx, min_laty, max_laty". Objects crossing the anti-meridian cover the full longitude range.
+ * Queries have to keep their exact coordinate conditions since the R*Tree uses rounded coordinates.
+ *
+ * The index tables are created in the database file when it is compiled or prepared. For other files they are
+ * built in the background into a separate database file in the settings directory. This sidecar file also
+ * contains the FTS tables of the textindex module and has to be attached to each connection using attachSidecar().
+ */
+namespace spatialindex {
+
+/* true if the R*Tree for table exists in the database or in an attached sidecar database */
+bool hasIndex(atools::sql::SqlDatabase *db, const QString& table);
+
+/* true if the index table of any type exists in the database or in an attached sidecar database */
+bool hasIndexTable(atools::sql::SqlDatabase *db, const QString& indexTable);
+
+/* Table lookup in a schema other than main, e.g. "src" while building a sidecar */
+bool hasSchemaTable(atools::sql::SqlDatabase *db, const QString& schema, const QString& table);
+
+/* true if any of the indexed tables exists but has no R*Tree */
+bool isIndexMissing(atools::sql::SqlDatabase *db);
+
+/* Creates all missing R*Tree tables. Database has to be writeable. Does not commit.
+ * Throws an exception if the SQLite R*Tree module is not available. */
+void createIndexes(atools::sql::SqlDatabase *db);
+
+/* Creates all missing R*Tree tables in db for the tables in the attached sourceSchema.
+ * progress is called with the table name before each index and stops creation if it returns false.
+ * Returns false if stopped. */
+bool createIndexesFrom(atools::sql::SqlDatabase *db, const QString& sourceSchema,
+                       const std::function<bool(const QString& table)>& progress = nullptr);
+
+/* Creates a new sidecar database file for the read only databaseFile and attaches databaseFile as "src".
+ * tempDb has to be a closed connection which is used to write the sidecar. Index tables are created with
+ * the createIndexesFrom functions using source schema "src" afterwards. Throws an exception on error. */
+void beginSidecar(atools::sql::SqlDatabase *tempDb, const QString& databaseFile);
+
+/* Finishes and closes the sidecar database. The file is removed if keep is false, e.g. if cancelled. */
+void endSidecar(atools::sql::SqlDatabase *tempDb, const QString& databaseFile, bool keep);
+
+/* Attaches the sidecar database of databaseFile to db if it exists and was created for the current file.
+ * Unqualified index table names are found in the attached database afterwards.
+ * Must not be called within a transaction. Returns true if attached. */
+bool attachSidecar(atools::sql::SqlDatabase *db, const QString& databaseFile);
+
+/* Drops the R*Tree for table. Has to be called if the content of the table is modified. Does not commit. */
+void dropIndex(atools::sql::SqlDatabase *db, const QString& table);
+
+/* Get a condition like "airport_id in (select id from airport_rtree where ...)".
+ * Rectangle values can be numbers or bind variable names like ":leftx". */
+QString rectCondition(const QString& table, const QString& idColumn, const QString& leftx, const QString& rightx,
+                      const QString& bottomy, const QString& topy);
+
+} // namespace spatialindex
+
+#endif // LITTLENAVMAP_SPATIALINDEX_H
@@ -0,0 +1,164 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "db/textindex.h"
+
+#include "db/spatialindex.h"
+#include "sql/sqldatabase.h"
+#include "sql/sqlquery.h"
+#include "sql/sqlutil.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <QVector>
+
+using atools::sql::SqlDatabase;
+using atools::sql::SqlQuery;
+using atools::sql::SqlUtil;
+
+namespace textindex {
+
+/* Search table and the columns to index */
+struct IndexTable
+{
+  QString table, idColumn;
+  QStringList columns;
+};
+
+static const QVector<IndexTable> INDEX_TABLES(
+{
+  {"airport", "airport_id", {"ident", "name", "city", "region"}},
+  {"nav_search", "nav_search_id", {"ident", "name", "region"}}
+});
+
+static QString indexName(const QString& table)
+{
+  return table + "_fts";
+}
+
+/* Get the indexed columns available in table of schema. Older database versions do not have all columns. */
+static QStringList availableColumns(SqlDatabase *db, const QString& schema, const IndexTable& idx)
+{
+  QStringList tableCols;
+  SqlQuery query(db);
+  query.exec("pragma " + schema + ".table_info(" + idx.table + ")");
+  while(query.next())
+    tableCols.append(query.value("name").toString());
+
+  QStringList cols;
+  for(const QString& col : idx.columns)
+  {
+    if(tableCols.contains(col))
+      cols.append(col);
+  }
+  return cols;
+}
+
+bool hasIndex(SqlDatabase *db, const QString& table)
+{
+  return spatialindex::hasIndexTable(db, indexName(table));
+}
+
+bool isIndexMissing(SqlDatabase *db)
+{
+  SqlUtil util(db);
+  for(const IndexTable& idx : INDEX_TABLES)
+  {
+    if(util.hasTable(idx.table) && !hasIndex(db, idx.table))
+      return true;
+  }
+  return false;
+}
+
+void createIndexes(SqlDatabase *db)
+{
+  createIndexesFrom(db, "main", nullptr);
+}
+
+bool createIndexesFrom(SqlDatabase *db, const QString& sourceSchema,
+                       const std::function<bool(const QString& table)>& progress)
+{
+  for(const IndexTable& idx : INDEX_TABLES)
+  {
+    QString name = indexName(idx.table);
+    if(!spatialindex::hasSchemaTable(db, sourceSchema, idx.table) || spatialindex::hasSchemaTable(db, "main", name))
+      continue;
+
+    if(progress && !progress(idx.table))
+      return false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList cols = availableColumns(db, sourceSchema, idx);
+    if(sourceSchema == "main")
+    {
+      // Index is filled from the external content table and not updated automatically
+      db->exec(QString("create virtual table %1 using fts5(%2, content='%3', content_rowid='%4', "
+                       "tokenize='unicode61', prefix='2 3')").
+               arg(name).arg(cols.join(", ")).arg(idx.table).arg(idx.idColumn));
+      db->exec(QString("insert into %1(%1) values('rebuild')").arg(name));
+    }
+    else
+    {
+      // External content has to be in the same database - use a contentless table which gives only the rowid
+      db->exec(QString("create virtual table %1 using fts5(%2, content='', "
+                       "tokenize='unicode61', prefix='2 3')").
+               arg(name).arg(cols.join(", ")));
+      db->exec(QString("insert into %1(rowid, %2) select %3, %2 from %4.%5").
+               arg(name).arg(cols.join(", ")).arg(idx.idColumn).arg(sourceSchema).arg(idx.table));
+    }
+
+    qDebug() << Q_FUNC_INFO << "Created" << name << "in" << timer.elapsed() << "ms";
+  }
+  return true;
+}
+
+QStringList indexedColumns(SqlDatabase *db, const QString& table)
+{
+  if(hasIndex(db, table))
+  {
+    for(const IndexTable& idx : INDEX_TABLES)
+    {
+      if(idx.table == table)
+        // Same columns as used when creating the index
+        return availableColumns(db, "main", idx);
+    }
+  }
+  return QStringList();
+}
+
+QString prefixTerm(const QString& column, const QString& likePattern)
+{
+  // Letters and digits only - these are never split by the tokenizer and need no quoting
+  static const QRegularExpression PREFIX_PATTERN("^([A-Za-z0-9]+)%$");
+
+  QRegularExpressionMatch match = PREFIX_PATTERN.match(likePattern);
+  if(match.hasMatch())
+    return column + " : " + match.captured(1).toLower() + "*";
+  else
+    return QString();
+}
+
+QString matchCondition(const QString& table, const QString& idColumn, const QStringList& terms)
+{
+  return QString("%1 in (select rowid from %2 where %2 match '%3')").
+         arg(idColumn).arg(indexName(table)).arg(terms.join(" AND "));
+}
+
+} // namespace textindex
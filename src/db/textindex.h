@@ -0,0 +1,70 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_TEXTINDEX_H
+#define LITTLENAVMAP_TEXTINDEX_H
+
+#include <QStringList>
+
+#include <functional>
+
+namespace atools {
+namespace sql {
+class SqlDatabase;
+}
+}
+
+/*
+ * Optional SQLite FTS5 tables for prefix searches on ident, name, city and region of the search tables
+ * airport and nav_search (VOR, NDB and waypoint).
+ * Each index table is named like the indexed table with a suffix "_fts". Tables in the database file use the
+ * indexed table as external content while tables in the sidecar database of the spatialindex module are
+ * contentless. Queries have to keep their like conditions since the index finds word prefixes and not only
+ * string prefixes.
+ */
+namespace textindex {
+
+/* true if the FTS table for table exists in the database or in an attached sidecar database */
+bool hasIndex(atools::sql::SqlDatabase *db, const QString& table);
+
+/* true if any of the indexed tables exists but has no FTS table */
+bool isIndexMissing(atools::sql::SqlDatabase *db);
+
+/* Creates all missing FTS tables. Database has to be writeable. Does not commit.
+ * Throws an exception if the SQLite FTS5 module is not available. */
+void createIndexes(atools::sql::SqlDatabase *db);
+
+/* Creates all missing FTS tables in db for the tables in the attached sourceSchema.
+ * progress is called with the table name before each index and stops creation if it returns false.
+ * Returns false if stopped. */
+bool createIndexesFrom(atools::sql::SqlDatabase *db, const QString& sourceSchema,
+                       const std::function<bool(const QString& table)>& progress = nullptr);
+
+/* Get all indexed columns for table or an empty list if table has no FTS table */
+QStringList indexedColumns(atools::sql::SqlDatabase *db, const QString& table);
+
+/* Get the FTS term for a like pattern on column or an empty string if the pattern cannot use the index.
+ * Only patterns like "abc%" containing letters and digits followed by a single trailing wildcard are supported. */
+QString prefixTerm(const QString& column, const QString& likePattern);
+
+/* Get a condition like "airport_id in (select rowid from airport_fts where airport_fts match '...')"
+ * for terms created by prefixTerm. */
+QString matchCondition(const QString& table, const QString& idColumn, const QStringList& terms);
+
+} // namespace textindex
+
+#endif // LITTLENAVMAP_TEXTINDEX_H
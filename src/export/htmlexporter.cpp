@@ -112,7 +112,7 @@ int HtmlExporter::exportAll(bool open)
   atools::sql::SqlDatabase *db = controller->getSqlDatabase();
   SqlQuery query(db);
   query.exec(controller->getCurrentSqlQuery());
-  totalToExport = controller->getTotalRowCount();
+  totalToExport = controller->waitForTotalRowCount();
   totalPages = static_cast<int>(std::ceil(static_cast<float>(totalToExport) / static_cast<float>(pageSize)));
 
   if(!askOverwriteDialog(filename, totalPages))
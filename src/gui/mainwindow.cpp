@@ -707,6 +707,9 @@ void MainWindow::connectAllSlots()
   connect(ui->actionReloadScenery, &QAction::triggered, NavApp::getDatabaseManager(), &DatabaseManager::run);
   connect(ui->actionReloadSceneryCopyAirspaces, &QAction::triggered,
           NavApp::getDatabaseManager(), &DatabaseManager::copyAirspaces);
+  // Copied airspaces are shown if the X-Plane database is the current one
+  connect(ui->actionReloadSceneryCopyAirspaces, &QAction::triggered,
+          mapWidget, &MapWidget::invalidateStaticLayerCache);
   connect(ui->actionDatabaseFiles, &QAction::triggered, this, &MainWindow::showDatabaseFiles);
 
   connect(ui->actionOptions, &QAction::triggered, this, &MainWindow::options);
@@ -933,9 +936,11 @@ void MainWindow::connectAllSlots()
   connect(mapWidget, &MapWidget::aircraftTrackPruned, profileWidget, &ProfileWidget::aircraftTrackPruned);
 
   connect(weatherReporter, &WeatherReporter::weatherUpdated, mapWidget, &MapWidget::updateTooltip);
+  connect(weatherReporter, &WeatherReporter::weatherUpdated, mapWidget, &MapWidget::invalidateStaticLayerCache);
   connect(weatherReporter, &WeatherReporter::weatherUpdated, infoController, &InfoController::updateAirport);
 
   connect(connectClient, &ConnectClient::weatherUpdated, mapWidget, &MapWidget::updateTooltip);
+  connect(connectClient, &ConnectClient::weatherUpdated, mapWidget, &MapWidget::invalidateStaticLayerCache);
   connect(connectClient, &ConnectClient::weatherUpdated, infoController, &InfoController::updateAirport);
 
   connect(ui->actionHelpNavmapLegend, &QAction::triggered, this, &MainWindow::showNavmapLegend);
@@ -2043,16 +2048,19 @@ void MainWindow::routeSelectionChanged(int selected, int total)
 void MainWindow::searchSelectionChanged(const SearchBaseTable *source, int selected, int visible, int total)
 {
   QString selectionLabelText = tr("%1 of %2 %3 selected, %4 visible.");
+
+  // Total is -1 while counting in background
+  QString totalText = total >= 0 ? QString::number(total) : tr("%1+").arg(visible);
   QString type;
   if(source == searchController->getAirportSearch())
   {
     type = tr("Airports");
-    ui->labelAirportSearchStatus->setText(selectionLabelText.arg(selected).arg(total).arg(type).arg(visible));
+    ui->labelAirportSearchStatus->setText(selectionLabelText.arg(selected).arg(totalText).arg(type).arg(visible));
   }
   else if(source == searchController->getNavSearch())
   {
     type = tr("Navaids");
-    ui->labelNavSearchStatus->setText(selectionLabelText.arg(selected).arg(total).arg(type).arg(visible));
+    ui->labelNavSearchStatus->setText(selectionLabelText.arg(selected).arg(totalText).arg(type).arg(visible));
   }
 
   map::MapSearchResult result;
@@ -2304,6 +2312,9 @@ void MainWindow::mainWindowShown()
     databaseManager->run();
   }
 
+  // Build missing spatial indexes now since the databases are reopened when done
+  databaseManager->startIndexBuild();
+
   // If enabled connect to simulator without showing dialog
   NavApp::getConnectClient()->tryConnectOnStartup();
 
@@ -286,7 +286,7 @@ void InfoController::updateProgress()
   {
     // ok - scrollbars not pressed
     html.clear();
-    infoBuilder->aircraftProgressText(lastSimData.getUserAircraft(), html, NavApp::getRoute());
+    infoBuilder->aircraftProgressText(lastSimData->getUserAircraft(), html, NavApp::getRoute());
     atools::gui::util::updateTextEdit(ui->textBrowserAircraftProgressInfo, html.getHtml());
   }
 }
@@ -586,14 +586,14 @@ void InfoController::updateAircraftText()
   if(NavApp::isConnected())
 #endif
   {
-    if(lastSimData.getUserAircraft().getPosition().isValid())
+    if(lastSimData->getUserAircraft().getPosition().isValid())
     {
       if(atools::gui::util::canTextEditUpdate(ui->textBrowserAircraftInfo))
       {
         // ok - scrollbars not pressed
         HtmlBuilder html(true /* has background color */);
-        infoBuilder->aircraftText(lastSimData.getUserAircraft(), html);
-        infoBuilder->aircraftTextWeightAndFuel(lastSimData.getUserAircraft(), html);
+        infoBuilder->aircraftText(lastSimData->getUserAircraft(), html);
+        infoBuilder->aircraftTextWeightAndFuel(lastSimData->getUserAircraft(), html);
         atools::gui::util::updateTextEdit(ui->textBrowserAircraftInfo, html.getHtml());
       }
     }
@@ -613,13 +613,13 @@ void InfoController::updateAircraftProgressText()
   if(NavApp::isConnected())
 #endif
   {
-    if(lastSimData.getUserAircraft().getPosition().isValid())
+    if(lastSimData->getUserAircraft().getPosition().isValid())
     {
       if(atools::gui::util::canTextEditUpdate(ui->textBrowserAircraftProgressInfo))
       {
         // ok - scrollbars not pressed
         HtmlBuilder html(true /* has background color */);
-        infoBuilder->aircraftProgressText(lastSimData.getUserAircraft(), html, NavApp::getRoute());
+        infoBuilder->aircraftProgressText(lastSimData->getUserAircraft(), html, NavApp::getRoute());
         atools::gui::util::updateTextEdit(ui->textBrowserAircraftProgressInfo, html.getHtml());
       }
     }
@@ -639,7 +639,7 @@ void InfoController::updateAiAircraftText()
   if(NavApp::isConnected())
 #endif
   {
-    if(lastSimData.getUserAircraft().getPosition().isValid())
+    if(lastSimData->getUserAircraft().getPosition().isValid())
     {
       if(atools::gui::util::canTextEditUpdate(ui->textBrowserAircraftAiInfo))
       {
@@ -651,7 +651,7 @@ void InfoController::updateAiAircraftText()
           int num = 1;
           for(const SimConnectAircraft& aircraft : currentSearchResult.aiAircraft)
           {
-            infoBuilder->aircraftText(aircraft, html, num, lastSimData.getAiAircraft().size());
+            infoBuilder->aircraftText(aircraft, html, num, lastSimData->getAiAircraft().size());
             infoBuilder->aircraftProgressText(aircraft, html, Route());
             num++;
           }
@@ -660,7 +660,7 @@ void InfoController::updateAiAircraftText()
         }
         else
         {
-          int numAi = lastSimData.getAiAircraft().size();
+          int numAi = lastSimData->getAiAircraft().size();
           QString text;
 
           if(!(NavApp::getShownMapFeatures() & map::AIRCRAFT_AI))
@@ -680,7 +680,7 @@ void InfoController::updateAiAircraftText()
     ui->textBrowserAircraftAiInfo->clear();
 }
 
-void InfoController::simulatorDataReceived(atools::fs::sc::SimConnectData data)
+void InfoController::simulatorDataReceived(const SimConnectDataPtr& data)
 {
   if(databaseLoadStatus)
     return;
@@ -689,12 +689,12 @@ void InfoController::simulatorDataReceived(atools::fs::sc::SimConnectData data)
                             lastSimUpdate, static_cast<qint64>(MIN_SIM_UPDATE_TIME_MS)))
   {
     // Last update was more than 500 ms ago
-    updateAiAirports(data);
+    updateAiAirports(*data);
 
     Ui::MainWindow *ui = NavApp::getMainUi();
 
     lastSimData = data;
-    if(data.getUserAircraft().getPosition().isValid() && ui->dockWidgetAircraft->isVisible())
+    if(data->getUserAircraft().getPosition().isValid() && ui->dockWidgetAircraft->isVisible())
     {
       if(ui->tabWidgetAircraft->currentIndex() == ic::AIRCRAFT_USER)
         updateAircraftText();
@@ -744,7 +744,7 @@ void InfoController::connectedToSimulator()
 void InfoController::disconnectedFromSimulator()
 {
   qDebug() << Q_FUNC_INFO;
-  lastSimData = atools::fs::sc::SimConnectData();
+  lastSimData = simdata::emptySimConnectData();
   lastSimUpdate = 0;
   updateAircraftInfo();
 }
@@ -18,7 +18,7 @@
 #ifndef LITTLENAVMAP_INFOCONTROLLER_H
 #define LITTLENAVMAP_INFOCONTROLLER_H
 
-#include "fs/sc/simconnectdata.h"
+#include "connect/simconnectdataptr.h"
 #include "common/maptypes.h"
 
 #include <QObject>
@@ -80,7 +80,7 @@ public:
   void postDatabaseLoad();
 
   /* Update aircraft and aircraft progress tab */
-  void simulatorDataReceived(atools::fs::sc::SimConnectData data);
+  void simulatorDataReceived(const SimConnectDataPtr& data);
   void connectedToSimulator();
   void disconnectedFromSimulator();
 
@@ -116,7 +116,7 @@ private:
   void updateAiAircraftText();
 
   bool databaseLoadStatus = false;
-  atools::fs::sc::SimConnectData lastSimData;
+  SimConnectDataPtr lastSimData = simdata::emptySimConnectData();
   qint64 lastSimUpdate = 0;
 
   /* Airport and navaids that are currently shown in the tabs */
@@ -37,6 +37,8 @@
 #include "common/maptypes.h"
 #include "common/proctypes.h"
 #include "common/unit.h"
+#include "route/routebatch.h"
+#include "sql/sqldatabase.h"
 
 #include <QCommandLineParser>
 #include <QDebug>
@@ -57,6 +59,109 @@ using atools::logging::LoggingUtil;
 using atools::settings::Settings;
 using atools::gui::Translator;
 
+/* Options are looked up by name since they are shared by the GUI and the route batch mode */
+static void addOptions(QCommandLineParser& parser)
+{
+  parser.addHelpOption();
+  parser.addVersionOption();
+
+  parser.addOption({{"s", "settings-directory"},
+                    QObject::tr("Use <settings-directory> instead of \"%1\".").
+                    arg(QCoreApplication::organizationName()),
+                    QObject::tr("settings-directory")});
+
+  parser.addOption({{"r", "route-batch"},
+                    QObject::tr("Calculate flight plans for all lines "
+                                "\"departure,destination,altitude,network\" in <csv-file> "
+                                "and exit. Network is one of radionav, high, low or altitude."),
+                    QObject::tr("csv-file")});
+
+  parser.addOption({{"o", "route-batch-output"},
+                    QObject::tr("Write flight plans, route strings and summary of "
+                                "route batch calculation to <directory>."),
+                    QObject::tr("directory")});
+
+  parser.addOption({{"b", "route-batch-benchmark"},
+                    QObject::tr("Calculate route batch pairs one after another in a "
+                                "single thread with a new network for each pair "
+                                "to get reproducible timings.")});
+}
+
+/* Route batch mode has to be detected before creating the application object
+ * since it does not need a GUI, a display or a splash screen */
+static bool isRouteBatch(int argc, char *argv[])
+{
+  for(int i = 1; i < argc; i++)
+  {
+    QString arg = QString::fromLocal8Bit(argv[i]);
+    if(arg == "--route-batch" || arg.startsWith("--route-batch=") || (arg.startsWith("-r") && !arg.startsWith("--")))
+      return true;
+  }
+  return false;
+}
+
+/* Headless flight plan calculation using a console application - no main window */
+static int runRouteBatch(int& argc, char *argv[])
+{
+  int retval = 0;
+  QCoreApplication app(argc, argv);
+  NavApp::initApplicationInformation();
+
+  DatabaseManager *dbManager = nullptr;
+  try
+  {
+    QCommandLineParser parser;
+    addOptions(parser);
+    parser.process(app);
+
+    if(parser.isSet("settings-directory") && !parser.value("settings-directory").isEmpty())
+      Settings::setOverrideOrganisation(parser.value("settings-directory"));
+
+    LoggingHandler::initializeForTemp(atools::settings::Settings::getOverloadedPath(
+                                        ":/littlenavmap/resources/config/logging.cfg"));
+    LoggingUtil::logSystemInformation();
+    qInfo().noquote().nospace() << "atools revision " << atools::gitRevision() << " "
+                                << QCoreApplication::applicationName() << " revision " << GIT_REVISION;
+    Settings::logSettingsInformation();
+
+    migrate::checkAndMigrateSettings();
+
+    // Only used to find the navaid database - databases are used as they are without preparation
+    dbManager = new DatabaseManager(nullptr);
+    QString navDbFile = dbManager->getDatabaseFileNav();
+    delete dbManager;
+    dbManager = nullptr;
+
+    QString outDir = parser.isSet("route-batch-output") ? parser.value("route-batch-output") : QDir::currentPath();
+
+    RouteBatch routeBatch(navDbFile);
+    routeBatch.setBenchmark(parser.isSet("route-batch-benchmark"));
+    if(!routeBatch.readPairs(parser.value("route-batch")) || !routeBatch.run(outDir))
+    {
+      for(const QString& error : routeBatch.getErrors())
+        qWarning().noquote() << error;
+      retval = 1;
+    }
+  }
+  catch(atools::Exception& e)
+  {
+    // No message boxes without GUI application
+    qWarning() << "Route batch failed" << e.what();
+    retval = 1;
+  }
+  catch(...)
+  {
+    qWarning() << "Route batch failed";
+    retval = 1;
+  }
+
+  delete dbManager;
+  dbManager = nullptr;
+
+  qInfo() << "Route batch done, retval is" << retval << (retval == 0 ? "(ok)" : "(error)");
+  return retval;
+}
+
 int main(int argc, char *argv[])
 {
   // Initialize the resources from atools static library
@@ -88,6 +193,9 @@ int main(int argc, char *argv[])
   qRegisterMetaType<atools::fs::sc::SimConnectReply>();
   qRegisterMetaType<atools::fs::sc::WeatherRequest>();
 
+  if(isRouteBatch(argc, argv))
+    return runRouteBatch(argc, argv);
+
   // Set application information
   int retval = 0;
   NavApp app(argc, argv);
@@ -106,20 +214,13 @@ int main(int argc, char *argv[])
     app.processEvents();
 
     QCommandLineParser parser;
-    parser.addHelpOption();
-    parser.addVersionOption();
-
-    QCommandLineOption settingsDirOpt({"s", "settings-directory"},
-                                      QObject::tr("Use <settings-directory> instead of \"%1\".").
-                                      arg(NavApp::organizationName()),
-                                      QObject::tr("settings-directory"));
-    parser.addOption(settingsDirOpt);
+    addOptions(parser);
 
     // Process the actual command line arguments given by the user
     parser.process(*QCoreApplication::instance());
 
-    if(parser.isSet(settingsDirOpt) && !parser.value(settingsDirOpt).isEmpty())
-      Settings::setOverrideOrganisation(parser.value(settingsDirOpt));
+    if(parser.isSet("settings-directory") && !parser.value("settings-directory").isEmpty())
+      Settings::setOverrideOrganisation(parser.value("settings-directory"));
 
     // Initialize logging and force logfiles into the system or user temp directory
     // This will prefix all log files with orgranization and application name and append ".log"
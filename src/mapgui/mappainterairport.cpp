@@ -90,9 +90,10 @@ void MapPainterAirport::render(PaintContext *context)
     // Nothing found in bounding rectangle and route
     return;
 
-  // Collect all airports that are visible
-  QList<const MapAirport *> visibleAirports;
-  QList<QPointF> visiblePoints;
+  // Collect candidates and project them at once
+  QList<const MapAirport *> airports;
+  QVector<double> lonX, latY;
+  QVector<QSize> sizes;
   for(const MapAirport *airport : airportMap.values())
   {
     // Either part of the route or enabled in the actions/menus/toolbar
@@ -102,23 +103,34 @@ void MapPainterAirport::render(PaintContext *context)
     // Avoid drawing too many airports during animation when zooming out
     if(airport->longestRunwayLength >= context->mapLayer->getMinRunwayLength())
     {
-      float x, y;
-      bool hidden;
-      bool visible = wToS(airport->position, x, y, scale->getScreeenSizeForRect(airport->bounding), &hidden);
+      airports.append(airport);
+      lonX.append(airport->position.getLonX());
+      latY.append(airport->position.getLatY());
+      sizes.append(scale->getScreeenSizeForRect(airport->bounding));
+    }
+  }
 
-      if(!hidden)
-      {
-        if(!visible && context->mapLayer->isAirportOverviewRunway())
-          // Check bounding rect for visibility if relevant - not for point symbols
-          visible = airport->bounding.overlaps(context->viewportRect);
+  QVector<double> xs, ys;
+  QVector<bool> visibleFlags, hiddenFlags;
+  wToSBatch(lonX, latY, xs, ys, visibleFlags, DEFAULT_WTOS_SIZE, &sizes, &hiddenFlags);
 
-        airport->bounding.overlaps(context->viewportRect);
+  // Collect all airports that are visible
+  QList<const MapAirport *> visibleAirports;
+  QList<QPointF> visiblePoints;
+  for(int i = 0; i < airports.size(); i++)
+  {
+    const MapAirport *airport = airports.at(i);
+    if(!hiddenFlags.at(i))
+    {
+      bool visible = visibleFlags.at(i);
+      if(!visible && context->mapLayer->isAirportOverviewRunway())
+        // Check bounding rect for visibility if relevant - not for point symbols
+        visible = airport->bounding.overlaps(context->viewportRect);
 
-        if(visible)
-        {
-          visibleAirports.append(airport);
-          visiblePoints.append(QPointF(x, y));
-        }
+      if(visible)
+      {
+        visibleAirports.append(airport);
+        visiblePoints.append(QPointF(static_cast<float>(xs.at(i)), static_cast<float>(ys.at(i))));
       }
     }
   }
@@ -61,6 +61,23 @@ void MapPainterAirspace::render(PaintContext *context)
 
     painter->setBackgroundMode(Qt::TransparentMode);
 
+    Marble::ViewportParams *viewport = context->viewport;
+    if(!(viewport->centerLongitude() == lastCenterLonX && viewport->centerLatitude() == lastCenterLatY &&
+         viewport->radius() == lastRadius && viewport->projection() == lastProjection &&
+         viewport->size() == lastSize))
+    {
+      // Viewport has changed - project again
+      screenPolygons.clear();
+      lastCenterLonX = viewport->centerLongitude();
+      lastCenterLatY = viewport->centerLatitude();
+      lastRadius = viewport->radius();
+      lastProjection = viewport->projection();
+      lastSize = viewport->size();
+    }
+
+    // Use a simplified geometry which differs less than a pixel from the original
+    int level = MapQuery::airspaceRingLevel(curBox.width(DEG) / std::max(viewport->width(), 1));
+
     for(const MapAirspace& airspace : *airspaces)
     {
       if(!(airspace.type & context->airspaceFilterByLayer.types))
@@ -73,21 +90,36 @@ void MapPainterAirspace::render(PaintContext *context)
 
         // qDebug() << airspace.getId() << airspace.name;
 
-        Marble::GeoDataLinearRing linearRing;
-        linearRing.setTessellate(true);
+        auto it = screenPolygons.find(airspace.id);
+        if(it == screenPolygons.end())
+        {
+          QVector<QPolygonF> polygons;
+          const GeoDataLinearRing *ring = mapQuery->getAirspaceRing(airspace.id, level);
+          if(ring != nullptr)
+          {
+            QVector<QPolygonF *> screenPolys;
+            viewport->screenCoordinates(*ring, screenPolys);
+            for(QPolygonF *poly : screenPolys)
+              polygons.append(*poly);
+            qDeleteAll(screenPolys);
+          }
+          it = screenPolygons.insert(airspace.id, polygons);
+        }
 
         painter->setPen(mapcolors::penForAirspace(airspace));
 
         if(!context->drawFast)
           painter->setBrush(mapcolors::colorForAirspaceFill(airspace));
 
-        const LineString *lines = mapQuery->getAirspaceGeometry(airspace.id);
-
-        for(const Pos& pos : *lines)
-          linearRing.append(Marble::GeoDataCoordinates(pos.getLonX(), pos.getLatY(), 0, DEG));
-
-        painter->drawPolygon(linearRing);
+        for(const QPolygonF& polygon : it.value())
+          painter->drawPolygon(polygon);
       }
     }
   }
 }
+
+void MapPainterAirspace::clearCache()
+{
+  screenPolygons.clear();
+  lastRadius = -1;
+}
@@ -20,6 +20,9 @@
 
 #include "mapgui/mappainter.h"
 
+#include <QHash>
+#include <QPolygonF>
+
 namespace Marble {
 class GeoDataLineString;
 }
@@ -39,8 +42,20 @@ public:
 
   virtual void render(PaintContext *context) override;
 
+  /* Drop projected polygons - needed if the database changes */
+  void clearCache();
+
 private:
   const Route *route;
+
+  /* Screen polygons by airspace id for the last viewport. Reused as long as the viewport does not change. */
+  QHash<int, QVector<QPolygonF> > screenPolygons;
+
+  /* Values of the last viewport */
+  qreal lastCenterLonX = 0., lastCenterLatY = 0.;
+  int lastRadius = -1;
+  Marble::Projection lastProjection = Marble::Spherical;
+  QSize lastSize;
 };
 
 #endif // LITTLENAVMAP_MAPPAINTERAIRSPACE_H
@@ -280,17 +280,21 @@ void MapPainterNav::paintWaypoints(PaintContext *context, const QList<MapWaypoin
   bool drawAirwayV = context->mapLayer->isAirwayWaypoint() && context->objectTypes.testFlag(map::AIRWAYV);
   bool drawAirwayJ = context->mapLayer->isAirwayWaypoint() && context->objectTypes.testFlag(map::AIRWAYJ);
 
-  for(const MapWaypoint& waypoint : *waypoints)
+  QVector<double> xs, ys;
+  QVector<bool> visible;
+  wToSBatch(*waypoints, xs, ys, visible);
+
+  for(int i = 0; i < waypoints->size(); i++)
   {
+    const MapWaypoint& waypoint = waypoints->at(i);
+
     // If waypoints are off, airways are on and waypoint has no airways skip it
     if(!(drawWaypoint || (drawAirwayV && waypoint.hasVictorAirways) || (drawAirwayJ && waypoint.hasJetAirways)))
       continue;
 
-    int x, y;
-    bool visible = wToS(waypoint.position, x, y);
-
-    if(visible)
+    if(visible.at(i))
     {
+      int x = static_cast<int>(std::round(xs.at(i))), y = static_cast<int>(std::round(ys.at(i)));
       if(context->objCount())
         return;
 
@@ -307,13 +311,16 @@ void MapPainterNav::paintWaypoints(PaintContext *context, const QList<MapWaypoin
 
 void MapPainterNav::paintVors(PaintContext *context, const QList<MapVor> *vors, bool drawFast)
 {
-  for(const MapVor& vor : *vors)
-  {
-    int x, y;
-    bool visible = wToS(vor.position, x, y);
+  QVector<double> xs, ys;
+  QVector<bool> visible;
+  wToSBatch(*vors, xs, ys, visible);
 
-    if(visible)
+  for(int i = 0; i < vors->size(); i++)
+  {
+    if(visible.at(i))
     {
+      const MapVor& vor = vors->at(i);
+      int x = static_cast<int>(std::round(xs.at(i))), y = static_cast<int>(std::round(ys.at(i)));
       if(context->objCount())
         return;
 
@@ -336,13 +343,16 @@ void MapPainterNav::paintVors(PaintContext *context, const QList<MapVor> *vors,
 
 void MapPainterNav::paintNdbs(PaintContext *context, const QList<MapNdb> *ndbs, bool drawFast)
 {
-  for(const MapNdb& ndb : *ndbs)
-  {
-    int x, y;
-    bool visible = wToS(ndb.position, x, y);
+  QVector<double> xs, ys;
+  QVector<bool> visible;
+  wToSBatch(*ndbs, xs, ys, visible);
 
-    if(visible)
+  for(int i = 0; i < ndbs->size(); i++)
+  {
+    if(visible.at(i))
     {
+      const MapNdb& ndb = ndbs->at(i);
+      int x = static_cast<int>(std::round(xs.at(i))), y = static_cast<int>(std::round(ys.at(i)));
       if(context->objCount())
         return;
 
@@ -363,13 +373,16 @@ void MapPainterNav::paintNdbs(PaintContext *context, const QList<MapNdb> *ndbs,
 
 void MapPainterNav::paintMarkers(PaintContext *context, const QList<MapMarker> *markers, bool drawFast)
 {
-  for(const MapMarker& marker : *markers)
-  {
-    int x, y;
-    bool visible = wToS(marker.position, x, y);
+  QVector<double> xs, ys;
+  QVector<bool> visible;
+  wToSBatch(*markers, xs, ys, visible);
 
-    if(visible)
+  for(int i = 0; i < markers->size(); i++)
+  {
+    if(visible.at(i))
     {
+      const MapMarker& marker = markers->at(i);
+      int x = static_cast<int>(std::round(xs.at(i))), y = static_cast<int>(std::round(ys.at(i)));
       if(context->objCount())
         return;
 
@@ -51,6 +51,10 @@ MapPainterRoute::~MapPainterRoute()
 
 void MapPainterRoute::render(PaintContext *context)
 {
+  // Draw alternatives of flight plan calculation below the route
+  if(!mapWidget->getRouteAlternatives().isEmpty())
+    paintRouteAlternatives(context);
+
   // Draw route including approaches
   if(context->objectTypes.testFlag(map::FLIGHTPLAN))
     paintRoute(context);
@@ -226,6 +230,42 @@ void MapPainterRoute::paintRoute(const PaintContext *context)
 
 }
 
+void MapPainterRoute::paintRouteAlternatives(const PaintContext *context)
+{
+  atools::util::PainterContextSaver saver(context->painter);
+  Q_UNUSED(saver);
+
+  QPainter *painter = context->painter;
+  painter->setBrush(Qt::NoBrush);
+
+  float outerlinewidth = context->sz(context->thicknessFlightplan, 7);
+  float innerlinewidth = context->sz(context->thicknessFlightplan, 4);
+
+  const QVector<LineString>& alternatives = mapWidget->getRouteAlternatives();
+  int selected = mapWidget->getRouteAlternativeSelected();
+
+  // Draw selected alternative last to have it on top
+  for(int i = 0; i < alternatives.size(); i++)
+  {
+    if(i == selected)
+      continue;
+
+    painter->setPen(QPen(mapcolors::routeAlternativeColor, innerlinewidth, Qt::DashLine, Qt::RoundCap,
+                         Qt::RoundJoin));
+    drawLineString(context, alternatives.at(i));
+  }
+
+  if(selected >= 0 && selected < alternatives.size())
+  {
+    painter->setPen(QPen(mapcolors::routeOutlineColor, outerlinewidth, Qt::SolidLine, Qt::RoundCap,
+                         Qt::RoundJoin));
+    drawLineString(context, alternatives.at(selected));
+    painter->setPen(QPen(mapcolors::routeAlternativeSelectedColor, innerlinewidth, Qt::SolidLine, Qt::RoundCap,
+                         Qt::RoundJoin));
+    drawLineString(context, alternatives.at(selected));
+  }
+}
+
 void MapPainterRoute::paintTopOfDescent(const PaintContext *context)
 {
   if(route->size() >= 2)
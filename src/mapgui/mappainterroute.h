@@ -102,6 +102,7 @@ private:
                             int index, QLineF& lastLine, QVector<DrawText> *drawTextLines, bool noText, bool preview);
 
   void paintTopOfDescent(const PaintContext *context);
+  void paintRouteAlternatives(const PaintContext *context);
 
   QLineF paintApproachTurn(QLineF& lastLine, QLineF line, const proc::MapProcedureLeg& leg, QPainter *painter,
                            QPointF intersectPoint);
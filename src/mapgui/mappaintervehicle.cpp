@@ -141,15 +141,32 @@ void MapPainterVehicle::paintTrack(const PaintContext *context)
     painter->setPen(mapcolors::aircraftTrailPen(size));
     bool lastVisible = false;
 
-    int x1, y1;
+    // Get track in a resolution matching the zoom distance
+    QVector<Pos> positions;
+    aircraftTrack.getTrackPositions(1000.f / std::max(scale->getPixelForMeter(1000.f), 0.001f), positions);
+
+    // Project the whole track at once
+    QVector<double> lonX, latY;
+    lonX.reserve(positions.size());
+    latY.reserve(positions.size());
+    for(const Pos& pos : positions)
+    {
+      lonX.append(pos.getLonX());
+      latY.append(pos.getLatY());
+    }
+
+    QVector<double> xs, ys;
+    QVector<bool> visible;
+    wToSBatch(lonX, latY, xs, ys, visible);
+
+    int x1 = static_cast<int>(std::round(xs.first())), y1 = static_cast<int>(std::round(ys.first()));
     int x2 = -1, y2 = -1;
     QRect vpRect(painter->viewport());
-    wToS(aircraftTrack.first().pos, x1, y1);
 
-    for(int i = 1; i < aircraftTrack.size(); i++)
+    for(int i = 1; i < positions.size(); i++)
     {
-      const at::AircraftTrackPos& trackPos = aircraftTrack.at(i);
-      wToS(trackPos.pos, x2, y2);
+      x2 = static_cast<int>(std::round(xs.at(i)));
+      y2 = static_cast<int>(std::round(ys.at(i)));
 
       QRect rect(QPoint(x1, y1), QPoint(x2, y2));
       rect = rect.normalized();
@@ -30,12 +30,17 @@
 #include "mapgui/mappainternav.h"
 #include "mapgui/mappainterroute.h"
 #include "mapgui/mapscale.h"
+#include "mapgui/mappaintprofiler.h"
+#include "query/mapquery.h"
 #include "route/route.h"
 #include "options/optiondata.h"
+#include "common/constants.h"
+#include "settings/settings.h"
 
 #include <QElapsedTimer>
 
 #include <marble/GeoPainter.h>
+#include <marble/ViewportParams.h>
 
 using namespace Marble;
 using namespace atools::geo;
@@ -58,6 +63,12 @@ MapPaintLayer::MapPaintLayer(MapWidget *widget, MapQuery *mapQueries)
   mapPainterAircraft = new MapPainterAircraft(mapWidget, mapScale);
   mapPainterShip = new MapPainterShip(mapWidget, mapScale);
 
+  profiler = new MapPaintProfiler();
+  mapQuery->setCollectStatistics(profiler->isEnabled());
+
+  staticLayerCacheEnabled = atools::settings::Settings::instance().getAndStoreValue(
+    lnm::SETTINGS_MAPPAINT + "StaticLayerCache", true).toBool();
+
   // Default for visible object types
   objectTypes = map::MapObjectTypes(map::AIRPORT | map::VOR | map::NDB | map::AP_ILS | map::MARKER | map::WAYPOINT);
 }
@@ -75,16 +86,20 @@ MapPaintLayer::~MapPaintLayer()
 
   delete layers;
   delete mapScale;
+  delete profiler;
 }
 
 void MapPaintLayer::preDatabaseLoad()
 {
   databaseLoadStatus = true;
+  mapPainterAirspace->clearCache();
+  staticLayerCacheValid = false;
 }
 
 void MapPaintLayer::postDatabaseLoad()
 {
   databaseLoadStatus = false;
+  staticLayerCacheValid = false;
 }
 
 void MapPaintLayer::setShowMapObjects(map::MapObjectTypes type, bool show)
@@ -93,16 +108,19 @@ void MapPaintLayer::setShowMapObjects(map::MapObjectTypes type, bool show)
     objectTypes |= type;
   else
     objectTypes &= ~type;
+  staticLayerCacheValid = false;
 }
 
 void MapPaintLayer::setShowAirspaces(map::MapAirspaceFilter types)
 {
   airspaceTypes = types;
+  staticLayerCacheValid = false;
 }
 
 void MapPaintLayer::setDetailFactor(int factor)
 {
   detailFactor = factor;
+  staticLayerCacheValid = false;
   updateLayers();
 }
 
@@ -342,125 +360,224 @@ bool MapPaintLayer::render(GeoPainter *painter, ViewportParams *viewport,
 
   if(!databaseLoadStatus)
   {
+    profiler->start(prof::FRAME);
+
     // Update map scale for screen distance approximation
     mapScale->update(viewport, mapWidget->distance());
 
-    // What to draw while scrolling or zooming map
-    opts::MapScrollDetail mapScrollDetail = OptionData::instance().getMapScrollDetail();
-
-    // Check if no painting wanted during scroll
-    if(!(mapScrollDetail == opts::NONE && mapWidget->viewContext() == Marble::Animation))
+    PaintContext context;
+    if(initPaintContext(context, painter, viewport))
     {
-      updateLayers();
-
-      PaintContext context;
-      context.mapLayer = mapLayer;
-      context.mapLayerEffective = mapLayerEffective;
-      context.painter = painter;
-      context.viewport = viewport;
-      context.objectTypes = objectTypes;
-      context.airspaceFilterByLayer = getShownAirspacesTypesByLayer();
-      context.viewContext = mapWidget->viewContext();
-      context.drawFast = (mapScrollDetail == opts::FULL || mapScrollDetail == opts::HIGHER) ?
-                         false : mapWidget->viewContext() == Marble::Animation;
-      context.lazyUpdate = mapScrollDetail == opts::FULL ? false : mapWidget->viewContext() == Marble::Animation;
-      context.mapScrollDetail = mapScrollDetail;
-
-      // Copy default font
-      context.defaultFont = painter->font();
-      context.defaultFont.setBold(true);
-      painter->setFont(context.defaultFont);
-
-      const GeoDataLatLonAltBox& box = viewport->viewLatLonAltBox();
-      context.viewportRect = atools::geo::Rect(box.west(GeoDataCoordinates::Degree),
-                                               box.north(GeoDataCoordinates::Degree),
-                                               box.east(GeoDataCoordinates::Degree),
-                                               box.south(GeoDataCoordinates::Degree));
-
-      const OptionData& od = OptionData::instance();
-
-      context.symbolSizeAircraftAi = od.getDisplaySymbolSizeAircraftAi() / 100.f;
-      context.symbolSizeAircraftUser = od.getDisplaySymbolSizeAircraftUser() / 100.f;
-      context.symbolSizeAirport = od.getDisplaySymbolSizeAirport() / 100.f;
-      context.symbolSizeNavaid = od.getDisplaySymbolSizeNavaid() / 100.f;
-      context.textSizeAircraftAi = od.getDisplayTextSizeAircraftAi() / 100.f;
-      context.textSizeAircraftUser = od.getDisplayTextSizeAircraftUser() / 100.f;
-      context.textSizeAirport = od.getDisplayTextSizeAirport() / 100.f;
-      context.textSizeFlightplan = od.getDisplayTextSizeFlightplan() / 100.f;
-      context.textSizeNavaid = od.getDisplayTextSizeNavaid() / 100.f;
-      context.thicknessFlightplan = od.getDisplayThicknessFlightplan() / 100.f;
-      context.thicknessTrail = od.getDisplayThicknessTrail() / 100.f;
-      context.thicknessRangeDistance = od.getDisplayThicknessRangeDistance() / 100.f;
-
-      context.dispOpts = od.getDisplayOptions();
-
-      if(mapWidget->viewContext() == Marble::Still)
+      if(staticLayerCacheEnabled && context.viewContext == Marble::Still)
       {
-        painter->setRenderHint(QPainter::Antialiasing, true);
-        painter->setRenderHint(QPainter::TextAntialiasing, true);
-        painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+        // Draw airspaces, navaids and airports from the image if view and data did not change
+        // The base map is not part of this image. Marble's texture layer keeps its own mapped canvas image
+        // for an unchanged viewport. Caching the composed map would need a separate pass for the float items
+        // which Marble paints after this layer.
+        updateStaticLayerCache(context);
+        static_cast<QPainter *>(painter)->drawImage(QPoint(0, 0), staticLayerCache);
+        context.objectCount = staticObjectCount;
       }
-      else if(mapWidget->viewContext() == Marble::Animation)
+      else
       {
-        painter->setRenderHint(QPainter::Antialiasing, false);
-        painter->setRenderHint(QPainter::TextAntialiasing, false);
-        painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+        // Map is moving - paint all directly
+        staticLayerCacheValid = false;
+        paintStaticLayers(&context);
       }
 
-      mapPainterShip->render(&context);
+      paintDynamicLayers(&context);
+    }
 
-      if(mapWidget->distance() < layer::DISTANCE_CUT_OFF_LIMIT)
-      {
-        if(!context.isOverflow())
-          mapPainterAirspace->render(&context);
-
-        if(context.mapLayerEffective->isAirportDiagram())
-        {
-          // Put ILS below and navaids on top of airport diagram
-          mapPainterIls->render(&context);
-
-          if(!context.isOverflow())
-            mapPainterAirport->render(&context);
-
-          if(!context.isOverflow())
-            mapPainterNav->render(&context);
-        }
-        else
-        {
-          // Airports on top of all
-          if(!context.isOverflow())
-            mapPainterIls->render(&context);
-
-          if(!context.isOverflow())
-            mapPainterNav->render(&context);
-
-          if(!context.isOverflow())
-            mapPainterAirport->render(&context);
-        }
-      }
+    finishFrame(painter, &context);
+  }
+  return true;
+}
 
-      // if(!context.isOverflow()) always paint route even if number of objets is too large
-      mapPainterRoute->render(&context);
+void MapPaintLayer::updateStaticLayerCache(const PaintContext& context)
+{
+  const ViewportParams *viewport = context.viewport;
+  if(staticLayerCacheValid &&
+     staticLayerCenterLonX == viewport->centerLongitude() && staticLayerCenterLatY == viewport->centerLatitude() &&
+     staticLayerRadius == viewport->radius() && staticLayerProjection == viewport->projection() &&
+     staticLayerSize == viewport->size())
+    return;
+
+  qreal ratio = context.painter->device()->devicePixelRatioF();
+  QSize imageSize = viewport->size() * ratio;
+  if(staticLayerCache.size() != imageSize)
+  {
+    staticLayerCache = QImage(imageSize, QImage::Format_ARGB32_Premultiplied);
+    staticLayerCache.setDevicePixelRatio(ratio);
+  }
+  staticLayerCache.fill(Qt::transparent);
 
-      // if(!context.isOverflow())
-      mapPainterMark->render(&context);
+  {
+    GeoPainter imagePainter(&staticLayerCache, context.viewport, mapWidget->mapQuality());
+    imagePainter.setFont(context.painter->font());
 
-      mapPainterAircraft->render(&context);
+    PaintContext imageContext;
+    initPaintContext(imageContext, &imagePainter, context.viewport);
+    paintStaticLayers(&imageContext);
+    staticObjectCount = imageContext.objectCount;
+  }
 
-      if(context.isOverflow())
-        overflow = PaintContext::MAX_OBJECT_COUNT;
-      else
-        overflow = 0;
-    }
+  staticLayerCenterLonX = viewport->centerLongitude();
+  staticLayerCenterLatY = viewport->centerLatitude();
+  staticLayerRadius = viewport->radius();
+  staticLayerProjection = viewport->projection();
+  staticLayerSize = viewport->size();
+  staticLayerCacheValid = true;
+}
+
+bool MapPaintLayer::initPaintContext(PaintContext& context, GeoPainter *painter, ViewportParams *viewport)
+{
+  // What to draw while scrolling or zooming map
+  opts::MapScrollDetail mapScrollDetail = OptionData::instance().getMapScrollDetail();
+
+  // Check if no painting wanted during scroll
+  if(mapScrollDetail == opts::NONE && mapWidget->viewContext() == Marble::Animation)
+    return false;
+
+  updateLayers();
+
+  context.mapLayer = mapLayer;
+  context.mapLayerEffective = mapLayerEffective;
+  context.painter = painter;
+  context.viewport = viewport;
+  context.objectTypes = objectTypes;
+  context.airspaceFilterByLayer = getShownAirspacesTypesByLayer();
+  context.viewContext = mapWidget->viewContext();
+  context.drawFast = (mapScrollDetail == opts::FULL || mapScrollDetail == opts::HIGHER) ?
+                     false : mapWidget->viewContext() == Marble::Animation;
+  context.lazyUpdate = mapScrollDetail == opts::FULL ? false : mapWidget->viewContext() == Marble::Animation;
+  context.mapScrollDetail = mapScrollDetail;
+
+  // Copy default font
+  context.defaultFont = painter->font();
+  context.defaultFont.setBold(true);
+  painter->setFont(context.defaultFont);
+
+  const GeoDataLatLonAltBox& box = viewport->viewLatLonAltBox();
+  context.viewportRect = atools::geo::Rect(box.west(GeoDataCoordinates::Degree),
+                                           box.north(GeoDataCoordinates::Degree),
+                                           box.east(GeoDataCoordinates::Degree),
+                                           box.south(GeoDataCoordinates::Degree));
+
+  const OptionData& od = OptionData::instance();
+
+  context.symbolSizeAircraftAi = od.getDisplaySymbolSizeAircraftAi() / 100.f;
+  context.symbolSizeAircraftUser = od.getDisplaySymbolSizeAircraftUser() / 100.f;
+  context.symbolSizeAirport = od.getDisplaySymbolSizeAirport() / 100.f;
+  context.symbolSizeNavaid = od.getDisplaySymbolSizeNavaid() / 100.f;
+  context.textSizeAircraftAi = od.getDisplayTextSizeAircraftAi() / 100.f;
+  context.textSizeAircraftUser = od.getDisplayTextSizeAircraftUser() / 100.f;
+  context.textSizeAirport = od.getDisplayTextSizeAirport() / 100.f;
+  context.textSizeFlightplan = od.getDisplayTextSizeFlightplan() / 100.f;
+  context.textSizeNavaid = od.getDisplayTextSizeNavaid() / 100.f;
+  context.thicknessFlightplan = od.getDisplayThicknessFlightplan() / 100.f;
+  context.thicknessTrail = od.getDisplayThicknessTrail() / 100.f;
+  context.thicknessRangeDistance = od.getDisplayThicknessRangeDistance() / 100.f;
+
+  context.dispOpts = od.getDisplayOptions();
+
+  if(mapWidget->viewContext() == Marble::Still)
+  {
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    painter->setRenderHint(QPainter::TextAntialiasing, true);
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+  }
+  else if(mapWidget->viewContext() == Marble::Animation)
+  {
+    painter->setRenderHint(QPainter::Antialiasing, false);
+    painter->setRenderHint(QPainter::TextAntialiasing, false);
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+  }
+  return true;
+}
 
-    // Dim the map by drawing a semi-transparent black rectangle
-    if(OptionData::instance().isGuiStyleDark())
+/* Airspaces, navaids and airports which change only with view or data */
+void MapPaintLayer::paintStaticLayers(PaintContext *context)
+{
+  if(mapWidget->distance() < layer::DISTANCE_CUT_OFF_LIMIT)
+  {
+    if(!context->isOverflow())
+      renderPainter(mapPainterAirspace, context, prof::AIRSPACE);
+
+    if(context->mapLayerEffective->isAirportDiagram())
     {
-      int dim = OptionData::instance().getGuiStyleMapDimming();
-      QColor col = QColor::fromRgb(0, 0, 0, 255 - (255 * dim / 100));
-      painter->fillRect(QRect(0, 0, painter->device()->width(), painter->device()->height()), col);
+      // Put ILS below and navaids on top of airport diagram
+      renderPainter(mapPainterIls, context, prof::ILS);
+
+      if(!context->isOverflow())
+        renderPainter(mapPainterAirport, context, prof::AIRPORT);
+
+      if(!context->isOverflow())
+        renderPainter(mapPainterNav, context, prof::NAV);
     }
+    else
+    {
+      // Airports on top of all
+      if(!context->isOverflow())
+        renderPainter(mapPainterIls, context, prof::ILS);
 
+      if(!context->isOverflow())
+        renderPainter(mapPainterNav, context, prof::NAV);
+
+      if(!context->isOverflow())
+        renderPainter(mapPainterAirport, context, prof::AIRPORT);
+    }
   }
-  return true;
+}
+
+/* Ships, route, marks and aircraft which can change with every simulator update */
+void MapPaintLayer::paintDynamicLayers(PaintContext *context)
+{
+  renderPainter(mapPainterShip, context, prof::SHIP);
+
+  // if(!context->isOverflow()) always paint route even if number of objets is too large
+  renderPainter(mapPainterRoute, context, prof::ROUTE);
+
+  // if(!context->isOverflow())
+  renderPainter(mapPainterMark, context, prof::MARK);
+
+  renderPainter(mapPainterAircraft, context, prof::AIRCRAFT);
+}
+
+/* Update overflow, dim map and finish profiler frame */
+void MapPaintLayer::finishFrame(GeoPainter *painter, PaintContext *context)
+{
+  if(context->isOverflow())
+    overflow = PaintContext::MAX_OBJECT_COUNT;
+  else
+    overflow = 0;
+
+  // Dim the map by drawing a semi-transparent black rectangle
+  if(OptionData::instance().isGuiStyleDark())
+  {
+    int dim = OptionData::instance().getGuiStyleMapDimming();
+    QColor col = QColor::fromRgb(0, 0, 0, 255 - (255 * dim / 100));
+    painter->fillRect(QRect(0, 0, painter->device()->width(), painter->device()->height()), col);
+  }
+
+  profiler->stop(prof::FRAME);
+
+  if(profiler->isEnabled())
+  {
+    // Database access of all painters and screen index updates since last frame
+    const MapQuery::Statistics& stats = mapQuery->getStatistics();
+    profiler->add(prof::QUERY, stats.queryNs, stats.numCalls);
+    profiler->endFrame(stats.tileHits, stats.tileMisses, mapWidget->viewContext() == Marble::Still);
+    mapQuery->resetStatistics();
+
+    profiler->paintOverlay(painter);
+  }
+}
+
+/* Call painter and collect time and number of drawn objects */
+void MapPaintLayer::renderPainter(MapPainter *mapPainter, PaintContext *context, prof::Section section)
+{
+  int objectCount = context->objectCount;
+  profiler->start(section);
+  mapPainter->render(context);
+  profiler->stop(section, context->objectCount - objectCount);
 }
@@ -19,10 +19,13 @@
 #define LITTLENAVMAP_MAPPAINTLAYER_H
 
 #include "mapgui/mappainter.h"
+#include "mapgui/mappaintprofiler.h"
 
+#include <QImage>
 #include <QPen>
 
 #include <marble/LayerInterface.h>
+#include <marble/MarbleGlobal.h>
 
 namespace Marble {
 class GeoPainter;
@@ -103,9 +106,31 @@ public:
     return overflow;
   }
 
+  /* Collects render times if enabled in settings */
+  MapPaintProfiler *getProfiler() const
+  {
+    return profiler;
+  }
+
+  /* Paint airspaces, navaids and airports again on next render. Needed if the data for these changes. */
+  void invalidateStaticLayerCache()
+  {
+    staticLayerCacheValid = false;
+  }
+
 private:
   void initMapLayerSettings();
   void updateLayers();
+  void renderPainter(MapPainter *mapPainter, PaintContext *context, prof::Section section);
+
+  /* Fill context and painter settings. Returns false if nothing should be painted */
+  bool initPaintContext(PaintContext& context, Marble::GeoPainter *painter, Marble::ViewportParams *viewport);
+  void paintStaticLayers(PaintContext *context);
+  void paintDynamicLayers(PaintContext *context);
+
+  /* Render static layers into staticLayerCache if view or data have changed */
+  void updateStaticLayerCache(const PaintContext& context);
+  void finishFrame(Marble::GeoPainter *painter, PaintContext *context);
 
   /* Implemented from LayerInterface: We  draw above all but below user tools */
   virtual QStringList renderPosition() const override
@@ -126,6 +151,20 @@ private:
 
   bool databaseLoadStatus = false;
 
+  /* Transparent image of airspaces, navaids and airports. Reused as long as view and data do not change
+   * so that simulator updates paint only ships, route, marks and aircraft. */
+  QImage staticLayerCache;
+  bool staticLayerCacheEnabled = true, staticLayerCacheValid = false;
+
+  /* Viewport of the cached image */
+  qreal staticLayerCenterLonX = 0., staticLayerCenterLatY = 0.;
+  int staticLayerRadius = -1;
+  Marble::Projection staticLayerProjection = Marble::Spherical;
+  QSize staticLayerSize;
+
+  /* Number of objects painted into the cached image */
+  int staticObjectCount = 0;
+
   /* All painters */
   MapPainterAirport *mapPainterAirport;
   MapPainterAirspace *mapPainterAirspace;
@@ -140,6 +179,7 @@ private:
   MapQuery *mapQuery = nullptr;
 
   MapScale *mapScale = nullptr;
+  MapPaintProfiler *profiler = nullptr;
   MapLayerSettings *layers = nullptr;
   MapWidget *mapWidget = nullptr;
   const MapLayer *mapLayer = nullptr, *mapLayerEffective = nullptr;
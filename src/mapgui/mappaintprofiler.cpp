@@ -0,0 +1,208 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "mapgui/mappaintprofiler.h"
+
+#include "common/constants.h"
+#include "settings/settings.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFontMetrics>
+#include <QPainter>
+#include <QTextStream>
+
+#include <algorithm>
+
+using atools::settings::Settings;
+
+/* Number of frames for the average frame time */
+static const int AVERAGE_FRAMES = 50;
+
+static const char *SECTION_NAMES[prof::NUM_SECTIONS] =
+{
+  "frame", "ship", "airspace", "ils", "airport", "nav", "route", "mark", "aircraft", "query", "screen_index"
+};
+
+MapPaintProfiler::MapPaintProfiler()
+{
+  Settings& settings = Settings::instance();
+  overlay = settings.getAndStoreValue(lnm::SETTINGS_MAPPAINT + "ProfilerOverlay", false).toBool();
+  log = settings.getAndStoreValue(lnm::SETTINGS_MAPPAINT + "ProfilerLog", false).toBool();
+  logMaxSize = settings.getAndStoreValue(lnm::SETTINGS_MAPPAINT + "ProfilerLogMaxSizeKb", 10240).toLongLong() * 1024;
+
+  clearFrame(current);
+  clearFrame(last);
+  frameTimes.fill(0, AVERAGE_FRAMES);
+
+  if(isEnabled())
+    timer.start();
+
+  if(log)
+    openLog();
+}
+
+MapPaintProfiler::~MapPaintProfiler()
+{
+  closeLog();
+}
+
+void MapPaintProfiler::add(prof::Section section, qint64 ns, int numObjects)
+{
+  if(isEnabled())
+  {
+    current.ns[section] += ns;
+    current.objects[section] += numObjects;
+  }
+}
+
+void MapPaintProfiler::endFrame(int tileHits, int tileMisses, bool still)
+{
+  if(!isEnabled())
+    return;
+
+  current.tileHits = tileHits;
+  current.tileMisses = tileMisses;
+
+  frameTimes[frameTimeIndex] = current.ns[prof::FRAME];
+  frameTimeIndex = (frameTimeIndex + 1) % AVERAGE_FRAMES;
+
+  if(log)
+    writeLog(current, still);
+
+  last = current;
+  clearFrame(current);
+}
+
+void MapPaintProfiler::paintOverlay(QPainter *painter) const
+{
+  if(!overlay)
+    return;
+
+  qint64 sum = 0;
+  int num = 0;
+  for(qint64 ns : frameTimes)
+  {
+    if(ns > 0)
+    {
+      sum += ns;
+      num++;
+    }
+  }
+
+  QStringList lines;
+  lines.append(QString("avg frame %1 ms").arg(num > 0 ? sum / num / 1.e6 : 0., 0, 'f', 1));
+  for(int i = 0; i < prof::NUM_SECTIONS; i++)
+    lines.append(QString("%1 %2 ms %3").
+                 arg(SECTION_NAMES[i]).arg(last.ns[i] / 1.e6, 0, 'f', 1).arg(last.objects[i]));
+
+  int tiles = last.tileHits + last.tileMisses;
+  lines.append(QString("tile hits %1 %").arg(tiles > 0 ? 100 * last.tileHits / tiles : 100));
+
+  painter->save();
+  QFontMetrics metrics(painter->font());
+  int width = 0;
+  for(const QString& line : lines)
+    width = std::max(width, metrics.width(line));
+
+  int lineHeight = metrics.height();
+  QRect rect(10, 10, width + 10, lineHeight * lines.size() + 10);
+  painter->setPen(Qt::black);
+  painter->setBrush(QColor(255, 255, 255, 200));
+  painter->drawRect(rect);
+
+  int y = rect.top() + 5 + metrics.ascent();
+  for(const QString& line : lines)
+  {
+    painter->drawText(rect.left() + 5, y, line);
+    y += lineHeight;
+  }
+  painter->restore();
+}
+
+void MapPaintProfiler::clearFrame(Frame& frame)
+{
+  for(int i = 0; i < prof::NUM_SECTIONS; i++)
+  {
+    frame.ns[i] = 0;
+    frame.objects[i] = 0;
+  }
+  frame.tileHits = frame.tileMisses = 0;
+}
+
+void MapPaintProfiler::openLog()
+{
+  QString filename = Settings::getConfigFilename("_paintprofile.csv");
+
+  closeLog();
+  logFile = new QFile(filename);
+  if(logFile->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+  {
+    logStream = new QTextStream(logFile);
+    if(logFile->size() == 0)
+    {
+      // Write header
+      *logStream << "time,still";
+      for(int i = 0; i < prof::NUM_SECTIONS; i++)
+        *logStream << "," << SECTION_NAMES[i] << "_ms," << SECTION_NAMES[i] << "_objects";
+      *logStream << ",tile_hits,tile_misses\n";
+    }
+  }
+  else
+  {
+    qWarning() << Q_FUNC_INFO << "Cannot open" << filename << logFile->errorString();
+    delete logFile;
+    logFile = nullptr;
+    logStream = nullptr;
+    log = false;
+  }
+}
+
+void MapPaintProfiler::writeLog(const Frame& frame, bool still)
+{
+  *logStream << QDateTime::currentDateTime().toString(Qt::ISODate) << "," << (still ? 1 : 0);
+  for(int i = 0; i < prof::NUM_SECTIONS; i++)
+    *logStream << "," << QString::number(frame.ns[i] / 1.e6, 'f', 3) << "," << frame.objects[i];
+  // No flush per frame - stream is flushed when its buffer is full or on close
+  *logStream << "," << frame.tileHits << "," << frame.tileMisses << '\n';
+
+  // Size does not include the stream buffer which is fine for rotating
+  if(logFile->size() > logMaxSize)
+  {
+    // Move full log to backup and start a new one
+    QString filename = logFile->fileName();
+    closeLog();
+
+    QFile::remove(filename + ".1");
+    QFile::rename(filename, filename + ".1");
+    openLog();
+  }
+}
+
+void MapPaintProfiler::closeLog()
+{
+  if(logStream != nullptr)
+    logStream->flush();
+  delete logStream;
+  logStream = nullptr;
+
+  if(logFile != nullptr)
+    logFile->close();
+  delete logFile;
+  logFile = nullptr;
+}
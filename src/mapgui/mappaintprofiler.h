@@ -0,0 +1,149 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_MAPPAINTPROFILER_H
+#define LITTLENAVMAP_MAPPAINTPROFILER_H
+
+#include <QElapsedTimer>
+#include <QVector>
+
+class QPainter;
+class QFile;
+class QTextStream;
+
+namespace prof {
+
+/* Timed parts of a map frame */
+enum Section
+{
+  FRAME, /* Whole MapPaintLayer::render */
+  SHIP,
+  AIRSPACE,
+  ILS,
+  AIRPORT,
+  NAV,
+  ROUTE,
+  MARK,
+  AIRCRAFT,
+  QUERY, /* MapQuery fetches - also contained in the painter times */
+  SCREEN_INDEX, /* MapScreenIndex geometry updates outside of render */
+  NUM_SECTIONS
+};
+
+}
+
+/*
+ * Collects render times, object counts and map query cache statistics per frame.
+ * Values for a frame are collected between two calls of endFrame and can be shown as an overlay on the map
+ * or written into a rolling CSV log. Does nothing if neither overlay nor log are enabled in the settings.
+ */
+class MapPaintProfiler
+{
+public:
+  MapPaintProfiler();
+  ~MapPaintProfiler();
+
+  bool isEnabled() const
+  {
+    return overlay || log;
+  }
+
+  bool isOverlay() const
+  {
+    return overlay;
+  }
+
+  /* Start timing of a section. Sections must not be nested with themselves. */
+  void start(prof::Section section)
+  {
+    if(isEnabled())
+      startNs[section] = timer.nsecsElapsed();
+  }
+
+  /* Stop timing of a section and add the number of painted objects */
+  void stop(prof::Section section, int numObjects = 0)
+  {
+    if(isEnabled())
+    {
+      current.ns[section] += timer.nsecsElapsed() - startNs[section];
+      current.objects[section] += numObjects;
+    }
+  }
+
+  /* Add time and counts collected elsewhere */
+  void add(prof::Section section, qint64 ns, int numObjects);
+
+  /* Finish frame, write log and start a new one
+   * @param still true if map was not moving */
+  void endFrame(int tileHits, int tileMisses, bool still);
+
+  /* Draw values of the last frame and average frame time into the top left corner */
+  void paintOverlay(QPainter *painter) const;
+
+private:
+  struct Frame
+  {
+    qint64 ns[prof::NUM_SECTIONS];
+    int objects[prof::NUM_SECTIONS];
+    int tileHits, tileMisses;
+  };
+
+  void clearFrame(Frame& frame);
+  void openLog();
+  void writeLog(const Frame& frame, bool still);
+
+  /* Flush and close the log file if open */
+  void closeLog();
+
+  bool overlay = false, log = false;
+  QElapsedTimer timer;
+  qint64 startNs[prof::NUM_SECTIONS];
+
+  /* Frame being collected and last finished frame */
+  Frame current, last;
+
+  /* Frame times in ns of the last frames for the average */
+  QVector<qint64> frameTimes;
+  int frameTimeIndex = 0;
+
+  /* Rolling CSV log which is moved to a backup if larger than logMaxSize */
+  QFile *logFile = nullptr;
+  QTextStream *logStream = nullptr;
+  qint64 logMaxSize = 0;
+};
+
+/* Adds the time between construction and destruction to a section */
+class MapPaintProfilerScope
+{
+public:
+  MapPaintProfilerScope(MapPaintProfiler *mapPaintProfiler, prof::Section profilerSection)
+    : profiler(mapPaintProfiler), section(profilerSection)
+  {
+    profiler->start(section);
+  }
+
+  ~MapPaintProfilerScope()
+  {
+    profiler->stop(section);
+  }
+
+private:
+  MapPaintProfiler *profiler;
+  prof::Section section;
+};
+
+#endif // LITTLENAVMAP_MAPPAINTPROFILER_H
@@ -0,0 +1,73 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "mapgui/mapscreengrid.h"
+
+#include <algorithm>
+
+MapScreenGrid::MapScreenGrid()
+{
+  cells.resize(1);
+}
+
+void MapScreenGrid::clear(const QRect& screenRect)
+{
+  bounds = screenRect;
+  columns = std::max(bounds.width() / CELL_SIZE + 1, 1);
+  rows = std::max(bounds.height() / CELL_SIZE + 1, 1);
+
+  cells.clear();
+  cells.resize(columns * rows);
+}
+
+void MapScreenGrid::insert(int index, const QRect& rect)
+{
+  QRect r = rect.normalized();
+  int rowMax = row(r.bottom()), colMax = column(r.right());
+
+  for(int rw = row(r.top()); rw <= rowMax; rw++)
+  {
+    for(int col = column(r.left()); col <= colMax; col++)
+      cells[rw * columns + col].append(index);
+  }
+}
+
+void MapScreenGrid::query(int x, int y, int maxDistance, QVector<int>& indexes) const
+{
+  indexes.clear();
+
+  int rowMax = row(y + maxDistance), colMax = column(x + maxDistance);
+  for(int rw = row(y - maxDistance); rw <= rowMax; rw++)
+  {
+    for(int col = column(x - maxDistance); col <= colMax; col++)
+      indexes += cells.at(rw * columns + col);
+  }
+
+  // Primitives spanning more than one cell are found more than once
+  std::sort(indexes.begin(), indexes.end());
+  indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+}
+
+int MapScreenGrid::column(int x) const
+{
+  return std::min(std::max((x - bounds.left()) / CELL_SIZE, 0), columns - 1);
+}
+
+int MapScreenGrid::row(int y) const
+{
+  return std::min(std::max((y - bounds.top()) / CELL_SIZE, 0), rows - 1);
+}
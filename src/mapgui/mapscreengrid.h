@@ -0,0 +1,62 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_MAPSCREENGRID_H
+#define LITTLENAVMAP_MAPSCREENGRID_H
+
+#include <QRect>
+#include <QVector>
+
+/*
+ * Bucket grid over the map widget that keeps indexes of screen primitives like lines, points or polygons
+ * for each cell touched by their bounding rectangle.
+ * Primitives outside of the screen are kept in the border cells so that queries never miss anything.
+ */
+class MapScreenGrid
+{
+public:
+  MapScreenGrid();
+
+  /* Remove all entries and prepare grid for the given screen rectangle */
+  void clear(const QRect& screenRect);
+
+  /* Add index of a primitive covering the screen rectangle */
+  void insert(int index, const QRect& rect);
+
+  void insert(int index, const QPoint& point)
+  {
+    insert(index, QRect(point, point));
+  }
+
+  /* Get indexes of all primitives in cells near x/y. Indexes are sorted ascending without duplicates.
+   * Candidates have to be checked for the exact distance by the caller. */
+  void query(int x, int y, int maxDistance, QVector<int>& indexes) const;
+
+private:
+  int column(int x) const;
+  int row(int y) const;
+
+  static Q_DECL_CONSTEXPR int CELL_SIZE = 64;
+
+  QRect bounds;
+  int columns = 1, rows = 1;
+
+  /* Indexes for each cell in row major order */
+  QVector<QVector<int> > cells;
+};
+
+#endif // LITTLENAVMAP_MAPSCREENGRID_H
@@ -23,6 +23,7 @@
 #include "mapgui/mapscale.h"
 #include "mapgui/mapwidget.h"
 #include "mapgui/mappaintlayer.h"
+#include "mapgui/mappaintprofiler.h"
 #include "mapgui/maplayer.h"
 #include "common/maptypes.h"
 #include "query/airportquery.h"
@@ -55,7 +56,10 @@ MapScreenIndex::~MapScreenIndex()
 
 void MapScreenIndex::updateAirspaceScreenGeometry(const Marble::GeoDataLatLonAltBox& curBox)
 {
+  MapPaintProfilerScope profilerScope(paintLayer->getProfiler(), prof::SCREEN_INDEX);
+
   airspacePolygons.clear();
+  airspacePolygonGrid.clear(mapWidget->rect());
 
   if(!paintLayer->getMapLayer()->isAirspace() || !paintLayer->getShownMapObjects().testFlag(map::AIRSPACE))
     return;
@@ -99,6 +103,7 @@ void MapScreenIndex::updateAirspaceScreenGeometry(const Marble::GeoDataLatLonAlt
 
           // qDebug() << airspace.name << polygon;
 
+          airspacePolygonGrid.insert(airspacePolygons.size(), polygon.boundingRect());
           airspacePolygons.append(std::make_pair(airspace.id, polygon));
         }
       }
@@ -108,7 +113,10 @@ void MapScreenIndex::updateAirspaceScreenGeometry(const Marble::GeoDataLatLonAlt
 
 void MapScreenIndex::updateAirwayScreenGeometry(const Marble::GeoDataLatLonAltBox& curBox)
 {
+  MapPaintProfilerScope profilerScope(paintLayer->getProfiler(), prof::SCREEN_INDEX);
+
   airwayLines.clear();
+  airwayLineGrid.clear(mapWidget->rect());
 
   CoordinateConverter conv(mapWidget->viewport());
   const MapScale *scale = paintLayer->getMapScale();
@@ -153,7 +161,10 @@ void MapScreenIndex::updateAirwayScreenGeometry(const Marble::GeoDataLatLonAltBo
           rect.adjust(-1, -1, 1, 1);
 
           if(mapGeo.intersects(rect))
+          {
+            airwayLineGrid.insert(airwayLines.size(), rect);
             airwayLines.append(std::make_pair(airway.id, QLine(xs1, ys1, xs2, ys2)));
+          }
         }
       }
     }
@@ -176,10 +187,14 @@ void MapScreenIndex::restoreState()
 
 void MapScreenIndex::updateRouteScreenGeometry(const Marble::GeoDataLatLonAltBox& curBox)
 {
+  MapPaintProfilerScope profilerScope(paintLayer->getProfiler(), prof::SCREEN_INDEX);
+
   const Route& route = NavApp::getRoute();
 
   routeLines.clear();
   routePoints.clear();
+  routeLineGrid.clear(mapWidget->rect());
+  routePointGrid.clear(mapWidget->rect());
 
   QList<std::pair<int, QPoint> > airportPoints;
   QList<std::pair<int, QPoint> > otherPoints;
@@ -250,7 +265,10 @@ void MapScreenIndex::updateRouteScreenGeometry(const Marble::GeoDataLatLonAltBox
               rect.adjust(-1, -1, 1, 1);
 
               if(mapGeo.intersects(rect))
+              {
+                routeLineGrid.insert(routeLines.size(), rect);
                 routeLines.append(std::make_pair(i - 1, QLine(xs1, ys1, xs2, ys2)));
+              }
             }
           }
         }
@@ -261,6 +279,9 @@ void MapScreenIndex::updateRouteScreenGeometry(const Marble::GeoDataLatLonAltBox
 
     routePoints.append(airportPoints);
     routePoints.append(otherPoints);
+
+    for(int i = 0; i < routePoints.size(); i++)
+      routePointGrid.insert(i, routePoints.at(i).second);
   }
 }
 
@@ -278,9 +299,9 @@ void MapScreenIndex::getAllNearest(int xs, int ys, int maxDistance, map::MapSear
   if(shown & map::AIRCRAFT && NavApp::isConnected())
   {
     int x, y;
-    if(conv.wToS(simData.getUserAircraft().getPosition(), x, y))
+    if(conv.wToS(simData->getUserAircraft().getPosition(), x, y))
       if(atools::geo::manhattanDistance(x, y, xs, ys) < maxDistance)
-        result.userAircraft = simData.getUserAircraft();
+        result.userAircraft = simData->getUserAircraft();
   }
 
   // Check for AI / multiplayer aircraft
@@ -292,7 +313,7 @@ void MapScreenIndex::getAllNearest(int xs, int ys, int maxDistance, map::MapSear
 
     if(shown & map::AIRCRAFT_AI_SHIP && mapLayer->isAiShipLarge())
     {
-      for(const atools::fs::sc::SimConnectAircraft& obj : simData.getAiAircraft())
+      for(const atools::fs::sc::SimConnectAircraft& obj : simData->getAiAircraft())
       {
         if(obj.getCategory() == atools::fs::sc::BOAT &&
            (obj.getModelRadiusCorrected() * 2 > layer::LARGE_SHIP_SIZE || mapLayer->isAiShipSmall()))
@@ -306,7 +327,7 @@ void MapScreenIndex::getAllNearest(int xs, int ys, int maxDistance, map::MapSear
 
     if(shown & map::AIRCRAFT_AI && mapLayer->isAiAircraftLarge())
     {
-      for(const atools::fs::sc::SimConnectAircraft& obj : simData.getAiAircraft())
+      for(const atools::fs::sc::SimConnectAircraft& obj : simData->getAiAircraft())
       {
         if(obj.getCategory() != atools::fs::sc::BOAT &&
            (obj.getModelRadiusCorrected() * 2 > layer::LARGE_AIRCRAFT_SIZE || mapLayer->isAiAircraftSmall()) &&
@@ -458,8 +479,12 @@ int MapScreenIndex::getNearestRoutePointIndex(int xs, int ys, int maxDistance)
   int minIndex = -1;
   float minDist = map::INVALID_DISTANCE_VALUE;
 
-  for(const std::pair<int, QPoint>& rsp : routePoints)
+  QVector<int> indexes;
+  routePointGrid.query(xs, ys, maxDistance, indexes);
+
+  for(int i : indexes)
   {
+    const std::pair<int, QPoint>& rsp = routePoints.at(i);
     const QPoint& point = rsp.second;
     float dist = atools::geo::manhattanDistance(point.x(), point.y(), xs, ys);
     if(dist < minDist && dist < maxDistance)
@@ -478,7 +503,10 @@ void MapScreenIndex::getNearestAirspaces(int xs, int ys, map::MapSearchResult& r
   if(!paintLayer->getShownMapObjects().testFlag(map::AIRSPACE))
     return;
 
-  for(int i = 0; i < airspacePolygons.size(); i++)
+  QVector<int> indexes;
+  airspacePolygonGrid.query(xs, ys, 0, indexes);
+
+  for(int i : indexes)
   {
     const std::pair<int, QPolygon>& polyPair = airspacePolygons.at(i);
 
@@ -500,7 +528,10 @@ void MapScreenIndex::getNearestAirways(int xs, int ys, int maxDistance, map::Map
      !paintLayer->getShownMapObjects().testFlag(map::AIRWAYV))
     return;
 
-  for(int i = 0; i < airwayLines.size(); i++)
+  QVector<int> indexes;
+  airwayLineGrid.query(xs, ys, maxDistance, indexes);
+
+  for(int i : indexes)
   {
     const std::pair<int, QLine>& linePair = airwayLines.at(i);
 
@@ -524,7 +555,10 @@ int MapScreenIndex::getNearestRouteLegIndex(int xs, int ys, int maxDistance)
   int minIndex = -1;
   float minDist = std::numeric_limits<float>::max();
 
-  for(int i = 0; i < routeLines.size(); i++)
+  QVector<int> indexes;
+  routeLineGrid.query(xs, ys, maxDistance, indexes);
+
+  for(int i : indexes)
   {
     const std::pair<int, QLine>& line = routeLines.at(i);
 
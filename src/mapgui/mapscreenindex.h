@@ -18,9 +18,10 @@
 #ifndef LITTLENAVMAP_MAPSCREENINDEX_H
 #define LITTLENAVMAP_MAPSCREENINDEX_H
 
-#include "fs/sc/simconnectdata.h"
+#include "connect/simconnectdataptr.h"
 
 #include "route/route.h"
+#include "mapgui/mapscreengrid.h"
 
 namespace map {
 struct MapSearchResult;
@@ -139,25 +140,25 @@ public:
 
   const atools::fs::sc::SimConnectUserAircraft& getUserAircraft()
   {
-    return simData.getUserAircraft();
+    return simData->getUserAircraft();
   }
 
   const atools::fs::sc::SimConnectUserAircraft& getLastUserAircraft()
   {
-    return lastSimData.getUserAircraft();
+    return lastSimData->getUserAircraft();
   }
 
   const QVector<atools::fs::sc::SimConnectAircraft>& getAiAircraft()
   {
-    return simData.getAiAircraft();
+    return simData->getAiAircraft();
   }
 
-  void updateSimData(const atools::fs::sc::SimConnectData& data)
+  void updateSimData(const SimConnectDataPtr& data)
   {
     simData = data;
   }
 
-  void updateLastSimData(const atools::fs::sc::SimConnectData& data)
+  void updateLastSimData(const SimConnectDataPtr& data)
   {
     lastSimData = data;
   }
@@ -179,7 +180,8 @@ private:
   void getNearestProcedureHighlights(int xs, int ys, int maxDistance, map::MapSearchResult& result,
                                      QList<proc::MapProcedurePoint>& procPoints);
 
-  atools::fs::sc::SimConnectData simData, lastSimData;
+  /* Shared snapshots from the connect client. Never null. */
+  SimConnectDataPtr simData = simdata::emptySimConnectData(), lastSimData = simdata::emptySimConnectData();
   MapWidget *mapWidget;
   MapQuery *mapQuery;
   AirportQuery *airportQuery;
@@ -198,6 +200,9 @@ private:
   QList<std::pair<int, QPolygon> > airspacePolygons;
   QList<std::pair<int, QPoint> > routePoints;
 
+  /* Grids with indexes into the lists above for fast hit tests */
+  MapScreenGrid routeLineGrid, airwayLineGrid, airspacePolygonGrid, routePointGrid;
+
 };
 
 #endif // LITTLENAVMAP_MAPSCREENINDEX_H
@@ -95,6 +95,9 @@ MapWidget::MapWidget(MainWindow *parent)
   mapQuery = NavApp::getMapQuery();
   airportQuery = NavApp::getAirportQuerySim();
 
+  // Redraw if map objects for the visible area were loaded in the background
+  connect(mapQuery, &MapQuery::tilesLoaded, this, &MapWidget::invalidateStaticLayerCache);
+
   setSizePolicy(QSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding));
   setMinimumSize(QSize(50, 50));
 
@@ -217,7 +220,8 @@ void MapWidget::optionsChanged()
   screenSearchDistanceTooltip = OptionData::instance().getMapTooltipSensitivity();
 
   updateCacheSizes();
-  update();
+  // Colors, symbol sizes and labels of the static layers depend on the options
+  invalidateStaticLayerCache();
 }
 
 void MapWidget::updateCacheSizes()
@@ -553,9 +557,10 @@ void MapWidget::restoreState()
     kmlFilePaths = s.valueStrList(lnm::MAP_KMLFILES);
   screenIndex->restoreState();
 
+  // Set limit first since restore reads only the number of positions kept in memory
+  aircraftTrack.setMaxTrackEntries(OptionData::instance().getAircraftTrackMaxPoints());
   if(OptionData::instance().getFlags() & opts::STARTUP_LOAD_TRAIL)
     aircraftTrack.restoreState();
-  aircraftTrack.setMaxTrackEntries(OptionData::instance().getAircraftTrackMaxPoints());
 
   atools::gui::WidgetState state(lnm::MAP_OVERLAY_VISIBLE, false /*save visibility*/, true /*block signals*/);
   for(QAction *action : mapOverlays.values())
@@ -878,7 +883,8 @@ void MapWidget::routeChanged(bool geometryChanged)
   {
     cancelDragAll();
     screenIndex->updateRouteScreenGeometry(currentViewBoundingBox);
-    update();
+    // Airports and airspaces are highlighted depending on the route
+    invalidateStaticLayerCache();
   }
 }
 
@@ -891,12 +897,12 @@ void MapWidget::routeAltitudeChanged(float altitudeFeet)
 
   qDebug() << Q_FUNC_INFO;
   screenIndex->updateAirspaceScreenGeometry(currentViewBoundingBox);
-  update();
+  invalidateStaticLayerCache();
 }
 
-void MapWidget::simDataChanged(const atools::fs::sc::SimConnectData& simulatorData)
+void MapWidget::simDataChanged(const SimConnectDataPtr& simulatorData)
 {
-  const atools::fs::sc::SimConnectUserAircraft& userAircraft = simulatorData.getUserAircraft();
+  const atools::fs::sc::SimConnectUserAircraft& userAircraft = simulatorData->getUserAircraft();
   if(databaseLoadStatus || !userAircraft.getPosition().isValid())
     return;
 
@@ -936,7 +942,7 @@ void MapWidget::simDataChanged(const atools::fs::sc::SimConnectData& simulatorDa
       bool aiVisible = false;
       if(paintLayer->getShownMapObjects() & map::AIRCRAFT_AI)
       {
-        for(const atools::fs::sc::SimConnectAircraft& ai : simulatorData.getAiAircraft())
+        for(const atools::fs::sc::SimConnectAircraft& ai : simulatorData->getAiAircraft())
         {
           if(currentViewBoundingBox.contains(
                Marble::GeoDataCoordinates(ai.getPosition().getLonX(), ai.getPosition().getLatY(), 0,
@@ -1040,7 +1046,7 @@ void MapWidget::disconnectedFromSimulator()
 {
   qDebug() << Q_FUNC_INFO;
   // Clear all data on disconnect
-  screenIndex->updateSimData(atools::fs::sc::SimConnectData());
+  screenIndex->updateSimData(simdata::emptySimConnectData());
   updateVisibleObjectsStatusBar();
   update();
 }
@@ -1093,6 +1099,13 @@ void MapWidget::changeApproachHighlight(const proc::MapProcedureLegs& approach)
   update();
 }
 
+void MapWidget::changeRouteAlternatives(const QVector<atools::geo::LineString>& alternatives, int selected)
+{
+  routeAlternatives = alternatives;
+  routeAlternativeSelected = selected;
+  update();
+}
+
 void MapWidget::changeSearchHighlights(const map::MapSearchResult& positions)
 {
   screenIndex->getSearchHighlights() = positions;
@@ -2046,7 +2059,7 @@ void MapWidget::mouseMoveEvent(QMouseEvent *event)
       atools::fs::sc::SimConnectData data = atools::fs::sc::SimConnectData::buildDebugForPosition(pos, lastPos);
       data.setPacketId(packetId++);
 
-      emit NavApp::getConnectClient()->dataPacketReceived(data);
+      emit NavApp::getConnectClient()->dataPacketReceived(simdata::makeSimConnectDataPtr(data));
       lastPos = pos;
       lastPoint = event->pos();
     }
@@ -2766,6 +2779,12 @@ void MapWidget::paintEvent(QPaintEvent *paintEvent)
     emit resultTruncated(paintLayer->getOverflow());
 }
 
+void MapWidget::invalidateStaticLayerCache()
+{
+  paintLayer->invalidateStaticLayerCache();
+  update();
+}
+
 void MapWidget::handleInfoClick(QPoint pos)
 {
   qDebug() << Q_FUNC_INFO;
@@ -20,7 +20,7 @@
 
 #include "common/maptypes.h"
 #include "gui/mapposhistory.h"
-#include "fs/sc/simconnectdata.h"
+#include "connect/simconnectdataptr.h"
 #include "common/aircrafttrack.h"
 
 #include <QTimer>
@@ -121,7 +121,7 @@ public:
   void routeAltitudeChanged(float altitudeFeet);
 
   /* New data from simconnect has arrived. Update aircraft position and track. */
-  void simDataChanged(const atools::fs::sc::SimConnectData& simulatorData);
+  void simDataChanged(const SimConnectDataPtr& simulatorData);
 
   /* Hightlight a point along the route while mouse over in the profile window */
   void highlightProfilePoint(const atools::geo::Pos& pos);
@@ -138,6 +138,9 @@ public:
   /* Remove all KML files from map */
   void clearKmlFiles();
 
+  /* Drop the cached airports, navaids and airspaces and repaint. Needed if the underlying data changes. */
+  void invalidateStaticLayerCache();
+
   const atools::geo::Pos& getSearchMarkPos() const
   {
     return searchMarkPos;
@@ -154,6 +157,20 @@ public:
 
   const proc::MapProcedureLegs& getProcedureHighlight() const;
 
+  /* Alternative flight plan calculation results and index of the highlighted one */
+  const QVector<atools::geo::LineString>& getRouteAlternatives() const
+  {
+    return routeAlternatives;
+  }
+
+  int getRouteAlternativeSelected() const
+  {
+    return routeAlternativeSelected;
+  }
+
+  /* Show alternative flight plans as an overlay. Pass an empty list to remove. */
+  void changeRouteAlternatives(const QVector<atools::geo::LineString>& alternatives, int selected);
+
   const QList<int>& getRouteHighlights() const;
 
   const QList<map::RangeMarker>& getRangeRings() const;
@@ -413,6 +430,10 @@ private:
 
   AircraftTrack aircraftTrack;
 
+  /* Overlay for alternative flight plans */
+  QVector<atools::geo::LineString> routeAlternatives;
+  int routeAlternativeSelected = -1;
+
   QHash<QString, QAction *> mapOverlays;
 
   /* Need to check if the zoom and position was changed by the map history to avoid recursion */
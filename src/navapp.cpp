@@ -61,11 +61,16 @@ NavApp::NavApp(int& argc, char **argv, int flags)
   : atools::gui::Application(argc, argv, flags)
 {
   setWindowIcon(QIcon(":/littlenavmap/resources/icons/littlenavmap.svg"));
-  setApplicationName("Little Navmap");
-  setOrganizationName("ABarthel");
-  setOrganizationDomain("abarthel.org");
+  initApplicationInformation();
+}
+
+void NavApp::initApplicationInformation()
+{
+  QCoreApplication::setApplicationName("Little Navmap");
+  QCoreApplication::setOrganizationName("ABarthel");
+  QCoreApplication::setOrganizationDomain("abarthel.org");
 
-  setApplicationVersion("1.9.0.develop"); // VERSION_NUMBER
+  QCoreApplication::setApplicationVersion("1.9.0.develop"); // VERSION_NUMBER
 }
 
 NavApp::~NavApp()
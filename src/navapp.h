@@ -76,6 +76,9 @@ public:
   NavApp(int& argc, char **argv, int flags = ApplicationFlags);
   virtual ~NavApp();
 
+  /* Set name, organization and version. Also used by the headless route batch mode which has no NavApp instance. */
+  static void initApplicationInformation();
+
   /* Creates all aggregated objects */
   static void init(MainWindow *mainWindowParam);
 
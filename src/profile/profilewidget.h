@@ -19,7 +19,7 @@
 #define LITTLENAVMAP_PROFILEWIDGET_H
 
 #include "route/route.h"
-#include "fs/sc/simconnectdata.h"
+#include "connect/simconnectdataptr.h"
 
 #include <QFuture>
 #include <QFutureWatcher>
@@ -54,7 +54,7 @@ public:
   void routeAltitudeChanged(int altitudeFeet);
 
   /* Update user aircraft on profile display */
-  void simDataChanged(const atools::fs::sc::SimConnectData& simulatorData);
+  void simDataChanged(const SimConnectDataPtr& simulatorData);
 
   /* Track was shortened and needs a full update */
   void aircraftTrackPruned();
@@ -158,7 +158,7 @@ private:
   static Q_DECL_CONSTEXPR int MIN_AIRCRAFT_TRACK_WIDTH = 10;
 
   /* User aircraft data */
-  atools::fs::sc::SimConnectData simData, lastSimData;
+  SimConnectDataPtr simData = simdata::emptySimConnectData(), lastSimData = simdata::emptySimConnectData();
   QPolygon aircraftTrackPoints;
   float maxTrackAltitudeFt = 0.f;
 
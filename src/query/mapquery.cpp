@@ -22,14 +22,24 @@
 #include "common/maptools.h"
 #include "fs/common/binarygeometry.h"
 #include "sql/sqlquery.h"
+#include "sql/sqldatabase.h"
+#include "exception.h"
 #include "query/airportquery.h"
+#include "db/spatialindex.h"
 #include "navapp.h"
 #include "common/maptools.h"
 #include "settings/settings.h"
 #include "fs/common/xpgeometry.h"
 
 #include <QDataStream>
+#include <QElapsedTimer>
 #include <QRegularExpression>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <marble/ViewportParams.h>
+
+#include <algorithm>
+#include <cmath>
 
 using namespace Marble;
 using namespace atools::sql;
@@ -47,6 +57,32 @@ static double queryRectInflationFactor = 0.2;
 static double queryRectInflationIncrement = 0.1;
 int MapQuery::queryMaxRows = 5000;
 
+/* Tile size is 2^level degrees for levels TILE_LEVEL_MIN to TILE_LEVEL_MAX */
+static const int TILE_LEVEL_MIN = -2;
+static const int TILE_LEVEL_MAX = 6;
+
+/* Select tile size so that about this number of tiles covers the requested rectangle in each direction */
+static const double TILES_PER_RECT = 3.;
+
+/* Douglas-Peucker tolerance in degrees for each airspace ring level */
+static const double AIRSPACE_RING_TOLERANCE[MapQuery::AIRSPACE_RING_LEVELS] = {0., 0.002, 0.01, 0.05};
+
+/* Airspace ring segments longer than this are split along the great circle */
+static const float AIRSPACE_RING_MAX_SEGMENT_METER = 50000.f;
+
+/* Number of tiles loaded by one background thread run */
+static const int TILE_LOAD_BATCH_SIZE = 16;
+
+/* Prefetch tiles for the rectangle this number of map movements ahead */
+static const double TILE_PREFETCH_STEPS = 2.;
+
+/* Cell size in pixels of the screen grids used by getNearestObjects */
+static const int SCREEN_GRID_CELL_SIZE = 32;
+
+/* Connection names for the background tile loader */
+static const QString TILE_LOAD_DATABASE_NAME("LNMDBMAPQUERYLOAD");
+static const QString TILE_LOAD_DATABASE_NAME_NAV("LNMDBMAPQUERYLOADNAV");
+
 struct MapAirspaceCoordinate
 {
   atools::geo::Pos pos;
@@ -63,6 +99,8 @@ MapQuery::MapQuery(QObject *parent, atools::sql::SqlDatabase *sqlDb, SqlDatabase
   runwayOverwiewCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "RunwayOverwiewCache",
                                                            1000).toInt());
   airspaceLineCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "AirspaceLineCache", 10000).toInt());
+  airspaceRingCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "AirspaceRingCachePoints",
+                                                         1000000).toInt());
 
   queryRectInflationFactor = settings.getAndStoreValue(
     lnm::SETTINGS_MAPQUERY + "QueryRectInflationFactor", 0.3).toDouble();
@@ -70,6 +108,41 @@ MapQuery::MapQuery(QObject *parent, atools::sql::SqlDatabase *sqlDb, SqlDatabase
     lnm::SETTINGS_MAPQUERY + "QueryRectInflationIncrement", 0.1).toDouble();
   queryMaxRows = settings.getAndStoreValue(
     lnm::SETTINGS_MAPQUERY + "QueryRowLimit", 5000).toInt();
+
+  // Memory budget for each tile cache as number of objects - prefetched tiles have an own smaller budget
+  int tileCacheMaxObjects = settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "TileCacheMaxObjects",
+                                                      100000).toInt();
+  int tilePrefetchMaxObjects = settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "TilePrefetchMaxObjects",
+                                                         20000).toInt();
+  airportCache.setMaxObjects(tileCacheMaxObjects, tilePrefetchMaxObjects);
+  waypointCache.setMaxObjects(tileCacheMaxObjects, tilePrefetchMaxObjects);
+  vorCache.setMaxObjects(tileCacheMaxObjects, tilePrefetchMaxObjects);
+  ndbCache.setMaxObjects(tileCacheMaxObjects, tilePrefetchMaxObjects);
+  markerCache.setMaxObjects(tileCacheMaxObjects, tilePrefetchMaxObjects);
+  ilsCache.setMaxObjects(tileCacheMaxObjects, tilePrefetchMaxObjects);
+  airwayCache.setMaxObjects(tileCacheMaxObjects, tilePrefetchMaxObjects);
+  airspaceCache.setMaxObjects(tileCacheMaxObjects, tilePrefetchMaxObjects);
+
+  // Load missing tiles in a background thread instead of the paint method
+  asyncLoading = settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "AsyncLoading", true).toBool();
+  connect(&tileLoadWatcher, &QFutureWatcher<QVector<TileResult> >::finished,
+          this, &MapQuery::loadTilesThreadFinished);
+
+  // Requests queued before a cache is cleared would only be loaded and dropped
+  airportCache.funcClear = [this]() {removeTileRequests(map::AIRPORT);};
+  waypointCache.funcClear = [this]() {removeTileRequests(map::WAYPOINT);};
+  vorCache.funcClear = [this]() {removeTileRequests(map::VOR);};
+  ndbCache.funcClear = [this]() {removeTileRequests(map::NDB);};
+  markerCache.funcClear = [this]() {removeTileRequests(map::MARKER);};
+  ilsCache.funcClear = [this]() {removeTileRequests(map::ILS);};
+  airwayCache.funcClear = [this]() {removeTileRequests(map::AIRWAY);};
+  airspaceCache.funcClear = [this]() {removeTileRequests(map::AIRSPACE);};
+}
+
+MapQuery::MapQuery(atools::sql::SqlDatabase *sqlDb, atools::sql::SqlDatabase *sqlDbNav)
+  : QObject(nullptr), db(sqlDb), dbNav(sqlDbNav)
+{
+  mapTypesFactory = new MapTypesFactory();
 }
 
 MapQuery::~MapQuery()
@@ -487,96 +560,91 @@ void MapQuery::getNearestObjects(const CoordinateConverter& conv, const MapLayer
   using maptools::insertSortedByDistance;
   using maptools::insertSortedByTowerDistance;
 
+  updateScreenGridView(conv);
+
+  // Indexes of objects near xs/ys in reverse list order like the full scan did before
+  QVector<int> indexes;
+
   int x, y;
   if(mapLayer->isAirport() && types.testFlag(map::AIRPORT))
   {
-    for(int i = airportCache.list.size() - 1; i >= 0; i--)
+    updateScreenGrid(airportGrid, airportCache, conv);
+    nearestFromScreenGrid(airportGrid, xs, ys, screenDistance, indexes);
+    for(int i : indexes)
     {
       const MapAirport& airport = airportCache.list.at(i);
-
       if(airport.isVisible(types))
-      {
-        if(conv.wToS(airport.position, x, y))
-          if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-            insertSortedByDistance(conv, result.airports, &result.airportIds, xs, ys, airport);
+        insertSortedByDistance(conv, result.airports, &result.airportIds, xs, ys, airport);
+    }
 
-        if(airportDiagram)
-        {
-          // Include tower for airport diagrams
-          if(conv.wToS(airport.towerCoords, x, y) &&
-             atools::geo::manhattanDistance(x, y, xs, ys) < screenDistance)
-            insertSortedByTowerDistance(conv, result.towers, xs, ys, airport);
-        }
+    if(airportDiagram)
+    {
+      // Include tower for airport diagrams - only a few airports are visible at this zoom distance
+      for(int i = airportCache.list.size() - 1; i >= 0; i--)
+      {
+        const MapAirport& airport = airportCache.list.at(i);
+        if(airport.isVisible(types) && conv.wToS(airport.towerCoords, x, y) &&
+           atools::geo::manhattanDistance(x, y, xs, ys) < screenDistance)
+          insertSortedByTowerDistance(conv, result.towers, xs, ys, airport);
       }
     }
   }
 
   if(mapLayer->isVor() && types.testFlag(map::VOR))
   {
-    for(int i = vorCache.list.size() - 1; i >= 0; i--)
-    {
-      const MapVor& vor = vorCache.list.at(i);
-      if(conv.wToS(vor.position, x, y))
-        if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-          insertSortedByDistance(conv, result.vors, &result.vorIds, xs, ys, vor);
-    }
+    updateScreenGrid(vorGrid, vorCache, conv);
+    nearestFromScreenGrid(vorGrid, xs, ys, screenDistance, indexes);
+    for(int i : indexes)
+      insertSortedByDistance(conv, result.vors, &result.vorIds, xs, ys, vorCache.list.at(i));
   }
 
   if(mapLayer->isNdb() && types.testFlag(map::NDB))
   {
-    for(int i = ndbCache.list.size() - 1; i >= 0; i--)
-    {
-      const MapNdb& ndb = ndbCache.list.at(i);
-      if(conv.wToS(ndb.position, x, y))
-        if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-          insertSortedByDistance(conv, result.ndbs, &result.ndbIds, xs, ys, ndb);
-    }
+    updateScreenGrid(ndbGrid, ndbCache, conv);
+    nearestFromScreenGrid(ndbGrid, xs, ys, screenDistance, indexes);
+    for(int i : indexes)
+      insertSortedByDistance(conv, result.ndbs, &result.ndbIds, xs, ys, ndbCache.list.at(i));
   }
 
-  if(mapLayer->isWaypoint() && types.testFlag(map::WAYPOINT))
+  bool waypoints = mapLayer->isWaypoint() && types.testFlag(map::WAYPOINT);
+  bool airwayWaypoints = mapLayer->isAirwayWaypoint();
+  if(waypoints || airwayWaypoints)
   {
-    for(int i = waypointCache.list.size() - 1; i >= 0; i--)
+    updateScreenGrid(waypointGrid, waypointCache, conv);
+    nearestFromScreenGrid(waypointGrid, xs, ys, screenDistance, indexes);
+
+    if(waypoints)
     {
-      const MapWaypoint& wp = waypointCache.list.at(i);
-      if(conv.wToS(wp.position, x, y))
-        if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-          insertSortedByDistance(conv, result.waypoints, &result.waypointIds, xs, ys, wp);
+      for(int i : indexes)
+        insertSortedByDistance(conv, result.waypoints, &result.waypointIds, xs, ys, waypointCache.list.at(i));
     }
-  }
 
-  if(mapLayer->isAirwayWaypoint())
-  {
-    for(int i = waypointCache.list.size() - 1; i >= 0; i--)
+    if(airwayWaypoints)
     {
-      const MapWaypoint& wp = waypointCache.list.at(i);
-      if((wp.hasVictorAirways && types.testFlag(map::AIRWAYV)) ||
-         (wp.hasJetAirways && types.testFlag(map::AIRWAYJ)))
-        if(conv.wToS(wp.position, x, y))
-          if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-            insertSortedByDistance(conv, result.waypoints, &result.waypointIds, xs, ys, wp);
+      for(int i : indexes)
+      {
+        const MapWaypoint& wp = waypointCache.list.at(i);
+        if((wp.hasVictorAirways && types.testFlag(map::AIRWAYV)) ||
+           (wp.hasJetAirways && types.testFlag(map::AIRWAYJ)))
+          insertSortedByDistance(conv, result.waypoints, &result.waypointIds, xs, ys, wp);
+      }
     }
   }
 
   if(mapLayer->isMarker() && types.testFlag(map::MARKER))
   {
-    for(int i = markerCache.list.size() - 1; i >= 0; i--)
-    {
-      const MapMarker& wp = markerCache.list.at(i);
-      if(conv.wToS(wp.position, x, y))
-        if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-          insertSortedByDistance(conv, result.markers, nullptr, xs, ys, wp);
-    }
+    updateScreenGrid(markerGrid, markerCache, conv);
+    nearestFromScreenGrid(markerGrid, xs, ys, screenDistance, indexes);
+    for(int i : indexes)
+      insertSortedByDistance(conv, result.markers, nullptr, xs, ys, markerCache.list.at(i));
   }
 
   if(mapLayer->isIls() && types.testFlag(map::ILS))
   {
-    for(int i = ilsCache.list.size() - 1; i >= 0; i--)
-    {
-      const MapIls& wp = ilsCache.list.at(i);
-      if(conv.wToS(wp.position, x, y))
-        if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-          insertSortedByDistance(conv, result.ils, nullptr, xs, ys, wp);
-    }
+    updateScreenGrid(ilsGrid, ilsCache, conv);
+    nearestFromScreenGrid(ilsGrid, xs, ys, screenDistance, indexes);
+    for(int i : indexes)
+      insertSortedByDistance(conv, result.ils, nullptr, xs, ys, ilsCache.list.at(i));
   }
 
   if(mapLayer->isAirport() && types.testFlag(map::AIRPORT))
@@ -614,200 +682,105 @@ void MapQuery::getNearestObjects(const CoordinateConverter& conv, const MapLayer
 const QList<map::MapAirport> *MapQuery::getAirports(const Marble::GeoDataLatLonBox& rect,
                                                     const MapLayer *mapLayer, bool lazy)
 {
-  airportCache.updateCache(rect, mapLayer, lazy,
-                           [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
+  TileRequest request;
+  request.type = map::AIRPORT;
+  request.airportSource = mapLayer->getDataSource();
+  request.minRunwayLength = mapLayer->getMinRunwayLength();
+
+  bool updated = updateTileCache(airportCache, request, rect, mapLayer, lazy,
+                                 [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersAirport(newLayer);
   });
 
-  switch(mapLayer->getDataSource())
-  {
-    case layer::ALL:
-      airportByRectQuery->bindValue(":minlength", mapLayer->getMinRunwayLength());
-      return fetchAirports(rect, airportByRectQuery, true /* reverse */, lazy, false /* overview */);
-
-    case layer::MEDIUM:
-      // Airports > 4000 ft
-      return fetchAirports(rect, airportMediumByRectQuery, false /* reverse */, lazy, true /* overview */);
-
-    case layer::LARGE:
-      // Airports > 8000 ft
-      return fetchAirports(rect, airportLargeByRectQuery, false /* reverse */, lazy, true /* overview */);
+  if(updated && request.airportSource == layer::ALL)
+    // Query order is lost when joining tiles - sort unimportant airports to the front to have them below
+    // in painting order
+    std::stable_sort(airportCache.list.begin(), airportCache.list.end(),
+                     [](const map::MapAirport& airport1, const map::MapAirport& airport2) -> bool
+    {
+      if(airport1.rating == airport2.rating)
+        return airport1.longestRunwayLength < airport2.longestRunwayLength;
+      else
+        return airport1.rating < airport2.rating;
+    });
 
-  }
-  return nullptr;
+  return &airportCache.list;
 }
 
 const QList<map::MapWaypoint> *MapQuery::getWaypoints(const GeoDataLatLonBox& rect,
                                                       const MapLayer *mapLayer, bool lazy)
 {
-  waypointCache.updateCache(rect, mapLayer, lazy,
-                            [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
+  TileRequest request;
+  request.type = map::WAYPOINT;
+  updateTileCache(waypointCache, request, rect, mapLayer, lazy,
+                  [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersWaypoint(newLayer);
   });
-
-  if(waypointCache.list.isEmpty() && !lazy)
-  {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
-    {
-      bindCoordinatePointInRect(r, waypointsByRectQuery);
-      waypointsByRectQuery->exec();
-      while(waypointsByRectQuery->next())
-      {
-        map::MapWaypoint wp;
-        mapTypesFactory->fillWaypoint(waypointsByRectQuery->record(), wp);
-        waypointCache.list.append(wp);
-      }
-    }
-  }
-  waypointCache.validate();
   return &waypointCache.list;
 }
 
 const QList<map::MapVor> *MapQuery::getVors(const GeoDataLatLonBox& rect, const MapLayer *mapLayer,
                                             bool lazy)
 {
-  vorCache.updateCache(rect, mapLayer, lazy,
-                       [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
+  TileRequest request;
+  request.type = map::VOR;
+  updateTileCache(vorCache, request, rect, mapLayer, lazy,
+                  [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersVor(newLayer);
   });
-
-  if(vorCache.list.isEmpty() && !lazy)
-  {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
-    {
-      bindCoordinatePointInRect(r, vorsByRectQuery);
-      vorsByRectQuery->exec();
-      while(vorsByRectQuery->next())
-      {
-        map::MapVor vor;
-        mapTypesFactory->fillVor(vorsByRectQuery->record(), vor);
-        vorCache.list.append(vor);
-      }
-    }
-  }
-  vorCache.validate();
   return &vorCache.list;
 }
 
 const QList<map::MapNdb> *MapQuery::getNdbs(const GeoDataLatLonBox& rect, const MapLayer *mapLayer,
                                             bool lazy)
 {
-  ndbCache.updateCache(rect, mapLayer, lazy,
-                       [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
+  TileRequest request;
+  request.type = map::NDB;
+  updateTileCache(ndbCache, request, rect, mapLayer, lazy,
+                  [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersNdb(newLayer);
   });
-
-  if(ndbCache.list.isEmpty() && !lazy)
-  {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
-    {
-      bindCoordinatePointInRect(r, ndbsByRectQuery);
-      ndbsByRectQuery->exec();
-      while(ndbsByRectQuery->next())
-      {
-        map::MapNdb ndb;
-        mapTypesFactory->fillNdb(ndbsByRectQuery->record(), ndb);
-        ndbCache.list.append(ndb);
-      }
-    }
-  }
-  ndbCache.validate();
   return &ndbCache.list;
 }
 
 const QList<map::MapMarker> *MapQuery::getMarkers(const GeoDataLatLonBox& rect, const MapLayer *mapLayer,
                                                   bool lazy)
 {
-  markerCache.updateCache(rect, mapLayer, lazy,
-                          [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
+  TileRequest request;
+  request.type = map::MARKER;
+  updateTileCache(markerCache, request, rect, mapLayer, lazy,
+                  [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersMarker(newLayer);
   });
-
-  if(markerCache.list.isEmpty() && !lazy)
-  {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
-    {
-      bindCoordinatePointInRect(r, markersByRectQuery);
-      markersByRectQuery->exec();
-      while(markersByRectQuery->next())
-      {
-        map::MapMarker marker;
-        mapTypesFactory->fillMarker(markersByRectQuery->record(), marker);
-        markerCache.list.append(marker);
-      }
-    }
-  }
-  markerCache.validate();
   return &markerCache.list;
 }
 
 const QList<map::MapIls> *MapQuery::getIls(const GeoDataLatLonBox& rect, const MapLayer *mapLayer, bool lazy)
 {
-  ilsCache.updateCache(rect, mapLayer, lazy,
-                       [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
+  TileRequest request;
+  request.type = map::ILS;
+  updateTileCache(ilsCache, request, rect, mapLayer, lazy,
+                  [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersIls(newLayer);
   });
-
-  if(ilsCache.list.isEmpty() && !lazy)
-  {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
-    {
-      bindCoordinatePointInRect(r, ilsByRectQuery);
-      ilsByRectQuery->exec();
-      while(ilsByRectQuery->next())
-      {
-        map::MapIls ils;
-        mapTypesFactory->fillIls(ilsByRectQuery->record(), ils);
-        ilsCache.list.append(ils);
-      }
-    }
-  }
-  ilsCache.validate();
   return &ilsCache.list;
 }
 
 const QList<map::MapAirway> *MapQuery::getAirways(const GeoDataLatLonBox& rect, const MapLayer *mapLayer, bool lazy)
 {
-  airwayCache.updateCache(rect, mapLayer, lazy,
-                          [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
+  TileRequest request;
+  request.type = map::AIRWAY;
+  updateTileCache(airwayCache, request, rect, mapLayer, lazy,
+                  [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersAirway(newLayer);
   });
-
-  if(airwayCache.list.isEmpty() && !lazy)
-  {
-    QSet<int> ids;
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
-    {
-      bindCoordinatePointInRect(r, airwayByRectQuery);
-      airwayByRectQuery->exec();
-      while(airwayByRectQuery->next())
-      {
-        if(ids.contains(airwayByRectQuery->valueInt("airway_id")))
-          continue;
-
-        // qreal north, qreal south, qreal east, qreal west
-        if(rect.intersects(GeoDataLatLonBox(airwayByRectQuery->valueFloat("top_laty"),
-                                            airwayByRectQuery->valueFloat("bottom_laty"),
-                                            airwayByRectQuery->valueFloat("right_lonx"),
-                                            airwayByRectQuery->valueFloat("left_lonx"),
-                                            GeoDataCoordinates::GeoDataCoordinates::Degree)))
-        {
-          map::MapAirway airway;
-          mapTypesFactory->fillAirway(airwayByRectQuery->record(), airway);
-          airwayCache.list.append(airway);
-          ids.insert(airway.id);
-        }
-      }
-    }
-  }
-  airwayCache.validate();
   return &airwayCache.list;
 }
 
@@ -815,124 +788,647 @@ const QList<map::MapAirspace> *MapQuery::getAirspaces(const GeoDataLatLonBox& re
                                                       map::MapAirspaceFilter filter, float flightPlanAltitude,
                                                       bool lazy)
 {
-  airspaceCache.updateCache(rect, mapLayer, lazy,
-                            [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
-  {
-    return curLayer->hasSameQueryParametersAirspace(newLayer);
-  });
-
   if(filter.types != lastAirspaceFilter.types || filter.flags != lastAirspaceFilter.flags ||
      atools::almostNotEqual(lastFlightplanAltitude, flightPlanAltitude))
   {
     // Need a few more parameters to clear the cache which is different to other map features
-    airspaceCache.list.clear();
+    airspaceCache.clear();
     lastAirspaceFilter = filter;
     lastFlightplanAltitude = flightPlanAltitude;
   }
 
-  if(airspaceCache.list.isEmpty() && !lazy)
+  if(filter.types == map::AIRSPACE_NONE)
+    return &airspaceCache.list;
+
+  TileRequest request;
+  request.type = map::AIRSPACE;
+  request.airspaceFilter = filter;
+  request.flightPlanAltitude = flightPlanAltitude;
+
+  bool updated = updateTileCache(airspaceCache, request, rect, mapLayer, lazy,
+                                 [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
-    QStringList typeStrings;
+    return curLayer->hasSameQueryParametersAirspace(newLayer);
+  });
 
-    if(filter.types != map::AIRSPACE_NONE)
+  if(updated)
+    // Sort by importance
+    std::sort(airspaceCache.list.begin(), airspaceCache.list.end(),
+              [](const map::MapAirspace& airspace1, const map::MapAirspace& airspace2) -> bool
     {
-      // Build a list of query strings based on the bitfield
-      if(filter.types == map::AIRSPACE_ALL)
-        typeStrings.append("%");
-      else
+      return map::airspaceDrawingOrder(airspace1.type) < map::airspaceDrawingOrder(airspace2.type);
+    });
+
+  return &airspaceCache.list;
+}
+
+void MapQuery::updateScreenGridView(const CoordinateConverter& conv)
+{
+  const ViewportParams *viewport = conv.getViewport();
+  if(screenGridCenterLonX != viewport->centerLongitude() || screenGridCenterLatY != viewport->centerLatitude() ||
+     screenGridRadius != viewport->radius() || screenGridProjection != viewport->projection() ||
+     screenGridSize != viewport->size())
+  {
+    // Invalidates all grids
+    screenGridViewVersion++;
+    screenGridCenterLonX = viewport->centerLongitude();
+    screenGridCenterLatY = viewport->centerLatitude();
+    screenGridRadius = viewport->radius();
+    screenGridProjection = viewport->projection();
+    screenGridSize = viewport->size();
+  }
+}
+
+quint64 MapQuery::screenGridKey(int x, int y)
+{
+  // Round down for negative coordinates too
+  quint32 cellX = static_cast<quint32>(static_cast<int>(std::floor(x / static_cast<double>(SCREEN_GRID_CELL_SIZE))));
+  quint32 cellY = static_cast<quint32>(static_cast<int>(std::floor(y / static_cast<double>(SCREEN_GRID_CELL_SIZE))));
+  return (static_cast<quint64>(cellX) << 32) | cellY;
+}
+
+template<typename TYPE>
+void MapQuery::updateScreenGrid(ScreenGrid& grid, const TileCache<TYPE>& cache, const CoordinateConverter& conv)
+{
+  if(grid.listVersion == cache.listVersion && grid.viewVersion == screenGridViewVersion)
+    return;
+
+  grid.cells.clear();
+  int x, y;
+  for(int i = 0; i < cache.list.size(); i++)
+  {
+    if(conv.wToS(cache.list.at(i).position, x, y))
+      grid.cells[screenGridKey(x, y)].append({i, x, y});
+  }
+
+  grid.listVersion = cache.listVersion;
+  grid.viewVersion = screenGridViewVersion;
+}
+
+void MapQuery::nearestFromScreenGrid(const ScreenGrid& grid, int xs, int ys, int screenDistance,
+                                     QVector<int>& indexes)
+{
+  indexes.clear();
+
+  // Cells overlapping the square around xs/ys which covers the manhattan distance
+  quint64 topLeft = screenGridKey(xs - screenDistance, ys - screenDistance);
+  quint64 bottomRight = screenGridKey(xs + screenDistance, ys + screenDistance);
+  qint32 cellXMin = static_cast<qint32>(topLeft >> 32), cellYMin = static_cast<qint32>(topLeft & 0xffffffff);
+  qint32 cellXMax = static_cast<qint32>(bottomRight >> 32),
+         cellYMax = static_cast<qint32>(bottomRight & 0xffffffff);
+
+  for(qint32 cellX = cellXMin; cellX <= cellXMax; cellX++)
+  {
+    for(qint32 cellY = cellYMin; cellY <= cellYMax; cellY++)
+    {
+      quint64 key = (static_cast<quint64>(static_cast<quint32>(cellX)) << 32) | static_cast<quint32>(cellY);
+      auto it = grid.cells.constFind(key);
+      if(it != grid.cells.constEnd())
       {
-        for(int i = 0; i <= map::MAP_AIRSPACE_TYPE_BITS; i++)
+        for(const ScreenGrid::Entry& entry : it.value())
         {
-          map::MapAirspaceTypes t(1 << i);
-          if(filter.types & t)
-            typeStrings.append(map::airspaceTypeToDatabase(t));
+          if(atools::geo::manhattanDistance(entry.x, entry.y, xs, ys) < screenDistance)
+            indexes.append(entry.index);
         }
       }
+    }
+  }
 
-      SqlQuery *query = nullptr;
-      int alt;
-      if(filter.flags & map::AIRSPACE_AT_FLIGHTPLAN)
-      {
-        query = airspaceByRectAtAltQuery;
-        alt = atools::roundToInt(flightPlanAltitude);
-      }
-      else if(filter.flags & map::AIRSPACE_BELOW_10000)
-      {
-        query = airspaceByRectBelowAltQuery;
-        alt = 10000;
-      }
-      else if(filter.flags & map::AIRSPACE_BELOW_18000)
-      {
-        query = airspaceByRectBelowAltQuery;
-        alt = 18000;
-      }
-      else if(filter.flags & map::AIRSPACE_ABOVE_10000)
-      {
-        query = airspaceByRectAboveAltQuery;
-        alt = 10000;
-      }
-      else if(filter.flags & map::AIRSPACE_ABOVE_18000)
-      {
-        query = airspaceByRectAboveAltQuery;
-        alt = 18000;
-      }
-      else
+  // Keep the order of the previous full list scan which went from last to first
+  std::sort(indexes.begin(), indexes.end(), std::greater<int>());
+}
+
+template<typename TYPE>
+bool MapQuery::updateTileCache(TileCache<TYPE>& cache, const TileRequest& request,
+                               const Marble::GeoDataLatLonBox& rect, const MapLayer *mapLayer, bool lazy,
+                               typename TileCache<TYPE>::LayerCompareFunc funcSameLayer)
+{
+  QElapsedTimer timer;
+  int numHits = cache.numHits, numMisses = cache.numMisses;
+  if(collectStatistics)
+    timer.start();
+
+  QVector<quint64> missingKeys;
+  bool updated = cache.updateCache(rect, mapLayer, lazy, funcSameLayer,
+                                   [this, &request](const GeoDataLatLonBox& tileRect, QList<TYPE>& tile) -> void
+  {
+    loadTile(request, tileRect, tile);
+  }, asyncLoading ? &missingKeys : nullptr);
+
+  if(asyncLoading && !lazy)
+  {
+    // Visible tiles first
+    requestTiles(cache, request, missingKeys, false /* prefetch */);
+
+    // Tiles along the current movement
+    QVector<quint64> prefetchKeys;
+    GeoDataLatLonBox predicted = prefetchRect(rect);
+    if(!predicted.isEmpty())
+    {
+      tileKeysForRect(prefetchKeys, predicted);
+      requestTiles(cache, request, prefetchKeys, true /* prefetch */);
+    }
+
+    // Drop requests left over from previous views
+    pruneTileRequests(cache, request.type, cache.curTileKeys + prefetchKeys);
+    startTileLoading();
+  }
+
+  if(collectStatistics)
+  {
+    statistics.queryNs += timer.nsecsElapsed();
+    statistics.numCalls++;
+    statistics.tileHits += cache.numHits - numHits;
+    statistics.tileMisses += cache.numMisses - numMisses;
+  }
+  return updated;
+}
+
+template<typename TYPE>
+void MapQuery::requestTiles(TileCache<TYPE>& cache, const TileRequest& request, const QVector<quint64>& keys,
+                            bool prefetch)
+{
+  for(quint64 key : keys)
+  {
+    if(cache.hasTile(key))
+      continue;
+
+    if(cache.requestedKeys.contains(key))
+    {
+      if(!prefetch)
       {
-        query = airspaceByRectQuery;
-        alt = 0;
+        // Tile is visible now - move a queued prefetch request to the front
+        for(int i = 0; i < tileRequests.size(); i++)
+        {
+          if(tileRequests.at(i).type == request.type && tileRequests.at(i).key == key &&
+             tileRequests.at(i).prefetch)
+          {
+            TileRequest tileRequest = tileRequests.takeAt(i);
+            tileRequest.prefetch = false;
+            tileRequests.prepend(tileRequest);
+            break;
+          }
+        }
       }
+      // else already queued or loading
+      continue;
+    }
+
+    TileRequest tileRequest(request);
+    tileRequest.key = key;
+    tileRequest.generation = cache.generation;
+    tileRequest.prefetch = prefetch;
+
+    if(prefetch)
+      tileRequests.append(tileRequest);
+    else
+      tileRequests.prepend(tileRequest);
+    cache.requestedKeys.insert(key);
+  }
+}
+
+template<typename TYPE>
+void MapQuery::pruneTileRequests(TileCache<TYPE>& cache, map::MapObjectType type, const QVector<quint64>& keys)
+{
+  QSet<quint64> keep;
+  for(quint64 key : keys)
+    keep.insert(key);
+
+  tileRequests.erase(std::remove_if(tileRequests.begin(), tileRequests.end(),
+                                    [type, &keep, &cache](const TileRequest& request) -> bool
+  {
+    if(request.type == type && !keep.contains(request.key))
+    {
+      // Allow requesting the tile again if it comes back into view
+      cache.requestedKeys.remove(request.key);
+      return true;
+    }
+    return false;
+  }), tileRequests.end());
+}
+
+/* Normalize longitude to -180 to 180 degree */
+static double normalizeLonX(double lonX)
+{
+  while(lonX > 180.)
+    lonX -= 360.;
+  while(lonX < -180.)
+    lonX += 360.;
+  return lonX;
+}
+
+GeoDataLatLonBox MapQuery::prefetchRect(const Marble::GeoDataLatLonBox& rect)
+{
+  if(!(rect == lastQueryRect))
+  {
+    // Map was moved or zoomed - remember movement
+    if(!lastQueryRect.isEmpty() && lastQueryRect.width(GeoDataCoordinates::Degree) > 0.)
+    {
+      moveLonX = normalizeLonX(rect.center().longitude(GeoDataCoordinates::Degree) -
+                               lastQueryRect.center().longitude(GeoDataCoordinates::Degree));
+      moveLatY = rect.center().latitude(GeoDataCoordinates::Degree) -
+                 lastQueryRect.center().latitude(GeoDataCoordinates::Degree);
+      zoomFactor = std::max(0.5, std::min(2., rect.width(GeoDataCoordinates::Degree) /
+                                          lastQueryRect.width(GeoDataCoordinates::Degree)));
+    }
+    lastQueryRect = rect;
+  }
 
-      QSet<int> ids;
+  double width = rect.width(GeoDataCoordinates::Degree) * std::pow(zoomFactor, TILE_PREFETCH_STEPS);
+  double height = rect.height(GeoDataCoordinates::Degree) * std::pow(zoomFactor, TILE_PREFETCH_STEPS);
 
-      // qDebug() << rect.toString(GeoDataCoordinates::Degree);
+  if(width >= 180. || (atools::almostEqual(moveLonX, 0.) && atools::almostEqual(moveLatY, 0.) &&
+                       atools::almostEqual(zoomFactor, 1.)))
+    // Whole world visible or no movement - inflated visible rectangle covers all
+    return GeoDataLatLonBox();
+
+  double lonX = rect.center().longitude(GeoDataCoordinates::Degree) + moveLonX * TILE_PREFETCH_STEPS;
+  double latY = rect.center().latitude(GeoDataCoordinates::Degree) + moveLatY * TILE_PREFETCH_STEPS;
+
+  // qreal north, qreal south, qreal east, qreal west
+  return GeoDataLatLonBox(std::min(latY + height / 2., 90.), std::max(latY - height / 2., -90.),
+                          normalizeLonX(lonX + width / 2.), normalizeLonX(lonX - width / 2.),
+                          GeoDataCoordinates::Degree);
+}
+
+void MapQuery::startTileLoading()
+{
+  if(tileLoadFuture.isRunning() || tileRequests.isEmpty() || db == nullptr || dbNav == nullptr)
+    return;
+
+  QVector<TileRequest> requests = tileRequests.mid(0, TILE_LOAD_BATCH_SIZE);
+  tileRequests.remove(0, requests.size());
+
+  tileLoadCancel = false;
+  tileLoadFuture = QtConcurrent::run(this, &MapQuery::loadTilesThread,
+                                     db->databaseName(), dbNav->databaseName(), requests);
+
+  // Watcher will call loadTilesThreadFinished when finished
+  tileLoadWatcher.setFuture(tileLoadFuture);
+}
+
+/* Cancel and wait for the background thread. Results are dropped since the caller clears the caches. */
+void MapQuery::stopTileLoading()
+{
+  tileRequests.clear();
+  tileLoadCancel = true;
+  tileLoadFuture.waitForFinished();
+}
+
+void MapQuery::removeTileRequests(map::MapObjectType type)
+{
+  tileRequests.erase(std::remove_if(tileRequests.begin(), tileRequests.end(),
+                                    [type](const TileRequest& request) -> bool
+  {
+    return request.type == type;
+  }), tileRequests.end());
+}
+
+QVector<MapQuery::TileResult> MapQuery::loadTilesThread(QString databaseFile, QString databaseFileNav,
+                                                        QVector<TileRequest> requests)
+{
+  QVector<TileResult> results;
+
+  // Database connections cannot be shared between threads
+  SqlDatabase::addDatabase("QSQLITE", TILE_LOAD_DATABASE_NAME);
+  SqlDatabase::addDatabase("QSQLITE", TILE_LOAD_DATABASE_NAME_NAV);
+
+  try
+  {
+    {
+      // Autocommit is needed to attach the R*Tree tables of read only databases
+      SqlDatabase dbLoad(TILE_LOAD_DATABASE_NAME);
+      dbLoad.setDatabaseName(databaseFile);
+      dbLoad.setReadonly();
+      dbLoad.setAutocommit(true);
+      dbLoad.open();
+      spatialindex::attachSidecar(&dbLoad, databaseFile);
+
+      SqlDatabase dbLoadNav(TILE_LOAD_DATABASE_NAME_NAV);
+      dbLoadNav.setDatabaseName(databaseFileNav);
+      dbLoadNav.setReadonly();
+      dbLoadNav.setAutocommit(true);
+      dbLoadNav.open();
+      spatialindex::attachSidecar(&dbLoadNav, databaseFileNav);
 
-      // Get the airspace objects without geometry
-      for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
       {
-        // qDebug() << r.toString(GeoDataCoordinates::Degree);
+        MapQuery loader(&dbLoad, &dbLoadNav);
+        loader.initQueries();
 
-        for(const QString& typeStr : typeStrings)
+        for(const TileRequest& request : requests)
         {
-          bindCoordinatePointInRect(r, query);
-          query->bindValue(":type", typeStr);
-
-          if(alt > 0)
-            query->bindValue(":alt", alt);
+          if(tileLoadCancel)
+            break;
 
-          // qDebug() << "==================== query" << endl << query->getFullQueryString();
+          TileResult result;
+          result.request = request;
+          GeoDataLatLonBox rect = tileRectForKey(request.key);
 
-          query->exec();
-          while(query->next())
+          switch(request.type)
           {
-            // Avoid double airspaces which can happen if they cross the date boundary
-            if(ids.contains(query->valueInt("boundary_id")))
+            case map::AIRPORT:
+              loader.loadTile(request, rect, result.airports);
+              break;
+            case map::WAYPOINT:
+              loader.loadTile(request, rect, result.waypoints);
+              break;
+            case map::VOR:
+              loader.loadTile(request, rect, result.vors);
+              break;
+            case map::NDB:
+              loader.loadTile(request, rect, result.ndbs);
+              break;
+            case map::MARKER:
+              loader.loadTile(request, rect, result.markers);
+              break;
+            case map::ILS:
+              loader.loadTile(request, rect, result.ils);
+              break;
+            case map::AIRWAY:
+              loader.loadTile(request, rect, result.airways);
+              break;
+            case map::AIRSPACE:
+              loader.loadTile(request, rect, result.airspaces);
+              break;
+            default:
+              qWarning() << Q_FUNC_INFO << "Invalid type" << request.type;
               continue;
-
-            // qreal north, qreal south, qreal east, qreal west
-            if(rect.intersects(GeoDataLatLonBox(query->valueFloat("max_laty"), query->valueFloat("min_laty"),
-                                                query->valueFloat("max_lonx"), query->valueFloat("min_lonx"),
-                                                GeoDataCoordinates::GeoDataCoordinates::Degree)))
-            {
-              map::MapAirspace airspace;
-              mapTypesFactory->fillAirspace(query->record(), airspace);
-              airspaceCache.list.append(airspace);
-
-              ids.insert(airspace.id);
-            }
           }
+          results.append(result);
         }
       }
 
-      // Sort by importance
-      std::sort(airspaceCache.list.begin(), airspaceCache.list.end(),
-                [](const map::MapAirspace& airspace1, const map::MapAirspace& airspace2) -> bool
+      dbLoad.close();
+      dbLoadNav.close();
+    }
+  }
+  catch(atools::Exception& e)
+  {
+    qWarning() << Q_FUNC_INFO << "Error loading tiles" << e.what();
+  }
+  catch(...)
+  {
+    qWarning() << Q_FUNC_INFO << "Unknown exception loading tiles";
+  }
+
+  // Remove connections on errors too - otherwise the next run cannot add them again
+  SqlDatabase::removeDatabase(TILE_LOAD_DATABASE_NAME);
+  SqlDatabase::removeDatabase(TILE_LOAD_DATABASE_NAME_NAV);
+
+  return results;
+}
+
+/* Called by watcher when the thread is finished */
+void MapQuery::loadTilesThreadFinished()
+{
+  bool visibleChanged = false;
+  for(const TileResult& result : tileLoadFuture.result())
+  {
+    const TileRequest& request = result.request;
+    switch(request.type)
+    {
+      case map::AIRPORT:
+        visibleChanged |= airportCache.insertTile(request.key, new QList<map::MapAirport>(result.airports),
+                                                  request.generation, request.prefetch);
+        break;
+      case map::WAYPOINT:
+        visibleChanged |= waypointCache.insertTile(request.key, new QList<map::MapWaypoint>(result.waypoints),
+                                                   request.generation, request.prefetch);
+        break;
+      case map::VOR:
+        visibleChanged |= vorCache.insertTile(request.key, new QList<map::MapVor>(result.vors),
+                                              request.generation, request.prefetch);
+        break;
+      case map::NDB:
+        visibleChanged |= ndbCache.insertTile(request.key, new QList<map::MapNdb>(result.ndbs),
+                                              request.generation, request.prefetch);
+        break;
+      case map::MARKER:
+        visibleChanged |= markerCache.insertTile(request.key, new QList<map::MapMarker>(result.markers),
+                                                 request.generation, request.prefetch);
+        break;
+      case map::ILS:
+        visibleChanged |= ilsCache.insertTile(request.key, new QList<map::MapIls>(result.ils),
+                                              request.generation, request.prefetch);
+        break;
+      case map::AIRWAY:
+        visibleChanged |= airwayCache.insertTile(request.key, new QList<map::MapAirway>(result.airways),
+                                                 request.generation, request.prefetch);
+        break;
+      case map::AIRSPACE:
+        visibleChanged |= airspaceCache.insertTile(request.key, new QList<map::MapAirspace>(result.airspaces),
+                                                   request.generation, request.prefetch);
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Continue with remaining requests
+  startTileLoading();
+
+  if(visibleChanged)
+    emit tilesLoaded();
+}
+
+void MapQuery::loadTile(const TileRequest& request, const Marble::GeoDataLatLonBox& rect,
+                        QList<map::MapAirport>& tile)
+{
+  SqlQuery *query = nullptr;
+  bool overview = true;
+  switch(request.airportSource)
+  {
+    case layer::ALL:
+      query = airportByRectQuery;
+      query->bindValue(":minlength", request.minRunwayLength);
+      overview = false;
+      break;
+
+    case layer::MEDIUM:
+      // Airports > 4000 ft
+      query = airportMediumByRectQuery;
+      break;
+
+    case layer::LARGE:
+      // Airports > 8000 ft
+      query = airportLargeByRectQuery;
+      break;
+  }
+
+  bindCoordinatePointInRect(rect, query);
+  query->exec();
+  while(query->next())
+  {
+    map::MapAirport ap;
+    if(overview)
+      // Fill only a part of the object
+      mapTypesFactory->fillAirportForOverview(query->record(), ap);
+    else
+      mapTypesFactory->fillAirport(query->record(), ap, true /* complete */, false /* nav */);
+    tile.append(ap);
+  }
+}
+
+void MapQuery::loadTile(const TileRequest&, const Marble::GeoDataLatLonBox& rect, QList<map::MapWaypoint>& tile)
+{
+  bindCoordinatePointInRect(rect, waypointsByRectQuery);
+  waypointsByRectQuery->exec();
+  while(waypointsByRectQuery->next())
+  {
+    map::MapWaypoint wp;
+    mapTypesFactory->fillWaypoint(waypointsByRectQuery->record(), wp);
+    tile.append(wp);
+  }
+}
+
+void MapQuery::loadTile(const TileRequest&, const Marble::GeoDataLatLonBox& rect, QList<map::MapVor>& tile)
+{
+  bindCoordinatePointInRect(rect, vorsByRectQuery);
+  vorsByRectQuery->exec();
+  while(vorsByRectQuery->next())
+  {
+    map::MapVor vor;
+    mapTypesFactory->fillVor(vorsByRectQuery->record(), vor);
+    tile.append(vor);
+  }
+}
+
+void MapQuery::loadTile(const TileRequest&, const Marble::GeoDataLatLonBox& rect, QList<map::MapNdb>& tile)
+{
+  bindCoordinatePointInRect(rect, ndbsByRectQuery);
+  ndbsByRectQuery->exec();
+  while(ndbsByRectQuery->next())
+  {
+    map::MapNdb ndb;
+    mapTypesFactory->fillNdb(ndbsByRectQuery->record(), ndb);
+    tile.append(ndb);
+  }
+}
+
+void MapQuery::loadTile(const TileRequest&, const Marble::GeoDataLatLonBox& rect, QList<map::MapMarker>& tile)
+{
+  bindCoordinatePointInRect(rect, markersByRectQuery);
+  markersByRectQuery->exec();
+  while(markersByRectQuery->next())
+  {
+    map::MapMarker marker;
+    mapTypesFactory->fillMarker(markersByRectQuery->record(), marker);
+    tile.append(marker);
+  }
+}
+
+void MapQuery::loadTile(const TileRequest&, const Marble::GeoDataLatLonBox& rect, QList<map::MapIls>& tile)
+{
+  bindCoordinatePointInRect(rect, ilsByRectQuery);
+  ilsByRectQuery->exec();
+  while(ilsByRectQuery->next())
+  {
+    map::MapIls ils;
+    mapTypesFactory->fillIls(ilsByRectQuery->record(), ils);
+    tile.append(ils);
+  }
+}
+
+void MapQuery::loadTile(const TileRequest&, const Marble::GeoDataLatLonBox& rect, QList<map::MapAirway>& tile)
+{
+  bindCoordinatePointInRect(rect, airwayByRectQuery);
+  airwayByRectQuery->exec();
+  while(airwayByRectQuery->next())
+  {
+    // qreal north, qreal south, qreal east, qreal west
+    if(rect.intersects(GeoDataLatLonBox(airwayByRectQuery->valueFloat("top_laty"),
+                                        airwayByRectQuery->valueFloat("bottom_laty"),
+                                        airwayByRectQuery->valueFloat("right_lonx"),
+                                        airwayByRectQuery->valueFloat("left_lonx"),
+                                        GeoDataCoordinates::GeoDataCoordinates::Degree)))
+    {
+      map::MapAirway airway;
+      mapTypesFactory->fillAirway(airwayByRectQuery->record(), airway);
+      tile.append(airway);
+    }
+  }
+}
+
+void MapQuery::loadTile(const TileRequest& request, const Marble::GeoDataLatLonBox& rect,
+                        QList<map::MapAirspace>& tile)
+{
+  const map::MapAirspaceFilter& filter = request.airspaceFilter;
+
+  QStringList typeStrings;
+  // Build a list of query strings based on the bitfield
+  if(filter.types == map::AIRSPACE_ALL)
+    typeStrings.append("%");
+  else
+  {
+    for(int i = 0; i <= map::MAP_AIRSPACE_TYPE_BITS; i++)
+    {
+      map::MapAirspaceTypes t(1 << i);
+      if(filter.types & t)
+        typeStrings.append(map::airspaceTypeToDatabase(t));
+    }
+  }
+
+  SqlQuery *query = nullptr;
+  int alt;
+  if(filter.flags & map::AIRSPACE_AT_FLIGHTPLAN)
+  {
+    query = airspaceByRectAtAltQuery;
+    alt = atools::roundToInt(request.flightPlanAltitude);
+  }
+  else if(filter.flags & map::AIRSPACE_BELOW_10000)
+  {
+    query = airspaceByRectBelowAltQuery;
+    alt = 10000;
+  }
+  else if(filter.flags & map::AIRSPACE_BELOW_18000)
+  {
+    query = airspaceByRectBelowAltQuery;
+    alt = 18000;
+  }
+  else if(filter.flags & map::AIRSPACE_ABOVE_10000)
+  {
+    query = airspaceByRectAboveAltQuery;
+    alt = 10000;
+  }
+  else if(filter.flags & map::AIRSPACE_ABOVE_18000)
+  {
+    query = airspaceByRectAboveAltQuery;
+    alt = 18000;
+  }
+  else
+  {
+    query = airspaceByRectQuery;
+    alt = 0;
+  }
+
+  // Get the airspace objects without geometry
+  QSet<int> ids;
+  for(const QString& typeStr : typeStrings)
+  {
+    bindCoordinatePointInRect(rect, query);
+    query->bindValue(":type", typeStr);
+
+    if(alt > 0)
+      query->bindValue(":alt", alt);
+
+    query->exec();
+    while(query->next())
+    {
+      if(ids.contains(query->valueInt("boundary_id")))
+        continue;
+
+      // qreal north, qreal south, qreal east, qreal west
+      if(rect.intersects(GeoDataLatLonBox(query->valueFloat("max_laty"), query->valueFloat("min_laty"),
+                                          query->valueFloat("max_lonx"), query->valueFloat("min_lonx"),
+                                          GeoDataCoordinates::GeoDataCoordinates::Degree)))
       {
-        return map::airspaceDrawingOrder(airspace1.type) < map::airspaceDrawingOrder(airspace2.type);
-      });
+        map::MapAirspace airspace;
+        mapTypesFactory->fillAirspace(query->record(), airspace);
+        tile.append(airspace);
+        ids.insert(airspace.id);
+      }
     }
   }
-  airspaceCache.validate();
-  return &airspaceCache.list;
 }
 
 const LineString *MapQuery::getAirspaceGeometry(int boundaryId)
@@ -959,41 +1455,125 @@ const LineString *MapQuery::getAirspaceGeometry(int boundaryId)
   }
 }
 
-/*
- * Get airport cache
- * @param reverse reverse order of airports to have unimportant small ones below in painting order
- * @param lazy do not update cache - instead return incomplete resut
- * @param overview fetch only incomplete data for overview airports
- * @return pointer to the airport cache
- */
-const QList<map::MapAirport> *MapQuery::fetchAirports(const Marble::GeoDataLatLonBox& rect,
-                                                      atools::sql::SqlQuery *query, bool reverse,
-                                                      bool lazy, bool overview)
+/* Square of the distance of point p to the segment from p1 to p2 using plain degree coordinates */
+static double segmentDistanceSq(const Pos& p, const Pos& p1, const Pos& p2)
+{
+  double x = p.getLonX(), y = p.getLatY();
+  double x1 = p1.getLonX(), y1 = p1.getLatY(), dx = p2.getLonX() - x1, dy = p2.getLatY() - y1;
+
+  double lenSq = dx * dx + dy * dy;
+  double t = lenSq > 0. ? std::max(0., std::min(1., ((x - x1) * dx + (y - y1) * dy) / lenSq)) : 0.;
+  double ex = x1 + t * dx - x, ey = y1 + t * dy - y;
+  return ex * ex + ey * ey;
+}
+
+/* Douglas-Peucker simplification. Fills keep with true for all points to retain. */
+static void simplifyLine(const LineString& line, double tolerance, QVector<bool>& keep)
 {
-  if(airportCache.list.isEmpty() && !lazy)
+  if(line.size() < 3 || tolerance <= 0.)
+  {
+    keep.fill(true, line.size());
+    return;
+  }
+
+  keep.fill(false, line.size());
+  keep[0] = keep[line.size() - 1] = true;
+
+  double toleranceSq = tolerance * tolerance;
+  QVector<std::pair<int, int> > stack;
+  stack.append(std::make_pair(0, line.size() - 1));
+  while(!stack.isEmpty())
   {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
+    std::pair<int, int> range = stack.takeLast();
+
+    int farthest = -1;
+    double maxDistSq = toleranceSq;
+    for(int i = range.first + 1; i < range.second; i++)
     {
-      bindCoordinatePointInRect(r, query);
-      query->exec();
-      while(query->next())
+      double distSq = segmentDistanceSq(line.at(i), line.at(range.first), line.at(range.second));
+      if(distSq > maxDistSq)
       {
-        map::MapAirport ap;
-        if(overview)
-          // Fill only a part of the object
-          mapTypesFactory->fillAirportForOverview(query->record(), ap);
-        else
-          mapTypesFactory->fillAirport(query->record(), ap, true /* complete */, false /* nav */);
-
-        if(reverse)
-          airportCache.list.prepend(ap);
-        else
-          airportCache.list.append(ap);
+        maxDistSq = distSq;
+        farthest = i;
       }
     }
+
+    if(farthest != -1)
+    {
+      keep[farthest] = true;
+      stack.append(std::make_pair(range.first, farthest));
+      stack.append(std::make_pair(farthest, range.second));
+    }
   }
-  airportCache.validate();
-  return &airportCache.list;
+}
+
+const Marble::GeoDataLinearRing *MapQuery::getAirspaceRing(int boundaryId, int level)
+{
+  level = std::max(0, std::min(AIRSPACE_RING_LEVELS - 1, level));
+
+  QVector<GeoDataLinearRing> *rings = airspaceRingCache.object(boundaryId);
+  if(rings == nullptr)
+  {
+    const LineString *lines = getAirspaceGeometry(boundaryId);
+
+    rings = new QVector<GeoDataLinearRing>(AIRSPACE_RING_LEVELS);
+    int numPoints = 0;
+    QVector<bool> keep;
+    for(int l = 0; l < AIRSPACE_RING_LEVELS; l++)
+    {
+      simplifyLine(*lines, AIRSPACE_RING_TOLERANCE[l], keep);
+      if(keep.count(true) < 4 && l > 0)
+      {
+        // Too much removed - use previous level
+        (*rings)[l] = rings->at(l - 1);
+        numPoints += rings->at(l).size();
+        continue;
+      }
+
+      GeoDataLinearRing& ring = (*rings)[l];
+      const Pos *last = nullptr;
+      for(int i = 0; i < lines->size(); i++)
+      {
+        if(!keep.at(i))
+          continue;
+
+        const Pos& pos = lines->at(i);
+        if(last != nullptr)
+        {
+          // Interpolate long segments along the great circle
+          float distanceMeter = last->distanceMeterTo(pos);
+          int numSegments = static_cast<int>(distanceMeter / AIRSPACE_RING_MAX_SEGMENT_METER);
+          for(int j = 1; j <= numSegments; j++)
+          {
+            Pos ipos = last->interpolate(pos, distanceMeter, static_cast<float>(j) / (numSegments + 1));
+            ring.append(GeoDataCoordinates(ipos.getLonX(), ipos.getLatY(), 0, GeoDataCoordinates::Degree));
+          }
+        }
+        ring.append(GeoDataCoordinates(pos.getLonX(), pos.getLatY(), 0, GeoDataCoordinates::Degree));
+        last = &pos;
+      }
+      numPoints += ring.size();
+    }
+
+    if(numPoints > airspaceRingCache.maxCost())
+    {
+      // Too large for the cache - keep until next call
+      airspaceRingsUncached = *rings;
+      delete rings;
+      return &airspaceRingsUncached.at(level);
+    }
+
+    airspaceRingCache.insert(boundaryId, rings, std::max(numPoints, 1));
+  }
+  return &rings->at(level);
+}
+
+int MapQuery::airspaceRingLevel(double degreesPerPixel)
+{
+  int level = 0;
+  while(level < AIRSPACE_RING_LEVELS - 1 && AIRSPACE_RING_TOLERANCE[level + 1] <= degreesPerPixel)
+    level++;
+  return level;
 }
 
 const QList<map::MapRunway> *MapQuery::getRunwaysForOverview(int airportId)
@@ -1034,6 +1614,64 @@ void MapQuery::bindCoordinatePointInRect(const Marble::GeoDataLatLonBox& rect, a
   query->bindValue(":" + prefix + "topy", rect.north(GeoDataCoordinates::Degree));
 }
 
+static quint64 tileKey(int level, int x, int y)
+{
+  return static_cast<quint64>(level - TILE_LEVEL_MIN) << 32 | static_cast<quint64>(y) << 16 |
+         static_cast<quint64>(x);
+}
+
+/* Tile index for a coordinate offset from -180 or -90 degree */
+static int tileIndex(double offset, double tileSize, int numTiles)
+{
+  return std::max(0, std::min(numTiles - 1, static_cast<int>(offset / tileSize)));
+}
+
+void MapQuery::tileKeysForRect(QVector<quint64>& keys, const Marble::GeoDataLatLonBox& rect)
+{
+  // Find the smallest tile size which gives not more than about TILES_PER_RECT tiles in each direction
+  double size = std::max(rect.width(GeoDataCoordinates::Degree), rect.height(GeoDataCoordinates::Degree)) /
+                TILES_PER_RECT;
+  int level = TILE_LEVEL_MIN;
+  while(level < TILE_LEVEL_MAX && std::ldexp(1., level) < size)
+    level++;
+
+  double tileSize = std::ldexp(1., level);
+  int numX = static_cast<int>(std::ceil(360. / tileSize));
+  int numY = static_cast<int>(std::ceil(180. / tileSize));
+
+  keys.clear();
+  for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
+  {
+    int x1 = tileIndex(r.west(GeoDataCoordinates::Degree) + 180., tileSize, numX);
+    int x2 = tileIndex(r.east(GeoDataCoordinates::Degree) + 180., tileSize, numX);
+    int y1 = tileIndex(r.south(GeoDataCoordinates::Degree) + 90., tileSize, numY);
+    int y2 = tileIndex(r.north(GeoDataCoordinates::Degree) + 90., tileSize, numY);
+
+    for(int y = y1; y <= y2; y++)
+    {
+      for(int x = x1; x <= x2; x++)
+        keys.append(tileKey(level, x, y));
+    }
+  }
+
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+Marble::GeoDataLatLonBox MapQuery::tileRectForKey(quint64 key)
+{
+  int level = static_cast<int>(key >> 32) + TILE_LEVEL_MIN;
+  int y = static_cast<int>((key >> 16) & 0xffff);
+  int x = static_cast<int>(key & 0xffff);
+  double tileSize = std::ldexp(1., level);
+
+  double west = -180. + x * tileSize, south = -90. + y * tileSize;
+
+  // qreal north, qreal south, qreal east, qreal west
+  return GeoDataLatLonBox(std::min(south + tileSize, 90.), south, std::min(west + tileSize, 180.), west,
+                          GeoDataCoordinates::Degree);
+}
+
 /* Inflates the rectangle and splits it at the antimeridian (date line) if it overlaps */
 QList<Marble::GeoDataLatLonBox> MapQuery::splitAtAntiMeridian(const Marble::GeoDataLatLonBox& rect)
 {
@@ -1087,6 +1725,25 @@ void MapQuery::initQueries()
   static const QString whereIdentRegion("ident = :ident and region like :region");
   static const QString whereLimit("limit " + QString::number(queryMaxRows));
 
+  // Use R*Tree tables for rectangle lookups if available. The exact coordinate condition is kept but
+  // column indexes are disabled by the unary plus to let SQLite use the R*Tree
+  auto spatialRect = [](SqlDatabase *database, const QString& table, const QString& idColumn) -> QString
+  {
+    if(spatialindex::hasIndex(database, table))
+      return spatialindex::rectCondition(table, idColumn, ":leftx", ":rightx", ":bottomy", ":topy") + " and ";
+    else
+      return QString();
+  };
+  auto whereRectFor = [&spatialRect](SqlDatabase *database, const QString& table,
+                                     const QString& idColumn) -> QString
+  {
+    QString spatial = spatialRect(database, table, idColumn);
+    if(spatial.isEmpty())
+      return whereRect;
+    else
+      return spatial + "+lonx between :leftx and :rightx and +laty between :bottomy and :topy";
+  };
+
   // Common select statements
   QStringList const airportQueryBase = AirportQuery::airportColumns(db);
 
@@ -1175,17 +1832,19 @@ void MapQuery::initQueries()
 
   airportByRectQuery = new SqlQuery(db);
   airportByRectQuery->prepare(
-    "select " + airportQueryBase.join(", ") + " from airport where " + whereRect +
+    "select " + airportQueryBase.join(", ") + " from airport where " + whereRectFor(db, "airport", "airport_id") +
     " and longest_runway_length >= :minlength order by rating desc, longest_runway_length desc "
     + whereLimit);
 
   airportMediumByRectQuery = new SqlQuery(db);
   airportMediumByRectQuery->prepare(
-    "select " + airportQueryBaseOverview + "from airport_medium where " + whereRect + " " + whereLimit);
+    "select " + airportQueryBaseOverview + "from airport_medium where " +
+    whereRectFor(db, "airport", "airport_id") + " " + whereLimit);
 
   airportLargeByRectQuery = new SqlQuery(db);
   airportLargeByRectQuery->prepare(
-    "select " + airportQueryBaseOverview + "from airport_large where " + whereRect + " " + whereLimit);
+    "select " + airportQueryBaseOverview + "from airport_large where " +
+    whereRectFor(db, "airport", "airport_id") + " " + whereLimit);
 
   // Runways > 4000 feet for simplyfied runway overview
   runwayOverviewQuery = new SqlQuery(db);
@@ -1195,13 +1854,16 @@ void MapQuery::initQueries()
 
   waypointsByRectQuery = new SqlQuery(dbNav);
   waypointsByRectQuery->prepare(
-    "select " + waypointQueryBase + " from waypoint where " + whereRect + " " + whereLimit);
+    "select " + waypointQueryBase + " from waypoint where " + whereRectFor(dbNav, "waypoint", "waypoint_id") + " " +
+    whereLimit);
 
   vorsByRectQuery = new SqlQuery(dbNav);
-  vorsByRectQuery->prepare("select " + vorQueryBase + " from vor where " + whereRect + " " + whereLimit);
+  vorsByRectQuery->prepare("select " + vorQueryBase + " from vor where " + whereRectFor(dbNav, "vor", "vor_id") +
+                           " " + whereLimit);
 
   ndbsByRectQuery = new SqlQuery(dbNav);
-  ndbsByRectQuery->prepare("select " + ndbQueryBase + " from ndb where " + whereRect + " " + whereLimit);
+  ndbsByRectQuery->prepare("select " + ndbQueryBase + " from ndb where " + whereRectFor(dbNav, "ndb", "ndb_id") +
+                           " " + whereLimit);
 
   markersByRectQuery = new SqlQuery(dbNav);
   markersByRectQuery->prepare(
@@ -1210,14 +1872,16 @@ void MapQuery::initQueries()
     "where " + whereRect + " " + whereLimit);
 
   ilsByRectQuery = new SqlQuery(db);
-  ilsByRectQuery->prepare("select " + ilsQueryBase + " from ils where " + whereRect + " " + whereLimit);
+  ilsByRectQuery->prepare("select " + ilsQueryBase + " from ils where " + whereRectFor(db, "ils", "ils_id") +
+                          " " + whereLimit);
 
   // Get all that are crossing the anti meridian too and filter them out from the query result
   airwayByRectQuery = new SqlQuery(dbNav);
   airwayByRectQuery->prepare(
     "select " + airwayQueryBase + ", right_lonx, left_lonx, bottom_laty, top_laty from airway where " +
-    "not (right_lonx < :leftx or left_lonx > :rightx or bottom_laty > :topy or top_laty < :bottomy) "
-    "or right_lonx < left_lonx");
+    spatialRect(dbNav, "airway", "airway_id") +
+    "(not (right_lonx < :leftx or left_lonx > :rightx or bottom_laty > :topy or top_laty < :bottomy) "
+    "or right_lonx < left_lonx)");
 
   airwayByWaypointIdQuery = new SqlQuery(dbNav);
   airwayByWaypointIdQuery->prepare(
@@ -1256,7 +1920,7 @@ void MapQuery::initQueries()
                                                               " order by airway_fragment_no, sequence_no");
 
   // Get all that are crossing the anti meridian too and filter them out from the query result
-  QString airspaceRect =
+  QString airspaceRect = spatialRect(dbNav, "boundary", "boundary_id") +
     " (not (max_lonx < :leftx or min_lonx > :rightx or "
     "min_laty > :topy or max_laty < :bottomy) or max_lonx < min_lonx) and ";
 
@@ -1278,7 +1942,7 @@ void MapQuery::initQueries()
   airspaceByRectAtAltQuery = new SqlQuery(dbNav);
   airspaceByRectAtAltQuery->prepare(
     "select " + airspaceQueryBase + "from boundary "
-                                    "where "
+                                    "where " + spatialRect(dbNav, "boundary", "boundary_id") +
                                     "not (max_lonx < :leftx or min_lonx > :rightx or "
                                     "min_laty > :topy or max_laty < :bottomy) and "
                                     "type like :type and "
@@ -1291,6 +1955,9 @@ void MapQuery::initQueries()
 
 void MapQuery::deInitQueries()
 {
+  // Background thread uses the same database files
+  stopTileLoading();
+
   airportCache.clear();
   waypointCache.clear();
   vorCache.clear();
@@ -1300,6 +1967,7 @@ void MapQuery::deInitQueries()
   airwayCache.clear();
   airspaceCache.clear();
   airspaceLineCache.clear();
+  airspaceRingCache.clear();
   runwayOverwiewCache.clear();
 
   delete airportByRectQuery;
@@ -22,11 +22,17 @@
 #include "mapgui/maplayer.h"
 
 #include <QCache>
+#include <QFutureWatcher>
 #include <QList>
+#include <QSet>
+#include <QSize>
+#include <QVector>
 
+#include <atomic>
 #include <functional>
 
 #include <marble/GeoDataLatLonBox.h>
+#include <marble/GeoDataLinearRing.h>
 
 namespace atools {
 namespace geo {
@@ -170,6 +176,20 @@ public:
                                               map::MapAirspaceFilter filter, float flightPlanAltitude, bool lazy);
   const atools::geo::LineString *getAirspaceGeometry(int boundaryId);
 
+  /* Number of simplification levels for getAirspaceRing */
+  static Q_DECL_CONSTEXPR int AIRSPACE_RING_LEVELS = 4;
+
+  /*
+   * Get airspace boundary as a ring which is simplified and densified for drawing.
+   * Segments are already interpolated along great circles so the ring can be drawn without tessellation.
+   * @param level simplification level from 0 (original geometry) to AIRSPACE_RING_LEVELS - 1.
+   * Use airspaceRingLevel to find the level for a map scale.
+   */
+  const Marble::GeoDataLinearRing *getAirspaceRing(int boundaryId, int level);
+
+  /* Simplification level that keeps errors below one pixel */
+  static int airspaceRingLevel(double degreesPerPixel);
+
   /* Get a partially filled runway list for the overview */
   const QList<map::MapRunway> *getRunwaysForOverview(int airportId);
 
@@ -179,42 +199,240 @@ public:
   /* Create and prepare all queries */
   void deInitQueries();
 
+  /* Counters for the paint profiler accumulated since the last reset */
+  struct Statistics
+  {
+    qint64 queryNs = 0; /* Time spent in the get methods including database access */
+    int numCalls = 0, tileHits = 0, tileMisses = 0;
+  };
+
+  const Statistics& getStatistics() const
+  {
+    return statistics;
+  }
+
+  void resetStatistics()
+  {
+    statistics = Statistics();
+  }
+
+  /* Statistics are only collected if enabled */
+  void setCollectStatistics(bool value)
+  {
+    collectStatistics = value;
+  }
+
+signals:
+  /* Tiles for the visible area were loaded in the background. Map has to be redrawn. */
+  void tilesLoaded();
+
 private:
-  /* Simple spatial cache that deals with objects in a bounding rectangle but does not run any queries to load data */
+  /*
+   * Spatial cache that divides the world into fixed lat/lon tiles and keeps the objects of each tile separately.
+   * Tile size is a power of two degrees and is selected by the size of the requested rectangle.
+   * Only tiles newly entering the rectangle are loaded. Tiles are evicted least recently used first
+   * when the number of cached objects exceeds the maximum.
+   * Prefetched tiles are kept in a separate smaller cache until they become visible so that
+   * predictions cannot evict visible tiles.
+   * Tiles which hit the query row limit are incomplete. They are used only while visible and are never cached.
+   */
   template<typename TYPE>
-  struct SimpleRectCache
+  struct TileCache
   {
+    ~TileCache()
+    {
+      qDeleteAll(truncatedTiles);
+    }
+
     typedef std::function<bool (const MapLayer *curLayer, const MapLayer *mapLayer)> LayerCompareFunc;
 
+    /* Load all objects of a tile into the list */
+    typedef std::function<void (const Marble::GeoDataLatLonBox& tileRect, QList<TYPE>& tileObjects)> LoadTileFunc;
+
+    /* Drop requests of the old generation which are queued for the background loader */
+    typedef std::function<void ()> ClearFunc;
+
     /*
      * @param rect bounding rectangle - all objects inside this rectangle are returned
      * @param mapLayer current map layer
      * @param lazy if true do not fetch new data but return the old potentially incomplete dataset
-     * @return true after clearing the cache. The caller has to request new data
+     * @param funcLoadTile called for each missing tile if missingKeys is null
+     * @param missingKeys if not null missing tiles are not loaded but their keys are added to this list
+     * @return true if the list was rebuilt from the tiles
      */
     bool updateCache(const Marble::GeoDataLatLonBox& rect, const MapLayer *mapLayer, bool lazy,
-                     LayerCompareFunc funcSameLayer);
+                     LayerCompareFunc funcSameLayer, LoadTileFunc funcLoadTile,
+                     QVector<quint64> *missingKeys = nullptr);
+
+    /* Add a tile loaded in the background. Takes ownership.
+     * @param prefetch put the tile into the prefetch cache if it is not visible
+     * @return true if the tile is part of the current list which will be rebuilt on the next update */
+    bool insertTile(quint64 key, QList<TYPE> *tile, int tileGeneration, bool prefetch);
+
+    /* True if the tile is in one of the caches */
+    bool hasTile(quint64 key) const
+    {
+      return tiles.contains(key) || prefetchTiles.contains(key) || truncatedTiles.contains(key);
+    }
+
+    /* True if the tile query hit the row limit */
+    static bool isTruncated(const QList<TYPE>& tile)
+    {
+      return tile.size() >= MapQuery::queryMaxRows;
+    }
+
     void clear();
-    void validate();
 
-    Marble::GeoDataLatLonBox curRect;
+    /* Memory budget as the number of objects in all cached tiles and in prefetched tiles */
+    void setMaxObjects(int maxObjects, int maxPrefetchObjects);
+
+    /* Tiles by key. Cost is the number of objects. */
+    QCache<quint64, QList<TYPE> > tiles;
+
+    /* Prefetched tiles which were not visible yet. Moved to tiles once visible. */
+    QCache<quint64, QList<TYPE> > prefetchTiles;
+
+    /* Visible tiles which hit the row limit. Deleted once they leave the view. */
+    QHash<quint64, QList<TYPE> *> truncatedTiles;
+
+    /* Sorted keys of the tiles covering the last rectangle */
+    QVector<quint64> curTileKeys;
+
+    /* A visible tile was loaded in the background - list has to be rebuilt even if the keys did not change */
+    bool listOutdated = false;
     const MapLayer *curMapLayer = nullptr;
+
+    /* Objects of all tiles in curTileKeys without duplicates */
     QList<TYPE> list;
+
+    /* Incremented each time the list is rebuilt or cleared */
+    int listVersion = 0;
+
+    /* Incremented on clear to drop tiles from background requests which were started before */
+    int generation = 0;
+
+    /* Tiles requested from the background loader but not inserted yet */
+    QSet<quint64> requestedKeys;
+
+    /* Called by clear if set */
+    ClearFunc funcClear;
+
+    /* Number of tiles found in cache or not found since creation */
+    int numHits = 0, numMisses = 0;
+  };
+
+  /* Screen coordinates of all objects in a tile cache list bucketed into square cells.
+   * Built on demand by getNearestObjects and kept until the view or the list change. */
+  struct ScreenGrid
+  {
+    struct Entry
+    {
+      int index, x, y; /* Index in the cache list and screen coordinates */
+    };
+
+    QHash<quint64, QVector<Entry> > cells;
+    int listVersion = -1, viewVersion = -1;
+  };
+
+  /* Rebuild grid from the cache list if outdated */
+  template<typename TYPE>
+  void updateScreenGrid(ScreenGrid& grid, const TileCache<TYPE>& cache, const CoordinateConverter& conv);
+
+  /* Get list indexes of all objects closer than screenDistance (manhattan) to xs/ys in descending order */
+  static void nearestFromScreenGrid(const ScreenGrid& grid, int xs, int ys, int screenDistance,
+                                    QVector<int>& indexes);
+
+  /* Increments screenGridViewVersion if the viewport has changed since the last call */
+  void updateScreenGridView(const CoordinateConverter& conv);
+
+  static quint64 screenGridKey(int x, int y);
+
+  /* Tile load request for the background thread */
+  struct TileRequest
+  {
+    map::MapObjectType type = map::NONE; /* AIRPORT, WAYPOINT, VOR, NDB, MARKER, ILS, AIRWAY or AIRSPACE */
+    quint64 key = 0;
+    int generation = 0; /* Generation of the tile cache at request time */
+    bool prefetch = false; /* Predicted tile - loaded after visible tiles and cached separately */
+
+    /* Query parameters which are not part of the tile key */
+    layer::AirportSource airportSource = layer::ALL;
+    int minRunwayLength = 0;
+    map::MapAirspaceFilter airspaceFilter = {map::AIRSPACE_NONE, map::AIRSPACE_FLAG_NONE};
+    float flightPlanAltitude = 0.f;
   };
 
+  /* Tile loaded by the background thread. Only the list matching the request type is filled. */
+  struct TileResult
+  {
+    TileRequest request;
+    QList<map::MapAirport> airports;
+    QList<map::MapWaypoint> waypoints;
+    QList<map::MapVor> vors;
+    QList<map::MapNdb> ndbs;
+    QList<map::MapMarker> markers;
+    QList<map::MapIls> ils;
+    QList<map::MapAirway> airways;
+    QList<map::MapAirspace> airspaces;
+  };
+
+  /* Creates an instance for the background loader. Does not read any settings. */
+  MapQuery(atools::sql::SqlDatabase *sqlDb, atools::sql::SqlDatabase *sqlDbNav);
+
+  /* Load all objects of a tile from the database */
+  void loadTile(const TileRequest& request, const Marble::GeoDataLatLonBox& rect, QList<map::MapAirport>& tile);
+  void loadTile(const TileRequest& request, const Marble::GeoDataLatLonBox& rect, QList<map::MapWaypoint>& tile);
+  void loadTile(const TileRequest& request, const Marble::GeoDataLatLonBox& rect, QList<map::MapVor>& tile);
+  void loadTile(const TileRequest& request, const Marble::GeoDataLatLonBox& rect, QList<map::MapNdb>& tile);
+  void loadTile(const TileRequest& request, const Marble::GeoDataLatLonBox& rect, QList<map::MapMarker>& tile);
+  void loadTile(const TileRequest& request, const Marble::GeoDataLatLonBox& rect, QList<map::MapIls>& tile);
+  void loadTile(const TileRequest& request, const Marble::GeoDataLatLonBox& rect, QList<map::MapAirway>& tile);
+  void loadTile(const TileRequest& request, const Marble::GeoDataLatLonBox& rect, QList<map::MapAirspace>& tile);
+
+  /* Update cache and load missing tiles either directly or in the background
+   * @return true if the list of the cache was rebuilt */
+  template<typename TYPE>
+  bool updateTileCache(TileCache<TYPE>& cache, const TileRequest& request, const Marble::GeoDataLatLonBox& rect,
+                       const MapLayer *mapLayer, bool lazy,
+                       typename TileCache<TYPE>::LayerCompareFunc funcSameLayer);
+
+  /* Queue tiles not in the cache and not requested yet for the background loader.
+   * Visible tiles are put in front of the queue and are moved there if already queued for prefetch. */
+  template<typename TYPE>
+  void requestTiles(TileCache<TYPE>& cache, const TileRequest& request, const QVector<quint64>& keys,
+                    bool prefetch);
+
+  /* Remove queued requests of the cache type for tiles which are neither visible nor predicted anymore */
+  template<typename TYPE>
+  void pruneTileRequests(TileCache<TYPE>& cache, map::MapObjectType type, const QVector<quint64>& keys);
+
+  /* Predict the next visible rectangle from the movement between the last two different rectangles */
+  Marble::GeoDataLatLonBox prefetchRect(const Marble::GeoDataLatLonBox& rect);
+
+  void startTileLoading();
+  void stopTileLoading();
+
+  /* Remove queued requests for the given type from tileRequests */
+  void removeTileRequests(map::MapObjectType type);
+
+  /* Runs in background thread. Opens own database connections and uses an own query instance. */
+  QVector<TileResult> loadTilesThread(QString databaseFile, QString databaseFileNav,
+                                      QVector<TileRequest> requests);
+  void loadTilesThreadFinished();
+
+  /* Get keys of all tiles covering the inflated rectangle */
+  static void tileKeysForRect(QVector<quint64>& keys, const Marble::GeoDataLatLonBox& rect);
+  static Marble::GeoDataLatLonBox tileRectForKey(quint64 key);
+
   void mapObjectByIdentInternal(map::MapSearchResult& result, map::MapObjectTypes type,
                                 const QString& ident, const QString& region, const QString& airport,
                                 const atools::geo::Pos& sortByDistancePos,
                                 float maxDistance, bool airportFromNavDatabase);
 
-  const QList<map::MapAirport> *fetchAirports(const Marble::GeoDataLatLonBox& rect,
-                                              atools::sql::SqlQuery *query, bool reverse,
-                                              bool lazy, bool overview);
-
   void bindCoordinatePointInRect(const Marble::GeoDataLatLonBox& rect, atools::sql::SqlQuery *query,
                                  const QString& prefix = QString());
 
-  QList<Marble::GeoDataLatLonBox> splitAtAntiMeridian(const Marble::GeoDataLatLonBox& rect);
+  static QList<Marble::GeoDataLatLonBox> splitAtAntiMeridian(const Marble::GeoDataLatLonBox& rect);
 
   static void inflateRect(Marble::GeoDataLatLonBox& rect);
 
@@ -223,22 +441,49 @@ private:
   MapTypesFactory *mapTypesFactory;
   atools::sql::SqlDatabase *db, *dbNav;
 
-  /* Simple bounding rectangle caches */
-  SimpleRectCache<map::MapAirport> airportCache;
-  SimpleRectCache<map::MapWaypoint> waypointCache;
-  SimpleRectCache<map::MapVor> vorCache;
-  SimpleRectCache<map::MapNdb> ndbCache;
-  SimpleRectCache<map::MapMarker> markerCache;
-  SimpleRectCache<map::MapIls> ilsCache;
-  SimpleRectCache<map::MapAirway> airwayCache;
-  SimpleRectCache<map::MapAirspace> airspaceCache;
+  /* Tile caches */
+  TileCache<map::MapAirport> airportCache;
+  TileCache<map::MapWaypoint> waypointCache;
+  TileCache<map::MapVor> vorCache;
+  TileCache<map::MapNdb> ndbCache;
+  TileCache<map::MapMarker> markerCache;
+  TileCache<map::MapIls> ilsCache;
+  TileCache<map::MapAirway> airwayCache;
+  TileCache<map::MapAirspace> airspaceCache;
   map::MapAirspaceFilter lastAirspaceFilter = {map::AIRSPACE_NONE, map::AIRSPACE_FLAG_NONE};
   float lastFlightplanAltitude = 0.f;
 
+  /* Background tile loading - requests for the visible area first followed by prefetch requests */
+  bool asyncLoading = false;
+  QVector<TileRequest> tileRequests;
+  QFuture<QVector<TileResult> > tileLoadFuture;
+  QFutureWatcher<QVector<TileResult> > tileLoadWatcher;
+  std::atomic_bool tileLoadCancel {false};
+
+  Statistics statistics;
+  bool collectStatistics = false;
+
+  /* Screen grids for getNearestObjects */
+  ScreenGrid airportGrid, waypointGrid, vorGrid, ndbGrid, markerGrid, ilsGrid;
+
+  /* Viewport of the screen grids */
+  int screenGridViewVersion = 0;
+  double screenGridCenterLonX = 0., screenGridCenterLatY = 0.;
+  int screenGridRadius = -1, screenGridProjection = -1;
+  QSize screenGridSize;
+
+  /* Last different query rectangle and movement in degrees and zoom factor to the one before */
+  Marble::GeoDataLatLonBox lastQueryRect;
+  double moveLonX = 0., moveLatY = 0., zoomFactor = 1.;
+
   /* ID/object caches */
   QCache<int, QList<map::MapRunway> > runwayOverwiewCache;
   QCache<int, atools::geo::LineString> airspaceLineCache;
 
+  /* Simplified airspace rings for all levels. Cost is number of points. */
+  QCache<int, QVector<Marble::GeoDataLinearRing> > airspaceRingCache;
+  QVector<Marble::GeoDataLinearRing> airspaceRingsUncached;
+
   static int queryMaxRows;
 
   /* Database queries */
@@ -269,44 +514,164 @@ private:
 
 // ---------------------------------------------------------------------------------
 template<typename TYPE>
-bool MapQuery::SimpleRectCache<TYPE>::updateCache(const Marble::GeoDataLatLonBox& rect, const MapLayer *mapLayer,
-                                                  bool lazy, LayerCompareFunc funcSameLayer)
+bool MapQuery::TileCache<TYPE>::updateCache(const Marble::GeoDataLatLonBox& rect, const MapLayer *mapLayer,
+                                            bool lazy, LayerCompareFunc funcSameLayer, LoadTileFunc funcLoadTile,
+                                            QVector<quint64> *missingKeys)
 {
   if(lazy)
-    // Nothing changed11
+    // Nothing changed
     return false;
 
-  // Store bounding rectangle and inflate it
-  Marble::GeoDataLatLonBox cur(curRect);
-  MapQuery::inflateRect(cur);
+  if(curMapLayer == nullptr || !funcSameLayer(curMapLayer, mapLayer))
+    // New layer selected which needs other queries - all tiles are invalid
+    clear();
+  curMapLayer = mapLayer;
+
+  QVector<quint64> keys;
+  MapQuery::tileKeysForRect(keys, rect);
 
-  if(curRect.isEmpty() || !cur.contains(rect) || !funcSameLayer(curMapLayer, mapLayer))
+  if(keys == curTileKeys && !listOutdated)
   {
-    // Rectangle not covered by loaded data or new layer selected
-    list.clear();
-    curRect = rect;
-    curMapLayer = mapLayer;
-    return true;
+    // Same tiles as before
+    numHits += keys.size();
+    return false;
   }
-  return false;
+
+  // Incomplete tiles are not cached - load them again when they come back into view
+  for(auto it = truncatedTiles.begin(); it != truncatedTiles.end();)
+  {
+    if(!keys.contains(it.key()))
+    {
+      delete it.value();
+      it = truncatedTiles.erase(it);
+    }
+    else
+      ++it;
+  }
+
+  list.clear();
+  listVersion++;
+  QSet<int> ids;
+  for(quint64 key : keys)
+  {
+    const QList<TYPE> *tile = tiles.object(key);
+    QList<TYPE> *newTile = nullptr;
+    if(tile != nullptr || (tile = truncatedTiles.value(key)) != nullptr)
+      numHits++;
+    else if((newTile = prefetchTiles.take(key)) != nullptr)
+    {
+      // Prefetched tile is visible now - move it to the cache of visible tiles below
+      numHits++;
+      tile = newTile;
+    }
+    else
+    {
+      numMisses++;
+      if(missingKeys != nullptr)
+      {
+        // Leave loading to the caller
+        missingKeys->append(key);
+        continue;
+      }
+
+      // Tile not in cache - load it from the database
+      newTile = new QList<TYPE>;
+      funcLoadTile(MapQuery::tileRectForKey(key), *newTile);
+      tile = newTile;
+    }
+
+    // Objects on tile borders are found in more than one tile
+    for(const TYPE& obj : *tile)
+    {
+      if(!ids.contains(obj.id))
+      {
+        list.append(obj);
+        ids.insert(obj.id);
+      }
+    }
+
+    if(newTile != nullptr)
+    {
+      if(isTruncated(*newTile))
+        // Tile hit the row limit and is incomplete - use it only as long as it is visible
+        truncatedTiles.insert(key, newTile);
+      else
+        // Cache takes ownership and might delete the tile immediately if it exceeds the budget
+        tiles.insert(key, newTile, std::max(newTile->size(), 1));
+    }
+  }
+
+  curTileKeys = keys;
+  listOutdated = false;
+  return true;
 }
 
 template<typename TYPE>
-void MapQuery::SimpleRectCache<TYPE>::validate()
+bool MapQuery::TileCache<TYPE>::insertTile(quint64 key, QList<TYPE> *tile, int tileGeneration, bool prefetch)
 {
-  if(list.size() >= queryMaxRows)
+  if(tileGeneration != generation)
+  {
+    // Layer or database changed after the request
+    delete tile;
+    return false;
+  }
+
+  requestedKeys.remove(key);
+
+  if(curTileKeys.contains(key))
   {
-    curRect.clear();
-    curMapLayer = nullptr;
+    if(isTruncated(*tile))
+    {
+      // Incomplete - not cached and deleted once the tile leaves the view
+      delete truncatedTiles.take(key);
+      truncatedTiles.insert(key, tile);
+    }
+    else
+      tiles.insert(key, tile, std::max(tile->size(), 1));
+
+    // Force rebuild of the list on next update
+    listOutdated = true;
+    return true;
+  }
+
+  if(isTruncated(*tile))
+  {
+    // Not visible anymore or prefetched - incomplete tiles are not cached
+    delete tile;
+    return false;
   }
+
+  if(prefetch)
+    prefetchTiles.insert(key, tile, std::max(tile->size(), 1));
+  else
+    tiles.insert(key, tile, std::max(tile->size(), 1));
+  return false;
 }
 
 template<typename TYPE>
-void MapQuery::SimpleRectCache<TYPE>::clear()
+void MapQuery::TileCache<TYPE>::clear()
 {
   list.clear();
-  curRect.clear();
+  listVersion++;
+  tiles.clear();
+  prefetchTiles.clear();
+  qDeleteAll(truncatedTiles);
+  truncatedTiles.clear();
+  curTileKeys.clear();
+  listOutdated = false;
+  requestedKeys.clear();
   curMapLayer = nullptr;
+  generation++;
+
+  if(funcClear)
+    funcClear();
+}
+
+template<typename TYPE>
+void MapQuery::TileCache<TYPE>::setMaxObjects(int maxObjects, int maxPrefetchObjects)
+{
+  tiles.setMaxCost(maxObjects);
+  prefetchTiles.setMaxCost(maxPrefetchObjects);
 }
 
 #endif // LITTLENAVMAP_MAPQUERY_H
@@ -0,0 +1,122 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "route/indexedheap.h"
+
+IndexedHeap::IndexedHeap(int reserveSize)
+{
+  heap.reserve(reserveSize);
+  positions.reserve(reserveSize);
+}
+
+IndexedHeap::~IndexedHeap()
+{
+
+}
+
+void IndexedHeap::push(int index, float costs)
+{
+  if(index >= positions.size())
+    positions.insert(positions.end(), index + 1 - positions.size(), -1);
+
+  heap.append({costs, index});
+  positions[index] = heap.size() - 1;
+  siftUp(heap.size() - 1);
+}
+
+int IndexedHeap::pop()
+{
+  int index = heap.first().index;
+  positions[index] = -1;
+
+  Entry last = heap.last();
+  heap.removeLast();
+
+  if(!heap.isEmpty())
+  {
+    place(0, last);
+    siftDown(0);
+  }
+  return index;
+}
+
+void IndexedHeap::change(int index, float costs)
+{
+  int pos = positions.at(index);
+  float oldCosts = heap.at(pos).costs;
+  heap[pos].costs = costs;
+
+  if(costs < oldCosts)
+    siftUp(pos);
+  else if(costs > oldCosts)
+    siftDown(pos);
+}
+
+void IndexedHeap::clear()
+{
+  for(const Entry& entry : heap)
+    positions[entry.index] = -1;
+
+  // Keeps capacity
+  heap.resize(0);
+}
+
+void IndexedHeap::siftUp(int pos)
+{
+  Entry entry = heap.at(pos);
+  while(pos > 0)
+  {
+    int parent = (pos - 1) / 2;
+    if(heap.at(parent).costs <= entry.costs)
+      break;
+
+    // Move parent down
+    place(pos, heap.at(parent));
+    pos = parent;
+  }
+  place(pos, entry);
+}
+
+void IndexedHeap::siftDown(int pos)
+{
+  Entry entry = heap.at(pos);
+  int size = heap.size();
+  while(true)
+  {
+    int child = 2 * pos + 1;
+    if(child >= size)
+      break;
+
+    // Use smaller of both children
+    if(child + 1 < size && heap.at(child + 1).costs < heap.at(child).costs)
+      child++;
+
+    if(entry.costs <= heap.at(child).costs)
+      break;
+
+    // Move child up
+    place(pos, heap.at(child));
+    pos = child;
+  }
+  place(pos, entry);
+}
+
+void IndexedHeap::place(int pos, const Entry& entry)
+{
+  heap[pos] = entry;
+  positions[entry.index] = pos;
+}
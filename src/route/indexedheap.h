@@ -0,0 +1,90 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_INDEXEDHEAP_H
+#define LITTLENAVMAP_INDEXEDHEAP_H
+
+#include <QVector>
+
+/*
+ * Binary min heap of dense integer indexes sorted by costs.
+ * Keeps the heap position of each index to allow contains() in O(1) and change() (decrease or increase key)
+ * in O(log n). Memory is kept on clear() to allow reuse for consecutive searches.
+ */
+class IndexedHeap
+{
+public:
+  IndexedHeap(int reserveSize = 0);
+  ~IndexedHeap();
+
+  /* Add index with costs. Index must not be in heap already. */
+  void push(int index, float costs);
+
+  /* Remove index with the lowest costs and return it. Heap must not be empty. */
+  int pop();
+
+  /* Change costs of an index which is already in the heap and resort */
+  void change(int index, float costs);
+
+  /* Lowest costs. Heap must not be empty. */
+  float topCosts() const
+  {
+    return heap.first().costs;
+  }
+
+  /* Costs of an index in the heap */
+  float costs(int index) const
+  {
+    return heap.at(positions.at(index)).costs;
+  }
+
+  bool contains(int index) const
+  {
+    return index < positions.size() && positions.at(index) != -1;
+  }
+
+  bool isEmpty() const
+  {
+    return heap.isEmpty();
+  }
+
+  int size() const
+  {
+    return heap.size();
+  }
+
+  /* Remove all entries but keep allocated memory */
+  void clear();
+
+private:
+  struct Entry
+  {
+    float costs;
+    int index;
+  };
+
+  void siftUp(int pos);
+  void siftDown(int pos);
+  void place(int pos, const Entry& entry);
+
+  QVector<Entry> heap;
+
+  /* Heap position for each index or -1 if not in heap */
+  QVector<int> positions;
+};
+
+#endif // LITTLENAVMAP_INDEXEDHEAP_H
@@ -0,0 +1,554 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "route/routebatch.h"
+
+#include "route/routefinder.h"
+#include "route/routenetworkairway.h"
+#include "route/routenetworkradio.h"
+#include "common/constants.h"
+#include "fs/db/databasemeta.h"
+#include "geo/calculations.h"
+#include "settings/settings.h"
+#include "sql/sqldatabase.h"
+#include "sql/sqlquery.h"
+#include "exception.h"
+#include "atools.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+#include <QScopedPointer>
+#include <QtConcurrent/QtConcurrentRun>
+
+#if defined(Q_OS_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using atools::sql::SqlDatabase;
+using atools::sql::SqlQuery;
+using atools::fs::pln::Flightplan;
+using atools::fs::pln::FlightplanEntry;
+using atools::geo::Pos;
+
+namespace pln = atools::fs::pln;
+
+/* Peak resident set size of the process in KiB or -1 if not available */
+static qint64 peakRssKb()
+{
+#if defined(Q_OS_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return static_cast<qint64>(counters.PeakWorkingSetSize / 1024);
+#else
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) == 0)
+#if defined(Q_OS_MACOS)
+    // Bytes on macOS
+    return static_cast<qint64>(usage.ru_maxrss / 1024);
+#else
+    // KiB on Linux
+    return static_cast<qint64>(usage.ru_maxrss);
+#endif
+#endif
+  return -1L;
+}
+
+RouteBatch::RouteBatch(const QString& databaseFilename)
+  : databaseFile(databaseFilename)
+{
+  atools::settings::Settings& settings = atools::settings::Settings::instance();
+  // Disable to measure routing using on demand SQL queries
+  preload = settings.getAndStoreValue(lnm::SETTINGS_ROUTENETWORK + "BatchPreload", true).toBool();
+  landmarks = settings.getAndStoreValue(lnm::SETTINGS_ROUTENETWORK + "Landmarks", false).toBool();
+  shortcuts = settings.getAndStoreValue(lnm::SETTINGS_ROUTENETWORK + "Shortcuts", false).toBool();
+}
+
+RouteBatch::~RouteBatch()
+{
+
+}
+
+bool RouteBatch::readPairs(const QString& filename)
+{
+  QFile file(filename);
+  if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+  {
+    errors.append(tr("Cannot open \"%1\": %2").arg(filename).arg(file.errorString()));
+    return false;
+  }
+
+  int lineNum = 0;
+  QTextStream stream(&file);
+  while(!stream.atEnd())
+  {
+    QString line = stream.readLine().trimmed();
+    lineNum++;
+
+    if(line.isEmpty() || line.startsWith("#"))
+      continue;
+
+    QStringList cols = line.split(",");
+    if(cols.size() < 4)
+    {
+      errors.append(tr("Line %1: Expected four columns").arg(lineNum));
+      continue;
+    }
+
+    Pair pair;
+    pair.departure = cols.at(0).trimmed().toUpper();
+    pair.destination = cols.at(1).trimmed().toUpper();
+
+    bool ok;
+    pair.altitude = cols.at(2).trimmed().toInt(&ok);
+    if(!ok)
+    {
+      errors.append(tr("Line %1: Invalid altitude \"%2\"").arg(lineNum).arg(cols.at(2)));
+      continue;
+    }
+
+    // Same network and flight plan types as used by the calculate actions of the route controller
+    QString network = cols.at(3).trimmed().toLower();
+    pair.network = network;
+    pair.useAltitude = false;
+    pair.airwayNetwork = true;
+    if(network == "radionav")
+    {
+      pair.mode = nw::ROUTE_RADIONAV;
+      pair.type = pln::VOR;
+      pair.airwayNetwork = false;
+    }
+    else if(network == "high")
+    {
+      pair.mode = nw::ROUTE_JET;
+      pair.type = pln::HIGH_ALTITUDE;
+    }
+    else if(network == "low")
+    {
+      pair.mode = nw::ROUTE_VICTOR;
+      pair.type = pln::LOW_ALTITUDE;
+    }
+    else if(network == "altitude")
+    {
+      pair.mode = nw::ROUTE_VICTOR | nw::ROUTE_JET;
+      pair.type = pair.altitude > 20000 ? pln::HIGH_ALTITUDE : pln::LOW_ALTITUDE;
+      pair.useAltitude = true;
+    }
+    else
+    {
+      errors.append(tr("Line %1: Invalid network \"%2\"").arg(lineNum).arg(cols.at(3)));
+      continue;
+    }
+
+    pairs.append(pair);
+  }
+  file.close();
+
+  qInfo() << Q_FUNC_INFO << "Read" << pairs.size() << "pairs from" << filename;
+  return errors.isEmpty();
+}
+
+bool RouteBatch::run(const QString& outputDirectory)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  // Load graphs and indexes once in this thread - these are shared read-only by all workers
+  bool loaded = false;
+  SqlDatabase::addDatabase("QSQLITE", "LNMDBROUTEBATCH");
+  {
+    SqlDatabase db("LNMDBROUTEBATCH");
+    try
+    {
+      db.setDatabaseName(databaseFile);
+      db.setReadonly();
+      db.open();
+
+      airacCycle = atools::fs::db::DatabaseMeta(&db).getAiracCycle();
+
+      RouteNetworkRadio radio(&db);
+      radio.setPreload(preload);
+      radio.setLandmarks(landmarks);
+      radio.loadGraph();
+      dataRadio = radio.getSharedData();
+
+      RouteNetworkAirway airway(&db);
+      airway.setPreload(preload);
+      airway.setLandmarks(landmarks);
+      airway.setShortcuts(shortcuts);
+      airway.loadGraph();
+      dataAirway = airway.getSharedData();
+      loaded = true;
+    }
+    catch(atools::Exception& e)
+    {
+      errors.append(tr("Error loading networks: %1").arg(e.what()));
+    }
+  }
+  // Remove connection also on errors - database has to be out of scope
+  SqlDatabase::removeDatabase("LNMDBROUTEBATCH");
+
+  if(!loaded)
+    return false;
+
+  qInfo() << Q_FUNC_INFO << "Networks loaded in" << timer.restart() << "ms"
+          << "peak RSS" << peakRssKb() << "KiB";
+
+  // Avoid detaching the vector while threads are writing results
+  pairData = pairs.data();
+  nextPair = 0;
+
+  // Single thread in benchmark mode to avoid measuring contention
+  int numThreads = benchmark ? 1 : std::max(QThread::idealThreadCount(), 1);
+  QVector<QFuture<void> > futures;
+  for(int i = 0; i < numThreads; i++)
+    futures.append(QtConcurrent::run(this, &RouteBatch::calculateThread, i));
+
+  for(QFuture<void>& future : futures)
+    future.waitForFinished();
+
+  // Workers stop on database errors - mark all pairs that were never calculated so each one has an error row
+  int numNotProcessed = 0;
+  for(Pair& pair : pairs)
+  {
+    if(!pair.processed)
+    {
+      if(pair.error.isEmpty())
+        pair.error = tr("Not calculated");
+      numNotProcessed++;
+    }
+  }
+
+  if(numNotProcessed > 0)
+    errors.append(tr("%1 of %2 pairs not calculated").arg(numNotProcessed).arg(pairs.size()));
+
+  qInfo() << Q_FUNC_INFO << pairs.size() << "pairs calculated in" << timer.elapsed() << "ms"
+          << "using" << numThreads << "threads" << "peak RSS" << peakRssKb() << "KiB";
+
+  writeResults(outputDirectory);
+  return errors.isEmpty();
+}
+
+/* Runs in background thread and calculates pairs until all are done */
+void RouteBatch::calculateThread(int threadNum)
+{
+  QString connectionName = QString("LNMDBROUTEBATCH%1").arg(threadNum);
+
+  // Pair currently calculated by this thread
+  int index = -1;
+
+  // Database connections cannot be shared between threads
+  SqlDatabase::addDatabase("QSQLITE", connectionName);
+  {
+    SqlDatabase db(connectionName);
+    try
+    {
+      db.setDatabaseName(databaseFile);
+      db.setReadonly();
+      db.open();
+
+      // Networks are created on demand - destroyed before the database is closed
+      QScopedPointer<RouteNetwork> radio, airway;
+
+      SqlQuery airportByIdent(&db), waypointById(&db), vorById(&db), ndbById(&db), airwayById(&db);
+      airportByIdent.prepare("select ident, name, mag_var, lonx, laty from airport where ident = :ident");
+      waypointById.prepare("select ident, region, mag_var, lonx, laty from waypoint where waypoint_id = :id");
+      vorById.prepare("select ident, region, name, mag_var, lonx, laty from vor where vor_id = :id");
+      ndbById.prepare("select ident, region, name, mag_var, lonx, laty from ndb where ndb_id = :id");
+      airwayById.prepare("select airway_name from airway where airway_id = :id");
+
+      ThreadQueries queries;
+      queries.airportByIdent = &airportByIdent;
+      queries.waypointById = &waypointById;
+      queries.vorById = &vorById;
+      queries.ndbById = &ndbById;
+      queries.airwayById = &airwayById;
+
+      while((index = nextPair++) < pairs.size())
+      {
+        Pair& pair = pairData[index];
+        QScopedPointer<RouteNetwork>& network = pair.airwayNetwork ? airway : radio;
+
+        // Benchmark uses a new network for each pair so on demand caches do not depend on the order of pairs
+        if(network.isNull() || benchmark)
+          network.reset(createNetwork(&db, pair.airwayNetwork));
+
+        calculatePair(pair, network.data(), queries);
+        pair.peakRssKb = peakRssKb();
+        pair.processed = true;
+      }
+      index = -1;
+    }
+    catch(atools::Exception& e)
+    {
+      qWarning() << Q_FUNC_INFO << "Thread" << threadNum << "failed" << e.what();
+      if(index >= 0 && index < pairs.size())
+      {
+        pairData[index].found = false;
+        pairData[index].error = tr("Calculation failed: %1").arg(e.what());
+      }
+    }
+    catch(...)
+    {
+      qWarning() << Q_FUNC_INFO << "Thread" << threadNum << "failed";
+      if(index >= 0 && index < pairs.size())
+      {
+        pairData[index].found = false;
+        pairData[index].error = tr("Calculation failed");
+      }
+    }
+  }
+  // Remove connection also on errors - database has to be out of scope
+  SqlDatabase::removeDatabase(connectionName);
+}
+
+/* Create a network using the preloaded data shared by all threads */
+RouteNetwork *RouteBatch::createNetwork(SqlDatabase *db, bool airwayNetwork) const
+{
+  RouteNetwork *network = nullptr;
+  if(airwayNetwork)
+    network = new RouteNetworkAirway(db);
+  else
+    network = new RouteNetworkRadio(db);
+
+  // Shared data has to be set last since changing the options drops loaded data
+  network->setPreload(preload);
+  network->setLandmarks(landmarks);
+  if(airwayNetwork)
+    network->setShortcuts(shortcuts);
+  network->setSharedData(airwayNetwork ? dataAirway : dataRadio);
+  return network;
+}
+
+void RouteBatch::calculatePair(Pair& pair, RouteNetwork *network, const ThreadQueries& queries)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  FlightplanEntry departure, destination;
+  if(!fetchAirport(queries.airportByIdent, pair.departure, departure))
+  {
+    pair.error = tr("Departure %1 not found").arg(pair.departure);
+    return;
+  }
+
+  if(!fetchAirport(queries.airportByIdent, pair.destination, destination))
+  {
+    pair.error = tr("Destination %1 not found").arg(pair.destination);
+    return;
+  }
+
+  network->setMode(pair.mode);
+
+  RouteFinder routeFinder(network);
+  routeFinder.setStrategy(landmarks ? rf::ASTAR_LANDMARKS : rf::ASTAR);
+
+  int numQueries = network->getNumberOfQueries();
+  QVector<rf::RouteEntry> calculatedRoute;
+  bool found = routeFinder.calculateRoute(departure.getPosition(), destination.getPosition(),
+                                          pair.useAltitude ? pair.altitude : 0);
+
+  pair.numExpandedNodes = routeFinder.getNumExpandedNodes();
+  pair.maxOpenNodes = routeFinder.getMaxOpenNodes();
+  pair.numQueries = network->getNumberOfQueries() - numQueries;
+  pair.numCacheNodes = network->getNumberOfNodesCache();
+
+  if(found)
+  {
+    routeFinder.extractRoute(calculatedRoute, pair.distanceMeter);
+
+    // Compare to direct connection and check if route is too long
+    pair.found = pair.distanceMeter / departure.getPosition().distanceMeterTo(destination.getPosition()) <
+                 MAX_DISTANCE_DIRECT_RATIO;
+  }
+
+  if(!pair.found)
+  {
+    pair.error = tr("No route found");
+    pair.timeMs = timer.elapsed();
+    return;
+  }
+
+  Flightplan& flightplan = pair.flightplan;
+  flightplan.setFlightplanType(pln::IFR);
+  flightplan.setRouteType(pair.type);
+  flightplan.setCruisingAltitude(pair.altitude);
+  flightplan.setDepartureIdent(departure.getIcaoIdent());
+  flightplan.setDepartureAiportName(departure.getName());
+  flightplan.setDeparturePosition(departure.getPosition());
+  flightplan.setDestinationIdent(destination.getIcaoIdent());
+  flightplan.setDestinationAiportName(destination.getName());
+  flightplan.setDestinationPosition(destination.getPosition());
+  flightplan.setTitle(pair.departure + " to " + pair.destination);
+  flightplan.setDescription(pair.departure + ", " + pair.destination);
+
+  // Build ATS route string like "EDDF DCT ABC UL123 DEF DCT LIRF" skipping waypoints along the same airway
+  QStringList routeString({pair.departure});
+  QString lastAirway;
+
+  flightplan.getEntries().append(departure);
+  for(const rf::RouteEntry& routeEntry : calculatedRoute)
+  {
+    SqlQuery *query = nullptr;
+    FlightplanEntry entry;
+    if(routeEntry.ref.type == map::WAYPOINT)
+    {
+      query = queries.waypointById;
+      entry.setWaypointType(pln::entry::INTERSECTION);
+    }
+    else if(routeEntry.ref.type == map::VOR)
+    {
+      query = queries.vorById;
+      entry.setWaypointType(pln::entry::VOR);
+    }
+    else if(routeEntry.ref.type == map::NDB)
+    {
+      query = queries.ndbById;
+      entry.setWaypointType(pln::entry::NDB);
+    }
+    else
+      continue;
+
+    query->bindValue(":id", routeEntry.ref.id);
+    query->exec();
+    if(query->next())
+    {
+      entry.setIcaoIdent(query->value("ident").toString());
+      entry.setIcaoRegion(query->value("region").toString());
+      entry.setWaypointId(entry.getIcaoIdent());
+      entry.setMagvar(query->value("mag_var").toFloat());
+      entry.setPosition(Pos(query->value("lonx").toFloat(), query->value("laty").toFloat()));
+      if(routeEntry.ref.type != map::WAYPOINT)
+        entry.setName(query->value("name").toString());
+    }
+    query->finish();
+
+    QString airwayName;
+    if(routeEntry.airwayId != -1)
+    {
+      queries.airwayById->bindValue(":id", routeEntry.airwayId);
+      queries.airwayById->exec();
+      if(queries.airwayById->next())
+        airwayName = queries.airwayById->value("airway_name").toString();
+      queries.airwayById->finish();
+      entry.setAirway(airwayName);
+    }
+    flightplan.getEntries().append(entry);
+
+    if(!airwayName.isEmpty() && airwayName == lastAirway)
+      // Still on the same airway - replace last waypoint
+      routeString.removeLast();
+    else
+      routeString.append(airwayName.isEmpty() ? "DCT" : airwayName);
+    routeString.append(entry.getIcaoIdent());
+    lastAirway = airwayName;
+  }
+  flightplan.getEntries().append(destination);
+  routeString << "DCT" << pair.destination;
+
+  pair.routeString = routeString.join(" ");
+  pair.timeMs = timer.elapsed();
+}
+
+bool RouteBatch::fetchAirport(SqlQuery *query, const QString& ident, FlightplanEntry& entry)
+{
+  bool found = false;
+  query->bindValue(":ident", ident);
+  query->exec();
+  if(query->next())
+  {
+    entry.setIcaoIdent(query->value("ident").toString());
+    entry.setName(query->value("name").toString());
+    entry.setMagvar(query->value("mag_var").toFloat());
+    entry.setPosition(Pos(query->value("lonx").toFloat(), query->value("laty").toFloat()));
+    entry.setWaypointType(pln::entry::AIRPORT);
+    entry.setWaypointId(entry.getIcaoIdent());
+    found = true;
+  }
+  query->finish();
+  return found;
+}
+
+void RouteBatch::writeResults(const QString& outputDirectory)
+{
+  QDir dir(outputDirectory);
+  if(!dir.exists() && !dir.mkpath("."))
+  {
+    errors.append(tr("Cannot create directory \"%1\"").arg(outputDirectory));
+    return;
+  }
+
+  QFile routeFile(dir.filePath("routes.txt")), summaryFile(dir.filePath("summary.csv"));
+  if(!routeFile.open(QIODevice::WriteOnly | QIODevice::Text) ||
+     !summaryFile.open(QIODevice::WriteOnly | QIODevice::Text))
+  {
+    errors.append(tr("Cannot write results into \"%1\"").arg(outputDirectory));
+    return;
+  }
+
+  QTextStream routeStream(&routeFile), summaryStream(&summaryFile);
+  summaryStream << "departure,destination,network,altitude,found,distance_nm,waypoints,time_ms,"
+                   "expanded_nodes,max_open_nodes,queries,cache_nodes,peak_rss_kb,file,error" << endl;
+
+  int numFound = 0, numFailed = 0;
+  qint64 totalMs = 0L;
+  for(int i = 0; i < pairs.size(); i++)
+  {
+    Pair& pair = pairs[i];
+    QString filename;
+
+    if(pair.found)
+    {
+      numFound++;
+      filename = QString("%1_%2_%3.pln").arg(i + 1, 4, 10, QChar('0')).arg(pair.departure).arg(pair.destination);
+      try
+      {
+        pair.flightplan.save(dir.filePath(filename), airacCycle, false /* clean */);
+      }
+      catch(atools::Exception& e)
+      {
+        pair.error = e.what();
+        filename.clear();
+      }
+
+      routeStream << pair.routeString << endl;
+    }
+    else
+    {
+      numFailed++;
+      routeStream << endl;
+    }
+
+    totalMs += pair.timeMs;
+    summaryStream << pair.departure << "," << pair.destination << "," << pair.network << "," << pair.altitude << ","
+                  << (pair.found ? 1 : 0) << ","
+                  << QString::number(atools::geo::meterToNm(pair.distanceMeter), 'f', 1) << ","
+                  << std::max(pair.flightplan.getEntries().size() - 2, 0) << ","
+                  << pair.timeMs << "," << pair.numExpandedNodes << "," << pair.maxOpenNodes << ","
+                  << pair.numQueries << "," << pair.numCacheNodes << "," << pair.peakRssKb << ","
+                  << filename << ",\"" << pair.error << "\"" << endl;
+  }
+
+  qInfo() << Q_FUNC_INFO << "Found" << numFound << "and failed" << numFailed << "of" << pairs.size() << "routes."
+          << "Sum of calculation times" << totalMs << "ms";
+}
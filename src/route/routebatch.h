@@ -0,0 +1,130 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_ROUTEBATCH_H
+#define LITTLENAVMAP_ROUTEBATCH_H
+
+#include "route/routenetwork.h"
+#include "fs/pln/flightplan.h"
+
+#include <QCoreApplication>
+
+#include <atomic>
+
+namespace atools {
+namespace sql {
+class SqlDatabase;
+class SqlQuery;
+}
+}
+
+/*
+ * Calculates flight plans for a list of departure and destination airports without user interface.
+ *
+ * Pairs are calculated in parallel on all cores. Each thread uses its own database connection and route
+ * networks which share the same preloaded graph, node grid, landmarks and shortcuts.
+ *
+ * The summary contains timing and search statistics for each pair and can be used to compare routing
+ * performance between versions when run with a fixed list of pairs like etc/routebatch_reference.csv.
+ * Benchmark mode calculates all pairs in one thread with new networks for each pair to get reproducible numbers.
+ */
+class RouteBatch
+{
+  Q_DECLARE_TR_FUNCTIONS(RouteBatch)
+
+public:
+  /* Database file is opened read-only once per thread */
+  RouteBatch(const QString& databaseFilename);
+  ~RouteBatch();
+
+  /* Read lines "departure,destination,altitude,network" where altitude is cruise altitude in feet and network is
+   * one of "radionav", "high", "low" or "altitude". Empty lines and lines starting with "#" are ignored.
+   * @return false if the file cannot be read or contains invalid lines */
+  bool readPairs(const QString& filename);
+
+  /* Calculate all pairs and write PLN files, a file with route strings and a summary report into the directory.
+   * @return false if any error occured */
+  bool run(const QString& outputDirectory);
+
+  /* Calculate pairs one after another using a new network instance for each pair. Preloaded data is still shared. */
+  void setBenchmark(bool value)
+  {
+    benchmark = value;
+  }
+
+  /* Messages for invalid lines or I/O errors */
+  const QStringList& getErrors() const
+  {
+    return errors;
+  }
+
+private:
+  /* Input and result for one line of the CSV file */
+  struct Pair
+  {
+    QString departure, destination, network;
+    int altitude;
+    nw::Modes mode;
+    atools::fs::pln::RouteType type;
+
+    /* Use airway network and altitude restrictions */
+    bool airwayNetwork, useAltitude;
+
+    /* Results. Processed is false if no worker finished the pair. */
+    bool processed = false, found = false;
+    QString error, routeString;
+    float distanceMeter = 0.f;
+    qint64 timeMs = 0L;
+
+    /* Peak resident set size of the process in KiB after calculating this pair or -1 if not available */
+    qint64 peakRssKb = -1L;
+
+    /* Search statistics */
+    int numExpandedNodes = 0, maxOpenNodes = 0, numQueries = 0, numCacheNodes = 0;
+    atools::fs::pln::Flightplan flightplan;
+  };
+
+  /* Per thread database queries */
+  struct ThreadQueries
+  {
+    atools::sql::SqlQuery *airportByIdent = nullptr, *waypointById = nullptr, *vorById = nullptr,
+                          *ndbById = nullptr, *airwayById = nullptr;
+  };
+
+  void calculateThread(int threadNum);
+  RouteNetwork *createNetwork(atools::sql::SqlDatabase *db, bool airwayNetwork) const;
+  void calculatePair(Pair& pair, RouteNetwork *network, const ThreadQueries& queries);
+  bool fetchAirport(atools::sql::SqlQuery *query, const QString& ident, atools::fs::pln::FlightplanEntry& entry);
+  void writeResults(const QString& outputDirectory);
+
+  /* Same limit as used in the route controller */
+  static Q_DECL_CONSTEXPR float MAX_DISTANCE_DIRECT_RATIO = 1.5f;
+
+  QString databaseFile, airacCycle;
+  QVector<Pair> pairs;
+  QStringList errors;
+
+  /* Preloaded data shared by all threads */
+  RouteNetwork::SharedData dataRadio, dataAirway;
+  bool preload = true, landmarks = false, shortcuts = false, benchmark = false;
+
+  /* Index of the next pair to calculate */
+  std::atomic_int nextPair {0};
+  Pair *pairData = nullptr;
+};
+
+#endif // LITTLENAVMAP_ROUTEBATCH_H
@@ -43,6 +43,7 @@
 #include "route/routenetworkairway.h"
 #include "route/routenetworkradio.h"
 #include "settings/settings.h"
+#include "sql/sqldatabase.h"
 #include "ui_mainwindow.h"
 #include "gui/dialog.h"
 #include "atools.h"
@@ -59,6 +60,9 @@
 #include <QStandardItemModel>
 #include <QInputDialog>
 #include <QFileInfo>
+#include <QProgressDialog>
+#include <QScopedPointer>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <marble/GeoDataLineString.h>
 
@@ -91,6 +95,7 @@ enum RouteColumns
 using atools::fs::pln::Flightplan;
 using atools::fs::pln::FlightplanEntry;
 using namespace atools::geo;
+using atools::sql::SqlDatabase;
 using Marble::GeoDataLatLonBox;
 using Marble::GeoDataLineString;
 using Marble::GeoDataCoordinates;
@@ -133,9 +138,33 @@ RouteController::RouteController(QMainWindow *parentWindow, QTableView *tableVie
 
   view->setContextMenuPolicy(Qt::CustomContextMenu);
 
-  // Create flight plan calculation caches
-  routeNetworkRadio = new RouteNetworkRadio(NavApp::getDatabaseNav());
-  routeNetworkAirway = new RouteNetworkAirway(NavApp::getDatabaseNav());
+  // Load whole networks into memory on first calculation to avoid SQL queries while routing.
+  // The loaded graph is kept between calculations while the on demand node cache is lost with each thread run.
+  routePreload = atools::settings::Settings::instance().
+                 getAndStoreValue(lnm::SETTINGS_ROUTENETWORK + "Preload", true).toBool();
+
+  // Use landmark heuristic for faster calculation of long routes - needs landmark table beside the database
+  routeLandmarks = atools::settings::Settings::instance().
+                   getAndStoreValue(lnm::SETTINGS_ROUTENETWORK + "Landmarks", false).toBool();
+
+  // Skip waypoints between airway junctions using a precalculated overlay stored beside the database
+  routeShortcuts = atools::settings::Settings::instance().
+                   getAndStoreValue(lnm::SETTINGS_ROUTENETWORK + "Shortcuts", false).toBool();
+
+  // Offer alternative routes after calculation if larger than one
+  routeNumAlternatives = atools::settings::Settings::instance().
+                         getAndStoreValue(lnm::SETTINGS_ROUTENETWORK + "Alternatives", 1).toInt();
+
+  // Check calculated flight plans for set altitude when changing cruise altitude
+  routeRecalcOnAltitude = atools::settings::Settings::instance().
+                          getAndStoreValue(lnm::SETTINGS_ROUTENETWORK + "RecalculateOnAltitudeChange", true).toBool();
+
+  // Route calculation runs in background - notification from thread when finished
+  connect(&routeCalcWatcher, &QFutureWatcher<RouteCalcResult>::finished,
+          this, &RouteController::calculateRouteThreadFinished);
+
+  routeCalcProgressTimer.setInterval(ROUTE_CALC_PROGRESS_INTERVAL_MS);
+  connect(&routeCalcProgressTimer, &QTimer::timeout, this, &RouteController::calculateRouteProgress);
 
   // Set up undo/redo framework
   undoStack = new QUndoStack(mainWindow);
@@ -228,12 +257,12 @@ RouteController::RouteController(QMainWindow *parentWindow, QTableView *tableVie
 
 RouteController::~RouteController()
 {
+  terminateRouteCalculation();
+  routeCalcProgressTimer.stop();
   routeAltDelayTimer.stop();
   delete entryBuilder;
   delete model;
   delete undoStack;
-  delete routeNetworkRadio;
-  delete routeNetworkAirway;
   delete zoomHandler;
   delete symbolPainter;
 }
@@ -362,6 +391,9 @@ void RouteController::routeAltChanged()
 {
   RouteCommand *undoCommand = nullptr;
 
+  // Plan is unchanged since the last calculation
+  bool calculated = lastRouteCalcValid && routeChangeCount == lastRouteCalcChangeCount;
+
   if(!route.isEmpty() /*&& route.getFlightplan().canSaveAltitude()*/)
     undoCommand = preChange(tr("Change Altitude"), rctype::ALTITUDE);
 
@@ -370,6 +402,10 @@ void RouteController::routeAltChanged()
 
   postChange(undoCommand);
 
+  if(calculated)
+    // Only the altitude differs from the calculated plan
+    lastRouteCalcChangeCount = routeChangeCount;
+
   NavApp::updateWindowTitle();
 
   routeAltDelayTimer.start(ROUTE_ALT_CHANGE_DELAY_MS);
@@ -382,6 +418,23 @@ void RouteController::routeAltChangedDelayed()
 {
   // Delay change to avoid hanging spin box when profile updates
   emit routeAltitudeChanged(route.getCruisingAltitudeFeet());
+
+  // Flight plan for set altitude was calculated and only the altitude was changed since
+  if(routeRecalcOnAltitude && !route.isEmpty() && lastRouteCalcValid && lastRouteCalcParams.useSetAltitude &&
+     !lastRouteCalcParams.calcRange && routeChangeCount == lastRouteCalcChangeCount && !routeCalcFuture.isRunning())
+  {
+    RouteCalcParams params = lastRouteCalcParams;
+    params.altitude = atools::roundToInt(Unit::rev(route.getFlightplan().getCruisingAltitude(), Unit::altFeetF));
+
+    if(canReuseRouteCalcResult(params))
+      // Search would give the same route which is already in the flight plan
+      qDebug() << Q_FUNC_INFO << "Calculated route valid for altitude" << params.altitude;
+    else
+    {
+      qDebug() << Q_FUNC_INFO << "Calculating route again for altitude" << params.altitude;
+      calculateSetAlt();
+    }
+  }
 }
 
 /* Combo box route type has value changed */
@@ -1122,17 +1175,9 @@ void RouteController::beforeRouteCalc()
 void RouteController::calculateRadionav(int fromIndex, int toIndex)
 {
   qDebug() << "calculateRadionav";
-  // Changing mode might need a clear
-  routeNetworkRadio->setMode(nw::ROUTE_RADIONAV);
-
-  RouteFinder routeFinder(routeNetworkRadio);
-
-  if(calculateRouteInternal(&routeFinder, atools::fs::pln::VOR, tr("Radionnav Flight Plan Calculation"),
-                            false /* fetch airways */, false /* Use altitude */,
-                            fromIndex, toIndex))
-    NavApp::setStatusMessage(tr("Calculated radio navaid flight plan."));
-  else
-    NavApp::setStatusMessage(tr("No route found."));
+  calculateRouteInternal(false /* airway network */, nw::ROUTE_RADIONAV, atools::fs::pln::VOR,
+                         tr("Radionnav Flight Plan Calculation"), tr("Calculated radio navaid flight plan."),
+                         false /* fetch airways */, false /* Use altitude */, fromIndex, toIndex);
 }
 
 void RouteController::calculateRadionav()
@@ -1143,17 +1188,10 @@ void RouteController::calculateRadionav()
 void RouteController::calculateHighAlt(int fromIndex, int toIndex)
 {
   qDebug() << "calculateHighAlt";
-  routeNetworkAirway->setMode(nw::ROUTE_JET);
-
-  RouteFinder routeFinder(routeNetworkAirway);
-
-  if(calculateRouteInternal(&routeFinder, atools::fs::pln::HIGH_ALTITUDE,
-                            tr("High altitude Flight Plan Calculation"),
-                            true /* fetch airways */, false /* Use altitude */,
-                            fromIndex, toIndex))
-    NavApp::setStatusMessage(tr("Calculated high altitude (Jet airways) flight plan."));
-  else
-    NavApp::setStatusMessage(tr("No route found."));
+  calculateRouteInternal(true /* airway network */, nw::ROUTE_JET, atools::fs::pln::HIGH_ALTITUDE,
+                         tr("High altitude Flight Plan Calculation"),
+                         tr("Calculated high altitude (Jet airways) flight plan."),
+                         true /* fetch airways */, false /* Use altitude */, fromIndex, toIndex);
 }
 
 void RouteController::calculateHighAlt()
@@ -1164,17 +1202,10 @@ void RouteController::calculateHighAlt()
 void RouteController::calculateLowAlt(int fromIndex, int toIndex)
 {
   qDebug() << "calculateLowAlt";
-  routeNetworkAirway->setMode(nw::ROUTE_VICTOR);
-
-  RouteFinder routeFinder(routeNetworkAirway);
-
-  if(calculateRouteInternal(&routeFinder, atools::fs::pln::LOW_ALTITUDE,
-                            tr("Low altitude Flight Plan Calculation"),
-                            true /* fetch airways */, false /* Use altitude */,
-                            fromIndex, toIndex))
-    NavApp::setStatusMessage(tr("Calculated low altitude (Victor airways) flight plan."));
-  else
-    NavApp::setStatusMessage(tr("No route found."));
+  calculateRouteInternal(true /* airway network */, nw::ROUTE_VICTOR, atools::fs::pln::LOW_ALTITUDE,
+                         tr("Low altitude Flight Plan Calculation"),
+                         tr("Calculated low altitude (Victor airways) flight plan."),
+                         true /* fetch airways */, false /* Use altitude */, fromIndex, toIndex);
 }
 
 void RouteController::calculateLowAlt()
@@ -1185,9 +1216,6 @@ void RouteController::calculateLowAlt()
 void RouteController::calculateSetAlt(int fromIndex, int toIndex)
 {
   qDebug() << "calculateSetAlt";
-  routeNetworkAirway->setMode(nw::ROUTE_VICTOR | nw::ROUTE_JET);
-
-  RouteFinder routeFinder(routeNetworkAirway);
 
   // Just decide by given altiude if this is a high or low plan
   atools::fs::pln::RouteType type;
@@ -1196,12 +1224,9 @@ void RouteController::calculateSetAlt(int fromIndex, int toIndex)
   else
     type = atools::fs::pln::LOW_ALTITUDE;
 
-  if(calculateRouteInternal(&routeFinder, type, tr("Low altitude flight plan"),
-                            true /* fetch airways */, true /* Use altitude */,
-                            fromIndex, toIndex))
-    NavApp::setStatusMessage(tr("Calculated high/low flight plan for given altitude."));
-  else
-    NavApp::setStatusMessage(tr("No route found."));
+  calculateRouteInternal(true /* airway network */, nw::ROUTE_VICTOR | nw::ROUTE_JET, type,
+                         tr("Low altitude flight plan"), tr("Calculated high/low flight plan for given altitude."),
+                         true /* fetch airways */, true /* Use altitude */, fromIndex, toIndex);
 }
 
 void RouteController::calculateSetAlt()
@@ -1209,133 +1234,471 @@ void RouteController::calculateSetAlt()
   calculateSetAlt(-1, -1);
 }
 
-/* Calculate a flight plan to all types */
-bool RouteController::calculateRouteInternal(RouteFinder *routeFinder, atools::fs::pln::RouteType type,
-                                             const QString& commandName, bool fetchAirways,
-                                             bool useSetAltitude, int fromIndex, int toIndex)
+/* Start calculation of a flight plan to all types in a background thread.
+ * Flight plan is changed in calculateRouteThreadFinished. */
+void RouteController::calculateRouteInternal(bool airwayNetwork, nw::Modes mode, atools::fs::pln::RouteType type,
+                                             const QString& commandName, const QString& successMessage,
+                                             bool fetchAirways, bool useSetAltitude, int fromIndex, int toIndex)
 {
-  bool calcRange = fromIndex != -1 && toIndex != -1;
-
-  // Create wait cursor if calculation takes too long
-  QGuiApplication::setOverrideCursor(Qt::WaitCursor);
+  if(routeCalcFuture.isRunning())
+  {
+    // Cancel the running calculation and start this one when it is finished - only the latest request is kept
+    qDebug() << Q_FUNC_INFO << "Route calculation already running - restarting";
+    pendingRouteCalc = [ = ]() -> void
+                       {
+                         calculateRouteInternal(airwayNetwork, mode, type, commandName, successMessage,
+                                                fetchAirways, useSetAltitude, fromIndex, toIndex);
+                       };
+    routeCalcCancel = true;
+    NavApp::setStatusMessage(tr("Restarting flight plan calculation."));
+    return;
+  }
 
   // Stop any background tasks
   beforeRouteCalc();
 
-  Flightplan& flightplan = route.getFlightplan();
-
-  int cruiseFt = atools::roundToInt(Unit::rev(flightplan.getCruisingAltitude(), Unit::altFeetF));
-  int altitude = useSetAltitude ? cruiseFt : 0;
+  RouteCalcParams params;
+  params.airwayNetwork = airwayNetwork;
+  params.mode = mode;
+  params.type = type;
+  params.commandName = commandName;
+  params.successMessage = successMessage;
+  params.fetchAirways = fetchAirways;
+  params.useSetAltitude = useSetAltitude;
+  params.calcRange = fromIndex != -1 && toIndex != -1;
 
-  routeFinder->setPreferVorToAirway(OptionData::instance().getFlags() & opts::ROUTE_PREFER_VOR);
-  routeFinder->setPreferNdbToAirway(OptionData::instance().getFlags() & opts::ROUTE_PREFER_NDB);
+  int cruiseFt = atools::roundToInt(Unit::rev(route.getFlightplan().getCruisingAltitude(), Unit::altFeetF));
+  params.altitude = useSetAltitude ? cruiseFt : 0;
 
-  Pos departurePos, destinationPos;
+  params.preferVor = OptionData::instance().getFlags() & opts::ROUTE_PREFER_VOR;
+  params.preferNdb = OptionData::instance().getFlags() & opts::ROUTE_PREFER_NDB;
 
-  if(calcRange)
+  if(params.calcRange)
   {
-    fromIndex = std::max(route.getStartIndexAfterProcedure(), fromIndex);
-    toIndex = std::min(route.getDestinationIndexBeforeProcedure(), toIndex);
+    params.fromIndex = std::max(route.getStartIndexAfterProcedure(), fromIndex);
+    params.toIndex = std::min(route.getDestinationIndexBeforeProcedure(), toIndex);
 
-    departurePos = route.at(fromIndex).getPosition();
-    destinationPos = route.at(toIndex).getPosition();
+    params.departurePos = route.at(params.fromIndex).getPosition();
+    params.destinationPos = route.at(params.toIndex).getPosition();
   }
   else
   {
-    departurePos = route.getStartAfterProcedure().getPosition();
-    destinationPos = route.getDestinationBeforeProcedure().getPosition();
+    params.fromIndex = params.toIndex = -1;
+    params.departurePos = route.getStartAfterProcedure().getPosition();
+    params.destinationPos = route.getDestinationBeforeProcedure().getPosition();
   }
 
-  // Calculate the route
-  bool found = routeFinder->calculateRoute(departurePos, destinationPos, altitude);
+  params.numAlternatives = routeNumAlternatives;
+  params.databaseFile = NavApp::getDatabaseNav()->databaseName();
+  params.databaseGeneration = routeCalcDatabaseGeneration;
+  params.networkData = airwayNetwork ? routeDataAirway : routeDataRadio;
+  params.routeChangeCount = routeChangeCount;
 
-  if(found)
+  if(canReuseRouteCalcResult(params))
   {
-    // A route was found
-    float distance = 0.f;
-    QVector<rf::RouteEntry> calculatedRoute;
+    // Search would expand the same nodes and edges with the new altitude - skip the thread
+    qDebug() << Q_FUNC_INFO << "Reusing last calculation for altitude" << params.altitude
+             << "valid range" << lastRouteCalcResult.validAltMin << lastRouteCalcResult.validAltMax;
+    applyRouteCalcResult(params, lastRouteCalcResult);
+    return;
+  }
 
-    // Fetch waypoints
-    routeFinder->extractRoute(calculatedRoute, distance);
+  routeCalcParams = params;
+  routeCalcCancel = false;
+  routeCalcNumExpanded = 0;
+  routeCalcNumOpen = 0;
 
-    // Compare to direct connection and check if route is too long
-    float directDistance = departurePos.distanceMeterTo(destinationPos);
-    float ratio = distance / directDistance;
-    qDebug() << "route distance" << QString::number(distance, 'f', 0)
-             << "direct distance" << QString::number(directDistance, 'f', 0) << "ratio" << ratio;
+  // Window modal progress dialog blocks flight plan changes but keeps map and simulator updates running
+  routeCalcProgress = new QProgressDialog(mainWindow);
+  routeCalcProgress->setWindowModality(Qt::WindowModal);
+  routeCalcProgress->setWindowTitle(QApplication::applicationName() + tr(" - Flight Plan Calculation"));
+  routeCalcProgress->setLabelText(tr("Calculating flight plan ..."));
+  routeCalcProgress->setRange(0, 0);
+  routeCalcProgress->setAutoClose(false);
+  routeCalcProgress->setAutoReset(false);
+  connect(routeCalcProgress, &QProgressDialog::canceled, this, &RouteController::cancelRouteCalculation);
 
-    if(ratio < MAX_DISTANCE_DIRECT_RATIO)
-    {
-      // Start undo
-      RouteCommand *undoCommand = preChange(commandName);
+  // Show dialog only if calculation takes longer
+  routeCalcTimer.start();
+  routeCalcProgressTimer.start();
+
+  routeCalcFuture = QtConcurrent::run(this, &RouteController::calculateRouteThread, params);
 
-      QList<FlightplanEntry>& entries = flightplan.getEntries();
+  // Watcher will call calculateRouteThreadFinished when finished
+  routeCalcWatcher.setFuture(routeCalcFuture);
+}
+
+/* Runs in background thread. Uses an own database connection and network instance. */
+RouteController::RouteCalcResult RouteController::calculateRouteThread(RouteCalcParams params)
+{
+  RouteCalcResult result;
+  result.validAltMin = result.validAltMax = params.altitude;
 
-      flightplan.setRouteType(type);
-      if(calcRange)
-        entries.erase(flightplan.getEntries().begin() + fromIndex + 1, flightplan.getEntries().begin() + toIndex);
+  // Database connections cannot be shared between threads
+  SqlDatabase::addDatabase("QSQLITE", ROUTE_CALC_DATABASE_NAME);
+  {
+    QScopedPointer<SqlDatabase> db(new SqlDatabase(ROUTE_CALC_DATABASE_NAME));
+    QScopedPointer<RouteNetwork> network;
+
+    try
+    {
+      db->setDatabaseName(params.databaseFile);
+      db->setReadonly();
+      db->open();
+
+      if(params.airwayNetwork)
+        network.reset(new RouteNetworkAirway(db.data()));
       else
-        // Erase all but start and destination
-        entries.erase(flightplan.getEntries().begin() + 1, entries.end() - 1);
+        network.reset(new RouteNetworkRadio(db.data()));
+
+      // Preload first since landmarks and shortcuts need the graph - shared data last since the setters drop it
+      network->setPreload(routePreload);
+      network->setLandmarks(routeLandmarks);
+      if(params.airwayNetwork)
+        network->setShortcuts(routeShortcuts);
+      network->setSharedData(params.networkData);
+      network->setMode(params.mode);
+
+      // Allow to stop loading of graph, landmarks and shortcuts
+      network->setCancelCallback([this]() -> bool
+      {
+        return routeCalcCancel;
+      });
+
+      RouteFinder routeFinder(network.data());
+      routeFinder.setPreferVorToAirway(params.preferVor);
+      routeFinder.setPreferNdbToAirway(params.preferNdb);
+      routeFinder.setStrategy(routeLandmarks ? rf::ASTAR_LANDMARKS : rf::ASTAR);
+      routeFinder.setProgressCallback([this](int numExpanded, int numOpen) -> bool
+      {
+        routeCalcNumExpanded = numExpanded;
+        routeCalcNumOpen = numOpen;
+        return !routeCalcCancel;
+      });
 
-      int idx = 1;
-      // Create flight plan entries - will be copied later to the route map objects
-      for(const rf::RouteEntry& routeEntry : calculatedRoute)
+      // Calculate the route and fetch waypoints
+      if(params.numAlternatives > 1)
       {
-        FlightplanEntry flightplanEntry;
-        entryBuilder->buildFlightplanEntry(routeEntry.ref.id, atools::geo::EMPTY_POS, routeEntry.ref.type,
-                                           flightplanEntry, fetchAirways);
-        if(fetchAirways && routeEntry.airwayId != -1)
-          // Get airway by id - needed to fetch the name first
-          updateFlightplanEntryAirway(routeEntry.airwayId, flightplanEntry);
-
-        if(calcRange)
-          entries.insert(flightplan.getEntries().begin() + fromIndex + idx, flightplanEntry);
-        else
-          entries.insert(entries.end() - 1, flightplanEntry);
-        idx++;
+        int num = routeFinder.calculateAlternatives(params.departurePos, params.destinationPos, params.altitude,
+                                                    params.numAlternatives);
+        result.routes.resize(num);
+        result.distances.resize(num);
+        for(int i = 0; i < num; i++)
+          routeFinder.extractAlternative(i, result.routes[i], result.distances[i]);
+      }
+      else if(routeFinder.calculateRoute(params.departurePos, params.destinationPos, params.altitude))
+      {
+        result.routes.resize(1);
+        result.distances.resize(1);
+        routeFinder.extractRoute(result.routes[0], result.distances[0]);
       }
 
-      // Remove procedure points from flight plan
-      flightplan.removeNoSaveEntries();
+      result.validAltMin = routeFinder.getValidAltitudeMin();
+      result.validAltMax = routeFinder.getValidAltitudeMax();
+    }
+    catch(atools::Exception& e)
+    {
+      result.routes.clear();
+      result.error = e.what();
+    }
+    catch(...)
+    {
+      result.routes.clear();
+      result.error = tr("Unknown exception");
+    }
+
+    // Pass loaded graph and indexes back for the next calculation - also if the search failed
+    if(!network.isNull())
+      result.networkData = network->getSharedData();
+
+    // Network queries have to be finished before closing the database
+    network.reset();
+    if(db->isOpen())
+      db->close();
+  }
+  // Always remove connection - otherwise the next calculation fails to add it
+  SqlDatabase::removeDatabase(ROUTE_CALC_DATABASE_NAME);
+
+  return result;
+}
+
+/* Called by watcher when the thread is finished */
+void RouteController::calculateRouteThreadFinished()
+{
+  routeCalcProgressTimer.stop();
+  if(routeCalcProgress != nullptr)
+  {
+    routeCalcProgress->deleteLater();
+    routeCalcProgress = nullptr;
+  }
 
-      // Copy flight plan to route object
-      createRouteLegsFromFlightplan();
+  const RouteCalcParams& params = routeCalcParams;
+  RouteCalcResult result = routeCalcFuture.result();
 
-      // Reload procedures from properties
-      loadProceduresFromFlightplan(true /* quiet */);
-      QGuiApplication::restoreOverrideCursor();
+  if(pendingRouteCalc)
+  {
+    // A newer request cancelled this calculation - keep loaded network data and start the new one
+    if(params.databaseGeneration == routeCalcDatabaseGeneration)
+    {
+      if(params.airwayNetwork)
+        routeDataAirway = result.networkData;
+      else
+        routeDataRadio = result.networkData;
+    }
+
+    std::function<void()> pending = pendingRouteCalc;
+    pendingRouteCalc = nullptr;
+    pending();
+    return;
+  }
 
-      // Remove duplicates in flight plan and route
-      route.removeDuplicateRouteLegs();
-      route.updateAll();
-      updateAirwaysAndAltitude(!useSetAltitude /* adjustRouteAltitude */);
+  if(params.databaseGeneration != routeCalcDatabaseGeneration)
+  {
+    // Database was changed while calculating - ignore result
+    qDebug() << Q_FUNC_INFO << "Database changed during route calculation";
+    return;
+  }
 
-      route.updateActiveLegAndPos(true /* force update */);
-      updateTableModel();
+  if(params.routeChangeCount != routeChangeCount)
+  {
+    // Flight plan was edited, undone or replaced while calculating - indexes do not match anymore
+    qDebug() << Q_FUNC_INFO << "Flight plan changed during route calculation";
+    NavApp::setStatusMessage(tr("Flight plan changed during calculation. Result ignored."));
+    return;
+  }
 
-      postChange(undoCommand);
-      NavApp::updateWindowTitle();
+  // Keep loaded network data even if cancelled
+  if(params.airwayNetwork)
+    routeDataAirway = result.networkData;
+  else
+    routeDataRadio = result.networkData;
 
-#ifdef DEBUG_INFORMATION
-      qDebug() << flightplan;
-#endif
+  if(!result.error.isEmpty())
+  {
+    qWarning() << Q_FUNC_INFO << "Error calculating route" << result.error;
+    NavApp::setStatusMessage(tr("Error calculating flight plan."));
+    return;
+  }
+
+  if(routeCalcCancel)
+  {
+    NavApp::setStatusMessage(tr("Flight plan calculation cancelled."));
+    return;
+  }
+
+  lastRouteCalcParams = params;
+  lastRouteCalcResult = result;
+  lastRouteCalcValid = true;
+
+  applyRouteCalcResult(params, result);
+}
+
+/* Check if the last calculation can be used for the given parameters. This is the case if the endpoints and options
+ * are the same and the new altitude does not change feasibility of any edge the last search looked at. */
+bool RouteController::canReuseRouteCalcResult(const RouteCalcParams& params) const
+{
+  const RouteCalcParams& last = lastRouteCalcParams;
+  return lastRouteCalcValid &&
+         last.databaseGeneration == params.databaseGeneration &&
+         last.airwayNetwork == params.airwayNetwork &&
+         last.mode == params.mode &&
+         last.useSetAltitude == params.useSetAltitude &&
+         last.preferVor == params.preferVor &&
+         last.preferNdb == params.preferNdb &&
+         last.numAlternatives == params.numAlternatives &&
+         last.departurePos == params.departurePos &&
+         last.destinationPos == params.destinationPos &&
+         params.altitude >= lastRouteCalcResult.validAltMin &&
+         params.altitude <= lastRouteCalcResult.validAltMax;
+}
+
+/* Let the user select from the routes of a calculation result and change the flight plan */
+void RouteController::applyRouteCalcResult(const RouteCalcParams& params, const RouteCalcResult& result)
+{
+  // Compare to direct connection and drop all routes which are too long
+  float directDistance = params.departurePos.distanceMeterTo(params.destinationPos);
+  QVector<int> candidates;
+  for(int i = 0; i < result.routes.size(); i++)
+  {
+    float ratio = result.distances.at(i) / directDistance;
+    qDebug() << "route" << i << "distance" << QString::number(result.distances.at(i), 'f', 0)
+             << "direct distance" << QString::number(directDistance, 'f', 0) << "ratio" << ratio;
 
-      emit routeChanged(true);
+    if(ratio < MAX_DISTANCE_DIRECT_RATIO)
+      candidates.append(i);
+  }
+
+  int selected = candidates.isEmpty() ? -1 : candidates.first();
+  if(candidates.size() > 1)
+  {
+    selected = selectRouteAlternative(params, result, candidates);
+    if(selected == -1)
+    {
+      NavApp::setStatusMessage(tr("Flight plan calculation cancelled."));
+      return;
     }
+  }
+
+  if(params.calcRange && (params.fromIndex >= route.size() || params.toIndex >= route.size()))
+  {
+    qWarning() << Q_FUNC_INFO << "Invalid range" << params.fromIndex << params.toIndex << "route size" << route.size();
+    return;
+  }
+
+  bool found = false;
+  if(selected != -1)
+  {
+    // A route was found
+    Flightplan& flightplan = route.getFlightplan();
+    const QVector<rf::RouteEntry>& calculatedRoute = result.routes.at(selected);
+
+    // Start undo
+    RouteCommand *undoCommand = preChange(params.commandName);
+
+    QList<FlightplanEntry>& entries = flightplan.getEntries();
+
+    flightplan.setRouteType(params.type);
+    if(params.calcRange)
+      entries.erase(flightplan.getEntries().begin() + params.fromIndex + 1,
+                    flightplan.getEntries().begin() + params.toIndex);
     else
-      // Too long
-      found = false;
+      // Erase all but start and destination
+      entries.erase(flightplan.getEntries().begin() + 1, entries.end() - 1);
+
+    int idx = 1;
+    // Create flight plan entries - will be copied later to the route map objects
+    for(const rf::RouteEntry& routeEntry : calculatedRoute)
+    {
+      FlightplanEntry flightplanEntry;
+      entryBuilder->buildFlightplanEntry(routeEntry.ref.id, atools::geo::EMPTY_POS, routeEntry.ref.type,
+                                         flightplanEntry, params.fetchAirways);
+      if(params.fetchAirways && routeEntry.airwayId != -1)
+        // Get airway by id - needed to fetch the name first
+        updateFlightplanEntryAirway(routeEntry.airwayId, flightplanEntry);
+
+      if(params.calcRange)
+        entries.insert(flightplan.getEntries().begin() + params.fromIndex + idx, flightplanEntry);
+      else
+        entries.insert(entries.end() - 1, flightplanEntry);
+      idx++;
+    }
+
+    // Remove procedure points from flight plan
+    flightplan.removeNoSaveEntries();
+
+    // Copy flight plan to route object
+    createRouteLegsFromFlightplan();
+
+    // Reload procedures from properties
+    loadProceduresFromFlightplan(true /* quiet */);
+
+    // Remove duplicates in flight plan and route
+    route.removeDuplicateRouteLegs();
+    route.updateAll();
+    updateAirwaysAndAltitude(!params.useSetAltitude /* adjustRouteAltitude */);
+
+    route.updateActiveLegAndPos(true /* force update */);
+    updateTableModel();
+
+    postChange(undoCommand);
+    NavApp::updateWindowTitle();
+    lastRouteCalcChangeCount = routeChangeCount;
+
+#ifdef DEBUG_INFORMATION
+    qDebug() << flightplan;
+#endif
+
+    emit routeChanged(true);
+    found = true;
   }
 
-  QGuiApplication::restoreOverrideCursor();
-  if(!found)
+  if(found)
+    NavApp::setStatusMessage(params.successMessage);
+  else
+  {
+    NavApp::setStatusMessage(tr("No route found."));
     atools::gui::Dialog(mainWindow).showInfoMsgBox(lnm::ACTIONS_SHOWROUTE_ERROR,
                                                    tr("Cannot find a route.\n"
                                                       "Try another routing type or create the flight plan manually."),
                                                    tr("Do not &show this dialog again."));
+  }
+}
+
+/* Let the user choose one of the calculated routes while showing all as overlay on the map.
+ * Returns index into result or -1 if cancelled */
+int RouteController::selectRouteAlternative(const RouteCalcParams& params, const RouteCalcResult& result,
+                                            const QVector<int>& candidates)
+{
+  QVector<atools::geo::LineString> lines;
+  QStringList items;
+  for(int i = 0; i < candidates.size(); i++)
+  {
+    const QVector<rf::RouteEntry>& entries = result.routes.at(candidates.at(i));
+
+    atools::geo::LineString line;
+    line.append(params.departurePos);
+    for(const rf::RouteEntry& entry : entries)
+      line.append(entry.pos);
+    line.append(params.destinationPos);
+    lines.append(line);
+
+    items.append(tr("%1: %2, %3 waypoints").
+                 arg(i + 1).arg(Unit::distMeter(result.distances.at(candidates.at(i)))).arg(entries.size()));
+  }
 
-  return found;
+  MapWidget *mapWidget = NavApp::getMapWidget();
+  mapWidget->changeRouteAlternatives(lines, 0);
+
+  QInputDialog dialog(mainWindow);
+  dialog.setWindowTitle(QApplication::applicationName() + tr(" - Flight Plan Calculation"));
+  dialog.setLabelText(tr("Select flight plan:"));
+  dialog.setComboBoxItems(items);
+  dialog.setComboBoxEditable(false);
+
+  // Highlight alternative on the map while browsing through the list
+  connect(&dialog, &QInputDialog::textValueChanged, [mapWidget, &lines, &items](const QString& text) -> void
+  {
+    mapWidget->changeRouteAlternatives(lines, items.indexOf(text));
+  });
+
+  int selected = -1;
+  if(dialog.exec() == QDialog::Accepted)
+    selected = candidates.at(items.indexOf(dialog.textValue()));
+
+  mapWidget->changeRouteAlternatives(QVector<atools::geo::LineString>(), -1);
+  return selected;
+}
+
+/* Called by timer while the calculation is running */
+void RouteController::calculateRouteProgress()
+{
+  if(routeCalcProgress == nullptr || routeCalcCancel)
+    return;
+
+  if(!routeCalcProgress->isVisible() && routeCalcTimer.elapsed() > ROUTE_CALC_PROGRESS_DELAY_MS)
+    routeCalcProgress->show();
+
+  routeCalcProgress->setLabelText(tr("Calculating flight plan ...\n"
+                                     "Nodes expanded: %L1, open nodes: %L2").
+                                  arg(routeCalcNumExpanded.load()).arg(routeCalcNumOpen.load()));
+}
+
+/* Stop calculation. Result is discarded in calculateRouteThreadFinished. */
+void RouteController::cancelRouteCalculation()
+{
+  routeCalcCancel = true;
+  pendingRouteCalc = nullptr;
+}
+
+/* Cancel calculation and wait until thread is finished */
+void RouteController::terminateRouteCalculation()
+{
+  pendingRouteCalc = nullptr;
+  if(routeCalcFuture.isRunning())
+  {
+    routeCalcCancel = true;
+    routeCalcFuture.waitForFinished();
+  }
 }
 
 void RouteController::adjustFlightplanAltitude()
@@ -1527,16 +1890,20 @@ bool RouteController::hasValidParking() const
 
 void RouteController::preDatabaseLoad()
 {
-  routeNetworkRadio->deInitQueries();
-  routeNetworkAirway->deInitQueries();
+  terminateRouteCalculation();
+
+  // Drop all network data and ignore results of any calculation that was running
+  routeCalcDatabaseGeneration++;
+  routeDataRadio = RouteNetwork::SharedData();
+  routeDataAirway = RouteNetwork::SharedData();
+  lastRouteCalcValid = false;
+  lastRouteCalcParams = RouteCalcParams();
+  lastRouteCalcResult = RouteCalcResult();
   routeAltDelayTimer.stop();
 }
 
 void RouteController::postDatabaseLoad()
 {
-  routeNetworkRadio->initQueries();
-  routeNetworkAirway->initQueries();
-
   // Remove the legs but keep the properties
   route.clearProcedureLegs(proc::PROCEDURE_ALL);
 
@@ -1997,6 +2364,7 @@ void RouteController::undoMerge()
 void RouteController::changeRouteUndoRedo(const atools::fs::pln::Flightplan& newFlightplan)
 {
   route.setFlightplan(newFlightplan);
+  routeChangeCount++;
 
   createRouteLegsFromFlightplan();
   loadProceduresFromFlightplan(true /* quiet */);
@@ -3059,14 +3427,14 @@ void RouteController::disconnectedFromSimulator()
   emit routeChanged(false);
 }
 
-void RouteController::simDataChanged(const atools::fs::sc::SimConnectData& simulatorData)
+void RouteController::simDataChanged(const SimConnectDataPtr& simulatorData)
 {
   if(atools::almostNotEqual(QDateTime::currentDateTime().toMSecsSinceEpoch(),
                             lastSimUpdate, static_cast<qint64>(MIN_SIM_UPDATE_TIME_MS)))
   {
-    if(simulatorData.isUserAircraftValid())
+    if(simulatorData->isUserAircraftValid())
     {
-      const atools::fs::sc::SimConnectUserAircraft& aircraft = simulatorData.getUserAircraft();
+      const atools::fs::sc::SimConnectUserAircraft& aircraft = simulatorData->getUserAircraft();
 
       // Sequence only for airborne airplanes
       if(!aircraft.isOnGround())
@@ -3378,6 +3746,7 @@ void RouteController::clearRoute()
   undoStack->clear();
   undoIndex = 0;
   undoIndexClean = 0;
+  routeChangeCount++;
   entryBuilder->setCurUserpointNumber(1);
   updateFlightplanFromWidgets();
 }
@@ -3407,6 +3776,7 @@ void RouteController::postChange(RouteCommand *undoCommand)
 
   // Index and clean index workaround
   undoIndex++;
+  routeChangeCount++;
   qDebug() << "postChange undoIndex" << undoIndex << "undoIndexClean" << undoIndexClean;
   undoStack->push(undoCommand);
 }
@@ -20,11 +20,18 @@
 
 #include "route/routecommand.h"
 #include "route/route.h"
+#include "route/routefinder.h"
 #include "fs/pln/flightplanconstants.h"
+#include "connect/simconnectdataptr.h"
 
 #include <QIcon>
 #include <QObject>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+
+#include <atomic>
+#include <functional>
 
 namespace atools {
 namespace gui {
@@ -32,10 +39,6 @@ class ItemViewZoomHandler;
 }
 
 namespace fs {
-
-namespace sc {
-class SimConnectData;
-}
 namespace pln {
 class Flightplan;
 class FlightplanEntry;
@@ -47,8 +50,7 @@ class QMainWindow;
 class QTableView;
 class QStandardItemModel;
 class QItemSelection;
-class RouteNetwork;
-class RouteFinder;
+class QProgressDialog;
 class FlightplanEntryBuilder;
 class SymbolPainter;
 class RouteViewEventFilter;
@@ -220,7 +222,7 @@ public:
 
   void disconnectedFromSimulator();
 
-  void simDataChanged(const atools::fs::sc::SimConnectData& simulatorData);
+  void simDataChanged(const SimConnectDataPtr& simulatorData);
 
   void editUserWaypointName(int index);
 
@@ -319,9 +321,59 @@ private:
 
   int adjustAltitude(int minAltitude);
 
-  bool calculateRouteInternal(RouteFinder *routeFinder, atools::fs::pln::RouteType type,
-                              const QString& commandName,
+  /* Parameters for a route calculation in the background thread. Filled in the GUI thread. */
+  struct RouteCalcParams
+  {
+    /* Use airway network if true. Radio navaid network otherwise. */
+    bool airwayNetwork;
+    nw::Modes mode;
+    atools::fs::pln::RouteType type;
+    QString commandName, successMessage;
+    bool fetchAirways, useSetAltitude, calcRange, preferVor, preferNdb;
+    int fromIndex, toIndex, altitude;
+    atools::geo::Pos departurePos, destinationPos;
+
+    /* Calculate alternatives if larger than one */
+    int numAlternatives;
+
+    /* Navdata database file opened read-only by the thread */
+    QString databaseFile;
+    int databaseGeneration;
+    RouteNetwork::SharedData networkData;
+
+    /* Value of routeChangeCount when the calculation was started */
+    int routeChangeCount;
+  };
+
+  /* Result of the background thread */
+  struct RouteCalcResult
+  {
+    /* Best route first followed by alternatives if requested. Empty if nothing found. */
+    QVector<QVector<rf::RouteEntry> > routes;
+    QVector<float> distances;
+
+    /* Exception message if not empty */
+    QString error;
+
+    /* Loaded graph and indexes to be reused by the next calculation */
+    RouteNetwork::SharedData networkData;
+
+    /* Altitude range in feet where the calculation gives the same result. See RouteFinder::getValidAltitudeMin */
+    int validAltMin, validAltMax;
+  };
+
+  void calculateRouteInternal(bool airwayNetwork, nw::Modes mode, atools::fs::pln::RouteType type,
+                              const QString& commandName, const QString& successMessage,
                               bool fetchAirways, bool useSetAltitude, int fromIndex, int toIndex);
+  RouteCalcResult calculateRouteThread(RouteCalcParams params);
+  void calculateRouteThreadFinished();
+  void applyRouteCalcResult(const RouteCalcParams& params, const RouteCalcResult& result);
+  bool canReuseRouteCalcResult(const RouteCalcParams& params) const;
+  void calculateRouteProgress();
+  void cancelRouteCalculation();
+  void terminateRouteCalculation();
+  int selectRouteAlternative(const RouteCalcParams& params, const RouteCalcResult& result,
+                             const QVector<int>& candidates);
 
   void updateModelRouteTime();
 
@@ -371,6 +423,15 @@ private:
 
   static Q_DECL_CONSTEXPR int ROUTE_UNDO_LIMIT = 50;
 
+  /* Show progress dialog if route calculation takes longer than this */
+  static Q_DECL_CONSTEXPR int ROUTE_CALC_PROGRESS_DELAY_MS = 500;
+
+  /* Update interval for progress dialog */
+  static Q_DECL_CONSTEXPR int ROUTE_CALC_PROGRESS_INTERVAL_MS = 100;
+
+  /* Connection name for the database used by the route calculation thread */
+  const QString ROUTE_CALC_DATABASE_NAME = "LNMDBROUTECALC";
+
   atools::gui::ItemViewZoomHandler *zoomHandler = nullptr;
 
   /* Need a workaround since QUndoStack does not report current indices and clean state correctly */
@@ -378,8 +439,45 @@ private:
   /* Clean index of the undo stack or -1 if not clean state exists */
   int undoIndexClean = 0;
 
-  /* Network cache for flight plan calculation */
-  RouteNetwork *routeNetworkRadio = nullptr, *routeNetworkAirway = nullptr;
+  /* Preloaded graphs and indexes for flight plan calculation. Filled by the background thread. */
+  RouteNetwork::SharedData routeDataRadio, routeDataAirway;
+
+  /* Load networks into memory, use landmark (ALT) heuristic and airway shortcuts for route calculation */
+  bool routePreload = false, routeLandmarks = false, routeShortcuts = false;
+
+  /* Number of alternative routes to offer. One disables alternatives. */
+  int routeNumAlternatives = 1;
+
+  /* Calculate a flight plan for set altitude again if only the cruise altitude was changed afterwards */
+  bool routeRecalcOnAltitude = true;
+
+  /* Background route calculation */
+  QFuture<RouteCalcResult> routeCalcFuture;
+  QFutureWatcher<RouteCalcResult> routeCalcWatcher;
+  RouteCalcParams routeCalcParams;
+  std::atomic_bool routeCalcCancel {false};
+
+  /* Latest calculation requested while another one was running. Started when the running one is finished. */
+  std::function<void()> pendingRouteCalc;
+  std::atomic_int routeCalcNumExpanded {0}, routeCalcNumOpen {0};
+  QProgressDialog *routeCalcProgress = nullptr;
+  QTimer routeCalcProgressTimer;
+  QElapsedTimer routeCalcTimer;
+
+  /* Incremented on database change to discard results of a running calculation */
+  int routeCalcDatabaseGeneration = 0;
+
+  /* Incremented on every change of the flight plan to discard results of a calculation started on an older plan */
+  int routeChangeCount = 0;
+
+  /* Parameters and result of the last completed calculation. Reused if only the altitude changes within the range
+   * where the search would run exactly the same way. */
+  RouteCalcParams lastRouteCalcParams;
+  RouteCalcResult lastRouteCalcResult;
+  bool lastRouteCalcValid = false;
+
+  /* Value of routeChangeCount after the last calculated route was applied. Kept in sync by altitude changes. */
+  int lastRouteCalcChangeCount = -1;
 
   /* Flightplan and route objects */
   Route route; /* real route containing all segments */
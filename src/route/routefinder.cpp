@@ -16,9 +16,15 @@
 *****************************************************************************/
 
 #include "route/routefinder.h"
+
+#include "route/routelandmarks.h"
+#include "route/routenetworkgraph.h"
+#include "route/routenetworkshortcuts.h"
 #include "geo/calculations.h"
 #include "atools.h"
 
+#include <algorithm>
+
 using nw::Node;
 using nw::Edge;
 using atools::geo::Pos;
@@ -26,12 +32,8 @@ using atools::geo::Pos;
 RouteFinder::RouteFinder(RouteNetwork *routeNetwork)
   : network(routeNetwork), openNodesHeap(5000)
 {
-  closedNodes.reserve(10000);
-  nodeCosts.reserve(10000);
-  nodeAltRange.reserve(10000);
-  nodePredecessor.reserve(10000);
-  nodeAirwayId.reserve(10000);
-  nodeAirwayName.reserve(10000);
+  nodes.reserve(10000);
+  nodeStates.reserve(10000);
 
   successorNodes.reserve(500);
   successorEdges.reserve(500);
@@ -42,10 +44,109 @@ RouteFinder::~RouteFinder()
 
 }
 
+/* Reset search state but keep allocated memory for the next calculation */
+void RouteFinder::clearState()
+{
+  openNodesHeap.clear();
+
+  // Reset only the touched slots instead of the whole id indexed array
+  for(const rf::SearchNode& node : nodes)
+  {
+    if(node.id >= 0)
+      nodeIndexById[node.id] = -1;
+  }
+  virtualNodeIndexes.resize(0);
+  nodes.resize(0);
+  nodeStates.resize(0);
+  numClosedNodes = 0;
+  maxOpenNodes = 0;
+  destIndex = -1;
+  nodePenalties.resize(0);
+  validAltMin = std::numeric_limits<int>::min();
+  validAltMax = std::numeric_limits<int>::max();
+}
+
+/* Reset costs and predecessors of all known nodes but keep the nodes and their edges */
+void RouteFinder::resetSearchState()
+{
+  openNodesHeap.clear();
+  for(rf::NodeState& state : nodeStates)
+  {
+    state.costs = std::numeric_limits<float>::max();
+    state.predecessor = -1;
+    state.airwayId = -1;
+    state.airwayNameId = -1;
+    state.minAltFt = 0;
+    state.maxAltFt = std::numeric_limits<int>::max();
+    state.shortcut = -1;
+    state.closed = false;
+  }
+  numClosedNodes = 0;
+  maxOpenNodes = 0;
+  destIndex = -1;
+}
+
+int& RouteFinder::nodeIndexSlot(int id)
+{
+  if(id < 0)
+  {
+    // Virtual departure or destination node
+    for(std::pair<int, int>& virtualNode : virtualNodeIndexes)
+    {
+      if(virtualNode.first == id)
+        return virtualNode.second;
+    }
+    virtualNodeIndexes.append(std::make_pair(id, -1));
+    return virtualNodeIndexes.last().second;
+  }
+
+  if(id >= nodeIndexById.size())
+  {
+    // Node ids are dense in the database - grow to the largest id seen so far
+    int oldSize = nodeIndexById.size();
+    nodeIndexById.resize(std::max(id + 1, oldSize * 2));
+    std::fill(nodeIndexById.begin() + oldSize, nodeIndexById.end(), -1);
+  }
+  return nodeIndexById[id];
+}
+
+int RouteFinder::nodeIndex(const nw::Node& node)
+{
+  int& slot = nodeIndexSlot(node.id);
+  if(slot != -1)
+    return slot;
+
+  int index = nodes.size();
+  slot = index;
+  nodes.append(rf::SearchNode(node));
+
+  rf::NodeState state;
+  state.costs = std::numeric_limits<float>::max();
+  state.predecessor = -1;
+  state.airwayId = -1;
+  state.airwayNameId = -1;
+  state.minAltFt = 0;
+  state.maxAltFt = std::numeric_limits<int>::max();
+  state.shortcut = -1;
+  state.closed = false;
+  nodeStates.append(state);
+  return index;
+}
+
 bool RouteFinder::calculateRoute(const atools::geo::Pos& from, const atools::geo::Pos& to, int flownAltitude)
 {
+  clearState();
+
   altitude = flownAltitude;
   network->addDepartureAndDestinationNodes(from, to);
+  prepareLandmarks();
+
+  return runSearch();
+}
+
+/* Run A* from the departure to the destination node using the current search state */
+bool RouteFinder::runSearch()
+{
   Node startNode = network->getDepartureNode();
   Node destNode = network->getDestinationNode();
 
@@ -54,36 +155,46 @@ bool RouteFinder::calculateRoute(const atools::geo::Pos& from, const atools::geo
   if(startNode.edges.isEmpty())
     return false;
 
-  openNodesHeap.push(startNode, 0.f);
-  nodeCosts[startNode.id] = 0.f;
-  nodeAltRange[startNode.id] = std::make_pair(0, std::numeric_limits<int>::max());
+  int startIndex = nodeIndex(startNode);
+  nodeStates[startIndex].costs = 0.f;
+  openNodesHeap.push(startIndex, 0.f);
 
-  Node currentNode;
   bool destinationFound = false;
   while(!openNodesHeap.isEmpty())
   {
+    maxOpenNodes = std::max(maxOpenNodes, openNodesHeap.size());
+
     // Contains known nodes
-    openNodesHeap.pop(currentNode);
+    int currentIndex = openNodesHeap.pop();
 
-    if(currentNode.id == destNode.id)
+    if(nodes.at(currentIndex).id == destNode.id)
     {
+      destIndex = currentIndex;
       destinationFound = true;
       break;
     }
 
     // Contains nodes with known shortest path
-    closedNodes.insert(currentNode.id);
+    nodeStates[currentIndex].closed = true;
+    numClosedNodes++;
 
-    if(closedNodes.size() > numNodesTotal / 2)
+    if(numClosedNodes > numNodesTotal / 2)
       // If we read too much nodes routing will fail
       break;
 
+    if(progressCallback && numClosedNodes % PROGRESS_INTERVAL == 0 &&
+       !progressCallback(numClosedNodes, openNodesHeap.size()))
+    {
+      qDebug() << "route calculation cancelled";
+      break;
+    }
+
     // Work on successors
-    expandNode(currentNode, destNode);
+    expandNode(currentIndex, destNode);
   }
 
   qDebug() << "found" << destinationFound << "heap size" << openNodesHeap.size()
-           << "close nodes size" << closedNodes.size();
+           << "close nodes size" << numClosedNodes << "nodes" << nodes.size();
 
   qDebug() << "num nodes database" << network->getNumberOfNodesDatabase()
            << "num nodes cache" << network->getNumberOfNodesCache();
@@ -97,118 +208,275 @@ void RouteFinder::extractRoute(QVector<rf::RouteEntry>& route, float& distanceMe
   route.reserve(500);
 
   // Build route
-  nw::Node pred = network->getDestinationNode();
-  while(pred.id != -1)
+  int index = destIndex;
+  while(index != -1)
   {
+    const rf::SearchNode& node = nodes.at(index);
     int navId;
     nw::NodeType type;
-    network->getNavIdAndTypeForNode(pred.id, navId, type);
+    network->getNavIdAndTypeForNode(node.id, navId, type);
 
     if(type != nw::DEPARTURE && type != nw::DESTINATION)
     {
       rf::RouteEntry entry;
       entry.ref = {navId, toMapObjectType(type)};
-      entry.airwayId = nodeAirwayId.value(pred.id, -1);
+      entry.airwayId = nodeStates.at(index).airwayId;
+      entry.pos = node.pos;
       route.prepend(entry);
     }
 
-    nw::Node next = network->getNode(nodePredecessor.value(pred.id, -1));
-    if(next.pos.isValid())
-      distanceMeter += pred.pos.distanceMeterTo(next.pos);
-    pred = next;
+    int predIndex = nodeStates.at(index).predecessor;
+    Pos lastPos = node.pos;
+
+    int shortcut = nodeStates.at(index).shortcut;
+    if(shortcut != -1)
+    {
+      // Insert chain nodes skipped by the shortcut in reverse order - these are the targets of all but the last segment
+      const RouteNetworkShortcuts *shortcuts = network->getShortcuts();
+      const RouteNetworkGraph *networkGraph = network->getGraph();
+
+      for(int s = shortcuts->getSegmentsEnd(shortcut) - 2; s >= shortcuts->getSegmentsBegin(shortcut); s--)
+      {
+        int segmentEdge = shortcuts->getSegmentEdge(s);
+        int chainIndex = networkGraph->getEdgeTo(segmentEdge);
+        network->getNavIdAndTypeForNode(networkGraph->getNodeId(chainIndex), navId, type);
+
+        rf::RouteEntry entry;
+        entry.ref = {navId, toMapObjectType(type)};
+        entry.airwayId = networkGraph->getEdgeAirwayId(segmentEdge);
+        entry.pos = networkGraph->getPos(chainIndex);
+        route.prepend(entry);
+
+        Pos chainPos = entry.pos;
+        distanceMeter += lastPos.distanceMeterTo(chainPos);
+        lastPos = chainPos;
+      }
+    }
+
+    if(predIndex != -1)
+      distanceMeter += lastPos.distanceMeterTo(nodes.at(predIndex).pos);
+    index = predIndex;
+  }
+}
+
+int RouteFinder::calculateAlternatives(const atools::geo::Pos& from, const atools::geo::Pos& to,
+                                       int flownAltitude, int numRoutes)
+{
+  alternatives.clear();
+  alternativeNodes.clear();
+
+  if(!calculateRoute(from, to, flownAltitude))
+    return 0;
+  addAlternative();
+
+  // Penalized routes might be too similar - allow some extra searches
+  for(int i = 1; i < numRoutes * 2 && alternatives.size() < numRoutes; i++)
+  {
+    resetSearchState();
+    if(!runSearch())
+      break;
+    addAlternative();
+  }
+
+  qDebug() << Q_FUNC_INFO << "found" << alternatives.size() << "alternatives";
+  return alternatives.size();
+}
+
+void RouteFinder::extractAlternative(int index, QVector<rf::RouteEntry>& route, float& distanceMeter) const
+{
+  route = alternatives.at(index).route;
+  distanceMeter = alternatives.at(index).distanceMeter;
+}
+
+/* Penalize nodes of the last found route and keep it if it differs enough from the ones found before */
+void RouteFinder::addAlternative()
+{
+  // Nodes loaded by the last search have no penalty
+  int oldSize = nodePenalties.size();
+  if(oldSize < nodes.size())
+  {
+    nodePenalties.resize(nodes.size());
+    std::fill(nodePenalties.begin() + oldSize, nodePenalties.end(), 1.f);
+  }
+
+  // Collect nodes of the route excluding departure and destination
+  QVector<int> path;
+  for(int index = nodeStates.at(destIndex).predecessor; nodeStates.at(index).predecessor != -1;
+      index = nodeStates.at(index).predecessor)
+    path.append(index);
+
+  int numShared = 0;
+  for(int index : path)
+  {
+    if(alternativeNodes.contains(index))
+      numShared++;
+  }
+
+  if(alternatives.isEmpty() || path.isEmpty() ||
+     static_cast<float>(numShared) / path.size() <= ALTERNATIVE_MAX_SHARED)
+  {
+    Alternative alternative;
+    extractRoute(alternative.route, alternative.distanceMeter);
+    alternatives.append(alternative);
+  }
+
+  for(int index : path)
+  {
+    alternativeNodes.insert(index);
+    nodePenalties[index] *= COST_FACTOR_ALTERNATIVE;
   }
 }
 
 /* Expands a node by investigating all successors */
-void RouteFinder::expandNode(const nw::Node& currentNode, const nw::Node& destNode)
+void RouteFinder::expandNode(int currentIndex, const nw::Node& destNode)
 {
+  // Copy since nodes might be reallocated below
+  const rf::SearchNode currentNode = nodes.at(currentIndex);
+  const rf::NodeState currentState = nodeStates.at(currentIndex);
+
   successorNodes.clear();
   successorEdges.clear();
-  network->getNeighbours(currentNode, successorNodes, successorEdges);
 
-  QString currentNodeAirway;
-  if(network->isAirwayRouting())
-    currentNodeAirway = nodeAirwayName[currentNode.id];
+  // Only the expanded node needs its edges - these are cached or built from the graph by the network
+  network->getNeighbours(network->getNode(currentNode.id), successorNodes, successorEdges);
+
+  bool airwayRouting = network->isAirwayRouting();
 
   for(int i = 0; i < successorNodes.size(); i++)
   {
-    const Node& successor = successorNodes.at(i);
+    int successorIndex = nodeIndex(successorNodes.at(i));
+    const rf::SearchNode& successor = nodes.at(successorIndex);
+    rf::NodeState& successorState = nodeStates[successorIndex];
 
-    if(closedNodes.contains(successor.id))
+    if(successorState.closed)
       // Already has a shortest path
       continue;
 
     const Edge& edge = successorEdges.at(i);
 
     // Calculate set altitude if altitude > 0
-    if(altitude > 0 && !(altitude >= edge.minAltFt && altitude <= edge.maxAltFt))
-      // Altitude restrictions do not match - ignore this edge to the node
-      continue;
+    if(altitude > 0)
+    {
+      // Narrow the altitude range where this edge keeps its feasibility
+      if(altitude < edge.minAltFt)
+        validAltMax = std::min(validAltMax, edge.minAltFt - 1);
+      else if(altitude > edge.maxAltFt)
+        validAltMin = std::max(validAltMin, edge.maxAltFt + 1);
+      else
+      {
+        validAltMin = std::max(validAltMin, edge.minAltFt);
+        validAltMax = std::min(validAltMax, edge.maxAltFt);
+      }
 
-    // if(edge.airwayName == "UJ3")
-    // qDebug() << Q_FUNC_INFO;
+      if(!(altitude >= edge.minAltFt && altitude <= edge.maxAltFt))
+        // Altitude restrictions do not match - ignore this edge to the node
+        continue;
+    }
 
     if(edge.direction == nw::BACKWARD)
       // Do not travel against a one-way airway
       continue;
 
-    int lengthMeter = edge.lengthMeter;
+    // Avoid jumping between equal airways
+    float airwayChangeFactor = 1.f;
+    if(airwayRouting && currentState.airwayNameId != -1 && edge.airwayNameId != -1 &&
+       currentState.airwayNameId != edge.airwayNameId)
+      airwayChangeFactor = COST_FACTOR_AIRWAY_CHANGE;
+
+    float successorEdgeCosts;
+    if(edge.shortcut != -1)
+      successorEdgeCosts = calculateShortcutCost(currentNode, edge.shortcut, airwayChangeFactor);
+    else
+    {
+      int lengthMeter = edge.lengthMeter;
 
-    if(lengthMeter == 0)
-      // No distance given for airways - have to calculate this here
-      lengthMeter = static_cast<int>(currentNode.pos.distanceMeterTo(successor.pos));
+      if(lengthMeter == 0)
+        // No distance given for airways - have to calculate this here
+        lengthMeter = static_cast<int>(currentNode.pos.distanceMeterTo(successor.pos));
 
-    float successorEdgeCosts = calculateEdgeCost(currentNode, successor, lengthMeter);
+      successorEdgeCosts = calculateEdgeCost(currentNode, successor, lengthMeter) * airwayChangeFactor;
+    }
 
-    // Avoid jumping between equal airways
-    if(!currentNodeAirway.isEmpty() && !edge.airwayName.isEmpty() && currentNodeAirway != edge.airwayName)
-      successorEdgeCosts *= COST_FACTOR_AIRWAY_CHANGE;
+    if(successorIndex < nodePenalties.size())
+      // Avoid nodes of already found alternatives
+      successorEdgeCosts *= nodePenalties.at(successorIndex);
 
-    float successorNodeCosts = nodeCosts.value(currentNode.id) + successorEdgeCosts;
+    float successorNodeCosts = currentState.costs + successorEdgeCosts;
 
-    if(successorNodeCosts >= nodeCosts.value(successor.id) && openNodesHeap.contains(successor))
+    bool inHeap = openNodesHeap.contains(successorIndex);
+    if(successorNodeCosts >= successorState.costs && inHeap)
       // New path is not cheaper
       continue;
 
-    std::pair<int, int> successorNodeAltRange = nodeAltRange.value(currentNode.id);
-
-    if(!combineRanges(successorNodeAltRange, edge.minAltFt, edge.maxAltFt))
+    rf::NodeState newState = currentState;
+    if(!combineRanges(newState, edge.minAltFt, edge.maxAltFt))
       continue;
 
     // New path is cheaper - update node
-    nodeAirwayId[successor.id] = successorEdges.at(i).airwayId;
-    if(network->isAirwayRouting())
-      nodeAirwayName[successor.id] = successorEdges.at(i).airwayName;
-    nodePredecessor[successor.id] = currentNode.id;
-    nodeCosts[successor.id] = successorNodeCosts;
-    nodeAltRange[successor.id] = successorNodeAltRange;
+    successorState.airwayId = edge.airwayId;
+    successorState.airwayNameId = airwayRouting ? edge.airwayNameId : -1;
+    successorState.predecessor = currentIndex;
+    successorState.shortcut = edge.shortcut;
+    successorState.costs = successorNodeCosts;
+    successorState.minAltFt = newState.minAltFt;
+    successorState.maxAltFt = newState.maxAltFt;
 
     // Costs from start to successor + estimate to destination = sort order in heap
     float totalCost = successorNodeCosts + costEstimate(successor, destNode);
 
-    if(openNodesHeap.contains(successor))
+    if(inHeap)
       // Update node and resort heap
-      openNodesHeap.change(successor, totalCost);
+      openNodesHeap.change(successorIndex, totalCost);
     else
-      openNodesHeap.push(successor, totalCost);
+      openNodesHeap.push(successorIndex, totalCost);
   }
 }
 
-bool RouteFinder::combineRanges(std::pair<int, int>& range1, int min, int max)
+bool RouteFinder::combineRanges(rf::NodeState& state, int min, int max)
 {
-  // qDebug() << "[" << range1.first << "," << range1.second << "]" << "[" << min << "," << max << "]";
-  if(range1.second < min || range1.first > max)
+  if(state.maxAltFt < min || state.minAltFt > max)
     return false;
 
-  range1.first = std::max(range1.first, min);
-  range1.second = std::min(range1.second, max);
-  // qDebug() << "RESULT [" << range1.first << "," << range1.second << "]";
+  state.minAltFt = std::max(state.minAltFt, min);
+  state.maxAltFt = std::min(state.maxAltFt, max);
   return true;
 }
 
+/* Sum of costs for all segments of a shortcut which gives the same result as expanding all chain nodes.
+ * The airway change factor applies to the first segment only. */
+float RouteFinder::calculateShortcutCost(const rf::SearchNode& currentNode, int shortcut, float airwayChangeFactor)
+{
+  const RouteNetworkShortcuts *shortcuts = network->getShortcuts();
+  const RouteNetworkGraph *networkGraph = network->getGraph();
+
+  // Chain nodes are always airway waypoints and never departure or destination - only length is relevant for costs
+  rf::SearchNode chainNode;
+
+  float costs = 0.f;
+  Pos lastPos = currentNode.pos;
+  for(int s = shortcuts->getSegmentsBegin(shortcut); s < shortcuts->getSegmentsEnd(shortcut); s++)
+  {
+    int segmentEdge = shortcuts->getSegmentEdge(s);
+    Pos pos = networkGraph->getPos(networkGraph->getEdgeTo(segmentEdge));
+
+    int lengthMeter = networkGraph->getEdgeLength(segmentEdge);
+    if(lengthMeter == 0)
+      lengthMeter = static_cast<int>(lastPos.distanceMeterTo(pos));
+
+    float segmentCosts = calculateEdgeCost(s == shortcuts->getSegmentsBegin(shortcut) ? currentNode : chainNode,
+                                           chainNode, lengthMeter);
+    if(s == shortcuts->getSegmentsBegin(shortcut))
+      segmentCosts *= airwayChangeFactor;
+
+    costs += segmentCosts;
+    lastPos = pos;
+  }
+  return costs;
+}
+
 /* Calculates the costs to travel from current to successor. Base is the distance between the nodes in meter that
  * will have several factors applied to get reasonable routes */
-float RouteFinder::calculateEdgeCost(const nw::Node& currentNode, const nw::Node& successorNode,
+float RouteFinder::calculateEdgeCost(const rf::SearchNode& currentNode, const rf::SearchNode& successorNode,
                                      int lengthMeter)
 {
   float costs = lengthMeter;
@@ -273,10 +541,75 @@ float RouteFinder::calculateEdgeCost(const nw::Node& currentNode, const nw::Node
   return costs;
 }
 
-/* GC distance in meter as costs between nodes */
-float RouteFinder::costEstimate(const nw::Node& currentNode, const nw::Node& destNode)
+/* GC distance in meter as costs between nodes or landmark estimate if larger */
+float RouteFinder::costEstimate(const rf::SearchNode& currentNode, const nw::Node& destNode)
+{
+  float estimate = currentNode.pos.distanceMeterTo(destNode.pos);
+
+  if(landmarks != nullptr)
+    estimate = std::max(estimate, landmarkEstimate(currentNode.id));
+  return estimate;
+}
+
+/* The destination is a virtual node which is not part of the landmark table.
+ * For each landmark L the distance from a node v to the destination is at least
+ * min(dL(p) + c(p)) - dL(v) and dL(v) - max(dL(p) - c(p)), where p are all nodes having a virtual edge
+ * of length c(p) to the destination. Calculate min and max once per route calculation. */
+void RouteFinder::prepareLandmarks()
+{
+  landmarks = nullptr;
+  graph = nullptr;
+  landmarkTargetMin.clear();
+  landmarkTargetMax.clear();
+
+  if(strategy != rf::ASTAR_LANDMARKS || network->getLandmarks() == nullptr)
+    return;
+
+  QVector<std::pair<int, int> > predecessors;
+  network->getDestinationPredecessors(predecessors);
+  if(predecessors.isEmpty())
+    return;
+
+  const RouteLandmarks *networkLandmarks = network->getLandmarks();
+  int numLandmarks = networkLandmarks->getNumLandmarks();
+  landmarkTargetMin.fill(RouteLandmarks::INVALID_DISTANCE, numLandmarks);
+  landmarkTargetMax.fill(-RouteLandmarks::INVALID_DISTANCE, numLandmarks);
+
+  for(int landmark = 0; landmark < numLandmarks; landmark++)
+  {
+    for(const std::pair<int, int>& pred : predecessors)
+    {
+      float dist = networkLandmarks->getDistance(pred.first, landmark);
+      if(dist < RouteLandmarks::INVALID_DISTANCE)
+      {
+        landmarkTargetMin[landmark] = std::min(landmarkTargetMin.at(landmark), dist + pred.second);
+        landmarkTargetMax[landmark] = std::max(landmarkTargetMax.at(landmark), dist - pred.second);
+      }
+    }
+  }
+
+  landmarks = networkLandmarks;
+  graph = network->getGraph();
+}
+
+/* Lower bound for distance from node to destination using landmarks. Returns 0 for virtual nodes. */
+float RouteFinder::landmarkEstimate(int nodeId) const
 {
-  return currentNode.pos.distanceMeterTo(destNode.pos);
+  int index = graph->indexOf(nodeId);
+  if(index == -1)
+    return 0.f;
+
+  float estimate = 0.f;
+  for(int landmark = 0; landmark < landmarkTargetMin.size(); landmark++)
+  {
+    float targetMin = landmarkTargetMin.at(landmark);
+    float dist = landmarks->getDistance(index, landmark);
+
+    if(targetMin < RouteLandmarks::INVALID_DISTANCE && dist < RouteLandmarks::INVALID_DISTANCE)
+      // Destination and node are both reachable from landmark
+      estimate = std::max(estimate, std::max(targetMin - dist, dist - landmarkTargetMax.at(landmark)));
+  }
+  return estimate;
 }
 
 /* Convert internal network type to MapObjectTypes for extract route */
@@ -18,19 +18,81 @@
 #ifndef LITTLENAVMAP_ROUTEFINDER_H
 #define LITTLENAVMAP_ROUTEFINDER_H
 
-#include "util/heap.h"
+#include "route/indexedheap.h"
 #include "route/routenetwork.h"
 
+#include <functional>
+#include <limits>
+
+class RouteLandmarks;
+class RouteNetworkGraph;
+
 namespace rf {
+
+/* Search strategy for the route finder */
+enum Strategy
+{
+  /* Plain A* using great circle distance as estimate */
+  ASTAR,
+
+  /* A* using landmarks and triangle inequality (ALT) for a tighter estimate.
+   * Falls back to ASTAR if the network has no landmarks. */
+  ASTAR_LANDMARKS
+};
+
 /* Used when fetching the route points after calculation. Adds airway id to node */
 struct RouteEntry
 {
   map::MapObjectRef ref;
   int airwayId;
+  atools::geo::Pos pos;
+};
+
+/* Node data needed by the search. Edges are fetched from the network only when a node is expanded. */
+struct SearchNode
+{
+  SearchNode()
+    : id(-1), range(0), type(nw::NONE), subtype(nw::NONE)
+  {
+  }
+
+  explicit SearchNode(const nw::Node& node)
+    : id(node.id), range(node.range), pos(node.pos), type(node.type), subtype(node.subtype)
+  {
+  }
+
+  int id /* Network node id */, range;
+  atools::geo::Pos pos;
+  nw::NodeType type, subtype;
+};
+
+/* Search state of a node. Kept in a flat array indexed by the dense node index. */
+struct NodeState
+{
+  /* Costs from start to this node. Costs are distance in meter adjusted by some factors. */
+  float costs;
+
+  /* Dense index of predecessor node or -1 */
+  int predecessor;
+
+  /* Airway id and interned airway name id of the edge leading to this node or -1 */
+  int airwayId, airwayNameId;
+
+  /* Min and maximum altitude range of airways to this node so far */
+  int minAltFt, maxAltFt;
+
+  /* Shortcut used to reach this node or -1. Skipped chain nodes are inserted when extracting the route. */
+  int shortcut;
+
+  /* Node has a known shortest path */
+  bool closed;
 };
 
 }
 
+Q_DECLARE_TYPEINFO(rf::SearchNode, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(rf::NodeState, Q_PRIMITIVE_TYPE);
+
 /*
  * Calculates flight plans within a route network which can be an airway or radio navaid network.
  * Use A* algorithm and several cost factor adjustments to get reasonable routes.
@@ -56,6 +118,25 @@ public:
    * From and to are not included in the list */
   void extractRoute(QVector<rf::RouteEntry>& route, float& distanceMeter);
 
+  /*
+   * Calculates up to numRoutes distinct flight plans using the penalty method. The best route is found first.
+   * Then costs for entering nodes of found routes are increased and the search is repeated.
+   * Nodes and edges loaded by previous searches are reused and only the per node search state is reset.
+   * extractRoute is not valid after calling this. Use extractAlternative instead.
+   * @return number of routes found
+   */
+  int calculateAlternatives(const atools::geo::Pos& from, const atools::geo::Pos& to, int flownAltitude,
+                            int numRoutes);
+
+  /* Number of routes found by calculateAlternatives */
+  int getNumAlternatives() const
+  {
+    return alternatives.size();
+  }
+
+  /* Get route points and distance for an alternative. Index 0 is the best route. */
+  void extractAlternative(int index, QVector<rf::RouteEntry>& route, float& distanceMeter) const;
+
   /* Prefer VORs to transition from departure to airway network */
   void setPreferVorToAirway(bool value)
   {
@@ -68,12 +149,70 @@ public:
     preferNdbToAirway = value;
   }
 
+  void setStrategy(rf::Strategy value)
+  {
+    strategy = value;
+  }
+
+  /* Statistics for the last calculation. Expanded nodes and largest size of the open node heap. */
+  int getNumExpandedNodes() const
+  {
+    return numClosedNodes;
+  }
+
+  int getMaxOpenNodes() const
+  {
+    return maxOpenNodes;
+  }
+
+  /* Altitude range in feet containing the flown altitude for which all edges examined by the last calculation have
+   * the same altitude feasibility. A calculation for any altitude in this range runs exactly the same way and
+   * gives the same result. Range is unlimited if the calculation did not use an altitude. */
+  int getValidAltitudeMin() const
+  {
+    return validAltMin;
+  }
+
+  int getValidAltitudeMax() const
+  {
+    return validAltMax;
+  }
+
+  /* Called every PROGRESS_INTERVAL expanded nodes with the number of expanded nodes and the size of the open node
+   * heap. calculateRoute stops and returns false if the callback returns false. */
+  typedef std::function<bool(int numExpanded, int numOpen)> ProgressCallbackType;
+
+  void setProgressCallback(const ProgressCallbackType& callback)
+  {
+    progressCallback = callback;
+  }
+
 private:
-  void expandNode(const nw::Node& node, const nw::Node& destNode);
-  float calculateEdgeCost(const nw::Node& node, const nw::Node& successorNode, int lengthMeter);
-  float costEstimate(const nw::Node& currentNode, const nw::Node& destNode);
+  /* Route found by calculateAlternatives */
+  struct Alternative
+  {
+    QVector<rf::RouteEntry> route;
+    float distanceMeter;
+  };
+
+  /* Get dense index for node and add an initial state if not known yet */
+  int nodeIndex(const nw::Node& node);
+
+  /* Slot in nodeIndexById or virtualNodeIndexes for the network node id. Contains -1 if node is not known yet. */
+  int& nodeIndexSlot(int id);
+  void clearState();
+  void resetSearchState();
+  bool runSearch();
+  void addAlternative();
+
+  void expandNode(int currentIndex, const nw::Node& destNode);
+  float calculateEdgeCost(const rf::SearchNode& node, const rf::SearchNode& successorNode, int lengthMeter);
+  float calculateShortcutCost(const rf::SearchNode& currentNode, int shortcut, float airwayChangeFactor);
+  float costEstimate(const rf::SearchNode& currentNode, const nw::Node& destNode);
+  void prepareLandmarks();
+  float landmarkEstimate(int nodeId) const;
   map::MapObjectTypes toMapObjectType(nw::NodeType type);
-  bool combineRanges(std::pair<int, int>& range1, int min, int max);
+  bool combineRanges(rf::NodeState& state, int min, int max);
 
   /* Force algortihm to avoid direct route from start to destination */
   static Q_DECL_CONSTEXPR float COST_FACTOR_DIRECT = 2.f;
@@ -101,38 +240,73 @@ private:
   /* Avoid airway changes during routing */
   static Q_DECL_CONSTEXPR float COST_FACTOR_AIRWAY_CHANGE = 1.2f;
 
+  /* Cost factor for entering a node used by a route already found by calculateAlternatives */
+  static Q_DECL_CONSTEXPR float COST_FACTOR_ALTERNATIVE = 1.4f;
+
+  /* Drop alternatives that share more than this fraction of nodes with the routes already found */
+  static Q_DECL_CONSTEXPR float ALTERNATIVE_MAX_SHARED = 0.8f;
+
+  /* Call progress callback after this number of expanded nodes */
+  static Q_DECL_CONSTEXPR int PROGRESS_INTERVAL = 1000;
+
   /* Distance to define a long airway segment in meter */
   static Q_DECL_CONSTEXPR float DISTANCE_LONG_AIRWAY_METER = atools::geo::nmToMeter(200.f);
 
   int altitude = 0;
+  rf::Strategy strategy = rf::ASTAR;
+
+  /* Landmark table and graph of network if strategy is ASTAR_LANDMARKS. Null otherwise. */
+  const RouteLandmarks *landmarks = nullptr;
+  const RouteNetworkGraph *graph = nullptr;
+
+  /* Per landmark distance bounds for the destination. See prepareLandmarks() */
+  QVector<float> landmarkTargetMin, landmarkTargetMax;
 
   RouteNetwork *network;
 
-  /* Heap structure storing open nodes.
+  /* Heap structure storing dense indexes of open nodes.
    * Sort order is defined by costs from start to node + estimate to destination */
-  atools::util::Heap<nw::Node> openNodesHeap;
+  IndexedHeap openNodesHeap;
 
-  /* Nodes that have been processed already and have a known shortest path */
-  QSet<int> closedNodes;
+  /* Dense index for nodes and nodeStates indexed by network node id or -1 if not touched by the search.
+   * Grows on demand up to the largest node id. */
+  QVector<int> nodeIndexById;
 
-  /* Costs from start to this node. Maps node id to costs. Costs are distance in meter
-   * adjusted by some factors. */
-  QHash<int, float> nodeCosts;
+  /* Network node id and dense index of the virtual departure and destination nodes which have negative ids */
+  QVector<std::pair<int, int> > virtualNodeIndexes;
 
-  /* Min and maximum altitude range of airways to this node so far */
-  QHash<int, std::pair<int, int> > nodeAltRange;
+  /* All nodes touched by the search by dense index */
+  QVector<rf::SearchNode> nodes;
+
+  /* Search state for each node by dense index */
+  QVector<rf::NodeState> nodeStates;
+
+  /* Number of nodes that have been processed already and have a known shortest path */
+  int numClosedNodes = 0;
+
+  /* Largest size of the heap during the last search */
+  int maxOpenNodes = 0;
 
-  /* Maps node id to predecessor node id */
-  QHash<int, int> nodePredecessor;
-  /* Maps node id to predecessor airway id */
-  QHash<int, int> nodeAirwayId;
-  QHash<int, QString> nodeAirwayName;
+  /* Altitude range where the search result does not change */
+  int validAltMin = std::numeric_limits<int>::min(), validAltMax = std::numeric_limits<int>::max();
+
+  /* Dense index of destination node after successful calculation or -1 */
+  int destIndex = -1;
+
+  /* Cost factors for entering a node by dense index. Might be shorter than nodes. Used for alternatives. */
+  QVector<float> nodePenalties;
+
+  /* Dense indexes of all nodes used by alternatives */
+  QSet<int> alternativeNodes;
+  QVector<Alternative> alternatives;
 
   /* For RouteNetwork::getNeighbours to avoid instantiations */
   QVector<nw::Node> successorNodes;
   QVector<nw::Edge> successorEdges;
 
   bool preferVorToAirway = false, preferNdbToAirway = false;
+
+  ProgressCallbackType progressCallback = nullptr;
 };
 
 #endif // LITTLENAVMAP_ROUTEFINDER_H
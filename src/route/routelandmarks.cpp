@@ -0,0 +1,220 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "route/routelandmarks.h"
+
+#include "route/routenetworkgraph.h"
+#include "route/indexedheap.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+
+Q_DECL_CONSTEXPR float RouteLandmarks::INVALID_DISTANCE;
+
+RouteLandmarks::RouteLandmarks()
+{
+
+}
+
+RouteLandmarks::~RouteLandmarks()
+{
+
+}
+
+void RouteLandmarks::clear()
+{
+  distances.clear();
+  landmarkIndexes.clear();
+  numLandmarks = 0;
+}
+
+void RouteLandmarks::calculate(const RouteNetworkGraph& graph, int numberOfLandmarks)
+{
+  clear();
+
+  if(graph.isEmpty() || numberOfLandmarks <= 0)
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  int numNodes = graph.size();
+  numLandmarks = numberOfLandmarks;
+  distances.fill(INVALID_DISTANCE, numNodes * numLandmarks);
+
+  // Start with the node having the most edges which is most likely part of the largest connected network
+  int start = 0;
+  for(int i = 0; i < numNodes; i++)
+  {
+    if(graph.getEdgeEnd(i) - graph.getEdgeBegin(i) > graph.getEdgeEnd(start) - graph.getEdgeBegin(start))
+      start = i;
+  }
+
+  // Minimum distance of each node to all landmarks selected so far
+  QVector<float> minDistances, result;
+  calculateDistances(graph, start, minDistances);
+
+  for(int landmark = 0; landmark < numLandmarks; landmark++)
+  {
+    // Next landmark is the reachable node farthest away from all other landmarks
+    int next = -1;
+    float maxDistance = 0.f;
+    for(int i = 0; i < numNodes; i++)
+    {
+      float dist = minDistances.at(i);
+      if(dist < INVALID_DISTANCE && dist > maxDistance)
+      {
+        maxDistance = dist;
+        next = i;
+      }
+    }
+
+    if(next == -1)
+      // Network too small - leave rest of the columns invalid
+      break;
+
+    landmarkIndexes.append(next);
+    calculateDistances(graph, next, result);
+
+    for(int i = 0; i < numNodes; i++)
+    {
+      float dist = result.at(i);
+      distances[i * numLandmarks + landmark] = dist;
+
+      if(landmark == 0)
+        // Ignore start node for the following selections
+        minDistances[i] = dist;
+      else
+        minDistances[i] = std::min(minDistances.at(i), dist);
+    }
+  }
+
+  qDebug() << Q_FUNC_INFO << "landmarks" << landmarkIndexes.size() << "nodes" << numNodes
+           << "time" << timer.elapsed() << "ms";
+}
+
+/* Dijkstra over all edges using the same lengths as the route finder */
+void RouteLandmarks::calculateDistances(const RouteNetworkGraph& graph, int source, QVector<float>& result) const
+{
+  result.fill(INVALID_DISTANCE, graph.size());
+
+  IndexedHeap heap(graph.size() / 10);
+  result[source] = 0.f;
+  heap.push(source, 0.f);
+
+  while(!heap.isEmpty())
+  {
+    int current = heap.pop();
+    float currentDistance = result.at(current);
+
+    for(int e = graph.getEdgeBegin(current); e < graph.getEdgeEnd(current); e++)
+    {
+      int to = graph.getEdgeTo(e);
+
+      int lengthMeter = graph.getEdgeLength(e);
+      if(lengthMeter == 0)
+        lengthMeter = static_cast<int>(graph.getPos(current).distanceMeterTo(graph.getPos(to)));
+
+      float distance = currentDistance + lengthMeter;
+      if(distance < result.at(to))
+      {
+        if(result.at(to) == INVALID_DISTANCE)
+          heap.push(to, distance);
+        else if(heap.contains(to))
+          heap.change(to, distance);
+        else
+          // Already settled - can only happen due to rounding
+          continue;
+
+        result[to] = distance;
+      }
+    }
+  }
+}
+
+bool RouteLandmarks::read(const QString& filename, const RouteNetworkGraph& graph, const QDateTime& timestamp)
+{
+  clear();
+
+  QFile file(filename);
+  if(!file.exists())
+    return false;
+
+  bool ok = false;
+  if(file.open(QIODevice::ReadOnly))
+  {
+    quint32 magic;
+    quint16 version;
+    qint64 fileTimestamp;
+    qint32 numNodes, numEdges, num;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_5);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    in >> magic >> version;
+
+    if(magic == FILE_MAGIC_NUMBER && version == FILE_VERSION)
+    {
+      in >> fileTimestamp >> numNodes >> numEdges >> num;
+
+      if(fileTimestamp == timestamp.toMSecsSinceEpoch() && numNodes == graph.size() &&
+         numEdges == graph.getNumEdges())
+      {
+        numLandmarks = num;
+        in >> landmarkIndexes >> distances;
+        ok = in.status() == QDataStream::Ok && distances.size() == numNodes * numLandmarks;
+      }
+      else
+        qInfo() << "Landmarks" << filename << "are outdated";
+    }
+    else
+      qWarning() << "Cannot read landmarks" << filename << ". Invalid magic number or version:" << magic << version;
+
+    file.close();
+  }
+  else
+    qWarning() << "Cannot read landmarks" << filename << ":" << file.errorString();
+
+  if(!ok)
+    clear();
+  return ok;
+}
+
+bool RouteLandmarks::write(const QString& filename, const RouteNetworkGraph& graph, const QDateTime& timestamp) const
+{
+  QFile file(filename);
+  if(file.open(QIODevice::WriteOnly))
+  {
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_5);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    out << FILE_MAGIC_NUMBER << FILE_VERSION << static_cast<qint64>(timestamp.toMSecsSinceEpoch())
+        << static_cast<qint32>(graph.size()) << static_cast<qint32>(graph.getNumEdges())
+        << static_cast<qint32>(numLandmarks) << landmarkIndexes << distances;
+    file.close();
+    return true;
+  }
+  else
+  {
+    qWarning() << "Cannot write landmarks" << filename << ":" << file.errorString();
+    return false;
+  }
+}
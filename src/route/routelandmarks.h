@@ -0,0 +1,83 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_ROUTELANDMARKS_H
+#define LITTLENAVMAP_ROUTELANDMARKS_H
+
+#include <QVector>
+
+#include <limits>
+
+class RouteNetworkGraph;
+class QDateTime;
+class QString;
+
+/*
+ * Landmark distance table for the ALT (A*, landmarks and triangle inequality) heuristic.
+ *
+ * A few landmark nodes are selected which are far apart from each other. The shortest path distance from each
+ * landmark to every node of the graph is calculated using plain edge lengths, ignoring directions and altitude
+ * restrictions. Since all route finder cost factors are >= 1 these distances give admissible and consistent
+ * lower bounds for the remaining costs to the destination.
+ *
+ * The table can be saved to and read from a file beside the navigation database.
+ */
+class RouteLandmarks
+{
+public:
+  RouteLandmarks();
+  ~RouteLandmarks();
+
+  /* Select landmarks and calculate distances to all nodes of the graph */
+  void calculate(const RouteNetworkGraph& graph, int numberOfLandmarks);
+
+  /* Read table from file. Returns false if file does not exist or does not match the graph or timestamp. */
+  bool read(const QString& filename, const RouteNetworkGraph& graph, const QDateTime& timestamp);
+
+  /* Write table to file using the timestamp to detect database changes */
+  bool write(const QString& filename, const RouteNetworkGraph& graph, const QDateTime& timestamp) const;
+
+  void clear();
+
+  /* Number of landmarks. Columns of unused landmarks return INVALID_DISTANCE. */
+  int getNumLandmarks() const
+  {
+    return numLandmarks;
+  }
+
+  /* Distance from landmark to node by dense graph index in meter or INVALID_DISTANCE if not reachable */
+  float getDistance(int nodeIndex, int landmark) const
+  {
+    return distances.at(nodeIndex * numLandmarks + landmark);
+  }
+
+  static Q_DECL_CONSTEXPR float INVALID_DISTANCE = std::numeric_limits<float>::max();
+
+private:
+  /* Shortest path distances from source to all nodes */
+  void calculateDistances(const RouteNetworkGraph& graph, int source, QVector<float>& result) const;
+
+  static Q_DECL_CONSTEXPR quint32 FILE_MAGIC_NUMBER = 0x2C4E1B3A;
+  static Q_DECL_CONSTEXPR quint16 FILE_VERSION = 1;
+
+  /* Node major layout - distances of all landmarks for a node are adjacent */
+  QVector<float> distances;
+  QVector<int> landmarkIndexes;
+  int numLandmarks = 0;
+};
+
+#endif // LITTLENAVMAP_ROUTELANDMARKS_H
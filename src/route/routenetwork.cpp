@@ -17,6 +17,11 @@
 
 #include "routenetwork.h"
 
+#include "route/routenetworkgraph.h"
+#include "route/routenetworkgrid.h"
+#include "route/routelandmarks.h"
+#include "route/routenetworkshortcuts.h"
+
 #include "sql/sqldatabase.h"
 #include "sql/sqlquery.h"
 #include "sql/sqlrecord.h"
@@ -26,6 +31,8 @@
 #include "geo/rect.h"
 
 #include <QElapsedTimer>
+#include <QDateTime>
+#include <QFileInfo>
 
 using atools::sql::SqlDatabase;
 using atools::sql::SqlQuery;
@@ -55,7 +62,12 @@ RouteNetwork::~RouteNetwork()
 int RouteNetwork::getNumberOfNodesDatabase()
 {
   if(numNodesDb == -1)
-    numNodesDb = atools::sql::SqlUtil(db).rowCount(nodeTable);
+  {
+    if(graph.isNull())
+      numNodesDb = atools::sql::SqlUtil(db).rowCount(nodeTable);
+    else
+      numNodesDb = graph->size();
+  }
   return numNodesDb;
 }
 
@@ -70,11 +82,178 @@ void RouteNetwork::setMode(nw::Modes routeMode)
   airwayRouting = mode & nw::ROUTE_JET || mode & nw::ROUTE_VICTOR;
 }
 
+void RouteNetwork::setPreload(bool value)
+{
+  // Landmarks and shortcuts cannot be used without the graph
+  value = value || useLandmarks || useShortcuts;
+
+  if(preload != value)
+  {
+    preload = value;
+
+    // Switch between cache and graph
+    clearStartAndDestinationNodes();
+    graph.clear();
+    grid.clear();
+    landmarks.clear();
+    shortcuts.clear();
+  }
+}
+
+void RouteNetwork::setLandmarks(bool value)
+{
+  useLandmarks = value;
+  if(!useLandmarks)
+    landmarks.clear();
+  setPreload(preload || useLandmarks);
+}
+
+void RouteNetwork::setShortcuts(bool value)
+{
+  useShortcuts = value;
+  if(!useShortcuts)
+  {
+    clearStartAndDestinationNodes();
+    shortcuts.clear();
+  }
+  setPreload(preload || useShortcuts);
+}
+
+void RouteNetwork::loadGraph()
+{
+  bool cancelled = false;
+  if(preload && graph.isNull())
+  {
+    RouteNetworkGraph *newGraph = new RouteNetworkGraph;
+    if(newGraph->load(db, nodeTable, edgeTable, nodeExtraCols, edgeExtraCols, cancelCallback))
+    {
+      graph.reset(newGraph);
+
+      // Drop nodes loaded from the database and force recreation of virtual nodes
+      clearStartAndDestinationNodes();
+    }
+    else
+    {
+      // Cancelled - grid is still needed for departure and destination
+      qDebug() << Q_FUNC_INFO << "Loading graph cancelled";
+      delete newGraph;
+      cancelled = true;
+    }
+  }
+
+  if(grid.isNull())
+  {
+    // Node positions are taken from the graph if available to avoid a second table scan
+    RouteNetworkGrid *newGrid = new RouteNetworkGrid;
+    if(graph.isNull())
+      newGrid->load(db, nodeTable);
+    else
+      newGrid->build(*graph);
+    grid.reset(newGrid);
+  }
+
+  if(cancelled || (cancelCallback && cancelCallback()))
+    return;
+
+  if(useLandmarks && landmarks.isNull() && !graph.isNull())
+    loadLandmarks();
+
+  if(cancelCallback && cancelCallback())
+    return;
+
+  if(useShortcuts && shortcuts.isNull() && !graph.isNull())
+    loadShortcuts();
+}
+
+RouteNetwork::SharedData RouteNetwork::getSharedData() const
+{
+  return {graph, grid, landmarks, shortcuts};
+}
+
+void RouteNetwork::setSharedData(const SharedData& data)
+{
+  // Virtual nodes might refer to nodes of the old data
+  clearStartAndDestinationNodes();
+  graph = data.graph;
+  grid = data.grid;
+  landmarks = data.landmarks;
+  shortcuts = data.shortcuts;
+}
+
+/* Name of a file beside the database for precalculated data of this network */
+QString RouteNetwork::sidecarFilename(const QString& suffix) const
+{
+  return QFileInfo(db->databaseName()).absoluteFilePath() + "-" + nodeTable + suffix;
+}
+
+/* Read landmarks from the file beside the database or calculate and save them if outdated */
+void RouteNetwork::loadLandmarks()
+{
+  QString filename = sidecarFilename(".landmarks");
+  QDateTime timestamp = QFileInfo(db->databaseName()).lastModified();
+
+  RouteLandmarks *newLandmarks = new RouteLandmarks;
+  if(!newLandmarks->read(filename, *graph, timestamp))
+  {
+    newLandmarks->calculate(*graph, NUM_LANDMARKS);
+    newLandmarks->write(filename, *graph, timestamp);
+  }
+  landmarks.reset(newLandmarks);
+}
+
+/* Read shortcuts from the file beside the database or calculate and save them if outdated */
+void RouteNetwork::loadShortcuts()
+{
+  QString filename = sidecarFilename(".shortcuts");
+  QDateTime timestamp = QFileInfo(db->databaseName()).lastModified();
+
+  RouteNetworkShortcuts *newShortcuts = new RouteNetworkShortcuts;
+  if(!newShortcuts->read(filename, *graph, timestamp))
+  {
+    newShortcuts->calculate(*graph);
+    newShortcuts->write(filename, *graph, timestamp);
+  }
+  shortcuts.reset(newShortcuts);
+}
+
+/* true if any node skipped by the shortcut needs a virtual edge to the destination */
+bool RouteNetwork::isShortcutNearDestination(int shortcut) const
+{
+  if(!destinationPos.isValid())
+    return false;
+
+  // Chain nodes are the targets of all but the last segment
+  for(int s = shortcuts->getSegmentsBegin(shortcut); s < shortcuts->getSegmentsEnd(shortcut) - 1; s++)
+  {
+    if(destinationNodeRect.contains(graph->getPos(graph->getEdgeTo(shortcuts->getSegmentEdge(s)))))
+      return true;
+  }
+  return false;
+}
+
+void RouteNetwork::getDestinationPredecessors(QVector<std::pair<int, int> >& predecessors) const
+{
+  if(graph.isNull() || !destinationPos.isValid())
+    return;
+
+  // Same condition as used for virtual destination edges
+  QVector<int> entries;
+  grid->getNodes(destinationNodeRect, entries);
+  for(int entry : entries)
+  {
+    Pos pos = grid->getPos(entry);
+    if(destinationNodeRect.contains(pos))
+      predecessors.append(std::make_pair(graph->indexOf(grid->getNodeId(entry)),
+                                         static_cast<int>(pos.distanceMeterTo(destinationPos))));
+  }
+}
+
 void RouteNetwork::clearStartAndDestinationNodes()
 {
   departurePos = atools::geo::EMPTY_POS;
   destinationPos = atools::geo::EMPTY_POS;
   nodeCache.clear();
+  airwayNameIds.clear();
   destinationNodePredecessors.clear();
   numNodesDb = -1;
   nodeIndexesCreated = false;
@@ -103,7 +282,11 @@ void RouteNetwork::getNeighbours(const nw::Node& from, QVector<nw::Node>& neighb
     if(add)
     {
       // Add nodes and edges only if they match airway mode
-      neighbours.append(fetchNode(e.toNodeId));
+      if(!graph.isNull() && !nodeCache.contains(e.toNodeId))
+        // Edges of adjacent nodes are not needed - avoid building them from the graph
+        neighbours.append(fetchNodeGraph(e.toNodeId, false /* loadEdges */));
+      else
+        neighbours.append(fetchNode(e.toNodeId));
       edges.append(e);
     }
   }
@@ -113,6 +296,8 @@ void RouteNetwork::addDepartureAndDestinationNodes(const atools::geo::Pos& from,
 {
   qDebug() << "adding start and  destination to network";
 
+  loadGraph();
+
   if(departurePos == from && destinationPos == to)
     return;
 
@@ -129,9 +314,20 @@ void RouteNetwork::addDepartureAndDestinationNodes(const atools::geo::Pos& from,
     // Will use the bounding rectangle to add any neighbor nodes to dest
     fetchNode(to.getLonX(), to.getLatY(), false, DESTINATION_NODE_ID);
 
-    for(int id : nodeCache.keys())
-      // Fill destination node predecessor index
-      addDestNodeEdges(nodeCache[id]);
+    // Fill destination node predecessor index for all cached nodes near the destination
+    QVector<int> entries;
+    grid->getNodes(destinationNodeRect, entries);
+    for(int entry : entries)
+    {
+      auto it = nodeCache.find(grid->getNodeId(entry));
+      if(it != nodeCache.end())
+        addDestNodeEdges(it.value());
+    }
+
+    // Virtual departure node is not part of the grid
+    auto it = nodeCache.find(DEPARTURE_NODE_ID);
+    if(it != nodeCache.end())
+      addDestNodeEdges(it.value());
   }
 
   if(departurePos != from)
@@ -212,6 +408,7 @@ nw::Node RouteNetwork::fetchNodeByNavId(int id, nw::NodeType type)
   nodeByNavIdQuery->bindValue(":id", id);
   nodeByNavIdQuery->bindValue(":type", type);
   nodeByNavIdQuery->exec();
+  numQueries++;
 
   nw::Node node;
 
@@ -225,6 +422,7 @@ nw::Node RouteNetwork::fetchNodeByNavId(int id, nw::NodeType type)
       // Not found and is an airway - look for waypoints
       nodeByNavIdQuery->bindValue(":type", nw::WAYPOINT_BOTH);
       nodeByNavIdQuery->exec();
+      numQueries++;
       if(nodeByNavIdQuery->next())
         node = fetchNode(nodeByNavIdQuery->value("node_id").toInt());
     }
@@ -247,22 +445,30 @@ void RouteNetwork::getNavIdAndTypeForNode(int nodeId, int& navId, nw::NodeType&
     type = DESTINATION;
     navId = -1; // No database id available
   }
+  else if(!graph.isNull())
+  {
+    int index = graph->indexOf(nodeId);
+    if(index != -1)
+    {
+      navId = graph->getNavId(index);
+      type = nodeType(graph->getType(index));
+    }
+    else
+    {
+      navId = -1;
+      type = nw::NONE;
+    }
+  }
   else
   {
     nodeNavIdAndTypeQuery->bindValue(":id", nodeId);
     nodeNavIdAndTypeQuery->exec();
+    numQueries++;
 
     if(nodeNavIdAndTypeQuery->next())
     {
       navId = nodeNavIdAndTypeQuery->value("nav_id").toInt();
-
-      int typeVal = nodeNavIdAndTypeQuery->value("type").toInt();
-
-      if(airwayRouting)
-        // This is an airway network which has the type in the upper four bits
-        type = static_cast<nw::NodeType>(typeVal >> 4);
-      else
-        type = static_cast<nw::NodeType>(typeVal);
+      type = nodeType(nodeNavIdAndTypeQuery->value("type").toInt());
     }
     else
     {
@@ -301,19 +507,12 @@ nw::Node RouteNetwork::fetchNode(float lonx, float laty, bool loadSuccessors, in
     QSet<Edge> tempEdges;
     tempEdges.reserve(1000);
 
-    for(const Rect& rect : queryRect.splitAtAntiMeridian())
+    QVector<int> entries;
+    grid->getNodes(queryRect, entries);
+    for(int entry : entries)
     {
-      bindCoordRect(rect, nearestNodesQuery);
-      nearestNodesQuery->exec();
-      while(nearestNodesQuery->next())
-      {
-        int nodeId = nearestNodesQuery->value("node_id").toInt();
-        if(testType(static_cast<nw::NodeType>(nearestNodesQuery->value("type").toInt())))
-        {
-          Pos otherPos(nearestNodesQuery->value("lonx").toFloat(), nearestNodesQuery->value("laty").toFloat());
-          tempEdges.insert(Edge(nodeId, static_cast<int>(node.pos.distanceMeterTo(otherPos))));
-        }
-      }
+      if(testType(static_cast<nw::NodeType>(grid->getType(entry))))
+        tempEdges.insert(Edge(grid->getNodeId(entry), static_cast<int>(node.pos.distanceMeterTo(grid->getPos(entry)))));
     }
     node.edges = tempEdges.values().toVector();
 
@@ -332,8 +531,12 @@ nw::Node RouteNetwork::fetchNode(int id)
   if(nodeCache.contains(id))
     return nodeCache.value(id);
 
+  if(!graph.isNull())
+    return fetchNodeGraph(id, true /* loadEdges */);
+
   nodeByIdQuery->bindValue(":id", id);
   nodeByIdQuery->exec();
+  numQueries++;
   nw::Node node;
 
   if(nodeByIdQuery->next())
@@ -347,6 +550,7 @@ nw::Node RouteNetwork::fetchNode(int id)
     // Add ingoing edges
     edgeToQuery->bindValue(":id", id);
     edgeToQuery->exec();
+    numQueries++;
 
     while(edgeToQuery->next())
     {
@@ -358,6 +562,7 @@ nw::Node RouteNetwork::fetchNode(int id)
     // Add outgoing edges
     edgeFromQuery->bindValue(":id", id);
     edgeFromQuery->exec();
+    numQueries++;
 
     while(edgeFromQuery->next())
     {
@@ -375,6 +580,88 @@ nw::Node RouteNetwork::fetchNode(int id)
   return node;
 }
 
+/* Create a node from the preloaded graph including all edges if loadEdges is true.
+ * The node is not cached since building it is cheap. */
+nw::Node RouteNetwork::fetchNodeGraph(int id, bool loadEdges)
+{
+  nw::Node node;
+  int index = graph->indexOf(id);
+  if(index == -1)
+    return node;
+
+  node.id = id;
+  node.type = nodeType(graph->getType(index));
+  node.subtype = nodeSubtype(graph->getType(index));
+  node.range = graph->getRange(index);
+  node.pos = graph->getPos(index);
+
+  if(!loadEdges)
+    return node;
+
+  // Keeps capacity and does not allocate if the node of the last call is already destroyed
+  graphEdges.resize(0);
+
+  int begin = graph->getEdgeBegin(index), end = graph->getEdgeEnd(index);
+  for(int e = begin; e < end; e++)
+  {
+    int toIndex = graph->getEdgeTo(e);
+
+    // Skip chain of airway waypoints if possible
+    int shortcut = shortcuts.isNull() ? -1 : shortcuts->getShortcut(e);
+    if(shortcut != -1 && isShortcutNearDestination(shortcut))
+      shortcut = -1;
+
+    if(shortcut != -1)
+    {
+      if(shortcuts->getMinAltFt(shortcut) > shortcuts->getMaxAltFt(shortcut))
+        // No altitude fits all segments - chain cannot be passed
+        continue;
+
+      toIndex = shortcuts->getTarget(shortcut);
+    }
+
+    if(!testType(static_cast<nw::NodeType>(graph->getType(toIndex))))
+      continue;
+
+    Edge edge;
+    edge.toNodeId = graph->getNodeId(toIndex);
+    edge.type = static_cast<nw::EdgeType>(graph->getEdgeType(e));
+
+    if(shortcut != -1)
+    {
+      edge.shortcut = shortcut;
+      edge.lengthMeter = shortcuts->getLengthMeter(shortcut);
+      edge.minAltFt = shortcuts->getMinAltFt(shortcut);
+      edge.maxAltFt = shortcuts->getMaxAltFt(shortcut);
+
+      // Airway of the last segment leading to the target node
+      edge.airwayId = graph->getEdgeAirwayId(shortcuts->getSegmentEdge(shortcuts->getSegmentsEnd(shortcut) - 1));
+      edge.direction = shortcuts->isBackward(shortcut) ? nw::BACKWARD : nw::BOTH;
+    }
+    else
+    {
+      edge.lengthMeter = graph->getEdgeLength(e);
+      edge.minAltFt = graph->getEdgeMinAlt(e);
+      edge.maxAltFt = graph->getEdgeMaxAlt(e);
+      edge.airwayId = graph->getEdgeAirwayId(e);
+      edge.direction = static_cast<nw::EdgeDirection>(graph->getEdgeDirection(e));
+    }
+
+    // Interned string - only the reference is copied
+    edge.airwayNameId = graph->getEdgeAirwayNameId(e);
+    edge.airwayName = graph->getAirwayName(edge.airwayNameId);
+    graphEdges.append(edge);
+  }
+
+  // Add virtual edge to destination. Not recorded in destinationNodePredecessors since node is not cached.
+  if(destinationPos.isValid() && destinationNodeRect.contains(node.pos))
+    graphEdges.append(Edge(DESTINATION_NODE_ID, static_cast<int>(node.pos.distanceMeterTo(destinationPos))));
+
+  // Implicitly shared - no copy
+  node.edges = graphEdges;
+  return node;
+}
+
 void RouteNetwork::initQueries()
 {
   QString nodeCols = nodeExtraCols.join(",");
@@ -391,11 +678,6 @@ void RouteNetwork::initQueries()
   nodeNavIdAndTypeQuery = new SqlQuery(db);
   nodeNavIdAndTypeQuery->prepare("select nav_id, type from " + nodeTable + " where node_id = :id");
 
-  nearestNodesQuery = new SqlQuery(db);
-  nearestNodesQuery->prepare(
-    "select node_id, type, lonx, laty from " + nodeTable +
-    " where lonx between :leftx and :rightx and laty between :bottomy and :topy");
-
   nodeByIdQuery = new SqlQuery(db);
   nodeByIdQuery->prepare(
     "select " + nodeCols + " type, lonx, laty from " + nodeTable + " where node_id = :id");
@@ -415,15 +697,18 @@ void RouteNetwork::deInitQueries()
 {
   clearStartAndDestinationNodes();
 
+  // Database might change - reload on next use
+  graph.clear();
+  grid.clear();
+  landmarks.clear();
+  shortcuts.clear();
+
   delete nodeByNavIdQuery;
   nodeByNavIdQuery = nullptr;
 
   delete nodeNavIdAndTypeQuery;
   nodeNavIdAndTypeQuery = nullptr;
 
-  delete nearestNodesQuery;
-  nearestNodesQuery = nullptr;
-
   delete nodeByIdQuery;
   nodeByIdQuery = nullptr;
 
@@ -441,13 +726,8 @@ nw::Node RouteNetwork::createNode(const SqlRecord& rec)
   updateNodeIndexes(rec);
   Node node;
 
-  if(airwayRouting)
-  {
-    node.type = static_cast<nw::NodeType>(rec.valueInt(nodeTypeIndex) >> 4);
-    node.subtype = static_cast<nw::NodeType>(rec.valueInt(nodeTypeIndex) & 0x0f);
-  }
-  else
-    node.type = static_cast<nw::NodeType>(rec.valueInt(nodeTypeIndex));
+  node.type = nodeType(rec.valueInt(nodeTypeIndex));
+  node.subtype = nodeSubtype(rec.valueInt(nodeTypeIndex));
 
   if(nodeRangeIndex != -1)
     // Add range if part of the extra columns
@@ -457,6 +737,25 @@ nw::Node RouteNetwork::createNode(const SqlRecord& rec)
   return node;
 }
 
+/* Get node type from database value */
+nw::NodeType RouteNetwork::nodeType(int typeVal) const
+{
+  if(airwayRouting)
+    // This is an airway network which has the type in the upper four bits
+    return static_cast<nw::NodeType>(typeVal >> 4);
+  else
+    return static_cast<nw::NodeType>(typeVal);
+}
+
+/* Get node subtype from database value. Only airway networks have a subtype. */
+nw::NodeType RouteNetwork::nodeSubtype(int typeVal) const
+{
+  if(airwayRouting)
+    return static_cast<nw::NodeType>(typeVal & 0x0f);
+  else
+    return nw::NONE;
+}
+
 /* Update node index caches to avoid string lookups in SqlRecord */
 void RouteNetwork::updateNodeIndexes(const SqlRecord& rec)
 {
@@ -513,8 +812,19 @@ nw::Edge RouteNetwork::createEdge(const atools::sql::SqlRecord& rec, int toNodeI
     edge.airwayId = rec.valueInt(edgeAirwayIdIndex);
 
   if(edgeAirwayNameIndex != -1)
+  {
     edge.airwayName = rec.valueStr(edgeAirwayNameIndex);
 
+    if(!edge.airwayName.isEmpty())
+    {
+      // Intern name to allow fast comparison
+      auto it = airwayNameIds.find(edge.airwayName);
+      if(it == airwayNameIds.end())
+        it = airwayNameIds.insert(edge.airwayName, airwayNameIds.size());
+      edge.airwayNameId = it.value();
+    }
+  }
+
   if(edgeDistanceIndex != -1)
     edge.lengthMeter = rec.valueInt(edgeDistanceIndex);
   return edge;
@@ -593,11 +903,3 @@ bool RouteNetwork::testType(nw::NodeType type)
 
   return false;
 }
-
-void RouteNetwork::bindCoordRect(const atools::geo::Rect& rect, atools::sql::SqlQuery *query)
-{
-  query->bindValue(":leftx", rect.getWest());
-  query->bindValue(":rightx", rect.getEast());
-  query->bindValue(":bottomy", rect.getSouth());
-  query->bindValue(":topy", rect.getNorth());
-}
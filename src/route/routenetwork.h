@@ -22,8 +22,11 @@
 #include "geo/calculations.h"
 
 #include <QHash>
+#include <QSharedPointer>
 #include <QVector>
 
+#include <functional>
+
 namespace  atools {
 namespace sql {
 class SqlDatabase;
@@ -90,17 +93,19 @@ struct Edge
 
   Edge()
     : toNodeId(-1), lengthMeter(0), minAltFt(MIN_ALTITUDE), maxAltFt(MAX_ALTITUDE), airwayId(-1),
-    type(nw::AIRWAY_NONE), direction(nw::BOTH)
+    airwayNameId(-1), shortcut(-1), type(nw::AIRWAY_NONE), direction(nw::BOTH)
   {
   }
 
   Edge(int to, int distance)
     : toNodeId(to), lengthMeter(distance), minAltFt(MIN_ALTITUDE), maxAltFt(MAX_ALTITUDE), airwayId(-1),
-    type(nw::AIRWAY_NONE), direction(nw::BOTH)
+    airwayNameId(-1), shortcut(-1), type(nw::AIRWAY_NONE), direction(nw::BOTH)
   {
   }
 
-  int toNodeId /* database "node_id" */, lengthMeter, minAltFt, maxAltFt, airwayId;
+  int toNodeId /* database "node_id" */, lengthMeter, minAltFt, maxAltFt, airwayId,
+      airwayNameId /* Interned airway name which is unique within the network or -1 if not an airway */,
+      shortcut /* Index into RouteNetworkShortcuts if edge skips a chain of airway waypoints or -1 */;
   nw::EdgeType type;
   nw::EdgeDirection direction;
   QString airwayName;
@@ -167,6 +172,11 @@ inline int qHash(const nw::Node& node)
 Q_DECLARE_TYPEINFO(nw::Node, Q_MOVABLE_TYPE);
 Q_DECLARE_TYPEINFO(nw::Edge, Q_MOVABLE_TYPE);
 
+class RouteNetworkGraph;
+class RouteNetworkGrid;
+class RouteLandmarks;
+class RouteNetworkShortcuts;
+
 /*
  * Routing network that loads and caches nodes and edges from the database.
  * Allows to resolve relations between objects and walk through the network.
@@ -196,7 +206,8 @@ public:
   /* Disconnect queries from database and remove departure and destination nodes */
   void deInitQueries();
 
-  /* Get all adjacent nodes and attached edges for the given node */
+  /* Get all adjacent nodes and attached edges for the given node.
+   * Adjacent nodes built from the preloaded graph are returned without edges. */
   void getNeighbours(const nw::Node& from, QVector<nw::Node>& neighbours, QVector<nw::Edge>& edges);
 
   /* Integrate departure and destination positions into the network as virtual nodes/edges */
@@ -217,6 +228,12 @@ public:
   /* Number of nodes in the memory cache */
   int getNumberOfNodesCache() const;
 
+  /* Number of SQL queries executed while routing since creation of this network */
+  int getNumberOfQueries() const
+  {
+    return numQueries;
+  }
+
   /* true if mode is either ROUTE_VICTOR, ROUTE_JET  or both flags */
   bool isAirwayRouting() const
   {
@@ -226,7 +243,81 @@ public:
   /* Sets the route mode. This will change some internal behavior like checking subtypes and more */
   void setMode(nw::Modes routeMode);
 
+  /* Load the whole network once into a compact in-memory graph instead of fetching nodes on demand.
+   * No SQL queries are needed while routing if enabled. The graph is loaded on first use and
+   * dropped in deInitQueries. Stays enabled if landmarks or shortcuts are used. */
+  void setPreload(bool value);
+
+  bool isPreload() const
+  {
+    return preload;
+  }
+
+  /* Read or calculate a landmark distance table for the ALT heuristic. Implies preload.
+   * The table is saved in a file beside the database. */
+  void setLandmarks(bool value);
+
+  /* Read or calculate a shortcut overlay skipping airway waypoints between junctions. Implies preload.
+   * The overlay is saved in a file beside the database. */
+  void setShortcuts(bool value);
+
+  /* Preloaded graph or null if not available */
+  const RouteNetworkGraph *getGraph() const
+  {
+    return graph.data();
+  }
+
+  /* Landmark table for the graph or null if not available */
+  const RouteLandmarks *getLandmarks() const
+  {
+    return landmarks.data();
+  }
+
+  /* Shortcut overlay for graph or null if not available */
+  const RouteNetworkShortcuts *getShortcuts() const
+  {
+    return shortcuts.data();
+  }
+
+  /* Immutable data loaded on demand which can be shared between networks in different threads */
+  struct SharedData
+  {
+    QSharedPointer<const RouteNetworkGraph> graph;
+    QSharedPointer<const RouteNetworkGrid> grid;
+    QSharedPointer<const RouteLandmarks> landmarks;
+    QSharedPointer<const RouteNetworkShortcuts> shortcuts;
+  };
+
+  /* Get preloaded graph, node grid, landmarks and shortcuts to pass them to another network on the same tables */
+  SharedData getSharedData() const;
+
+  /* Use data loaded by another network. Missing parts are loaded on next use. */
+  void setSharedData(const SharedData& data);
+
+  /* Get dense graph indexes and virtual edge lengths of all graph nodes which are connected to the destination.
+   * Only available if the graph is preloaded. */
+  void getDestinationPredecessors(QVector<std::pair<int, int> >& predecessors) const;
+
+  /* Load graph if preload or landmarks are enabled and not done yet. Loads the node grid too.
+   * Called automatically by addDepartureAndDestinationNodes. */
+  void loadGraph();
+
+  /* Called periodically while loading the graph. Graph, landmarks and shortcuts are not loaded if it returns
+   * true. They are loaded again on next use. */
+  void setCancelCallback(const std::function<bool()>& callback)
+  {
+    cancelCallback = callback;
+  }
+
 private:
+  void loadLandmarks();
+  void loadShortcuts();
+  QString sidecarFilename(const QString& suffix) const;
+  bool isShortcutNearDestination(int shortcut) const;
+  nw::Node fetchNodeGraph(int id, bool loadEdges);
+  nw::NodeType nodeType(int typeVal) const;
+  nw::NodeType nodeSubtype(int typeVal) const;
+
   void clearStartAndDestinationNodes();
 
   nw::Node fetchNodeByNavId(int id, nw::NodeType type);
@@ -236,7 +327,6 @@ private:
   void addDestNodeEdges(nw::Node& node);
   void cleanDestNodeEdges();
 
-  void bindCoordRect(const atools::geo::Rect& rect, atools::sql::SqlQuery *query);
   bool testType(nw::NodeType type);
   nw::Node createNode(const atools::sql::SqlRecord& rec);
   nw::Edge createEdge(const atools::sql::SqlRecord& rec, int toNodeId, bool reverseDirection);
@@ -244,6 +334,9 @@ private:
   void updateNodeIndexes(const atools::sql::SqlRecord& rec);
   void updateEdgeIndexes(const atools::sql::SqlRecord& rec);
 
+  /* Number of landmarks for the ALT heuristic */
+  static Q_DECL_CONSTEXPR int NUM_LANDMARKS = 16;
+
   /* Search radius for nodes around departure and destination position */
   static Q_DECL_CONSTEXPR int NODE_SEARCH_RADIUS_METER = atools::geo::nmToMeter(200);
 
@@ -255,9 +348,11 @@ private:
   /* Cache the number of nodes in the database */
   int numNodesDb = -1;
 
+  /* Statistics */
+  int numQueries = 0;
+
   atools::sql::SqlQuery *nodeByNavIdQuery = nullptr, *nodeNavIdAndTypeQuery = nullptr,
-                        *nearestNodesQuery = nullptr, *nodeByIdQuery = nullptr, *edgeToQuery = nullptr,
-                        *edgeFromQuery = nullptr;
+                        *nodeByIdQuery = nullptr, *edgeToQuery = nullptr, *edgeFromQuery = nullptr;
 
   /* Bounding rectangle around destination used to find virtual successor edges */
   atools::geo::Rect destinationNodeRect;
@@ -269,9 +364,34 @@ private:
   atools::sql::SqlDatabase *db;
   nw::Modes mode;
 
-  /* Cache for nodes (also containing edges) for the whole network. Filled on demand. */
+  /* Maps airway names to ids for nw::Edge::airwayNameId if not using the graph */
+  QHash<QString, int> airwayNameIds;
+
+  /* Cache for nodes (also containing edges) for the whole network. Filled on demand.
+   * Contains only the virtual departure and destination nodes if the graph is preloaded. */
   QHash<int, nw::Node> nodeCache;
 
+  /* Buffer for edges of nodes built from the graph. Shared with the node returned by the last fetchNodeGraph
+   * call and reused without allocation once that node is gone. */
+  QVector<nw::Edge> graphEdges;
+
+  /* Complete network if preload is enabled. Null otherwise. */
+  QSharedPointer<const RouteNetworkGraph> graph;
+  bool preload = false;
+
+  /* Spatial index of all node positions used to attach departure and destination. Loaded on first use. */
+  QSharedPointer<const RouteNetworkGrid> grid;
+
+  /* Landmark distances for graph if enabled. Null otherwise. */
+  QSharedPointer<const RouteLandmarks> landmarks;
+  bool useLandmarks = false;
+
+  /* Shortcut overlay for graph if enabled. Null otherwise. */
+  QSharedPointer<const RouteNetworkShortcuts> shortcuts;
+  bool useShortcuts = false;
+
+  std::function<bool()> cancelCallback;
+
   /* Database tables and extra columns */
   QString nodeTable, edgeTable;
   QStringList nodeExtraCols, edgeExtraCols;
@@ -0,0 +1,316 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "route/routenetworkgraph.h"
+
+#include "route/routenetwork.h"
+#include "sql/sqldatabase.h"
+#include "sql/sqlquery.h"
+#include "sql/sqlutil.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+
+using atools::sql::SqlDatabase;
+using atools::sql::SqlQuery;
+
+namespace  {
+/* Number of loaded rows between two checks of the cancel callback */
+const int CANCEL_CHECK_ROWS = 10000;
+
+/* Temporary edge as loaded from the database. From and to are dense node indexes. */
+struct EdgeRow
+{
+  int from, to, length, minAlt, maxAlt, airwayId, airwayNameId;
+  quint8 type, direction;
+};
+
+}
+
+RouteNetworkGraph::RouteNetworkGraph()
+{
+
+}
+
+RouteNetworkGraph::~RouteNetworkGraph()
+{
+
+}
+
+bool RouteNetworkGraph::load(SqlDatabase *db, const QString& nodeTable, const QString& edgeTable,
+                             const QStringList& nodeExtraColumns, const QStringList& edgeExtraColumns,
+                             const std::function<bool()>& cancelled)
+{
+  clear();
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // Load nodes ===============================================================
+  int numNodesDb = atools::sql::SqlUtil(db).rowCount(nodeTable);
+  nodeIds.reserve(numNodesDb);
+  nodeNavIds.reserve(numNodesDb);
+  nodeTypes.reserve(numNodesDb);
+  nodeLonX.reserve(numNodesDb);
+  nodeLatY.reserve(numNodesDb);
+
+  bool hasRange = nodeExtraColumns.contains("range");
+  if(hasRange)
+    nodeRanges.reserve(numNodesDb);
+
+  int maxNodeId = 0;
+  SqlQuery nodeQuery(db);
+  nodeQuery.exec("select node_id, nav_id, type, lonx, laty" + QString(hasRange ? ", range" : "") +
+                 " from " + nodeTable);
+  while(nodeQuery.next())
+  {
+    if(nodeIds.size() % CANCEL_CHECK_ROWS == 0 && cancelled && cancelled())
+    {
+      clear();
+      return false;
+    }
+
+    int nodeId = nodeQuery.valueInt(0);
+    maxNodeId = std::max(maxNodeId, nodeId);
+
+    nodeIds.append(nodeId);
+    nodeNavIds.append(nodeQuery.valueInt(1));
+    nodeTypes.append(static_cast<quint8>(nodeQuery.valueInt(2)));
+    nodeLonX.append(nodeQuery.valueFloat(3));
+    nodeLatY.append(nodeQuery.valueFloat(4));
+    if(hasRange)
+      nodeRanges.append(nodeQuery.valueInt(5));
+  }
+  nodeQuery.finish();
+
+  // Database ids are dense - use a plain array to map them to indexes
+  indexById.fill(-1, maxNodeId + 1);
+  for(int i = 0; i < nodeIds.size(); i++)
+    indexById[nodeIds.at(i)] = i;
+
+  // Load edges into temporary list ===========================================
+  // Column indexes of extra columns - first two are from and to node id
+  int typeIdx = edgeExtraColumns.indexOf("type"), directionIdx = edgeExtraColumns.indexOf("direction"),
+      minAltIdx = edgeExtraColumns.indexOf("minimum_altitude"), maxAltIdx = edgeExtraColumns.indexOf("maximum_altitude"),
+      airwayIdIdx = edgeExtraColumns.indexOf("airway_id"), airwayNameIdx = edgeExtraColumns.indexOf("airway_name"),
+      distanceIdx = edgeExtraColumns.indexOf("distance");
+
+  QString edgeCols = edgeExtraColumns.join(", ");
+  if(!edgeExtraColumns.isEmpty())
+    edgeCols.prepend(", ");
+
+  QHash<QString, int> airwayNameIds;
+  QVector<EdgeRow> rows;
+  rows.reserve(atools::sql::SqlUtil(db).rowCount(edgeTable));
+
+  SqlQuery edgeQuery(db);
+  edgeQuery.exec("select from_node_id, to_node_id" + edgeCols + " from " + edgeTable);
+  while(edgeQuery.next())
+  {
+    if(rows.size() % CANCEL_CHECK_ROWS == 0 && cancelled && cancelled())
+    {
+      clear();
+      return false;
+    }
+
+    EdgeRow row;
+    row.from = indexOf(edgeQuery.valueInt(0));
+    row.to = indexOf(edgeQuery.valueInt(1));
+
+    if(row.from == -1 || row.to == -1 || row.from == row.to)
+      // Not part of the network or loop
+      continue;
+
+    row.type = static_cast<quint8>(typeIdx != -1 ? edgeQuery.valueInt(typeIdx + 2) : nw::AIRWAY_NONE);
+    row.direction = static_cast<quint8>(directionIdx != -1 ? edgeQuery.valueInt(directionIdx + 2) : nw::BOTH);
+
+    // Zero means no restriction
+    row.minAlt = minAltIdx != -1 ? edgeQuery.valueInt(minAltIdx + 2) : 0;
+    if(row.minAlt <= 0)
+      row.minAlt = nw::Edge::MIN_ALTITUDE;
+    row.maxAlt = maxAltIdx != -1 ? edgeQuery.valueInt(maxAltIdx + 2) : 0;
+    if(row.maxAlt <= 0)
+      row.maxAlt = nw::Edge::MAX_ALTITUDE;
+
+    row.airwayId = airwayIdIdx != -1 ? edgeQuery.valueInt(airwayIdIdx + 2) : -1;
+    row.length = distanceIdx != -1 ? edgeQuery.valueInt(distanceIdx + 2) : 0;
+
+    row.airwayNameId = -1;
+    if(airwayNameIdx != -1)
+    {
+      QString name = edgeQuery.valueStr(airwayNameIdx + 2);
+      if(!name.isEmpty())
+      {
+        auto it = airwayNameIds.find(name);
+        if(it == airwayNameIds.end())
+        {
+          it = airwayNameIds.insert(name, airwayNames.size());
+          airwayNames.append(name);
+        }
+        row.airwayNameId = it.value();
+      }
+    }
+    rows.append(row);
+  }
+  edgeQuery.finish();
+
+  // Build compressed sparse row layout =======================================
+  int numNodes = nodeIds.size();
+
+  // Count edges per node - every row is added in both directions
+  edgeOffset.fill(0, numNodes + 1);
+  for(const EdgeRow& row : rows)
+  {
+    edgeOffset[row.from + 1]++;
+    edgeOffset[row.to + 1]++;
+  }
+
+  for(int i = 0; i < numNodes; i++)
+    edgeOffset[i + 1] += edgeOffset.at(i);
+
+  int numEdges = edgeOffset.at(numNodes);
+  edgeTo.resize(numEdges);
+  edgeLength.resize(numEdges);
+  edgeMinAlt.resize(numEdges);
+  edgeMaxAlt.resize(numEdges);
+  edgeAirwayId.resize(numEdges);
+  edgeAirwayNameId.resize(numEdges);
+  edgeType.resize(numEdges);
+  edgeDirection.resize(numEdges);
+
+  auto setEdge = [this](int edge, const EdgeRow& row, int to, bool reverseDirection)
+  {
+    edgeTo[edge] = to;
+    edgeLength[edge] = row.length;
+    edgeMinAlt[edge] = row.minAlt;
+    edgeMaxAlt[edge] = row.maxAlt;
+    edgeAirwayId[edge] = row.airwayId;
+    edgeAirwayNameId[edge] = row.airwayNameId;
+    edgeType[edge] = row.type;
+
+    quint8 direction = row.direction;
+    if(reverseDirection && direction == nw::FORWARD)
+      direction = nw::BACKWARD;
+    else if(reverseDirection && direction == nw::BACKWARD)
+      direction = nw::FORWARD;
+    edgeDirection[edge] = direction;
+  };
+
+  QVector<int> fillIndex(edgeOffset);
+  for(const EdgeRow& row : rows)
+  {
+    // Outgoing edge as stored and ingoing edge with reversed direction
+    setEdge(fillIndex[row.from]++, row, row.to, false /* reverseDirection */);
+    setEdge(fillIndex[row.to]++, row, row.from, true /* reverseDirection */);
+  }
+  rows.clear();
+  rows.squeeze();
+
+  // Remove duplicates with same target and type in place - same as the QSet in RouteNetwork::fetchNode
+  int write = 0;
+  for(int i = 0; i < numNodes; i++)
+  {
+    int begin = edgeOffset.at(i), end = edgeOffset.at(i + 1);
+    edgeOffset[i] = write;
+
+    for(int e = begin; e < end; e++)
+    {
+      bool duplicate = false;
+      for(int k = edgeOffset.at(i); k < write && !duplicate; k++)
+        duplicate = edgeTo.at(k) == edgeTo.at(e) && edgeType.at(k) == edgeType.at(e);
+
+      if(!duplicate)
+      {
+        edgeTo[write] = edgeTo.at(e);
+        edgeLength[write] = edgeLength.at(e);
+        edgeMinAlt[write] = edgeMinAlt.at(e);
+        edgeMaxAlt[write] = edgeMaxAlt.at(e);
+        edgeAirwayId[write] = edgeAirwayId.at(e);
+        edgeAirwayNameId[write] = edgeAirwayNameId.at(e);
+        edgeType[write] = edgeType.at(e);
+        edgeDirection[write] = edgeDirection.at(e);
+        write++;
+      }
+    }
+  }
+  edgeOffset[numNodes] = write;
+
+  edgeTo.resize(write);
+  edgeLength.resize(write);
+  edgeMinAlt.resize(write);
+  edgeMaxAlt.resize(write);
+  edgeAirwayId.resize(write);
+  edgeAirwayNameId.resize(write);
+  edgeType.resize(write);
+  edgeDirection.resize(write);
+
+  edgeTo.squeeze();
+  edgeLength.squeeze();
+  edgeMinAlt.squeeze();
+  edgeMaxAlt.squeeze();
+  edgeAirwayId.squeeze();
+  edgeAirwayNameId.squeeze();
+  edgeType.squeeze();
+  edgeDirection.squeeze();
+
+  qDebug() << Q_FUNC_INFO << nodeTable << "nodes" << numNodes << "edges" << write
+           << "airway names" << airwayNames.size()
+           << "memory" << getMemorySize() / 1024 << "kB" << "time" << timer.elapsed() << "ms";
+  return true;
+}
+
+void RouteNetworkGraph::clear()
+{
+  indexById.clear();
+  nodeIds.clear();
+  nodeNavIds.clear();
+  nodeRanges.clear();
+  nodeTypes.clear();
+  nodeLonX.clear();
+  nodeLatY.clear();
+  edgeOffset.clear();
+  edgeTo.clear();
+  edgeLength.clear();
+  edgeMinAlt.clear();
+  edgeMaxAlt.clear();
+  edgeAirwayId.clear();
+  edgeAirwayNameId.clear();
+  edgeType.clear();
+  edgeDirection.clear();
+  airwayNames.clear();
+}
+
+const QString& RouteNetworkGraph::getAirwayName(int nameId) const
+{
+  return nameId == -1 ? emptyName : airwayNames.at(nameId);
+}
+
+qint64 RouteNetworkGraph::getMemorySize() const
+{
+  qint64 size = 0;
+  size += (indexById.size() + nodeIds.size() + nodeNavIds.size() + nodeRanges.size()) * sizeof(int);
+  size += nodeTypes.size() * sizeof(quint8);
+  size += (nodeLonX.size() + nodeLatY.size()) * sizeof(float);
+  size += (edgeOffset.size() + edgeTo.size() + edgeLength.size() + edgeMinAlt.size() + edgeMaxAlt.size() +
+           edgeAirwayId.size() + edgeAirwayNameId.size()) * sizeof(int);
+  size += (edgeType.size() + edgeDirection.size()) * sizeof(quint8);
+
+  for(const QString& name : airwayNames)
+    size += name.size() * sizeof(QChar);
+  return size;
+}
@@ -0,0 +1,200 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_ROUTENETWORKGRAPH_H
+#define LITTLENAVMAP_ROUTENETWORKGRAPH_H
+
+#include "geo/pos.h"
+
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+namespace  atools {
+namespace sql {
+class SqlDatabase;
+}
+}
+
+/*
+ * Compact read only copy of a complete routing network that is loaded once from the database.
+ *
+ * Uses a compressed sparse row layout: node attributes are kept in separate arrays indexed by a dense node index.
+ * Edges of the node with index i are stored in the range getEdgeBegin(i) to getEdgeEnd(i) of the edge arrays.
+ * Edges are added for both directions like RouteNetwork does. Airway names are interned and stored as ids.
+ *
+ * Instances are never changed after loading and can be shared between several RouteNetwork objects.
+ */
+class RouteNetworkGraph
+{
+public:
+  RouteNetworkGraph();
+  ~RouteNetworkGraph();
+
+  /* Load all nodes and edges from the given tables. Tables and columns are the same as used by RouteNetwork.
+   * cancelled is called periodically if set. Returns false and leaves the graph empty if it returned true. */
+  bool load(atools::sql::SqlDatabase *db, const QString& nodeTable, const QString& edgeTable,
+            const QStringList& nodeExtraColumns, const QStringList& edgeExtraColumns,
+            const std::function<bool()>& cancelled = nullptr);
+
+  /* Remove all nodes and edges and free memory */
+  void clear();
+
+  bool isEmpty() const
+  {
+    return nodeIds.isEmpty();
+  }
+
+  /* Number of nodes */
+  int size() const
+  {
+    return nodeIds.size();
+  }
+
+  /* Number of edges including the reverse ones */
+  int getNumEdges() const
+  {
+    return edgeTo.size();
+  }
+
+  /* Get dense node index for database "node_id" or -1 if not found */
+  int indexOf(int nodeId) const
+  {
+    return nodeId >= 0 && nodeId < indexById.size() ? indexById.at(nodeId) : -1;
+  }
+
+  /* Node attributes by dense node index */
+  int getNodeId(int index) const
+  {
+    return nodeIds.at(index);
+  }
+
+  int getNavId(int index) const
+  {
+    return nodeNavIds.at(index);
+  }
+
+  /* Raw database type. Airway networks have the type in the upper four bits and the subtype in the lower ones */
+  int getType(int index) const
+  {
+    return nodeTypes.at(index);
+  }
+
+  /* Range of radio navaid or 0 if not applicable */
+  int getRange(int index) const
+  {
+    return nodeRanges.isEmpty() ? 0 : nodeRanges.at(index);
+  }
+
+  float getLonX(int index) const
+  {
+    return nodeLonX.at(index);
+  }
+
+  float getLatY(int index) const
+  {
+    return nodeLatY.at(index);
+  }
+
+  atools::geo::Pos getPos(int index) const
+  {
+    return atools::geo::Pos(nodeLonX.at(index), nodeLatY.at(index));
+  }
+
+  /* First edge index of node */
+  int getEdgeBegin(int index) const
+  {
+    return edgeOffset.at(index);
+  }
+
+  /* Edge index after the last edge of node */
+  int getEdgeEnd(int index) const
+  {
+    return edgeOffset.at(index + 1);
+  }
+
+  /* Edge attributes by edge index. getEdgeTo returns the dense node index of the target node. */
+  int getEdgeTo(int edge) const
+  {
+    return edgeTo.at(edge);
+  }
+
+  int getEdgeLength(int edge) const
+  {
+    return edgeLength.at(edge);
+  }
+
+  int getEdgeMinAlt(int edge) const
+  {
+    return edgeMinAlt.at(edge);
+  }
+
+  int getEdgeMaxAlt(int edge) const
+  {
+    return edgeMaxAlt.at(edge);
+  }
+
+  int getEdgeAirwayId(int edge) const
+  {
+    return edgeAirwayId.at(edge);
+  }
+
+  /* Index into getAirwayName or -1 if edge has no airway */
+  int getEdgeAirwayNameId(int edge) const
+  {
+    return edgeAirwayNameId.at(edge);
+  }
+
+  int getEdgeType(int edge) const
+  {
+    return edgeType.at(edge);
+  }
+
+  int getEdgeDirection(int edge) const
+  {
+    return edgeDirection.at(edge);
+  }
+
+  /* Get interned airway name by id. Returns an empty string for id -1. */
+  const QString& getAirwayName(int nameId) const;
+
+  /* Approximate memory used by all arrays in bytes */
+  qint64 getMemorySize() const;
+
+private:
+  /* Maps "node_id" to dense index */
+  QVector<int> indexById;
+
+  /* Node arrays indexed by dense index */
+  QVector<int> nodeIds, nodeNavIds, nodeRanges;
+  QVector<quint8> nodeTypes;
+  QVector<float> nodeLonX, nodeLatY;
+
+  /* Size is number of nodes + 1 */
+  QVector<int> edgeOffset;
+
+  /* Edge arrays indexed by edge index */
+  QVector<int> edgeTo, edgeLength, edgeMinAlt, edgeMaxAlt, edgeAirwayId, edgeAirwayNameId;
+  QVector<quint8> edgeType, edgeDirection;
+
+  /* Interned airway names */
+  QStringList airwayNames;
+  QString emptyName;
+};
+
+#endif // LITTLENAVMAP_ROUTENETWORKGRAPH_H
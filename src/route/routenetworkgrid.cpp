@@ -0,0 +1,158 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "route/routenetworkgrid.h"
+
+#include "route/routenetworkgraph.h"
+#include "geo/rect.h"
+#include "sql/sqldatabase.h"
+#include "sql/sqlquery.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+
+using atools::sql::SqlQuery;
+
+RouteNetworkGrid::RouteNetworkGrid()
+{
+
+}
+
+RouteNetworkGrid::~RouteNetworkGrid()
+{
+
+}
+
+void RouteNetworkGrid::load(atools::sql::SqlDatabase *db, const QString& nodeTable)
+{
+  clear();
+
+  SqlQuery query(db);
+  query.exec("select node_id, type, lonx, laty from " + nodeTable);
+  while(query.next())
+  {
+    nodeIds.append(query.valueInt(0));
+    nodeTypes.append(query.valueInt(1));
+    nodeLonX.append(query.valueFloat(2));
+    nodeLatY.append(query.valueFloat(3));
+  }
+  query.finish();
+
+  buildCells();
+}
+
+void RouteNetworkGrid::build(const RouteNetworkGraph& graph)
+{
+  clear();
+
+  for(int i = 0; i < graph.size(); i++)
+  {
+    nodeIds.append(graph.getNodeId(i));
+    nodeTypes.append(graph.getType(i));
+    nodeLonX.append(graph.getLonX(i));
+    nodeLatY.append(graph.getLatY(i));
+  }
+
+  buildCells();
+}
+
+void RouteNetworkGrid::clear()
+{
+  cellOffset.clear();
+  nodeIds.clear();
+  nodeTypes.clear();
+  nodeLonX.clear();
+  nodeLatY.clear();
+}
+
+void RouteNetworkGrid::buildCells()
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  int numEntries = nodeIds.size();
+
+  // Count entries per cell
+  QVector<int> cells(numEntries);
+  cellOffset.fill(0, CELLS_X * CELLS_Y + 1);
+  for(int i = 0; i < numEntries; i++)
+  {
+    cells[i] = cellY(nodeLatY.at(i)) * CELLS_X + cellX(nodeLonX.at(i));
+    cellOffset[cells.at(i) + 1]++;
+  }
+
+  for(int c = 0; c < CELLS_X * CELLS_Y; c++)
+    cellOffset[c + 1] += cellOffset.at(c);
+
+  // Sort entries into cells
+  QVector<int> sortedIds(numEntries), sortedTypes(numEntries);
+  QVector<float> sortedLonX(numEntries), sortedLatY(numEntries);
+  QVector<int> fillIndex(cellOffset);
+  for(int i = 0; i < numEntries; i++)
+  {
+    int index = fillIndex[cells.at(i)]++;
+    sortedIds[index] = nodeIds.at(i);
+    sortedTypes[index] = nodeTypes.at(i);
+    sortedLonX[index] = nodeLonX.at(i);
+    sortedLatY[index] = nodeLatY.at(i);
+  }
+
+  nodeIds.swap(sortedIds);
+  nodeTypes.swap(sortedTypes);
+  nodeLonX.swap(sortedLonX);
+  nodeLatY.swap(sortedLatY);
+
+  qDebug() << Q_FUNC_INFO << "entries" << numEntries << "time" << timer.elapsed() << "ms";
+}
+
+void RouteNetworkGrid::getNodes(const atools::geo::Rect& rect, QVector<int>& entries) const
+{
+  if(isEmpty())
+    return;
+
+  for(const atools::geo::Rect& r : rect.splitAtAntiMeridian())
+  {
+    float west = r.getWest(), east = r.getEast(), south = r.getSouth(), north = r.getNorth();
+
+    for(int y = cellY(south); y <= cellY(north); y++)
+    {
+      for(int x = cellX(west); x <= cellX(east); x++)
+      {
+        int cell = y * CELLS_X + x;
+        for(int entry = cellOffset.at(cell); entry < cellOffset.at(cell + 1); entry++)
+        {
+          float lonX = nodeLonX.at(entry), latY = nodeLatY.at(entry);
+          if(lonX >= west && lonX <= east && latY >= south && latY <= north)
+            entries.append(entry);
+        }
+      }
+    }
+  }
+}
+
+int RouteNetworkGrid::cellX(float lonX) const
+{
+  return std::min(std::max(static_cast<int>(std::floor(lonX + 180.f)), 0), CELLS_X - 1);
+}
+
+int RouteNetworkGrid::cellY(float latY) const
+{
+  return std::min(std::max(static_cast<int>(std::floor(latY + 90.f)), 0), CELLS_Y - 1);
+}
@@ -0,0 +1,99 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_ROUTENETWORKGRID_H
+#define LITTLENAVMAP_ROUTENETWORKGRID_H
+
+#include "geo/pos.h"
+
+#include <QVector>
+
+namespace  atools {
+namespace sql {
+class SqlDatabase;
+}
+namespace geo {
+class Rect;
+}
+}
+
+class RouteNetworkGraph;
+
+/*
+ * Uniform one degree grid over all node positions of a routing network. Allows fast rectangle lookups without
+ * SQL queries when attaching the virtual departure and destination nodes to the network.
+ *
+ * Entries are sorted by grid cell and stored in separate arrays.
+ */
+class RouteNetworkGrid
+{
+public:
+  RouteNetworkGrid();
+  ~RouteNetworkGrid();
+
+  /* Load node positions from the given node table */
+  void load(atools::sql::SqlDatabase *db, const QString& nodeTable);
+
+  /* Use node positions of an already loaded graph */
+  void build(const RouteNetworkGraph& graph);
+
+  void clear();
+
+  bool isEmpty() const
+  {
+    return nodeIds.isEmpty();
+  }
+
+  /* Append entry indexes of all nodes inside the rectangle. The rectangle can cross the anti-meridian. */
+  void getNodes(const atools::geo::Rect& rect, QVector<int>& entries) const;
+
+  /* Database "node_id" for entry */
+  int getNodeId(int entry) const
+  {
+    return nodeIds.at(entry);
+  }
+
+  /* Raw database type for entry */
+  int getType(int entry) const
+  {
+    return nodeTypes.at(entry);
+  }
+
+  atools::geo::Pos getPos(int entry) const
+  {
+    return atools::geo::Pos(nodeLonX.at(entry), nodeLatY.at(entry));
+  }
+
+private:
+  /* Sort all entries into cells */
+  void buildCells();
+
+  int cellX(float lonX) const;
+  int cellY(float latY) const;
+
+  static Q_DECL_CONSTEXPR int CELLS_X = 360;
+  static Q_DECL_CONSTEXPR int CELLS_Y = 180;
+
+  /* Size is number of cells + 1 */
+  QVector<int> cellOffset;
+
+  /* Entry arrays */
+  QVector<int> nodeIds, nodeTypes;
+  QVector<float> nodeLonX, nodeLatY;
+};
+
+#endif // LITTLENAVMAP_ROUTENETWORKGRID_H
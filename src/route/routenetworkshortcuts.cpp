@@ -0,0 +1,220 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "route/routenetworkshortcuts.h"
+
+#include "route/routenetwork.h"
+#include "route/routenetworkgraph.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+
+RouteNetworkShortcuts::RouteNetworkShortcuts()
+{
+
+}
+
+RouteNetworkShortcuts::~RouteNetworkShortcuts()
+{
+
+}
+
+void RouteNetworkShortcuts::clear()
+{
+  edgeShortcut.clear();
+  shortcutTarget.clear();
+  shortcutMinAlt.clear();
+  shortcutMaxAlt.clear();
+  shortcutLength.clear();
+  shortcutBackward.clear();
+  shortcutSegmentOffset.clear();
+  segmentEdges.clear();
+}
+
+/* Node in the middle of an airway which connects exactly two other nodes */
+bool RouteNetworkShortcuts::isChainNode(const RouteNetworkGraph& graph, int index) const
+{
+  int edge1 = graph.getEdgeBegin(index), edge2 = edge1 + 1;
+  if(graph.getEdgeEnd(index) - edge1 != 2)
+    return false;
+
+  return graph.getEdgeAirwayNameId(edge1) != -1 &&
+         graph.getEdgeAirwayNameId(edge1) == graph.getEdgeAirwayNameId(edge2) &&
+         graph.getEdgeType(edge1) == graph.getEdgeType(edge2) &&
+         graph.getEdgeTo(edge1) != graph.getEdgeTo(edge2);
+}
+
+void RouteNetworkShortcuts::calculate(const RouteNetworkGraph& graph)
+{
+  clear();
+
+  QElapsedTimer timer;
+  timer.start();
+
+  int numNodes = graph.size();
+  QVector<bool> chainNodes(numNodes, false);
+  for(int i = 0; i < numNodes; i++)
+    chainNodes[i] = isChainNode(graph, i);
+
+  edgeShortcut.fill(-1, graph.getNumEdges());
+  shortcutSegmentOffset.append(0);
+
+  // Create shortcuts only from junctions - chain nodes reached from departure are expanded normally
+  for(int node = 0; node < numNodes; node++)
+  {
+    if(chainNodes.at(node))
+      continue;
+
+    for(int startEdge = graph.getEdgeBegin(node); startEdge < graph.getEdgeEnd(node); startEdge++)
+    {
+      if(!chainNodes.at(graph.getEdgeTo(startEdge)))
+        continue;
+
+      int segmentsBegin = segmentEdges.size();
+      int minAlt = nw::Edge::MIN_ALTITUDE, maxAlt = nw::Edge::MAX_ALTITUDE, length = 0;
+      bool backward = false, valid = true;
+
+      // Follow the chain until the next junction
+      int edge = startEdge, from = node, current = graph.getEdgeTo(startEdge);
+      while(true)
+      {
+        segmentEdges.append(edge);
+        minAlt = std::max(minAlt, graph.getEdgeMinAlt(edge));
+        maxAlt = std::min(maxAlt, graph.getEdgeMaxAlt(edge));
+        backward |= graph.getEdgeDirection(edge) == nw::BACKWARD;
+
+        int lengthMeter = graph.getEdgeLength(edge);
+        if(lengthMeter == 0)
+          // Same as in RouteFinder::expandNode
+          lengthMeter = static_cast<int>(graph.getPos(from).distanceMeterTo(graph.getPos(current)));
+        length += lengthMeter;
+
+        if(current == node || segmentEdges.size() - segmentsBegin > numNodes)
+        {
+          // Airway loops back to the junction
+          valid = false;
+          break;
+        }
+
+        if(!chainNodes.at(current))
+          // Reached junction
+          break;
+
+        // Continue with the edge which does not lead back
+        int nextEdge = graph.getEdgeBegin(current);
+        if(graph.getEdgeTo(nextEdge) == from)
+          nextEdge++;
+
+        from = current;
+        current = graph.getEdgeTo(nextEdge);
+        edge = nextEdge;
+      }
+
+      if(valid)
+      {
+        edgeShortcut[startEdge] = shortcutTarget.size();
+        shortcutTarget.append(current);
+        shortcutMinAlt.append(minAlt);
+        shortcutMaxAlt.append(maxAlt);
+        shortcutLength.append(length);
+        shortcutBackward.append(backward);
+        shortcutSegmentOffset.append(segmentEdges.size());
+      }
+      else
+        segmentEdges.resize(segmentsBegin);
+    }
+  }
+  segmentEdges.squeeze();
+
+  qDebug() << Q_FUNC_INFO << "chain nodes" << chainNodes.count(true) << "shortcuts" << shortcutTarget.size()
+           << "segments" << segmentEdges.size() << "time" << timer.elapsed() << "ms";
+}
+
+bool RouteNetworkShortcuts::read(const QString& filename, const RouteNetworkGraph& graph,
+                                 const QDateTime& timestamp)
+{
+  clear();
+
+  QFile file(filename);
+  if(!file.exists())
+    return false;
+
+  bool ok = false;
+  if(file.open(QIODevice::ReadOnly))
+  {
+    quint32 magic;
+    quint16 version;
+    qint64 fileTimestamp;
+    qint32 numNodes, numEdges;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_5);
+    in >> magic >> version;
+
+    if(magic == FILE_MAGIC_NUMBER && version == FILE_VERSION)
+    {
+      in >> fileTimestamp >> numNodes >> numEdges;
+
+      if(fileTimestamp == timestamp.toMSecsSinceEpoch() && numNodes == graph.size() &&
+         numEdges == graph.getNumEdges())
+      {
+        in >> edgeShortcut >> shortcutTarget >> shortcutMinAlt >> shortcutMaxAlt >> shortcutLength
+        >> shortcutBackward >> shortcutSegmentOffset >> segmentEdges;
+        ok = in.status() == QDataStream::Ok && edgeShortcut.size() == numEdges &&
+             shortcutSegmentOffset.size() == shortcutTarget.size() + 1;
+      }
+      else
+        qInfo() << "Shortcuts" << filename << "are outdated";
+    }
+    else
+      qWarning() << "Cannot read shortcuts" << filename << ". Invalid magic number or version:" << magic << version;
+
+    file.close();
+  }
+  else
+    qWarning() << "Cannot read shortcuts" << filename << ":" << file.errorString();
+
+  if(!ok)
+    clear();
+  return ok;
+}
+
+bool RouteNetworkShortcuts::write(const QString& filename, const RouteNetworkGraph& graph,
+                                  const QDateTime& timestamp) const
+{
+  QFile file(filename);
+  if(file.open(QIODevice::WriteOnly))
+  {
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_5);
+
+    out << FILE_MAGIC_NUMBER << FILE_VERSION << static_cast<qint64>(timestamp.toMSecsSinceEpoch())
+        << static_cast<qint32>(graph.size()) << static_cast<qint32>(graph.getNumEdges())
+        << edgeShortcut << shortcutTarget << shortcutMinAlt << shortcutMaxAlt << shortcutLength
+        << shortcutBackward << shortcutSegmentOffset << segmentEdges;
+    file.close();
+    return true;
+  }
+  else
+  {
+    qWarning() << "Cannot write shortcuts" << filename << ":" << file.errorString();
+    return false;
+  }
+}
@@ -0,0 +1,133 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_ROUTENETWORKSHORTCUTS_H
+#define LITTLENAVMAP_ROUTENETWORKSHORTCUTS_H
+
+#include <QVector>
+
+class RouteNetworkGraph;
+class QDateTime;
+class QString;
+
+/*
+ * Shortcut overlay for an airway network graph.
+ *
+ * A chain node is a node which has exactly two edges of the same airway and type, i.e. a waypoint in the middle
+ * of an airway without any junction. Every graph edge leading into a chain is assigned a shortcut which
+ * skips all following chain nodes up to the next junction node. A shortcut keeps the list of graph edges it
+ * replaces which allows exact cost calculation and unpacking of the route.
+ *
+ * Altitude bands of all segments are combined and one-way segments are honored per travel direction.
+ * The overlay can be saved to and read from a file beside the navigation database.
+ */
+class RouteNetworkShortcuts
+{
+public:
+  RouteNetworkShortcuts();
+  ~RouteNetworkShortcuts();
+
+  /* Find all chains and create shortcuts for the graph */
+  void calculate(const RouteNetworkGraph& graph);
+
+  /* Read overlay from file. Returns false if file does not exist or does not match the graph or timestamp. */
+  bool read(const QString& filename, const RouteNetworkGraph& graph, const QDateTime& timestamp);
+
+  /* Write overlay to file using the timestamp to detect database changes */
+  bool write(const QString& filename, const RouteNetworkGraph& graph, const QDateTime& timestamp) const;
+
+  void clear();
+
+  /* Number of shortcuts */
+  int size() const
+  {
+    return shortcutTarget.size();
+  }
+
+  /* Shortcut for graph edge index or -1 if the edge does not lead into a chain */
+  int getShortcut(int edge) const
+  {
+    return edgeShortcut.isEmpty() ? -1 : edgeShortcut.at(edge);
+  }
+
+  /* Dense node index of the junction node at the end of the chain */
+  int getTarget(int shortcut) const
+  {
+    return shortcutTarget.at(shortcut);
+  }
+
+  /* Combined altitude band of all segments. Minimum is larger than maximum if no altitude fits. */
+  int getMinAltFt(int shortcut) const
+  {
+    return shortcutMinAlt.at(shortcut);
+  }
+
+  int getMaxAltFt(int shortcut) const
+  {
+    return shortcutMaxAlt.at(shortcut);
+  }
+
+  /* Sum of segment lengths in meter */
+  int getLengthMeter(int shortcut) const
+  {
+    return shortcutLength.at(shortcut);
+  }
+
+  /* true if at least one segment is a one-way airway against the travel direction */
+  bool isBackward(int shortcut) const
+  {
+    return shortcutBackward.at(shortcut);
+  }
+
+  /* Range of graph edge indexes in getSegmentEdge() for the shortcut. First is the edge leading into the chain,
+   * last is the edge leading to the target. */
+  int getSegmentsBegin(int shortcut) const
+  {
+    return shortcutSegmentOffset.at(shortcut);
+  }
+
+  int getSegmentsEnd(int shortcut) const
+  {
+    return shortcutSegmentOffset.at(shortcut + 1);
+  }
+
+  int getSegmentEdge(int segment) const
+  {
+    return segmentEdges.at(segment);
+  }
+
+private:
+  bool isChainNode(const RouteNetworkGraph& graph, int index) const;
+
+  static Q_DECL_CONSTEXPR quint32 FILE_MAGIC_NUMBER = 0x7A1D3C5E;
+  static Q_DECL_CONSTEXPR quint16 FILE_VERSION = 1;
+
+  /* Shortcut by graph edge index or -1 */
+  QVector<int> edgeShortcut;
+
+  /* Shortcut arrays */
+  QVector<int> shortcutTarget, shortcutMinAlt, shortcutMaxAlt, shortcutLength;
+  QVector<bool> shortcutBackward;
+
+  /* Size is number of shortcuts + 1 */
+  QVector<int> shortcutSegmentOffset;
+
+  /* Graph edge indexes of all shortcuts */
+  QVector<int> segmentEdges;
+};
+
+#endif // LITTLENAVMAP_ROUTENETWORKSHORTCUTS_H
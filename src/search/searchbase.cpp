@@ -484,6 +484,7 @@ void SearchBaseTable::connectSearchSlots()
   connect(controller->getSqlModel(), &SqlModel::modelReset, this, &SearchBaseTable::reconnectSelectionModel);
   void (SearchBaseTable::*selChangedPtr)() = &SearchBaseTable::tableSelectionChanged;
   connect(controller->getSqlModel(), &SqlModel::fetchedMore, this, selChangedPtr);
+  connect(controller->getSqlModel(), &SqlModel::totalRowCountChanged, this, selChangedPtr);
 
   connect(ui->dockWidgetSearch, &QDockWidget::visibilityChanged, this, &SearchBaseTable::dockVisibilityChanged);
 }
@@ -754,9 +755,9 @@ void SearchBaseTable::contextMenu(const QPoint& pos)
   ui->actionRouteAirportDest->setText(tr("Set as Flight Plan Destination"));
 
   ui->actionSearchTableCopy->setEnabled(index.isValid());
-  ui->actionSearchTableSelectAll->setEnabled(controller->getTotalRowCount() > 0);
+  ui->actionSearchTableSelectAll->setEnabled(controller->getVisibleRowCount() > 0);
   ui->actionSearchTableSelectNothing->setEnabled(
-    controller->getTotalRowCount() > 0 && view->selectionModel()->hasSelection());
+    controller->getVisibleRowCount() > 0 && view->selectionModel()->hasSelection());
 
   // Build the menu
   QMenu menu;
@@ -301,6 +301,16 @@ int SqlController::getTotalRowCount() const
     return 0;
 }
 
+int SqlController::waitForTotalRowCount()
+{
+  if(proxyModel != nullptr)
+    return proxyModel->rowCount();
+  else if(model != nullptr)
+    return model->waitForTotalRowCount();
+  else
+    return 0;
+}
+
 bool SqlController::isColumnVisibleInView(int physicalIndex) const
 {
   return view->columnWidth(physicalIndex) > view->horizontalHeader()->minimumSectionSize() + 1;
@@ -88,9 +88,12 @@ public:
   /* Number of rows currently loaded into the table view */
   int getVisibleRowCount() const;
 
-  /* Total number of rows returned by the last query */
+  /* Total number of rows returned by the last query or -1 if still counting in the background */
   int getTotalRowCount() const;
 
+  /* Total number of rows returned by the last query. Waits for the count if needed. */
+  int waitForTotalRowCount();
+
   /* Get the SQL query that was used to populate the table */
   QString getCurrentSqlQuery() const;
 
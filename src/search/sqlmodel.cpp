@@ -25,20 +25,69 @@
 #include "exception.h"
 #include "search/column.h"
 #include "sql/sqlrecord.h"
+#include "db/spatialindex.h"
+#include "db/textindex.h"
+#include "common/constants.h"
+#include "settings/settings.h"
 
 #include <QLineEdit>
 #include <QCheckBox>
 #include <QSqlError>
 #include <QRegularExpression>
+#include <QSqlDriver>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <sqlite3.h>
+
+#include <algorithm>
 
 using atools::sql::SqlQuery;
 using atools::sql::SqlDatabase;
 using atools::gui::ErrorHandler;
 using atools::sql::SqlRecord;
 
+namespace {
+
+/* Get the native handle of an open connection for sqlite3_interrupt. Returns null if the Qt driver uses another
+ * SQLite version than the one linked here since the handle cannot be passed between libraries then. */
+void *interruptHandle(SqlDatabase& database)
+{
+  QVariant handle = database.getQSqlDatabase().driver()->handle();
+  if(!handle.isValid() || qstrcmp(handle.typeName(), "sqlite3*") != 0)
+    return nullptr;
+
+  SqlQuery versionStmt(database);
+  versionStmt.exec("select sqlite_version()");
+  if(!versionStmt.next() || versionStmt.value(0).toString() != QLatin1String(sqlite3_libversion()))
+  {
+    static bool warned = false;
+    if(!warned)
+    {
+      qWarning() << Q_FUNC_INFO << "SQLite version mismatch. Qt driver" << versionStmt.value(0).toString()
+                 << "linked" << sqlite3_libversion() << "- cannot interrupt searches";
+      warned = true;
+    }
+    return nullptr;
+  }
+  return *static_cast<sqlite3 **>(handle.data());
+}
+
+}
+
 SqlModel::SqlModel(QWidget *parent, SqlDatabase *sqlDb, const ColumnList *columnList)
   : QSqlQueryModel(parent), db(sqlDb), columns(columnList), parentWidget(parent)
 {
+  QString id = QString::number(reinterpret_cast<quintptr>(this));
+  rowCountDatabaseName = "LNMDBSQLMODELCOUNT" + id;
+  searchThreadDatabaseName = "LNMDBSQLMODELSEARCH" + id;
+  connect(&rowCountWatcher, &QFutureWatcher<RowCountResult>::finished, this, &SqlModel::rowCountThreadFinished);
+  connect(&searchWatcher, &QFutureWatcher<SearchResult>::finished, this, &SqlModel::searchThreadFinished);
+
+  searchInBackground = atools::settings::Settings::instance().
+                       getAndStoreValue(lnm::SETTINGS_DATABASE + "SearchInBackground", true).toBool();
+
   // Set default handler
   setDataCallback(nullptr, QSet<Qt::ItemDataRole>());
 
@@ -47,6 +96,25 @@ SqlModel::SqlModel(QWidget *parent, SqlDatabase *sqlDb, const ColumnList *column
 
 SqlModel::~SqlModel()
 {
+  // Threads use this object - interrupt and wait for them
+  stopRowCount();
+  stopSearch();
+  rowCountFuture.waitForFinished();
+  searchFuture.waitForFinished();
+}
+
+void SqlModel::clear()
+{
+  // Database might be closed or replaced after this - running threads are interrupted and their results dropped
+  stopRowCount();
+  stopSearch();
+  rowCountCache.clear();
+
+  beginResetModel();
+  clearSearchRows();
+  QSqlQueryModel::clear();
+  modelGeneration = -1;
+  endResetModel();
 }
 
 void SqlModel::filterIncluding(QModelIndex index)
@@ -86,7 +154,7 @@ void SqlModel::filterByIdent(const QString& ident, const QString& region, const
 void SqlModel::filterBy(QModelIndex index, bool exclude)
 {
   QString whereCol = getSqlRecord().fieldName(index.column());
-  filterBy(exclude, whereCol, QSqlQueryModel::data(index));
+  filterBy(exclude, whereCol, rawData(index));
 }
 
 /* Simple include/exclude filter. Updates the attached search widgets */
@@ -424,9 +492,20 @@ void SqlModel::buildQuery()
   currentSqlQuery = "select " + queryCols + " from " + columns->getTablename() +
                     " " + queryWhere + " " + queryOrder;
 
-  // Build a query to find the total row count of the result
-  totalRowCount = 0;
-  QString queryCount = "select count(1) from " + columns->getTablename() + " " + queryWhere;
+  // Same query for the background search giving the ordered ids and optionally the rows
+  currentQueryCols = queryCols;
+  currentSearchQuery = "select " + columns->getIdColumnName() + " as lnm_result_id from " +
+                       columns->getTablename() + " " + queryWhere + " " + queryOrder;
+  currentSearchRowQuery = "select " + columns->getIdColumnName() + " as lnm_result_id, " + queryCols + " from " +
+                          columns->getTablename() + " " + queryWhere + " " + queryOrder;
+  searchGeneration++;
+
+  // Running search is outdated now
+  interruptSearch();
+
+  // Build a query to find the total row count of the result - this is run lazily after the query
+  totalRowCount = -1;
+  currentCountQuery = "select count(1) from " + columns->getTablename() + " " + queryWhere;
 
 #ifdef DEBUG_INFORMATION
   qDebug() << Q_FUNC_INFO << currentSqlQuery;
@@ -434,15 +513,22 @@ void SqlModel::buildQuery()
 
   try
   {
-    // Count total rows
-    SqlQuery countStmt(db);
-    countStmt.exec(queryCount);
-    if(countStmt.next())
-      totalRowCount = countStmt.value(0).toInt();
-
     if(!boundingRect.isValid())
+    {
       // Delay query for bounding rectangle query with proxy model
-      resetSqlQuery();
+      if(searchInBackground && db != nullptr && !record().isEmpty())
+        // Model has already a query with the same columns - keep it until the search is done
+        startSearch();
+      else
+      {
+        // First query or disabled - run it here
+        searchStartedGeneration = searchGeneration;
+        resetSqlQuery();
+
+        // Proxy model counts on its own
+        updateTotalRowCount();
+      }
+    }
   }
   catch(atools::Exception& e)
   {
@@ -460,6 +546,10 @@ QString SqlModel::buildWhere(const atools::sql::SqlRecord& tableCols)
   const static QRegularExpression REQUIRED_COL_MATCH(".*/\\*([A-Za-z0-9_]+)\\*/.*");
   QString queryWhere;
 
+  // Prefix searches on these columns can be narrowed down by the FTS table
+  QStringList textIndexColumns = textindex::indexedColumns(db, columns->getTablename());
+  QStringList textIndexTerms;
+
   int numCond = 0;
   for(const WhereCondition& cond : whereConditionMap)
   {
@@ -487,26 +577,49 @@ QString SqlModel::buildWhere(const atools::sql::SqlRecord& tableCols)
 
     if(!cond.value.isNull())
       queryWhere += buildWhereValue(cond);
+
+    if(cond.oper == "like" && !cond.col->isIncludesName() && textIndexColumns.contains(cond.col->getColumnName()))
+    {
+      QString term = textindex::prefixTerm(cond.col->getColumnName(), cond.value.toString());
+      if(!term.isEmpty())
+        textIndexTerms.append(term);
+    }
+  }
+
+  if(!textIndexTerms.isEmpty())
+  {
+    // Like conditions are kept since the index matches the prefix of any word and not only the string prefix
+    if(numCond++ > 0)
+      queryWhere += " " + WHERE_OPERATOR + " ";
+    queryWhere += textindex::matchCondition(columns->getTablename(), columns->getIdColumnName(), textIndexTerms);
   }
 
   if(boundingRect.isValid())
   {
-    QString rectCond;
-    if(boundingRect.crossesAntiMeridian())
+    // Use the R*Tree table for the coarse lookup if available and disable the coordinate indexes
+    bool spatial = spatialindex::hasIndex(db, columns->getTablename());
+
+    QStringList rectConds;
+    const QList<atools::geo::Rect> rects = boundingRect.crossesAntiMeridian() ?
+                                           boundingRect.splitAtAntiMeridian() :
+                                           QList<atools::geo::Rect>({boundingRect});
+    for(const atools::geo::Rect& rect : rects)
     {
-      QList<atools::geo::Rect> rect = boundingRect.splitAtAntiMeridian();
-
-      rectCond = QString("((lonx between %1 and %2 and laty between %3 and %4) or "
-                         "(lonx between %5 and %6 and laty between %7 and %8))").
-                 arg(rect.at(0).getTopLeft().getLonX()).arg(rect.at(0).getBottomRight().getLonX()).
-                 arg(rect.at(0).getBottomRight().getLatY()).arg(rect.at(0).getTopLeft().getLatY()).
-                 arg(rect.at(1).getTopLeft().getLonX()).arg(rect.at(1).getBottomRight().getLonX()).
-                 arg(rect.at(1).getBottomRight().getLatY()).arg(rect.at(1).getTopLeft().getLatY());
+      QString leftx = QString::number(rect.getTopLeft().getLonX()),
+              rightx = QString::number(rect.getBottomRight().getLonX()),
+              bottomy = QString::number(rect.getBottomRight().getLatY()),
+              topy = QString::number(rect.getTopLeft().getLatY());
+
+      if(spatial)
+        rectConds.append(QString("(%1 and +lonx between %2 and %3 and +laty between %4 and %5)").
+                         arg(spatialindex::rectCondition(columns->getTablename(), columns->getIdColumnName(),
+                                                         leftx, rightx, bottomy, topy)).
+                         arg(leftx).arg(rightx).arg(bottomy).arg(topy));
+      else
+        rectConds.append(QString("(lonx between %1 and %2 and laty between %3 and %4)").
+                         arg(leftx).arg(rightx).arg(bottomy).arg(topy));
     }
-    else
-      rectCond = QString("(lonx between %1 and %2 and laty between %3 and %4)").
-                 arg(boundingRect.getTopLeft().getLonX()).arg(boundingRect.getBottomRight().getLonX()).
-                 arg(boundingRect.getBottomRight().getLatY()).arg(boundingRect.getTopLeft().getLatY());
+    QString rectCond = rectConds.size() > 1 ? "(" + rectConds.join(" or ") + ")" : rectConds.first();
 
     if(numCond > 0)
       queryWhere += " " + WHERE_OPERATOR + " ";
@@ -542,7 +655,13 @@ QString SqlModel::buildWhereValue(const WhereCondition& cond)
 
 void SqlModel::resetSqlQuery()
 {
+  beginResetModel();
+
+  // Model does not read from a background search result anymore
+  clearSearchRows();
   QSqlQueryModel::setQuery(currentSqlQuery, db->getQSqlDatabase());
+  modelGeneration = searchGeneration;
+  endResetModel();
 
   if(lastError().isValid())
     atools::gui::ErrorHandler(parentWidget).handleSqlError(lastError());
@@ -575,14 +694,14 @@ QVariant SqlModel::data(const QModelIndex& index, int role) const
   Qt::ItemDataRole dataRole = static_cast<Qt::ItemDataRole>(role);
 
   // Get the default value for this role. Can be a font, color, etc.
-  QVariant roleValue = QSqlQueryModel::data(index, role);
+  QVariant roleValue = rawData(index, role);
 
   if(handlerRoles.contains(dataRole))
   {
     // Callback wants to be called for this role
 
     // Get data to display
-    QVariant dataValue = QSqlQueryModel::data(index, Qt::DisplayRole);
+    QVariant dataValue = rawData(index, Qt::DisplayRole);
     QString col = getSqlRecord().fieldName(index.column());
     const Column *column = columns->getColumn(col);
 
@@ -598,12 +717,426 @@ QVariant SqlModel::data(const QModelIndex& index, int role) const
   return roleValue;
 }
 
+QVariant SqlModel::rawData(const QModelIndex& index, int role) const
+{
+  if(!searchRowsActive)
+    return QSqlQueryModel::data(index, role);
+
+  // Same as QSqlQueryModel - only display and edit role are backed by data
+  if(!index.isValid() || index.row() >= searchRows.size() || (role != Qt::DisplayRole && role != Qt::EditRole))
+    return QVariant();
+
+  return searchRows.at(index.row()).value(index.column());
+}
+
+int SqlModel::rowCount(const QModelIndex& parent) const
+{
+  if(searchRowsActive)
+    return parent.isValid() ? 0 : searchRows.size();
+  else
+    return QSqlQueryModel::rowCount(parent);
+}
+
+bool SqlModel::canFetchMore(const QModelIndex& parent) const
+{
+  if(searchRowsActive)
+    return !parent.isValid() && searchRows.size() < searchIds.size();
+  else
+    return QSqlQueryModel::canFetchMore(parent);
+}
+
 void SqlModel::fetchMore(const QModelIndex& parent)
 {
-  QSqlQueryModel::fetchMore(parent);
+  if(searchRowsActive)
+  {
+    if(!parent.isValid())
+      fetchSearchRows();
+  }
+  else
+    QSqlQueryModel::fetchMore(parent);
+
+  if(totalRowCount == -1 && modelGeneration == searchGeneration && !canFetchMore())
+    // Reached the end of the current result before the count is done - not of a previous one still shown
+    setTotalRowCount(currentCountQuery, rowCount());
+
   emit fetchedMore();
 }
 
+void SqlModel::updateTotalRowCount()
+{
+  if(!canFetchMore())
+    // All rows already fetched with the first page - no need to count
+    setTotalRowCount(currentCountQuery, rowCount());
+  else if(rowCountCache.contains(currentCountQuery))
+    setTotalRowCount(currentCountQuery, rowCountCache.value(currentCountQuery));
+  else
+  {
+    // Count in background - replace any query waiting for the running one
+    pendingCountQuery = currentCountQuery;
+    startRowCount();
+  }
+}
+
+void SqlModel::setTotalRowCount(const QString& query, int count)
+{
+  if(rowCountCache.size() > MAX_ROW_COUNT_CACHE_SIZE)
+    rowCountCache.clear();
+  rowCountCache.insert(query, count);
+
+  if(query == currentCountQuery && count != totalRowCount)
+  {
+    totalRowCount = count;
+    emit totalRowCountChanged();
+  }
+}
+
+int SqlModel::waitForTotalRowCount()
+{
+  if(totalRowCount == -1)
+  {
+    if(rowCountFuture.isRunning())
+    {
+      // Let the thread finish and collect the result
+      rowCountFuture.waitForFinished();
+      rowCountThreadFinished();
+    }
+
+    if(totalRowCount == -1)
+    {
+      // Still not known - count here and drop any pending background count
+      pendingCountQuery.clear();
+      SqlQuery countStmt(db);
+      countStmt.exec(currentCountQuery);
+      if(countStmt.next())
+        setTotalRowCount(currentCountQuery, countStmt.value(0).toInt());
+    }
+  }
+  return totalRowCount;
+}
+
+void SqlModel::startRowCount()
+{
+  if(rowCountFuture.isRunning() || pendingCountQuery.isEmpty() || db == nullptr)
+    return;
+
+  QString query = pendingCountQuery;
+  pendingCountQuery.clear();
+
+  rowCountFuture = QtConcurrent::run(this, &SqlModel::rowCountThread, db->databaseName(),
+                                     rowCountDatabaseName, query, rowCountGeneration);
+
+  // Watcher will call rowCountThreadFinished when finished
+  rowCountWatcher.setFuture(rowCountFuture);
+}
+
+/* Interrupt the background thread without waiting. The result is dropped in rowCountThreadFinished. */
+void SqlModel::stopRowCount()
+{
+  pendingCountQuery.clear();
+  rowCountGeneration++;
+
+  QMutexLocker locker(&threadHandleMutex);
+  if(rowCountThreadHandle != nullptr)
+    sqlite3_interrupt(static_cast<sqlite3 *>(rowCountThreadHandle));
+}
+
+SqlModel::RowCountResult SqlModel::rowCountThread(QString databaseFile, QString connectionName, QString query,
+                                                  int generation)
+{
+  RowCountResult result;
+  result.query = query;
+  result.generation = generation;
+
+  // Database connections cannot be shared between threads
+  SqlDatabase::addDatabase("QSQLITE", connectionName);
+  {
+    SqlDatabase dbCount(connectionName);
+    try
+    {
+      dbCount.setDatabaseName(databaseFile);
+      dbCount.setReadonly();
+      dbCount.setAutocommit(true);
+      dbCount.open();
+
+      {
+        // Allow the GUI thread to interrupt the statement if the model is cleared
+        QMutexLocker locker(&threadHandleMutex);
+        rowCountThreadHandle = interruptHandle(dbCount);
+      }
+
+      // Query can refer to R*Tree tables in a separate file
+      spatialindex::attachSidecar(&dbCount, databaseFile);
+
+      SqlQuery countStmt(dbCount);
+      countStmt.exec(query);
+      if(countStmt.next())
+        result.count = countStmt.value(0).toInt();
+    }
+    catch(atools::Exception& e)
+    {
+      qWarning() << Q_FUNC_INFO << "Error counting rows" << e.what();
+    }
+    catch(...)
+    {
+      qWarning() << Q_FUNC_INFO << "Unknown exception counting rows";
+    }
+
+    {
+      // Connection is closed below
+      QMutexLocker locker(&threadHandleMutex);
+      rowCountThreadHandle = nullptr;
+    }
+
+    if(dbCount.isOpen())
+      dbCount.close();
+  }
+  SqlDatabase::removeDatabase(connectionName);
+
+  return result;
+}
+
+void SqlModel::startSearch()
+{
+  if(searchFuture.isRunning() || searchStartedGeneration == searchGeneration)
+    return;
+
+  // Show the first rows quickly and get the full result afterwards
+  runSearch(SEARCH_FIRST_PAGE_ROWS);
+}
+
+void SqlModel::runSearch(int limit)
+{
+  searchStartedGeneration = searchGeneration;
+
+  // First page is read including all columns while the full result contains only the ids
+  QString query = limit > 0 ? currentSearchRowQuery + " limit " + QString::number(limit) : currentSearchQuery;
+  searchFuture = QtConcurrent::run(this, &SqlModel::searchThread, db->databaseName(), query, searchGeneration,
+                                   limit);
+
+  // Watcher will call searchThreadFinished when finished
+  searchWatcher.setFuture(searchFuture);
+}
+
+void SqlModel::stopSearch()
+{
+  // Make the running search outdated without waiting - result is dropped in searchThreadFinished
+  searchGeneration++;
+  searchStartedGeneration = searchGeneration;
+  interruptSearch();
+}
+
+void SqlModel::interruptSearch()
+{
+  QMutexLocker locker(&threadHandleMutex);
+  if(searchThreadHandle != nullptr)
+    // Statement fails with an error in the thread
+    sqlite3_interrupt(static_cast<sqlite3 *>(searchThreadHandle));
+}
+
+SqlModel::SearchResult SqlModel::searchThread(QString databaseFile, QString query, int generation, int limit)
+{
+  SearchResult result;
+  result.generation = generation;
+
+  // Database connections cannot be shared between threads
+  SqlDatabase::addDatabase("QSQLITE", searchThreadDatabaseName);
+  {
+    SqlDatabase dbSearch(searchThreadDatabaseName);
+    try
+    {
+      dbSearch.setDatabaseName(databaseFile);
+      dbSearch.setReadonly();
+      dbSearch.setAutocommit(true);
+      dbSearch.open();
+
+      {
+        // Allow the GUI thread to interrupt the statement if the search is outdated
+        QMutexLocker locker(&threadHandleMutex);
+        searchThreadHandle = interruptHandle(dbSearch);
+      }
+
+      // Query can refer to R*Tree tables in a separate file
+      spatialindex::attachSidecar(&dbSearch, databaseFile);
+
+      // Plain Qt query to get the records including values which are handed over to the model
+      QSqlQuery searchStmt(dbSearch.getQSqlDatabase());
+      searchStmt.setForwardOnly(true);
+      if(searchStmt.exec(query))
+      {
+        while(searchStmt.next())
+        {
+          result.ids.append(searchStmt.value(0).toInt());
+
+          if(limit > 0)
+          {
+            QSqlRecord rec = searchStmt.record();
+            rec.remove(0);
+            result.rows.append(rec);
+          }
+        }
+      }
+
+      // Interrupted statements end with an error too
+      result.ok = !searchStmt.lastError().isValid();
+      if(!result.ok)
+        qWarning() << Q_FUNC_INFO << "Error running search" << searchStmt.lastError().text();
+
+      // Less rows than the limit - this is the full result
+      result.complete = limit <= 0 || result.ids.size() < limit;
+    }
+    catch(atools::Exception& e)
+    {
+      qWarning() << Q_FUNC_INFO << "Error running search" << e.what();
+      result.ok = false;
+    }
+    catch(...)
+    {
+      qWarning() << Q_FUNC_INFO << "Unknown exception running search";
+      result.ok = false;
+    }
+
+    {
+      // Connection is closed below
+      QMutexLocker locker(&threadHandleMutex);
+      searchThreadHandle = nullptr;
+    }
+
+    if(dbSearch.isOpen())
+      dbSearch.close();
+  }
+  SqlDatabase::removeDatabase(searchThreadDatabaseName);
+
+  return result;
+}
+
+/* Called by watcher when the thread is finished */
+void SqlModel::searchThreadFinished()
+{
+  if(searchFuture.isFinished() && searchFuture.resultCount() > 0)
+  {
+    SearchResult result = searchFuture.result();
+    searchFuture = QFuture<SearchResult>();
+
+    // Drop result if outdated since filter was changed in the meantime
+    if(result.generation == searchGeneration)
+    {
+      if(result.ok)
+      {
+        setSearchResult(result);
+
+        // The first page is not the full result
+        modelGeneration = result.complete ? result.generation : -1;
+
+        if(result.complete)
+          setTotalRowCount(currentCountQuery, result.ids.size());
+        else
+        {
+          // First page is shown - get the full result now
+          runSearch(0);
+          return;
+        }
+      }
+      else
+      {
+        // Failed - run query here
+        resetSqlQuery();
+        updateTotalRowCount();
+      }
+    }
+  }
+
+  // Start the next one if the query was changed in the meantime
+  startSearch();
+}
+
+void SqlModel::setSearchResult(const SearchResult& result)
+{
+  if(searchRowsActive && result.rows.isEmpty() && searchIds.size() <= result.ids.size() &&
+     std::equal(searchIds.constBegin(), searchIds.constEnd(), result.ids.constBegin()))
+  {
+    // Full result starts with the rows of the first page already shown - keep them and the view position
+    searchIds = result.ids;
+    return;
+  }
+
+  beginResetModel();
+
+  // Model needs an empty query with the same columns for headers and records
+  QSqlQueryModel::setQuery("select " + currentQueryCols + " from " + columns->getTablename() + " limit 0",
+                           db->getQSqlDatabase());
+  searchIds = result.ids;
+  searchRows = result.rows;
+  searchRowsActive = true;
+  endResetModel();
+
+  if(lastError().isValid())
+    qWarning() << Q_FUNC_INFO << "Error reading columns" << lastError().text();
+
+  if(searchRows.isEmpty())
+    // Full result without first page - read the first rows here
+    fetchSearchRows();
+}
+
+void SqlModel::fetchSearchRows()
+{
+  int from = searchRows.size();
+  int to = std::min(from + SEARCH_FIRST_PAGE_ROWS, searchIds.size());
+  if(from >= to)
+    return;
+
+  QStringList idList;
+  for(int i = from; i < to; i++)
+    idList.append(QString::number(searchIds.at(i)));
+
+  // Lookup by primary key is fast enough to be done here
+  QHash<int, QSqlRecord> recordsById;
+  QSqlQuery rowStmt(db->getQSqlDatabase());
+  rowStmt.setForwardOnly(true);
+  if(rowStmt.exec("select " + columns->getIdColumnName() + " as lnm_result_id, " + currentQueryCols +
+                  " from " + columns->getTablename() +
+                  " where " + columns->getIdColumnName() + " in (" + idList.join(",") + ")"))
+  {
+    while(rowStmt.next())
+    {
+      QSqlRecord rec = rowStmt.record();
+      rec.remove(0);
+      recordsById.insert(rowStmt.value(0).toInt(), rec);
+    }
+  }
+  else
+    qWarning() << Q_FUNC_INFO << "Error reading rows" << rowStmt.lastError().text();
+
+  beginInsertRows(QModelIndex(), from, to - 1);
+  for(int i = from; i < to; i++)
+    // Use empty record if the row was not found
+    searchRows.append(recordsById.value(searchIds.at(i), record()));
+  endInsertRows();
+}
+
+void SqlModel::clearSearchRows()
+{
+  searchRowsActive = false;
+  searchIds.clear();
+  searchRows.clear();
+}
+
+/* Called by watcher when the thread is finished */
+void SqlModel::rowCountThreadFinished()
+{
+  if(rowCountFuture.isFinished() && rowCountFuture.resultCount() > 0)
+  {
+    RowCountResult result = rowCountFuture.result();
+    rowCountFuture = QFuture<RowCountResult>();
+
+    // Drop results of interrupted counts and counts started before the model was cleared
+    if(result.generation == rowCountGeneration && result.count >= 0)
+      setTotalRowCount(result.query, result.count);
+  }
+
+  // Start the next one if the query was changed in the meantime
+  startRowCount();
+}
+
 QVariant SqlModel::getRawData(int row, const QString& colname) const
 {
   return getRawData(row, getSqlRecord().indexOf(colname));
@@ -616,7 +1149,7 @@ void SqlModel::updateSqlQuery()
 
 QVariant SqlModel::getRawData(int row, int col) const
 {
-  return QSqlQueryModel::data(createIndex(row, col));
+  return rawData(createIndex(row, col));
 }
 
 QString SqlModel::getColumnName(int col) const
@@ -636,5 +1169,8 @@ atools::sql::SqlRecord SqlModel::getSqlRecord() const
 
 atools::sql::SqlRecord SqlModel::getSqlRecord(int row) const
 {
-  return atools::sql::SqlRecord(record(row), currentSqlQuery);
+  if(searchRowsActive)
+    return atools::sql::SqlRecord(searchRows.value(row, record()), currentSqlQuery);
+  else
+    return atools::sql::SqlRecord(record(row), currentSqlQuery);
 }
@@ -23,6 +23,11 @@
 #include <functional>
 
 #include <QSqlQueryModel>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMutex>
+#include <QSqlRecord>
+#include <QVector>
 
 namespace atools {
 namespace sql {
@@ -37,6 +42,11 @@ class ColumnList;
 
 /*
  * Extends the QSqlQueryModel and adds query building based on filters and ordering.
+ * The total row count for a query is not known when the first rows are shown. It is calculated
+ * in a background thread if needed and signalled by totalRowCountChanged.
+ * Filter and sort changes run the query in a background thread which returns the rows of the first page and
+ * then the ordered ids of the full result. The model switches to the new result when it is done and keeps showing
+ * the previous result until then. Further rows of a background result are read by id when fetching more.
  */
 class SqlModel :
   public QSqlQueryModel
@@ -94,11 +104,18 @@ public:
     return orderByColIndex;
   }
 
+  /* Total number of rows for the current query or -1 if the count is still running in the background */
   int getTotalRowCount() const
   {
     return totalRowCount;
   }
 
+  /* Total number of rows for the current query. Waits for the background count or counts if needed. */
+  int waitForTotalRowCount();
+
+  /* Clear the model, stop counting and drop all cached row counts */
+  virtual void clear() override;
+
   QString getCurrentSqlQuery() const
   {
     return currentSqlQuery;
@@ -106,6 +123,8 @@ public:
 
   /* Fetch more data and emit signal fetchedMore */
   virtual void fetchMore(const QModelIndex& parent) override;
+  virtual bool canFetchMore(const QModelIndex& parent = QModelIndex()) const override;
+  virtual int rowCount(const QModelIndex& parent = QModelIndex()) const override;
 
   /* Get unformatted data from the model */
   QVariant getRawData(int row, int col) const;
@@ -159,6 +178,9 @@ signals:
   /* Emitted when more data was fetched */
   void fetchedMore();
 
+  /* Emitted when the total row count is known */
+  void totalRowCountChanged();
+
 private:
   // Hide the record method
   using QSqlQueryModel::record;
@@ -183,6 +205,68 @@ private:
   QVariant defaultDataHandler(int colIndex, int rowIndex, const Column *col, const QVariant& roleValue,
                               const QVariant& displayRoleValue, Qt::ItemDataRole role) const;
 
+  /* Get total row count from fetched rows or cache or start a count in background */
+  void updateTotalRowCount();
+  void startRowCount();
+  void stopRowCount();
+  void setTotalRowCount(const QString& query, int count);
+
+  /* Count query and number of rows */
+  struct RowCountResult
+  {
+    QString query;
+    int count = -1; /* -1 if counting failed or was interrupted */
+    int generation = 0; /* Matches rowCountGeneration if still valid */
+  };
+
+  /* Runs the count query in a separate thread using its own database connection */
+  RowCountResult rowCountThread(QString databaseFile, QString connectionName, QString query, int generation);
+  void rowCountThreadFinished();
+
+  /* Maximum number of cached counts before the cache is cleared */
+  static Q_DECL_CONSTEXPR int MAX_ROW_COUNT_CACHE_SIZE = 200;
+
+  /* Number of rows fetched before the full search result. Same as the fetch size of QSqlQueryModel. */
+  static Q_DECL_CONSTEXPR int SEARCH_FIRST_PAGE_ROWS = 256;
+
+  /* Result of a background search */
+  struct SearchResult
+  {
+    QVector<int> ids; /* Ordered ids of the first page or the full result */
+    QVector<QSqlRecord> rows; /* Rows of the first page. Empty for the full result. */
+    int generation = 0; /* Matches searchGeneration if still current */
+    bool ok = false; /* false if the search failed or was interrupted */
+    bool complete = true; /* false if only the first page was fetched */
+  };
+
+  /* Start search for the current query in background unless one is already running.
+   * Fetches the first page and then the full result. */
+  void startSearch();
+
+  /* Start the search thread for the current query. Result is limited to limit rows if limit is > 0. */
+  void runSearch(int limit);
+
+  /* Interrupt the SQL statement of an outdated search. Does not wait for the thread and its result is dropped. */
+  void stopSearch();
+
+  /* Interrupt the SQL statement running in the search thread if any */
+  void interruptSearch();
+
+  /* Runs the search query in a separate thread using its own database connection.
+   * Rows are returned only if limit is > 0, otherwise only the ids. */
+  SearchResult searchThread(QString databaseFile, QString query, int generation, int limit);
+  void searchThreadFinished();
+
+  /* Show the rows of a background search result in the model */
+  void setSearchResult(const SearchResult& result);
+
+  /* Read the next page of rows for the ids of a background search result */
+  void fetchSearchRows();
+  void clearSearchRows();
+
+  /* Get data from the background search result or from the query */
+  QVariant rawData(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
   /* Default - all conditions are combined using "and" */
   const QString WHERE_OPERATOR = "and";
 
@@ -210,6 +294,50 @@ private:
   QWidget *parentWidget;
   int totalRowCount = 0;
 
+  /* Count query for the current where clause */
+  QString currentCountQuery;
+
+  /* Count query waiting until the background thread is done. Only the last one is kept. */
+  QString pendingCountQuery;
+
+  /* Maps count query to result to avoid counting again when going back to a previous search */
+  QHash<QString, int> rowCountCache;
+
+  /* Unique connection name for the background thread */
+  QString rowCountDatabaseName;
+
+  QFuture<RowCountResult> rowCountFuture;
+  QFutureWatcher<RowCountResult> rowCountWatcher;
+
+  /* Incremented when the model is cleared to drop results of counts still running */
+  int rowCountGeneration = 0;
+
+  /* Run filter and sort queries in background */
+  bool searchInBackground = true;
+
+  /* Column list and queries returning the ordered ids or ids and all columns of the current result */
+  QString currentQueryCols, currentSearchQuery, currentSearchRowQuery;
+
+  /* Incremented for each new query. searchStartedGeneration is the last one passed to the thread. */
+  int searchGeneration = 0, searchStartedGeneration = 0;
+
+  /* Generation of the query or complete search result the model rows belong to. -1 if incomplete or empty. */
+  int modelGeneration = -1;
+
+  QString searchThreadDatabaseName;
+
+  /* Background search result shown instead of the model query if searchRowsActive is true */
+  bool searchRowsActive = false;
+  QVector<int> searchIds;
+  QVector<QSqlRecord> searchRows;
+
+  QFuture<SearchResult> searchFuture;
+  QFutureWatcher<SearchResult> searchWatcher;
+
+  /* Native sqlite3 handles of the thread connections while they are open. Null if interrupting is not possible. */
+  void *searchThreadHandle = nullptr, *rowCountThreadHandle = nullptr;
+  QMutex threadHandleMutex;
+
 };
 
 #endif // LITTLENAVMAP_SQLMODEL_H
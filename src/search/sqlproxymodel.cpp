@@ -21,6 +21,7 @@
 #include "search/sqlmodel.h"
 #include "common/unit.h"
 #include "common/mapflags.h"
+#include "sql/sqlrecord.h"
 
 #include <QApplication>
 
@@ -29,6 +30,11 @@ using namespace atools::geo;
 SqlProxyModel::SqlProxyModel(QObject *parent, SqlModel *sqlModel)
   : QSortFilterProxyModel(parent), sourceSqlModel(sqlModel)
 {
+  // Connect before the source model is assigned so the cache is cleared before the proxy filters again
+  connect(sourceSqlModel, &QAbstractItemModel::modelReset, this, &SqlProxyModel::resetDistanceCache);
+  connect(sourceSqlModel, &QAbstractItemModel::layoutChanged, this, &SqlProxyModel::resetDistanceCache);
+  connect(sourceSqlModel, &QAbstractItemModel::rowsRemoved, this, &SqlProxyModel::resetDistanceCache);
+  resetDistanceCache();
 }
 
 SqlProxyModel::~SqlProxyModel()
@@ -43,11 +49,41 @@ void SqlProxyModel::setDistanceFilter(const Pos& center, sqlproxymodel::SearchDi
   maxDistMeter = nmToMeter(maxDistance);
   centerPos = center;
   direction = dir;
+  resetDistanceCache();
 }
 
 void SqlProxyModel::clearDistanceFilter()
 {
   centerPos = Pos();
+  resetDistanceCache();
+}
+
+void SqlProxyModel::resetDistanceCache()
+{
+  distanceCache.clear();
+
+  atools::sql::SqlRecord rec = sourceSqlModel->getSqlRecord();
+  lonxColumn = rec.indexOf("lonx");
+  latyColumn = rec.indexOf("laty");
+  distanceColumn = rec.indexOf("distance");
+  headingColumn = rec.indexOf("heading");
+}
+
+SqlProxyModel::DistanceEntry SqlProxyModel::distanceEntry(int sourceRow) const
+{
+  if(sourceRow >= distanceCache.size())
+    // More rows fetched - grow cache
+    distanceCache.resize(std::max(sourceRow + 1, sourceSqlModel->rowCount()));
+
+  DistanceEntry& entry = distanceCache[sourceRow];
+  if(!entry.valid)
+  {
+    Pos pos = buildPos(sourceRow);
+    entry.distMeter = pos.distanceMeterTo(centerPos);
+    entry.heading = normalizeCourse(centerPos.angleDegTo(pos));
+    entry.valid = true;
+  }
+  return entry;
 }
 
 /* Does the filtering by minimum and maximum distance and direction */
@@ -55,45 +91,44 @@ bool SqlProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex& sourcePar
 {
   Q_UNUSED(sourceParent);
 
-  Pos pos = buildPos(sourceRow);
-  float heading = normalizeCourse(centerPos.angleDegTo(pos));
+  DistanceEntry entry = distanceEntry(sourceRow);
+  float heading = entry.heading;
 
   switch(direction)
   {
     case sqlproxymodel::ALL:
       // All directions
-      return matchDistance(pos);
+      return matchDistance(entry.distMeter);
 
     case sqlproxymodel::NORTH:
       if(MIN_NORTH_DEG <= heading || heading <= MAX_NORTH_DEG)
-        return matchDistance(pos);
+        return matchDistance(entry.distMeter);
       else
         return false;
 
     case sqlproxymodel::EAST:
       if(MIN_EAST_DEG <= heading && heading <= MAX_EAST_DEG)
-        return matchDistance(pos);
+        return matchDistance(entry.distMeter);
       else
         return false;
 
     case sqlproxymodel::SOUTH:
       if(MIN_SOUTH_DEG <= heading && heading <= MAX_SOUTH_DEG)
-        return matchDistance(pos);
+        return matchDistance(entry.distMeter);
       else
         return false;
 
     case sqlproxymodel::WEST:
       if(MIN_WEST_DEG <= heading && heading <= MAX_WEST_DEG)
-        return matchDistance(pos);
+        return matchDistance(entry.distMeter);
       else
         return false;
   }
   return true;
 }
 
-bool SqlProxyModel::matchDistance(const Pos& pos) const
+bool SqlProxyModel::matchDistance(float distMeter) const
 {
-  float distMeter = pos.distanceMeterTo(centerPos);
   return distMeter >= minDistMeter && distMeter <= maxDistMeter;
 }
 
@@ -119,23 +154,15 @@ QVariant SqlProxyModel::headerData(int section, Qt::Orientation orientation, int
 /* Defines greater and lower than for sorting of the two columns distance and heading */
 bool SqlProxyModel::lessThan(const QModelIndex& sourceLeft, const QModelIndex& sourceRight) const
 {
-  QString leftCol = sourceSqlModel->getColumnName(sourceLeft.column());
-  QString rightCol = sourceSqlModel->getColumnName(sourceRight.column());
+  int leftCol = sourceLeft.column();
+  int rightCol = sourceRight.column();
 
-  if(leftCol == "distance" && rightCol == "distance")
-  {
+  if(leftCol == distanceColumn && rightCol == distanceColumn)
     // Sort by distance
-    float distLeft = buildPos(sourceLeft.row()).distanceMeterTo(centerPos);
-    float distRight = buildPos(sourceRight.row()).distanceMeterTo(centerPos);
-    return distLeft < distRight;
-  }
-  else if(leftCol == "heading" && rightCol == "heading")
-  {
+    return distanceEntry(sourceLeft.row()).distMeter < distanceEntry(sourceRight.row()).distMeter;
+  else if(leftCol == headingColumn && rightCol == headingColumn)
     // Sort by heading
-    float headingLeft = normalizeCourse(centerPos.angleDegTo(buildPos(sourceLeft.row())));
-    float headingRight = normalizeCourse(centerPos.angleDegTo(buildPos(sourceRight.row())));
-    return headingLeft < headingRight;
-  }
+    return distanceEntry(sourceLeft.row()).heading < distanceEntry(sourceRight.row()).heading;
   else
     // Let the model do the sorting for other columns
     return QSortFilterProxyModel::lessThan(sourceLeft, sourceRight);
@@ -144,18 +171,18 @@ bool SqlProxyModel::lessThan(const QModelIndex& sourceLeft, const QModelIndex& s
 /* Returns the formatted data for the "distance" and "heading" column */
 QVariant SqlProxyModel::data(const QModelIndex& index, int role) const
 {
-  if(sourceSqlModel->getColumnName(index.column()) == "distance")
+  if(index.column() == distanceColumn)
   {
     if(role == Qt::DisplayRole)
-      return Unit::distMeter(buildPos(mapToSource(index).row()).distanceMeterTo(centerPos), false);
+      return Unit::distMeter(distanceEntry(mapToSource(index).row()).distMeter, false);
     else if(role == Qt::TextAlignmentRole)
       return Qt::AlignRight;
   }
-  else if(sourceSqlModel->getColumnName(index.column()) == "heading")
+  else if(index.column() == headingColumn)
   {
     if(role == Qt::DisplayRole)
     {
-      float heading = normalizeCourse(centerPos.angleDegTo(buildPos(mapToSource(index).row())));
+      float heading = distanceEntry(mapToSource(index).row()).heading;
       if(heading < map::INVALID_COURSE_VALUE)
         return QLocale().toString(heading, 'f', 0);
       else
@@ -170,5 +197,6 @@ QVariant SqlProxyModel::data(const QModelIndex& index, int role) const
 
 Pos SqlProxyModel::buildPos(int row) const
 {
-  return Pos(sourceSqlModel->getRawData(row, "lonx").toFloat(), sourceSqlModel->getRawData(row, "laty").toFloat());
+  return Pos(sourceSqlModel->getRawData(row, lonxColumn).toFloat(),
+             sourceSqlModel->getRawData(row, latyColumn).toFloat());
 }
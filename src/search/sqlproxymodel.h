@@ -21,6 +21,7 @@
 #include "geo/pos.h"
 
 #include <QSortFilterProxyModel>
+#include <QVector>
 
 class SqlModel;
 
@@ -46,6 +47,8 @@ enum SearchDirection
  * and direction.
  * Dynamic loading on demand (like the SQL model does) does not work with this model. Therefore all results
  * have to be fetched.
+ * Distance and heading to the center are calculated only once per source row and kept in a cache which is
+ * used for filtering, sorting and display. The cache is cleared when the filter or the source model changes.
  */
 class SqlProxyModel :
   public QSortFilterProxyModel
@@ -78,9 +81,22 @@ private:
   virtual bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override;
   virtual bool lessThan(const QModelIndex& sourceLeft, const QModelIndex& sourceRight) const override;
 
-  bool matchDistance(const atools::geo::Pos& pos) const;
+  /* Cached distance and heading from center point for one source row */
+  struct DistanceEntry
+  {
+    float distMeter = 0.f, heading = 0.f;
+    bool valid = false;
+  };
+
+  bool matchDistance(float distMeter) const;
   atools::geo::Pos buildPos(int row) const;
 
+  /* Get distance and heading for source row from the cache. Calculates and caches the values if needed. */
+  DistanceEntry distanceEntry(int sourceRow) const;
+
+  /* Clear all cached values and look up column indexes again. Called on filter or source model change. */
+  void resetDistanceCache();
+
   /* Direction filter ranges are decreased by this value on each side */
   static float Q_DECL_CONSTEXPR DIR_RANGE_DEG = 22.5f;
 
@@ -95,6 +111,11 @@ private:
   sqlproxymodel::SearchDirection direction;
   float minDistMeter = 0.f, maxDistMeter = 0.f;
 
+  /* Indexed by source row */
+  mutable QVector<DistanceEntry> distanceCache;
+
+  /* Column indexes in the source model to avoid name lookups for each row and comparison */
+  int lonxColumn = -1, latyColumn = -1, distanceColumn = -1, headingColumn = -1;
 };
 
 #endif // LITTLENAVMAP_SQLPROXYMODEL_H